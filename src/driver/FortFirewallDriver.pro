@@ -8,9 +8,12 @@ SOURCES += \
     fortbuf.c \
     fortcb.c \
     fortcnf.c \
+    fortcnt.c \
     fortcout.c \
+    fortdedup.c \
     fortdev.c \
     fortdrv.c \
+    fortflow.c \
     fortmod.c \
     fortpkt.c \
     fortpool.c \
@@ -20,7 +23,9 @@ SOURCES += \
     forttds.c \
     forttlsf.c \
     forttmr.c \
+    forttrc.c \
     fortutl.c \
+    fortvch.c \
     fortwrk.c \
     loader/fortdl.c \
     loader/fortimg.c \
@@ -28,6 +33,7 @@ SOURCES += \
     proxycb/fortpcb_drv.c \
     proxycb/fortpcb_dst.c \
     proxycb/fortpcb_src.c \
+    test/bench.c \
     test/main.c \
     wdm/um_aux_klib.c \
     wdm/um_fwpmk.c \
@@ -41,9 +47,12 @@ HEADERS += \
     fortbuf.h \
     fortcb.h \
     fortcnf.h \
+    fortcnt.h \
     fortcout.h \
+    fortdedup.h \
     fortdev.h \
     fortdrv.h \
+    fortflow.h \
     fortmod.h \
     fortpkt.h \
     fortpool.h \
@@ -53,7 +62,9 @@ HEADERS += \
     forttds.h \
     forttlsf.h \
     forttmr.h \
+    forttrc.h \
     fortutl.h \
+    fortvch.h \
     fortwrk.h \
     loader/fortdl.h \
     loader/fortimg.h \
@@ -62,6 +73,7 @@ HEADERS += \
     proxycb/fortpcb_drv.h \
     proxycb/fortpcb_dst.h \
     proxycb/fortpcb_src.h \
+    test/bench.h \
     wdm/um_aux_klib.h \
     wdm/um_fwpmk.h \
     wdm/um_fwpsk.h \
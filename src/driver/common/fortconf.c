@@ -30,49 +30,222 @@ FORT_API BOOL is_time_in_period(FORT_TIME time, FORT_PERIOD period)
     return (from <= to ? (x >= from && x < (to - 1)) : (x >= from || x < (to - 1)));
 }
 
-static BOOL fort_conf_ip_find(UINT32 ip, UINT32 count, const UINT32 *iparr, BOOL is_range)
+#if defined(_M_AMD64) || defined(__x86_64__)
+#    define FORT_CONF_IP_SIMD_SSE2
+#    include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#    define FORT_CONF_IP_SIMD_NEON
+#    include <arm_neon.h>
+#endif
+
+#define FORT_CONF_IP_NODE_CHILDREN (FORT_CONF_IP_NODE_KEYS + 1)
+#define FORT_CONF_IP_LEVEL_MAX     8
+
+/* Count of the node's keys, which are less than or equal to the IP */
+static UINT32 fort_conf_ip_node_rank(const UINT32 *node, UINT32 ip)
 {
-    if (count == 0)
-        return FALSE;
+#if defined(FORT_CONF_IP_SIMD_SSE2)
+    /* There is no unsigned compare in SSE2, so flip the sign bits */
+    const __m128i bias = _mm_set1_epi32((int) 0x80000000);
+    const __m128i x = _mm_xor_si128(_mm_set1_epi32((int) ip), bias);
+
+    const __m128i *v = (const __m128i *) node;
+    const __m128i gt0 = _mm_cmpgt_epi32(_mm_xor_si128(_mm_loadu_si128(v + 0), bias), x);
+    const __m128i gt1 = _mm_cmpgt_epi32(_mm_xor_si128(_mm_loadu_si128(v + 1), bias), x);
+    const __m128i gt2 = _mm_cmpgt_epi32(_mm_xor_si128(_mm_loadu_si128(v + 2), bias), x);
+    const __m128i gt3 = _mm_cmpgt_epi32(_mm_xor_si128(_mm_loadu_si128(v + 3), bias), x);
+
+    const unsigned long mask = _mm_movemask_ps(_mm_castsi128_ps(gt0))
+            | (_mm_movemask_ps(_mm_castsi128_ps(gt1)) << 4)
+            | (_mm_movemask_ps(_mm_castsi128_ps(gt2)) << 8)
+            | (_mm_movemask_ps(_mm_castsi128_ps(gt3)) << 12);
+
+    /* Keys are sorted, so the greater ones are at the end */
+    return bit_scan_forward(mask | (1 << FORT_CONF_IP_NODE_KEYS));
+#elif defined(FORT_CONF_IP_SIMD_NEON)
+    const uint32x4_t x = vdupq_n_u32(ip);
+
+    uint32x4_t n = vshrq_n_u32(vcleq_u32(vld1q_u32(node + 0), x), 31);
+    n = vaddq_u32(n, vshrq_n_u32(vcleq_u32(vld1q_u32(node + 4), x), 31));
+    n = vaddq_u32(n, vshrq_n_u32(vcleq_u32(vld1q_u32(node + 8), x), 31));
+    n = vaddq_u32(n, vshrq_n_u32(vcleq_u32(vld1q_u32(node + 12), x), 31));
+
+    return vaddvq_u32(n);
+#else
+    UINT32 n = 0;
+    for (int i = 0; i < FORT_CONF_IP_NODE_KEYS; ++i) {
+        n += (node[i] <= ip);
+    }
+    return n;
+#endif
+}
 
-    int low = 0;
-    int high = count - 1;
+static UINT32 fort_conf_ip_keys_rank(const UINT32 *keys, UINT32 count, UINT32 ip)
+{
+    if (count == FORT_CONF_IP_NODE_KEYS)
+        return fort_conf_ip_node_rank(keys, ip);
 
-    do {
-        const int mid = (low + high) / 2;
-        const UINT32 mid_ip = iparr[mid];
+    UINT32 n = 0;
+    for (UINT32 i = 0; i < count; ++i) {
+        n += (keys[i] <= ip);
+    }
+    return n;
+}
 
-        if (ip < mid_ip)
-            high = mid - 1;
-        else if (ip > mid_ip)
-            low = mid + 1;
-        else
-            return TRUE;
-    } while (low <= high);
+/* Get node counts of the index levels, from the bottom one */
+static int fort_conf_ip_index_levels(UINT32 count, UINT32 *level_sizes)
+{
+    UINT32 nodes_n = (count + (FORT_CONF_IP_NODE_KEYS - 1)) / FORT_CONF_IP_NODE_KEYS;
+    int levels_n = 0;
 
-    if (!is_range)
-        return FALSE;
+    while (nodes_n > 1) {
+        nodes_n = (nodes_n + (FORT_CONF_IP_NODE_CHILDREN - 1)) / FORT_CONF_IP_NODE_CHILDREN;
+        level_sizes[levels_n++] = nodes_n;
+    }
+
+    return levels_n;
+}
+
+FORT_API UINT32 fort_conf_ip_index_size(UINT32 count)
+{
+    UINT32 level_sizes[FORT_CONF_IP_LEVEL_MAX];
+    UINT32 nodes_n = 0;
 
-    return high >= 0 && ip >= iparr[high] && ip <= iparr[count + high];
+    const int levels_n = fort_conf_ip_index_levels(count, level_sizes);
+    for (int i = 0; i < levels_n; ++i) {
+        nodes_n += level_sizes[i];
+    }
+
+    return nodes_n * FORT_CONF_IP_NODE_SIZE;
+}
+
+FORT_API UINT32 fort_conf_addr_list_size(UINT32 ip_n, UINT32 pair_n)
+{
+    return FORT_CONF_ADDR_LIST_SIZE(ip_n, pair_n) + fort_conf_ip_index_size(ip_n)
+            + fort_conf_ip_index_size(pair_n);
 }
 
-static BOOL fort_conf_ip_inarr(UINT32 ip, UINT32 count, const UINT32 *iparr)
+FORT_API UINT32 fort_conf_zones_size(UINT32 interval_n)
 {
-    return fort_conf_ip_find(ip, count, iparr, FALSE);
+    return FORT_CONF_ZONES_DATA_OFF + FORT_CONF_IP_RANGE_SIZE(interval_n)
+            + fort_conf_ip_index_size(interval_n);
+}
+
+#ifndef FORT_DRIVER
+FORT_API void fort_conf_ip_index_build(const UINT32 *keys, UINT32 count, UINT32 *index)
+{
+    UINT32 level_sizes[FORT_CONF_IP_LEVEL_MAX];
+
+    const int levels_n = fort_conf_ip_index_levels(count, level_sizes);
+    if (levels_n == 0)
+        return;
+
+    /* Count of the keys, covered by a node of the current level */
+    UINT32 node_span = FORT_CONF_IP_NODE_KEYS;
+    UINT32 lower_n = (count + (FORT_CONF_IP_NODE_KEYS - 1)) / FORT_CONF_IP_NODE_KEYS;
+
+    /* Levels are stored from the root down to the bottom one */
+    UINT32 *level = index + fort_conf_ip_index_size(count) / sizeof(UINT32);
+
+    for (int i = 0; i < levels_n; ++i) {
+        const UINT32 nodes_n = level_sizes[i];
+
+        level -= nodes_n * FORT_CONF_IP_NODE_KEYS;
+
+        for (UINT32 node_index = 0; node_index < nodes_n; ++node_index) {
+            UINT32 *node = level + node_index * FORT_CONF_IP_NODE_KEYS;
+
+            /* Separator is the first key of the next child's subtree */
+            for (UINT32 k = 0; k < FORT_CONF_IP_NODE_KEYS; ++k) {
+                const UINT32 child = node_index * FORT_CONF_IP_NODE_CHILDREN + k + 1;
+
+                node[k] = (child < lower_n) ? keys[child * node_span] : (UINT32) -1;
+            }
+        }
+
+        node_span *= FORT_CONF_IP_NODE_CHILDREN;
+        lower_n = nodes_n;
+    }
 }
+#endif
 
-static BOOL fort_conf_ip_inrange(UINT32 ip, UINT32 count, const UINT32 *iprange)
+/* Find the position of the last key, which is less than or equal to the IP */
+FORT_API int fort_conf_ip_index_find(
+        UINT32 ip, UINT32 count, const UINT32 *keys, const UINT32 *index)
 {
-    return fort_conf_ip_find(ip, count, iprange, TRUE);
+    if (count == 0)
+        return -1;
+
+    UINT32 level_sizes[FORT_CONF_IP_LEVEL_MAX];
+    const int levels_n = fort_conf_ip_index_levels(count, level_sizes);
+
+    const UINT32 blocks_n = (count + (FORT_CONF_IP_NODE_KEYS - 1)) / FORT_CONF_IP_NODE_KEYS;
+    const UINT32 *level = index;
+    UINT32 child = 0;
+
+    /* Descend from the root */
+    for (int i = levels_n; --i >= 0;) {
+        const UINT32 *node = level + child * FORT_CONF_IP_NODE_KEYS;
+        const UINT32 lower_n = (i > 0) ? level_sizes[i - 1] : blocks_n;
+
+        child = child * FORT_CONF_IP_NODE_CHILDREN + fort_conf_ip_node_rank(node, ip);
+        if (child >= lower_n) {
+            child = lower_n - 1;
+        }
+
+        level += level_sizes[i] * FORT_CONF_IP_NODE_KEYS;
+    }
+
+    /* Search in the keys block */
+    const UINT32 base = child * FORT_CONF_IP_NODE_KEYS;
+    const UINT32 n = count - base;
+    const UINT32 rank = fort_conf_ip_keys_rank(
+            keys + base, (n < FORT_CONF_IP_NODE_KEYS ? n : FORT_CONF_IP_NODE_KEYS), ip);
+
+    return (int) (base + rank) - 1;
 }
 
 #define fort_conf_addr_list_ip_ref(addr_list)   (addr_list)->ip
 #define fort_conf_addr_list_pair_ref(addr_list) &(addr_list)->ip[(addr_list)->ip_n]
+#define fort_conf_addr_list_ip_index_ref(addr_list)                                                \
+    &(addr_list)->ip[(addr_list)->ip_n + (addr_list)->pair_n * 2]
+#define fort_conf_addr_list_pair_index_ref(addr_list)                                              \
+    (fort_conf_addr_list_ip_index_ref(addr_list)                                                   \
+            + fort_conf_ip_index_size((addr_list)->ip_n) / sizeof(UINT32))
+
+static BOOL fort_conf_ip_inarr(
+        UINT32 ip, UINT32 count, const UINT32 *iparr, const UINT32 *index)
+{
+    const int pos = fort_conf_ip_index_find(ip, count, iparr, index);
+
+    return pos >= 0 && iparr[pos] == ip;
+}
+
+static BOOL fort_conf_ip_inrange(
+        UINT32 ip, UINT32 count, const UINT32 *iprange, const UINT32 *index)
+{
+    const int pos = fort_conf_ip_index_find(ip, count, iprange, index);
+
+    return pos >= 0 && ip <= iprange[count + pos];
+}
 
 FORT_API BOOL fort_conf_ip_inlist(UINT32 ip, const PFORT_CONF_ADDR_LIST addr_list)
 {
-    return fort_conf_ip_inarr(ip, addr_list->ip_n, fort_conf_addr_list_ip_ref(addr_list))
-            || fort_conf_ip_inrange(ip, addr_list->pair_n, fort_conf_addr_list_pair_ref(addr_list));
+    return fort_conf_ip_inarr(ip, addr_list->ip_n, fort_conf_addr_list_ip_ref(addr_list),
+                   fort_conf_addr_list_ip_index_ref(addr_list))
+            || fort_conf_ip_inrange(ip, addr_list->pair_n, fort_conf_addr_list_pair_ref(addr_list),
+                    fort_conf_addr_list_pair_index_ref(addr_list));
+}
+
+FORT_API UINT32 fort_conf_zones_ip_find(const PFORT_CONF_ZONES zones, UINT32 ip)
+{
+    const UINT32 count = zones->interval_n;
+    const UINT32 *index = &zones->ip[count * 2];
+
+    /* Find the last interval, which starts at or before the IP */
+    const int pos = fort_conf_ip_index_find(ip, count, zones->ip, index);
+
+    return (pos >= 0) ? zones->ip[count + pos] : 0;
 }
 
 FORT_API PFORT_CONF_ADDR_GROUP fort_conf_addr_group_ref(const PFORT_CONF conf, int addr_group_index)
@@ -83,28 +256,32 @@ FORT_API PFORT_CONF_ADDR_GROUP fort_conf_addr_group_ref(const PFORT_CONF conf, i
     return (PFORT_CONF_ADDR_GROUP) (addr_group_data + addr_group_offsets[addr_group_index]);
 }
 
-static BOOL fort_conf_ip_included_check(const PFORT_CONF_ADDR_LIST addr_list,
-        fort_conf_zones_ip_included_func zone_func, void *ctx, UINT32 remote_ip, UINT32 zones_mask,
-        BOOL list_is_empty)
+static BOOL fort_conf_ip_included_check(const PFORT_CONF_ADDR_LIST addr_list, UINT32 remote_ip,
+        UINT32 zones_mask, UINT32 ip_zones_mask, BOOL list_is_empty)
 {
     return (!list_is_empty && fort_conf_ip_inlist(remote_ip, addr_list))
-            || (zone_func != NULL && zone_func(ctx, zones_mask, remote_ip));
+            || (zones_mask & ip_zones_mask) != 0;
 }
 
 FORT_API BOOL fort_conf_ip_included(const PFORT_CONF conf,
-        fort_conf_zones_ip_included_func zone_func, void *ctx, UINT32 remote_ip,
-        int addr_group_index)
+        fort_conf_zones_ip_mask_func zone_func, void *ctx, UINT32 remote_ip, int addr_group_index)
 {
     const PFORT_CONF_ADDR_GROUP addr_group = fort_conf_addr_group_ref(conf, addr_group_index);
 
     const BOOL include_all = addr_group->include_all;
     const BOOL exclude_all = addr_group->exclude_all;
 
+    /* Lookup zones, containing the IP, once */
+    const UINT32 ip_zones_mask =
+            (zone_func != NULL && (addr_group->include_zones | addr_group->exclude_zones) != 0)
+            ? zone_func(ctx, remote_ip)
+            : 0;
+
     /* Include All */
     const BOOL ip_excluded = exclude_all
             ? TRUE
             : fort_conf_ip_included_check(fort_conf_addr_group_exclude_list_ref(addr_group),
-                    zone_func, ctx, remote_ip, addr_group->exclude_zones,
+                    remote_ip, addr_group->exclude_zones, ip_zones_mask,
                     addr_group->exclude_is_empty);
     if (include_all)
         return !ip_excluded;
@@ -113,7 +290,7 @@ FORT_API BOOL fort_conf_ip_included(const PFORT_CONF conf,
     const BOOL ip_included = include_all
             ? TRUE
             : fort_conf_ip_included_check(fort_conf_addr_group_include_list_ref(addr_group),
-                    zone_func, ctx, remote_ip, addr_group->include_zones,
+                    remote_ip, addr_group->include_zones, ip_zones_mask,
                     addr_group->include_is_empty);
     if (exclude_all)
         return ip_included;
@@ -161,19 +338,36 @@ FORT_API FORT_APP_FLAGS fort_conf_app_exe_find(
     return app_flags;
 }
 
-static int fort_conf_app_prefix_cmp(PFORT_APP_ENTRY app_entry, const char *path, UINT32 path_len)
+static PFORT_APP_ENTRY fort_conf_app_entry_at(
+        const char *app_entries, const UINT32 *app_offsets, UINT16 app_index)
 {
-    const char *app_path = (const char *) (app_entry + 1);
-    const UINT32 app_path_len = app_entry->path_len;
+    return (PFORT_APP_ENTRY) (app_entries + app_offsets[app_index]);
+}
+
+static PFORT_CONF_PREFIX_NODE fort_conf_prefix_node_child(
+        const PFORT_CONF_PREFIX_TRIE trie, const PFORT_CONF_PREFIX_NODE node, WCHAR c)
+{
+    int low = node->child_off;
+    int high = low + node->child_n - 1;
+
+    while (low <= high) {
+        const int mid = (low + high) / 2;
+        const PFORT_CONF_PREFIX_NODE child = (const PFORT_CONF_PREFIX_NODE) &trie->nodes[mid];
+        const WCHAR mid_c = child->c;
 
-    if (path_len > app_path_len)
-        path_len = app_path_len;
+        if (c < mid_c)
+            high = mid - 1;
+        else if (c > mid_c)
+            low = mid + 1;
+        else
+            return child;
+    }
 
-    return fort_memcmp(path, app_path, path_len);
+    return NULL;
 }
 
 static FORT_APP_FLAGS fort_conf_app_prefix_find(
-        const PFORT_CONF conf, const char *path, UINT32 path_len)
+        const PFORT_CONF conf, const WCHAR *path, UINT32 path_len)
 {
     FORT_APP_FLAGS app_flags;
     const UINT16 count = conf->prefix_apps_n;
@@ -187,32 +381,160 @@ static FORT_APP_FLAGS fort_conf_app_prefix_find(
     const UINT32 *app_offsets = (const UINT32 *) (data + conf->prefix_apps_off);
 
     const char *app_entries = (const char *) (app_offsets + count + 1);
-    int low = 0;
-    int high = count - 1;
+    const PFORT_CONF_PREFIX_TRIE trie =
+            (const PFORT_CONF_PREFIX_TRIE) (data + conf->prefix_trie_off);
 
-    do {
+    const UINT32 path_n = path_len / sizeof(WCHAR);
+    UINT32 pos = 0;
+
+    PFORT_CONF_PREFIX_NODE node = (const PFORT_CONF_PREFIX_NODE) &trie->nodes[0];
+
+    /* Walk down to the longest matching prefix */
+    for (;;) {
+        if (node->app_id != 0) {
+            app_flags = fort_conf_app_entry_at(app_entries, app_offsets, node->app_id - 1)->flags;
+        }
+
+        if (pos >= path_n)
+            break;
+
+        const PFORT_CONF_PREFIX_NODE child = fort_conf_prefix_node_child(trie, node, path[pos]);
+        if (child == NULL || child->label_len > path_n - pos)
+            break;
+
+        const PFORT_APP_ENTRY label_entry =
+                fort_conf_app_entry_at(app_entries, app_offsets, child->label_app);
+        const WCHAR *label = (const WCHAR *) (label_entry + 1) + child->label_pos;
+
+        if (fort_memcmp((const char *) (path + pos), (const char *) label,
+                    child->label_len * sizeof(WCHAR))
+                != 0)
+            break;
+
+        pos += child->label_len;
+        node = child;
+    }
+
+    return app_flags;
+}
+
+typedef struct fort_conf_wild_candidates
+{
+    UINT16 from; /* minimal app index to collect */
+    UINT16 n;
+
+    BOOL overflow;
+
+    UINT16 indexes[FORT_CONF_WILD_CANDIDATES_MAX]; /* sorted */
+} FORT_CONF_WILD_CANDIDATES, *PFORT_CONF_WILD_CANDIDATES;
+
+/* Keep the least app indexes to check them in the config's order */
+static void fort_conf_wild_candidate_add(PFORT_CONF_WILD_CANDIDATES cands, UINT16 app_index)
+{
+    if (app_index < cands->from)
+        return;
+
+    UINT16 n = cands->n;
+    UINT16 pos = n;
+
+    while (pos > 0 && cands->indexes[pos - 1] > app_index) {
+        --pos;
+    }
+
+    if (pos > 0 && cands->indexes[pos - 1] == app_index)
+        return; /* already added */
+
+    if (n == FORT_CONF_WILD_CANDIDATES_MAX) {
+        cands->overflow = TRUE;
+
+        if (pos == n)
+            return;
+
+        --n; /* drop the greatest one */
+    }
+
+    for (UINT16 i = n; i > pos; --i) {
+        cands->indexes[i] = cands->indexes[i - 1];
+    }
+
+    cands->indexes[pos] = app_index;
+    cands->n = n + 1;
+}
+
+static int fort_conf_wild_state_edge(
+        const PFORT_CONF_WILD_STATE state, const WCHAR *edge_chars, WCHAR c)
+{
+    int low = state->edge_off;
+    int high = low + state->edge_n - 1;
+
+    while (low <= high) {
         const int mid = (low + high) / 2;
-        const UINT32 app_off = app_offsets[mid];
-        const PFORT_APP_ENTRY app_entry = (PFORT_APP_ENTRY) (app_entries + app_off);
-        const int res = fort_conf_app_prefix_cmp(app_entry, path, path_len);
+        const WCHAR mid_c = edge_chars[mid];
 
-        if (res < 0)
+        if (c < mid_c)
             high = mid - 1;
-        else if (res > 0)
+        else if (c > mid_c)
             low = mid + 1;
-        else {
-            app_flags = app_entry->flags;
-            break;
+        else
+            return mid;
+    }
+
+    return -1;
+}
+
+/* Collect apps, which anchors are found in the path */
+static void fort_conf_wild_index_collect(const PFORT_CONF_WILD_INDEX index, const WCHAR *path,
+        UINT32 path_n, PFORT_CONF_WILD_CANDIDATES cands)
+{
+    const PFORT_CONF_WILD_STATE states = (const PFORT_CONF_WILD_STATE) index->data;
+    const UINT32 *edge_targets = (const UINT32 *) (states + index->state_n);
+    const WCHAR *edge_chars = (const WCHAR *) (edge_targets + index->edge_n);
+    const UINT16 *outs = (const UINT16 *) ((const char *) edge_chars
+            + FORT_CONF_STR_DATA_SIZE(index->edge_n * sizeof(WCHAR)));
+    const UINT16 *anys = outs + index->out_n;
+
+    for (UINT32 i = 0; i < index->any_n; ++i) {
+        fort_conf_wild_candidate_add(cands, anys[i]);
+    }
+
+    UINT32 state_index = 0;
+
+    for (UINT32 i = 0; i < path_n; ++i) {
+        const WCHAR c = path[i];
+
+        for (;;) {
+            const int edge = fort_conf_wild_state_edge(&states[state_index], edge_chars, c);
+            if (edge >= 0) {
+                state_index = edge_targets[edge];
+                break;
+            }
+
+            if (state_index == 0)
+                break;
+
+            state_index = states[state_index].fail;
         }
-    } while (low <= high);
 
-    return app_flags;
+        UINT32 out_index =
+                (states[state_index].out_n != 0) ? state_index : states[state_index].out_link;
+
+        while (out_index != 0) {
+            const PFORT_CONF_WILD_STATE state = &states[out_index];
+
+            for (UINT32 j = 0; j < state->out_n; ++j) {
+                fort_conf_wild_candidate_add(cands, outs[state->out_off + j]);
+            }
+
+            out_index = state->out_link;
+        }
+    }
 }
 
-static FORT_APP_FLAGS fort_conf_app_wild_find(const PFORT_CONF conf, const char *path)
+static FORT_APP_FLAGS fort_conf_app_wild_find(
+        const PFORT_CONF conf, const WCHAR *path, UINT32 path_len)
 {
     FORT_APP_FLAGS app_flags;
-    UINT16 count = conf->wild_apps_n;
+    const UINT16 count = conf->wild_apps_n;
 
     app_flags.v = 0;
 
@@ -220,20 +542,34 @@ static FORT_APP_FLAGS fort_conf_app_wild_find(const PFORT_CONF conf, const char
         return app_flags;
 
     const char *data = conf->data;
-    const char *app_entries = (const char *) (data + conf->wild_apps_off);
+    const UINT32 *app_offsets = (const UINT32 *) (data + conf->wild_apps_off);
+
+    const char *app_entries = (const char *) (app_offsets + count + 1);
+    const PFORT_CONF_WILD_INDEX index = (const PFORT_CONF_WILD_INDEX) (data + conf->wild_index_off);
+
+    FORT_CONF_WILD_CANDIDATES cands;
+    cands.from = 0;
 
     do {
-        const PFORT_APP_ENTRY app_entry = (const PFORT_APP_ENTRY) app_entries;
-        const WCHAR *app_path = (const WCHAR *) (app_entry + 1);
-        const int res = wildmatch(app_path, (const WCHAR *) path);
+        cands.n = 0;
+        cands.overflow = FALSE;
 
-        if (res == WM_MATCH) {
-            app_flags = app_entry->flags;
-            break;
+        fort_conf_wild_index_collect(index, path, path_len / sizeof(WCHAR), &cands);
+
+        for (UINT16 i = 0; i < cands.n; ++i) {
+            const PFORT_APP_ENTRY app_entry =
+                    (const PFORT_APP_ENTRY) (app_entries + app_offsets[cands.indexes[i]]);
+            const WCHAR *app_path = (const WCHAR *) (app_entry + 1);
+
+            if (wildmatch(app_path, path) == WM_MATCH) {
+                app_flags = app_entry->flags;
+                return app_flags;
+            }
         }
 
-        app_entries += FORT_CONF_APP_ENTRY_SIZE(app_entry->path_len);
-    } while (--count != 0);
+        /* Check the next candidates */
+        cands.from = cands.indexes[FORT_CONF_WILD_CANDIDATES_MAX - 1] + 1;
+    } while (cands.overflow);
 
     return app_flags;
 }
@@ -247,11 +583,11 @@ FORT_API FORT_APP_FLAGS fort_conf_app_find(const PFORT_CONF conf, const PVOID pa
     if (app_flags.v != 0)
         return app_flags;
 
-    app_flags = fort_conf_app_prefix_find(conf, path, path_len);
+    app_flags = fort_conf_app_prefix_find(conf, (const WCHAR *) path, path_len);
     if (app_flags.v != 0)
         return app_flags;
 
-    return fort_conf_app_wild_find(conf, path);
+    return fort_conf_app_wild_find(conf, path, path_len);
 }
 
 static BOOL fort_conf_app_blocked_check(const PFORT_CONF conf, INT8 *block_reason, BOOL app_found,
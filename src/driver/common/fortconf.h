@@ -6,6 +6,8 @@
 #define FORT_CONF_IP_MAX             (2 * 1024 * 1024)
 #define FORT_CONF_IP_ARR_SIZE(n)     ((n) * sizeof(UINT32))
 #define FORT_CONF_IP_RANGE_SIZE(n)   (FORT_CONF_IP_ARR_SIZE(n) * 2)
+#define FORT_CONF_IP_NODE_KEYS       16 /* keys per index node of 64 bytes */
+#define FORT_CONF_IP_NODE_SIZE       (FORT_CONF_IP_NODE_KEYS * sizeof(UINT32))
 #define FORT_CONF_ZONE_MAX           32
 #define FORT_CONF_GROUP_MAX          16
 #define FORT_CONF_APPS_LEN_MAX       (64 * 1024 * 1024)
@@ -38,12 +40,14 @@ typedef struct fort_conf_flags
 
 static_assert(sizeof(FORT_CONF_FLAGS) == sizeof(UINT32), "FORT_CONF_FLAGS is not 32 bits");
 
+/* Sorted IP-s and ranges are followed by their static B+tree indexes,
+ * nodes of each index are stored level by level from the root. */
 typedef struct fort_conf_addr_list
 {
     UINT32 ip_n;
     UINT32 pair_n;
 
-    UINT32 ip[1];
+    UINT32 ip[1]; /* IP-s, ranges' from and to IP-s, then IP-s and from IP-s indexes */
 } FORT_CONF_ADDR_LIST, *PFORT_CONF_ADDR_LIST;
 
 typedef struct fort_conf_addr_group
@@ -61,14 +65,16 @@ typedef struct fort_conf_addr_group
     char data[4];
 } FORT_CONF_ADDR_GROUP, *PFORT_CONF_ADDR_GROUP;
 
+/* Zones are merged into sorted non-overlapping IP intervals,
+ * each of them has a mask of zones, containing its addresses. */
 typedef struct fort_conf_zones
 {
     UINT32 mask;
     UINT32 enabled_mask;
 
-    UINT32 addr_off[FORT_CONF_ZONE_MAX];
+    UINT32 interval_n;
 
-    char data[4];
+    UINT32 ip[1]; /* interval start IP-s, then zones masks, then start IP-s index */
 } FORT_CONF_ZONES, *PFORT_CONF_ZONES;
 
 typedef struct fort_conf_zone_flag
@@ -147,6 +153,52 @@ typedef struct fort_app_entry
     };
 } FORT_APP_ENTRY, *PFORT_APP_ENTRY;
 
+#define FORT_CONF_WILD_CANDIDATES_MAX 32 /* wildcard apps to check per automaton's pass */
+
+/* Aho-Corasick automaton over the longest literal anchors of wildcard apps' paths */
+typedef struct fort_conf_wild_state
+{
+    UINT32 edge_off; /* index of the first edge */
+    UINT32 edge_n;
+
+    UINT32 out_off; /* index of the first app, which anchor ends at the state */
+    UINT32 out_n;
+
+    UINT32 fail; /* state of the longest proper suffix */
+    UINT32 out_link; /* nearest state with outputs by fail links, 0 if none */
+} FORT_CONF_WILD_STATE, *PFORT_CONF_WILD_STATE;
+
+typedef struct fort_conf_wild_index
+{
+    UINT32 state_n;
+    UINT32 edge_n;
+    UINT32 out_n;
+    UINT32 any_n; /* count of apps without anchors */
+
+    char data[4]; /* states, edges' targets and chars, outputs' and anchorless apps' indexes */
+} FORT_CONF_WILD_INDEX, *PFORT_CONF_WILD_INDEX;
+
+/* Compressed trie of prefix apps' paths: a walk finds the longest matching prefix */
+typedef struct fort_conf_prefix_node
+{
+    WCHAR c; /* first char of the label */
+    UINT16 label_len; /* in chars */
+    UINT16 label_app; /* index of the app, which path contains the label */
+    UINT16 label_pos; /* position of the label in the app's path, in chars */
+
+    UINT16 app_id; /* index + 1 of the app, which path ends at the node, or 0 */
+    UINT16 child_n;
+
+    UINT32 child_off; /* index of the first child node, children are sorted by first chars */
+} FORT_CONF_PREFIX_NODE, *PFORT_CONF_PREFIX_NODE;
+
+typedef struct fort_conf_prefix_trie
+{
+    UINT32 node_n;
+
+    FORT_CONF_PREFIX_NODE nodes[1]; /* the root is first */
+} FORT_CONF_PREFIX_TRIE, *PFORT_CONF_PREFIX_TRIE;
+
 typedef struct fort_conf_group
 {
     UINT16 log_conn;
@@ -176,7 +228,9 @@ typedef struct fort_conf
     UINT32 app_periods_off;
 
     UINT32 wild_apps_off;
+    UINT32 wild_index_off;
     UINT32 prefix_apps_off;
+    UINT32 prefix_trie_off;
     UINT32 exe_apps_off;
 
     char data[4];
@@ -187,6 +241,109 @@ typedef struct fort_conf_version
     UINT16 driver_version;
 } FORT_CONF_VERSION, *PFORT_CONF_VERSION;
 
+#define FORT_TRACE_CLASSIFY 1 /* connection's classify */
+#define FORT_TRACE_PATH     2 /* defines the path id, the path's chars are in the next records */
+
+#define FORT_TRACE_INBOUND  0x01
+#define FORT_TRACE_REAUTH   0x02
+#define FORT_TRACE_BLOCKED  0x04
+#define FORT_TRACE_CONTINUE 0x08 /* allowed, the search is continued */
+#define FORT_TRACE_KEPT     0x10 /* reauthorized flow is kept as is */
+
+#define FORT_TRACE_RESTART 0x01 /* drain's flag: drop the pending records and redefine the paths */
+
+typedef struct fort_trace_record
+{
+    UCHAR type;
+    UCHAR flags;
+    UINT16 path_id;
+
+    union {
+        struct
+        {
+            UCHAR ip_proto;
+            INT8 block_reason;
+            UINT16 reserved;
+
+            UINT32 process_id;
+            UINT32 conf_gen;
+
+            UINT32 local_ip;
+            UINT32 remote_ip;
+            UINT16 local_port;
+            UINT16 remote_port;
+
+            UINT32 ticks; /* performance counter ticks of the classify */
+        };
+
+        UINT32 path_len; /* FORT_TRACE_PATH: in bytes */
+    };
+} FORT_TRACE_RECORD, *PFORT_TRACE_RECORD;
+
+typedef struct fort_trace_header
+{
+    UINT32 record_n;
+    UINT32 lost_n; /* records dropped, when the ring was full */
+
+    INT64 ticks_freq; /* performance counter frequency */
+} FORT_TRACE_HEADER, *PFORT_TRACE_HEADER;
+
+#define FORT_CALLOUT_CONNECT_V4       0
+#define FORT_CALLOUT_ACCEPT_V4        1
+#define FORT_CALLOUT_STREAM_V4        2
+#define FORT_CALLOUT_DATAGRAM_V4      3
+#define FORT_CALLOUT_IN_TRANSPORT_V4  4
+#define FORT_CALLOUT_OUT_TRANSPORT_V4 5
+#define FORT_CALLOUT_FLOW_DELETE_V4   6
+#define FORT_CALLOUT_COUNT            7
+
+#define FORT_CALLOUT_LATENCY_BUCKETS 24 /* bucket i counts [2^(i-1), 2^i) ticks, the last: more */
+
+typedef struct fort_callout_stat
+{
+    UINT64 calls;
+    UINT64 permits; /* permitted or continued */
+    UINT64 blocks;
+    UINT64 defers; /* absorbed: queued or dropped */
+    UINT64 reauths; /* ALE reauthorizations, also counted by their actions */
+
+    UINT64 latency[FORT_CALLOUT_LATENCY_BUCKETS]; /* log2 histogram of the callout's ticks */
+} FORT_CALLOUT_STAT, *PFORT_CALLOUT_STAT;
+
+typedef struct fort_callout_stats
+{
+    INT64 ticks_freq; /* performance counter frequency */
+
+    FORT_CALLOUT_STAT callouts[FORT_CALLOUT_COUNT];
+} FORT_CALLOUT_STATS, *PFORT_CALLOUT_STATS;
+
+#define FORT_DRIVER_STAT_FLOWS               0 /* active flows */
+#define FORT_DRIVER_STAT_CACHE_HITS          1 /* verdict cache */
+#define FORT_DRIVER_STAT_CACHE_MISSES        2
+#define FORT_DRIVER_STAT_FLOWS_FULL          3 /* failed flow additions */
+#define FORT_DRIVER_STAT_SHAPER_DEFERS       4 /* datagrams of the speed limited groups */
+#define FORT_DRIVER_STAT_SHAPER_DROPS        5
+#define FORT_DRIVER_STAT_FLOW_REASSOC        6 /* existing flows, associated on reauth. */
+#define FORT_DRIVER_STAT_FLOW_LAYERS_AVOIDED 7 /* flow-context associations, not needed */
+#define FORT_DRIVER_STAT_DEFER_QUEUE_MAX     8 /* the deepest queue of deferred packets */
+#define FORT_DRIVER_STAT_DEFER_WAITS         9 /* re-injected packets */
+#define FORT_DRIVER_STAT_DEFER_WAIT_MAX      10 /* microseconds in queue */
+#define FORT_DRIVER_STAT_DEFER_WAIT_SUM      11
+#define FORT_DRIVER_STAT_COUNT               12
+
+/* The driver's gauges and counters, indexed by FORT_DRIVER_STAT_* */
+typedef struct fort_driver_stats
+{
+    UINT64 values[FORT_DRIVER_STAT_COUNT];
+} FORT_DRIVER_STATS, *PFORT_DRIVER_STATS;
+
+/* Output of FORT_IOCTL_GETSTATS */
+typedef struct fort_stats
+{
+    FORT_CALLOUT_STATS callout;
+    FORT_DRIVER_STATS driver;
+} FORT_STATS, *PFORT_STATS;
+
 typedef struct fort_conf_io
 {
     FORT_CONF_GROUP conf_group;
@@ -194,19 +351,29 @@ typedef struct fort_conf_io
     FORT_CONF conf;
 } FORT_CONF_IO, *PFORT_CONF_IO;
 
-#define FORT_CONF_DATA_OFF       offsetof(FORT_CONF, data)
-#define FORT_CONF_IO_CONF_OFF    offsetof(FORT_CONF_IO, conf)
-#define FORT_CONF_ADDR_LIST_OFF  offsetof(FORT_CONF_ADDR_LIST, ip)
-#define FORT_CONF_ADDR_GROUP_OFF offsetof(FORT_CONF_ADDR_GROUP, data)
-#define FORT_CONF_ZONES_DATA_OFF offsetof(FORT_CONF_ZONES, data)
+#define FORT_CONF_DATA_OFF        offsetof(FORT_CONF, data)
+#define FORT_CONF_IO_CONF_OFF     offsetof(FORT_CONF_IO, conf)
+#define FORT_CONF_ADDR_LIST_OFF   offsetof(FORT_CONF_ADDR_LIST, ip)
+#define FORT_CONF_ADDR_GROUP_OFF  offsetof(FORT_CONF_ADDR_GROUP, data)
+#define FORT_CONF_ZONES_DATA_OFF  offsetof(FORT_CONF_ZONES, ip)
+#define FORT_CONF_WILD_INDEX_OFF  offsetof(FORT_CONF_WILD_INDEX, data)
+#define FORT_CONF_PREFIX_TRIE_OFF offsetof(FORT_CONF_PREFIX_TRIE, nodes)
 
 #define FORT_CONF_ADDR_LIST_SIZE(ip_n, pair_n)                                                     \
     (FORT_CONF_ADDR_LIST_OFF + FORT_CONF_IP_ARR_SIZE(ip_n) + FORT_CONF_IP_RANGE_SIZE(pair_n))
 
+#define FORT_CONF_WILD_INDEX_SIZE(state_n, edge_n, out_n, any_n)                                   \
+    (FORT_CONF_WILD_INDEX_OFF + (state_n) * sizeof(FORT_CONF_WILD_STATE)                           \
+            + FORT_CONF_IP_ARR_SIZE(edge_n) + FORT_CONF_STR_DATA_SIZE((edge_n) * sizeof(WCHAR))    \
+            + FORT_CONF_STR_DATA_SIZE(((out_n) + (any_n)) * sizeof(UINT16)))
+
+#define FORT_CONF_PREFIX_TRIE_SIZE(node_n)                                                         \
+    (FORT_CONF_PREFIX_TRIE_OFF + (node_n) * sizeof(FORT_CONF_PREFIX_NODE))
+
 typedef FORT_APP_FLAGS fort_conf_app_exe_find_func(
         const PFORT_CONF conf, const PVOID path, UINT32 path_len);
 
-typedef BOOL fort_conf_zones_ip_included_func(void *ctx, UINT32 zones_mask, UINT32 remote_ip);
+typedef UINT32 fort_conf_zones_ip_mask_func(void *ctx, UINT32 remote_ip);
 
 #if defined(__cplusplus)
 extern "C" {
@@ -216,8 +383,23 @@ FORT_API int bit_scan_forward(unsigned long mask);
 
 FORT_API BOOL is_time_in_period(FORT_TIME time, FORT_PERIOD period);
 
+FORT_API UINT32 fort_conf_ip_index_size(UINT32 count);
+
+FORT_API UINT32 fort_conf_addr_list_size(UINT32 ip_n, UINT32 pair_n);
+
+FORT_API UINT32 fort_conf_zones_size(UINT32 interval_n);
+
+#ifndef FORT_DRIVER
+FORT_API void fort_conf_ip_index_build(const UINT32 *keys, UINT32 count, UINT32 *index);
+#endif
+
+FORT_API int fort_conf_ip_index_find(
+        UINT32 ip, UINT32 count, const UINT32 *keys, const UINT32 *index);
+
 FORT_API BOOL fort_conf_ip_inlist(UINT32 ip, const PFORT_CONF_ADDR_LIST addr_list);
 
+FORT_API UINT32 fort_conf_zones_ip_find(const PFORT_CONF_ZONES zones, UINT32 ip);
+
 FORT_API PFORT_CONF_ADDR_GROUP fort_conf_addr_group_ref(
         const PFORT_CONF conf, int addr_group_index);
 
@@ -228,8 +410,7 @@ FORT_API PFORT_CONF_ADDR_GROUP fort_conf_addr_group_ref(
     ((PFORT_CONF_ADDR_LIST) ((addr_group)->data + (addr_group)->exclude_off))
 
 FORT_API BOOL fort_conf_ip_included(const PFORT_CONF conf,
-        fort_conf_zones_ip_included_func zone_func, void *ctx, UINT32 remote_ip,
-        int addr_group_index);
+        fort_conf_zones_ip_mask_func zone_func, void *ctx, UINT32 remote_ip, int addr_group_index);
 
 #define fort_conf_ip_is_inet(conf, zone_func, ctx, remote_ip)                                      \
     fort_conf_ip_included((conf), (zone_func), (ctx), (remote_ip), 0)
@@ -9,6 +9,9 @@ enum FortLogType {
     FORT_LOG_TYPE_PROC_NEW,
     FORT_LOG_TYPE_STAT_TRAF,
     FORT_LOG_TYPE_TIME,
+    FORT_LOG_TYPE_PATH_DEFINE,
+    FORT_LOG_TYPE_BLOCKED_IP_REPEAT,
+    FORT_LOG_TYPE_ALLOWED_IP,
 };
 
 enum FortBlockReason {
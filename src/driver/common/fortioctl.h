@@ -81,13 +81,17 @@ DEFINE_GUID(FORT_GUID_FILTER_REAUTH_OUT, 0x749709ce, 0x9686, 0x4056, 0xb8, 0x9a,
 
 #define FORT_CTL_CODE(i, a) CTL_CODE(FORT_DEVICE_TYPE, FORT_IOCTL_BASE + (i), METHOD_BUFFERED, (a))
 
-#define FORT_IOCTL_VALIDATE    FORT_CTL_CODE(0, FILE_WRITE_DATA)
-#define FORT_IOCTL_SETCONF     FORT_CTL_CODE(1, FILE_WRITE_DATA)
-#define FORT_IOCTL_SETFLAGS    FORT_CTL_CODE(2, FILE_WRITE_DATA)
-#define FORT_IOCTL_GETLOG      FORT_CTL_CODE(3, FILE_READ_DATA)
-#define FORT_IOCTL_ADDAPP      FORT_CTL_CODE(4, FILE_WRITE_DATA)
-#define FORT_IOCTL_DELAPP      FORT_CTL_CODE(5, FILE_WRITE_DATA)
-#define FORT_IOCTL_SETZONES    FORT_CTL_CODE(6, FILE_WRITE_DATA)
-#define FORT_IOCTL_SETZONEFLAG FORT_CTL_CODE(7, FILE_WRITE_DATA)
+#define FORT_IOCTL_VALIDATE     FORT_CTL_CODE(0, FILE_WRITE_DATA)
+#define FORT_IOCTL_SETCONF      FORT_CTL_CODE(1, FILE_WRITE_DATA)
+#define FORT_IOCTL_SETFLAGS     FORT_CTL_CODE(2, FILE_WRITE_DATA)
+#define FORT_IOCTL_GETLOG       FORT_CTL_CODE(3, FILE_READ_DATA)
+#define FORT_IOCTL_ADDAPP       FORT_CTL_CODE(4, FILE_WRITE_DATA)
+#define FORT_IOCTL_DELAPP       FORT_CTL_CODE(5, FILE_WRITE_DATA)
+#define FORT_IOCTL_SETZONES     FORT_CTL_CODE(6, FILE_WRITE_DATA)
+#define FORT_IOCTL_SETZONEFLAG  FORT_CTL_CODE(7, FILE_WRITE_DATA)
+#define FORT_IOCTL_MAPLOG       FORT_CTL_CODE(9, FILE_READ_DATA)
+#define FORT_IOCTL_PATCHCONF    FORT_CTL_CODE(10, FILE_WRITE_DATA)
+#define FORT_IOCTL_GETTRACE     FORT_CTL_CODE(11, FILE_READ_DATA)
+#define FORT_IOCTL_GETSTATS     FORT_CTL_CODE(12, FILE_READ_DATA)
 
 #endif // FORTIOCTL_H
@@ -17,7 +17,7 @@ FORT_API void fort_log_blocked_write(
 {
     fort_log_blocked_header_write(p, blocked, pid, path_len);
 
-    if (path_len != 0) {
+    if (fort_log_path_size(path_len) != 0) {
         RtlCopyMemory(p + FORT_LOG_BLOCKED_HEADER_SIZE, path, path_len);
     }
 }
@@ -28,7 +28,7 @@ FORT_API void fort_log_blocked_header_read(
     const UINT32 *up = (const UINT32 *) p;
 
     *blocked = (fort_log_type(up) == FORT_LOG_TYPE_BLOCKED);
-    *path_len = (*up++ & ~FORT_LOG_FLAG_EX_MASK);
+    *path_len = (*up++ & FORT_LOG_PATH_MASK);
     *pid = *up;
 }
 
@@ -54,7 +54,7 @@ void fort_log_blocked_ip_write(char *p, BOOL inbound, BOOL inherited, UCHAR bloc
     fort_log_blocked_ip_header_write(p, inbound, inherited, block_reason, ip_proto, local_port,
             remote_port, local_ip, remote_ip, pid, path_len);
 
-    if (path_len != 0) {
+    if (fort_log_path_size(path_len) != 0) {
         RtlCopyMemory(p + FORT_LOG_BLOCKED_IP_HEADER_SIZE, path, path_len);
     }
 }
@@ -66,7 +66,7 @@ void fort_log_blocked_ip_header_read(const char *p, BOOL *inbound, BOOL *inherit
     const UINT32 *up = (const UINT32 *) p;
 
     *inbound = (*up & FORT_LOG_FLAG_IP_INBOUND) != 0;
-    *path_len = (*up++ & ~FORT_LOG_FLAG_EX_MASK);
+    *path_len = (*up++ & FORT_LOG_PATH_MASK);
     *inherited = (UCHAR) *up;
     *block_reason = (UCHAR) (*up >> 8);
     *ip_proto = (UCHAR) (*up++ >> 16);
@@ -77,6 +77,61 @@ void fort_log_blocked_ip_header_read(const char *p, BOOL *inbound, BOOL *inherit
     *pid = *up;
 }
 
+/* The BLOCKED_IP header must be written before */
+FORT_API void fort_log_blocked_ip_repeat_header_write(
+        char *p, UINT32 repeat_count, INT64 first_time, INT64 last_time)
+{
+    UINT32 *up = (UINT32 *) p;
+
+    *up = (*up & ~FORT_LOG_FLAG_TYPE_MASK) | fort_log_flag_type(FORT_LOG_TYPE_BLOCKED_IP_REPEAT);
+
+    INT64 *tp = (INT64 *) (p + FORT_LOG_BLOCKED_IP_HEADER_SIZE);
+
+    *tp++ = first_time;
+    *tp++ = last_time;
+    *((UINT32 *) tp) = repeat_count;
+}
+
+FORT_API void fort_log_blocked_ip_repeat_header_read(
+        const char *p, UINT32 *repeat_count, INT64 *first_time, INT64 *last_time)
+{
+    const INT64 *tp = (const INT64 *) (p + FORT_LOG_BLOCKED_IP_HEADER_SIZE);
+
+    *first_time = *tp++;
+    *last_time = *tp++;
+    *repeat_count = *((const UINT32 *) tp);
+}
+
+FORT_API void fort_log_allowed_ip_header_write(char *p, BOOL inbound, BOOL inherited,
+        UCHAR ip_proto, UINT16 remote_port, UINT32 remote_ip, UINT32 pid, UINT32 conn_count,
+        UINT32 path_len)
+{
+    UINT32 *up = (UINT32 *) p;
+
+    *up++ = fort_log_flag_type(FORT_LOG_TYPE_ALLOWED_IP) | (inbound ? FORT_LOG_FLAG_IP_INBOUND : 0)
+            | path_len;
+    *up++ = inherited | ((UINT32) ip_proto << 8) | ((UINT32) remote_port << 16);
+    *up++ = remote_ip;
+    *up++ = pid;
+    *up = conn_count;
+}
+
+FORT_API void fort_log_allowed_ip_header_read(const char *p, BOOL *inbound, BOOL *inherited,
+        UCHAR *ip_proto, UINT16 *remote_port, UINT32 *remote_ip, UINT32 *pid, UINT32 *conn_count,
+        UINT32 *path_len)
+{
+    const UINT32 *up = (const UINT32 *) p;
+
+    *inbound = (*up & FORT_LOG_FLAG_IP_INBOUND) != 0;
+    *path_len = (*up++ & FORT_LOG_PATH_MASK);
+    *inherited = (UCHAR) *up;
+    *ip_proto = (UCHAR) (*up >> 8);
+    *remote_port = (UINT16) (*up++ >> 16);
+    *remote_ip = *up++;
+    *pid = *up++;
+    *conn_count = *up;
+}
+
 FORT_API void fort_log_proc_new_header_write(char *p, UINT32 pid, UINT32 path_len)
 {
     UINT32 *up = (UINT32 *) p;
@@ -89,7 +144,7 @@ FORT_API void fort_log_proc_new_write(char *p, UINT32 pid, UINT32 path_len, cons
 {
     fort_log_proc_new_header_write(p, pid, path_len);
 
-    if (path_len != 0) {
+    if (fort_log_path_size(path_len) != 0) {
         RtlCopyMemory(p + FORT_LOG_PROC_NEW_HEADER_SIZE, path, path_len);
     }
 }
@@ -98,10 +153,34 @@ FORT_API void fort_log_proc_new_header_read(const char *p, UINT32 *pid, UINT32 *
 {
     const UINT32 *up = (const UINT32 *) p;
 
-    *path_len = (*up++ & ~FORT_LOG_FLAG_EX_MASK);
+    *path_len = (*up++ & FORT_LOG_PATH_MASK);
     *pid = *up;
 }
 
+FORT_API void fort_log_path_define_header_write(char *p, UINT16 path_id, UINT32 path_len)
+{
+    UINT32 *up = (UINT32 *) p;
+
+    *up++ = fort_log_flag_type(FORT_LOG_TYPE_PATH_DEFINE) | path_len;
+    *up = path_id;
+}
+
+FORT_API void fort_log_path_define_write(
+        char *p, UINT16 path_id, UINT32 path_len, const char *path)
+{
+    fort_log_path_define_header_write(p, path_id, path_len);
+
+    RtlCopyMemory(p + FORT_LOG_PATH_DEFINE_HEADER_SIZE, path, path_len);
+}
+
+FORT_API void fort_log_path_define_header_read(const char *p, UINT16 *path_id, UINT32 *path_len)
+{
+    const UINT32 *up = (const UINT32 *) p;
+
+    *path_len = (*up++ & ~FORT_LOG_FLAG_EX_MASK);
+    *path_id = (UINT16) *up;
+}
+
 FORT_API void fort_log_stat_traf_header_write(char *p, UINT16 proc_count)
 {
     UINT32 *up = (UINT32 *) p;
@@ -10,6 +10,7 @@
 #define FORT_LOG_FLAG_TYPE_MASK     0x0FF00000
 #define FORT_LOG_FLAG_TYPE_MASK_OFF 20
 #define FORT_LOG_FLAG_IP_INBOUND    0x10000000
+#define FORT_LOG_FLAG_PATH_ID       0x20000000
 #define FORT_LOG_FLAG_OPT_MASK      0xF0000000
 #define FORT_LOG_FLAG_OPT_MASK_OFF  28
 #define FORT_LOG_FLAG_EX_MASK       (FORT_LOG_FLAG_TYPE_MASK | FORT_LOG_FLAG_OPT_MASK)
@@ -21,24 +22,57 @@
     ((*((UINT32 *) (p)) & FORT_LOG_FLAG_TYPE_MASK) >> FORT_LOG_FLAG_TYPE_MASK_OFF)
 #define fort_log_opt(p) ((*((UINT32 *) (p)) & FORT_LOG_FLAG_OPT_MASK) >> FORT_LOG_FLAG_OPT_MASK_OFF)
 
+/* The path_len of a record may refer to a path, defined before by the same log stream */
+#define FORT_LOG_PATH_ID_COUNT 64 /* Must be power of 2 */
+#define FORT_LOG_PATH_MASK     (FORT_LOG_FLAG_PATH_ID | ~FORT_LOG_FLAG_EX_MASK)
+
+#define fort_log_path_ref(path_id)     (FORT_LOG_FLAG_PATH_ID | (UINT32) (path_id))
+#define fort_log_path_is_ref(path_len) (((path_len) & FORT_LOG_FLAG_PATH_ID) != 0)
+#define fort_log_path_ref_id(path_len) ((UINT16) (path_len))
+#define fort_log_path_size(path_len)   (fort_log_path_is_ref(path_len) ? 0 : (path_len))
+
 #define FORT_LOG_BLOCKED_HEADER_SIZE (2 * sizeof(UINT32))
 
 #define FORT_LOG_BLOCKED_SIZE(path_len)                                                            \
-    ((FORT_LOG_BLOCKED_HEADER_SIZE + (path_len) + (FORT_LOG_ALIGN - 1)) & ~(FORT_LOG_ALIGN - 1))
+    ((FORT_LOG_BLOCKED_HEADER_SIZE + fort_log_path_size(path_len) + (FORT_LOG_ALIGN - 1))          \
+            & ~(FORT_LOG_ALIGN - 1))
 
 #define FORT_LOG_BLOCKED_SIZE_MAX FORT_LOG_BLOCKED_SIZE(FORT_LOG_PATH_MAX)
 
 #define FORT_LOG_BLOCKED_IP_HEADER_SIZE (6 * sizeof(UINT32))
 
 #define FORT_LOG_BLOCKED_IP_SIZE(path_len)                                                         \
-    ((FORT_LOG_BLOCKED_IP_HEADER_SIZE + (path_len) + (FORT_LOG_ALIGN - 1)) & ~(FORT_LOG_ALIGN - 1))
+    ((FORT_LOG_BLOCKED_IP_HEADER_SIZE + fort_log_path_size(path_len) + (FORT_LOG_ALIGN - 1))       \
+            & ~(FORT_LOG_ALIGN - 1))
 
 #define FORT_LOG_BLOCKED_IP_SIZE_MAX FORT_LOG_BLOCKED_IP_SIZE(FORT_LOG_PATH_MAX)
 
+/* BLOCKED_IP header, followed by the first/last repeat's Unix times and the repeat count */
+#define FORT_LOG_BLOCKED_IP_REPEAT_HEADER_SIZE                                                     \
+    (FORT_LOG_BLOCKED_IP_HEADER_SIZE + 2 * sizeof(INT64) + sizeof(UINT32))
+
+#define FORT_LOG_BLOCKED_IP_REPEAT_SIZE(path_len)                                                  \
+    ((FORT_LOG_BLOCKED_IP_REPEAT_HEADER_SIZE + fort_log_path_size(path_len)                        \
+             + (FORT_LOG_ALIGN - 1))                                                               \
+            & ~(FORT_LOG_ALIGN - 1))
+
+/* Allowed connections, aggregated by the driver */
+#define FORT_LOG_ALLOWED_IP_HEADER_SIZE (5 * sizeof(UINT32))
+
+#define FORT_LOG_ALLOWED_IP_SIZE(path_len)                                                         \
+    ((FORT_LOG_ALLOWED_IP_HEADER_SIZE + fort_log_path_size(path_len) + (FORT_LOG_ALIGN - 1))       \
+            & ~(FORT_LOG_ALIGN - 1))
+
 #define FORT_LOG_PROC_NEW_HEADER_SIZE (2 * sizeof(UINT32))
 
 #define FORT_LOG_PROC_NEW_SIZE(path_len)                                                           \
-    ((FORT_LOG_PROC_NEW_HEADER_SIZE + (path_len) + (FORT_LOG_ALIGN - 1)) & ~(FORT_LOG_ALIGN - 1))
+    ((FORT_LOG_PROC_NEW_HEADER_SIZE + fort_log_path_size(path_len) + (FORT_LOG_ALIGN - 1))         \
+            & ~(FORT_LOG_ALIGN - 1))
+
+#define FORT_LOG_PATH_DEFINE_HEADER_SIZE (2 * sizeof(UINT32))
+
+#define FORT_LOG_PATH_DEFINE_SIZE(path_len)                                                        \
+    ((FORT_LOG_PATH_DEFINE_HEADER_SIZE + (path_len) + (FORT_LOG_ALIGN - 1)) & ~(FORT_LOG_ALIGN - 1))
 
 #define FORT_LOG_STAT_HEADER_SIZE (sizeof(UINT32))
 
@@ -52,7 +86,48 @@
 
 #define FORT_LOG_TIME_SIZE (sizeof(UINT32) + sizeof(INT64))
 
-#define FORT_LOG_SIZE_MAX FORT_LOG_BLOCKED_SIZE_MAX
+/* A record may be preceded by its path's definition */
+#define FORT_LOG_SIZE_MAX                                                                          \
+    (FORT_LOG_PATH_DEFINE_SIZE(FORT_LOG_PATH_MAX) + FORT_LOG_BLOCKED_IP_REPEAT_HEADER_SIZE)
+
+#define FORT_LOG_RING_SIZE (32 * 1024) /* Must be power of 2 */
+
+/* Per-CPU ring of log records, the driver is the only writer */
+typedef struct fort_log_ring
+{
+    UINT32 volatile head; /* written bytes, released after the record */
+    UINT32 volatile drop_count; /* records dropped on overflow */
+
+    UCHAR reserved[56]; /* keep the rings' heads on separate cache lines */
+} FORT_LOG_RING, *PFORT_LOG_RING;
+
+/* Mapped read-only into the reader's process, followed by the rings' data */
+typedef struct fort_log_rings
+{
+    UINT32 ring_count;
+    UINT32 ring_size;
+
+    UCHAR reserved[56];
+
+    FORT_LOG_RING rings[1];
+} FORT_LOG_RINGS, *PFORT_LOG_RINGS;
+
+#define FORT_LOG_RINGS_DATA_OFF(ring_count)                                                        \
+    (offsetof(FORT_LOG_RINGS, rings) + (ring_count) * sizeof(FORT_LOG_RING))
+
+#define FORT_LOG_RINGS_SIZE(ring_count)                                                            \
+    (FORT_LOG_RINGS_DATA_OFF(ring_count) + (ring_count) * FORT_LOG_RING_SIZE)
+
+/* The reader passes the consumed positions of the rings to FORT_IOCTL_GETLOG */
+#define FORT_LOG_RINGS_TAILS_SIZE(ring_count) ((ring_count) * sizeof(UINT32))
+
+/* FORT_IOCTL_MAPLOG returns the rings' address and the positions, which the reader starts from */
+#define FORT_LOG_RINGS_MAP_SIZE(ring_count) (sizeof(UINT64) + FORT_LOG_RINGS_TAILS_SIZE(ring_count))
+
+#define FORT_LOG_RINGS_MAX 2048 /* the maximum count of processors */
+
+#define fort_log_ring_data(rings, i)                                                               \
+    ((PCHAR) (rings) + FORT_LOG_RINGS_DATA_OFF((rings)->ring_count) + (i) * (rings)->ring_size)
 
 #if defined(__cplusplus)
 extern "C" {
@@ -78,12 +153,33 @@ FORT_API void fort_log_blocked_ip_header_read(const char *p, BOOL *inbound, BOOL
         UCHAR *block_reason, UCHAR *ip_proto, UINT16 *local_port, UINT16 *remote_port,
         UINT32 *local_ip, UINT32 *remote_ip, UINT32 *pid, UINT32 *path_len);
 
+FORT_API void fort_log_blocked_ip_repeat_header_write(
+        char *p, UINT32 repeat_count, INT64 first_time, INT64 last_time);
+
+FORT_API void fort_log_blocked_ip_repeat_header_read(
+        const char *p, UINT32 *repeat_count, INT64 *first_time, INT64 *last_time);
+
+FORT_API void fort_log_allowed_ip_header_write(char *p, BOOL inbound, BOOL inherited,
+        UCHAR ip_proto, UINT16 remote_port, UINT32 remote_ip, UINT32 pid, UINT32 conn_count,
+        UINT32 path_len);
+
+FORT_API void fort_log_allowed_ip_header_read(const char *p, BOOL *inbound, BOOL *inherited,
+        UCHAR *ip_proto, UINT16 *remote_port, UINT32 *remote_ip, UINT32 *pid, UINT32 *conn_count,
+        UINT32 *path_len);
+
 FORT_API void fort_log_proc_new_header_write(char *p, UINT32 pid, UINT32 path_len);
 
 FORT_API void fort_log_proc_new_write(char *p, UINT32 pid, UINT32 path_len, const char *path);
 
 FORT_API void fort_log_proc_new_header_read(const char *p, UINT32 *pid, UINT32 *path_len);
 
+FORT_API void fort_log_path_define_header_write(char *p, UINT16 path_id, UINT32 path_len);
+
+FORT_API void fort_log_path_define_write(
+        char *p, UINT16 path_id, UINT32 path_len, const char *path);
+
+FORT_API void fort_log_path_define_header_read(const char *p, UINT16 *path_id, UINT32 *path_len);
+
 FORT_API void fort_log_stat_traf_header_write(char *p, UINT16 proc_count);
 
 FORT_API void fort_log_stat_traf_header_read(const char *p, UINT16 *proc_count);
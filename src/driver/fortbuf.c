@@ -2,6 +2,10 @@
 
 #include "fortbuf.h"
 
+#include "common/fortdef.h"
+
+#include "forttds.h"
+
 #define FORT_BUFFER_POOL_TAG 'BwfF'
 
 static PFORT_BUFFER_DATA fort_buffer_data_new(PFORT_BUFFER buf)
@@ -69,15 +73,345 @@ static void fort_buffer_data_shift(PFORT_BUFFER buf)
     buf->data_free = data;
 }
 
+#if defined(FORT_WIN7_COMPAT)
+#    define FORT_BUFFER_MAPPING_FLAGS 0
+#else
+#    define FORT_BUFFER_MAPPING_FLAGS (MdlMappingNoWrite | MdlMappingNoExecute)
+#endif
+
+typedef struct fort_buffer_write
+{
+    KIRQL old_irql;
+
+    BOOL use_ring; /* or the locked buffer */
+
+    PFORT_BUFFER_RING ring; /* NULL, when the record is dropped */
+    UINT32 ring_index;
+    UINT32 ring_head;
+
+    PFORT_BUFFER_PATHS paths; /* of the current stream */
+    PFORT_BUFFER_PATH path_def; /* to be defined before the record */
+    UINT32 path_hash;
+
+    KLOCK_QUEUE_HANDLE lock_queue;
+} FORT_BUFFER_WRITE, *PFORT_BUFFER_WRITE;
+
+static PFORT_BUFFER_PATHS fort_buffer_paths_new(UINT32 count)
+{
+    const SIZE_T paths_size = count * sizeof(FORT_BUFFER_PATHS);
+
+    /* The paths are optional, the records carry the whole paths without them */
+    PFORT_BUFFER_PATHS paths = fort_mem_alloc(paths_size, FORT_BUFFER_POOL_TAG);
+    if (paths != NULL) {
+        RtlZeroMemory(paths, paths_size);
+    }
+
+    return paths;
+}
+
+static void fort_buffer_paths_del(PFORT_BUFFER_PATHS paths)
+{
+    if (paths != NULL) {
+        fort_mem_free(paths, FORT_BUFFER_POOL_TAG);
+    }
+}
+
+/* The stream has a new reader, which knows no paths */
+static void fort_buffer_paths_reset(PFORT_BUFFER_PATHS paths, UINT32 count)
+{
+    if (paths == NULL)
+        return;
+
+    for (UINT32 i = 0; i < count; ++i) {
+        PFORT_BUFFER_PATH slot = paths[i].slots;
+
+        for (int j = 0; j < FORT_LOG_PATH_ID_COUNT; ++j, ++slot) {
+            slot->path_len = 0;
+        }
+    }
+}
+
+static UINT32 fort_buffer_path_intern(PFORT_BUFFER_WRITE bw, UINT32 path_len, const PVOID path)
+{
+    bw->path_def = NULL;
+
+    PFORT_BUFFER_PATHS paths = bw->paths;
+    if (paths == NULL || path_len == 0)
+        return path_len;
+
+    const UINT32 hash = (UINT32) tommy_hash_u64(0, path, path_len);
+    const UINT16 path_id = (UINT16) (hash & (FORT_LOG_PATH_ID_COUNT - 1));
+
+    PFORT_BUFFER_PATH slot = &paths->slots[path_id];
+
+    if (slot->hash != hash || slot->path_len != path_len
+            || RtlCompareMemory(slot->path, path, path_len) != path_len) {
+        bw->path_def = slot;
+        bw->path_hash = hash;
+    }
+
+    return fort_log_path_ref(path_id);
+}
+
+static UINT32 fort_buffer_path_define_size(PFORT_BUFFER_WRITE bw, UINT32 path_len)
+{
+    return (bw->path_def != NULL) ? FORT_LOG_PATH_DEFINE_SIZE(path_len) : 0;
+}
+
+static PCHAR fort_buffer_path_define(
+        PFORT_BUFFER_WRITE bw, PCHAR out, UINT32 path_len, const PVOID path)
+{
+    PFORT_BUFFER_PATH slot = bw->path_def;
+    if (slot == NULL)
+        return out;
+
+    /* Evict the slot's previous path, the reader redefines it in the stream's order */
+    slot->hash = bw->path_hash;
+    slot->path_len = path_len;
+    RtlCopyMemory(slot->path, path, path_len);
+
+    const UINT16 path_id = (UINT16) (slot - bw->paths->slots);
+
+    fort_log_path_define_write(out, path_id, path_len, path);
+
+    return out + FORT_LOG_PATH_DEFINE_SIZE(path_len);
+}
+
+static BOOL fort_buffer_rings_alloc(PFORT_BUFFER buf)
+{
+    if (buf->log_rings != NULL)
+        return TRUE;
+
+    const UINT32 ring_count = KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS);
+    const SIZE_T rings_size = ring_count * sizeof(FORT_BUFFER_RING);
+
+    /* Whole pages to not expose the pool's neighbours to the reader */
+    const SIZE_T log_rings_size = ROUND_TO_PAGES(FORT_LOG_RINGS_SIZE(ring_count));
+
+    PFORT_BUFFER_RING rings = fort_mem_alloc(rings_size, FORT_BUFFER_POOL_TAG);
+    PFORT_LOG_RINGS log_rings = fort_mem_alloc(log_rings_size, FORT_BUFFER_POOL_TAG);
+    PMDL mdl = (log_rings == NULL)
+            ? NULL
+            : IoAllocateMdl(log_rings, (ULONG) log_rings_size, FALSE, FALSE, NULL);
+
+    if (rings == NULL || mdl == NULL) {
+        if (log_rings != NULL) {
+            fort_mem_free(log_rings, FORT_BUFFER_POOL_TAG);
+        }
+        if (rings != NULL) {
+            fort_mem_free(rings, FORT_BUFFER_POOL_TAG);
+        }
+        return FALSE;
+    }
+
+    RtlZeroMemory(rings, rings_size);
+    RtlZeroMemory(log_rings, log_rings_size);
+
+    log_rings->ring_count = ring_count;
+    log_rings->ring_size = FORT_LOG_RING_SIZE;
+
+    MmBuildMdlForNonPagedPool(mdl);
+
+    buf->ring_count = ring_count;
+    buf->rings = rings;
+    buf->log_rings = log_rings;
+    buf->log_rings_mdl = mdl;
+
+    buf->ring_paths = fort_buffer_paths_new(ring_count);
+
+    return TRUE;
+}
+
+static void fort_buffer_rings_free(PFORT_BUFFER buf)
+{
+    if (buf->log_rings == NULL)
+        return;
+
+    IoFreeMdl(buf->log_rings_mdl);
+
+    fort_mem_free(buf->log_rings, FORT_BUFFER_POOL_TAG);
+    fort_mem_free(buf->rings, FORT_BUFFER_POOL_TAG);
+
+    fort_buffer_paths_del(buf->ring_paths);
+
+    buf->ring_paths = NULL;
+    buf->log_rings_mdl = NULL;
+    buf->log_rings = NULL;
+    buf->rings = NULL;
+    buf->ring_count = 0;
+}
+
+static BOOL fort_buffer_rings_pending(PFORT_BUFFER buf)
+{
+    if (!buf->rings_active)
+        return FALSE;
+
+    for (UINT32 i = 0; i < buf->ring_count; ++i) {
+        const PFORT_BUFFER_RING ring = &buf->rings[i];
+
+        if (ring->head != ring->tail)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void fort_buffer_rings_consume(PFORT_BUFFER buf, const UINT32 *tails, ULONG tails_len)
+{
+    if (!buf->rings_active || tails_len < FORT_LOG_RINGS_TAILS_SIZE(buf->ring_count))
+        return;
+
+    for (UINT32 i = 0; i < buf->ring_count; ++i) {
+        PFORT_BUFFER_RING ring = &buf->rings[i];
+
+        const UINT32 tail = ring->tail;
+        const UINT32 new_tail = tails[i];
+
+        /* The reader can't pass the writer */
+        if (new_tail - tail <= ring->head - tail) {
+            ring->tail = new_tail;
+        }
+    }
+}
+
+static void fort_buffer_rings_signal(PFORT_BUFFER buf, PIRP *irp, ULONG_PTR *info)
+{
+    if (irp == NULL)
+        return;
+
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLockAtDpcLevel(&buf->lock, &lock_queue);
+
+    if (buf->out_len != 0 && *irp == NULL) {
+        *info = buf->out_top;
+
+        buf->out_top = 0;
+        buf->out_len = 0;
+
+        *irp = buf->irp;
+        buf->irp = NULL;
+    }
+
+    KeReleaseInStackQueuedSpinLockFromDpcLevel(&lock_queue);
+}
+
+static PCHAR fort_buffer_ring_reserve(PFORT_BUFFER buf, PFORT_BUFFER_WRITE bw, UINT32 len)
+{
+    const UINT32 ring_index = bw->ring_index;
+
+    if (ring_index >= buf->ring_count)
+        return NULL;
+
+    PFORT_BUFFER_RING ring = &buf->rings[ring_index];
+    PCHAR data = fort_log_ring_data(buf->log_rings, ring_index);
+
+    const UINT32 head = ring->head;
+    const UINT32 used = head - ring->tail;
+
+    UINT32 offset = head & (FORT_LOG_RING_SIZE - 1);
+
+    /* Records are not wrapped around, the tail of the ring is skipped instead */
+    const UINT32 skip_len = (FORT_LOG_RING_SIZE - offset < len) ? FORT_LOG_RING_SIZE - offset : 0;
+
+    if (used + skip_len + len > FORT_LOG_RING_SIZE) {
+        ++buf->log_rings->rings[ring_index].drop_count;
+        return NULL;
+    }
+
+    if (skip_len != 0) {
+        *((UINT32 *) (data + offset)) = fort_log_flag_type(FORT_LOG_TYPE_NONE);
+        offset = 0;
+    }
+
+    bw->ring = ring;
+    bw->ring_head = head + skip_len + len;
+
+    return data + offset;
+}
+
+static void fort_buffer_ring_commit(
+        PFORT_BUFFER buf, PFORT_BUFFER_WRITE bw, PIRP *irp, ULONG_PTR *info)
+{
+    PFORT_BUFFER_RING ring = bw->ring;
+    PFORT_LOG_RING log_ring = &buf->log_rings->rings[bw->ring_index];
+
+    const UINT32 old_used = ring->head - ring->tail;
+
+    ring->head = bw->ring_head;
+
+    /* Publish the record */
+    InterlockedExchange((PLONG) &log_ring->head, (LONG) bw->ring_head);
+
+    const UINT32 used = bw->ring_head - ring->tail;
+
+    if (old_used < FORT_BUFFER_RING_SIGNAL_SIZE && used >= FORT_BUFFER_RING_SIGNAL_SIZE) {
+        fort_buffer_rings_signal(buf, irp, info);
+    }
+}
+
+static void fort_buffer_write_begin(PFORT_BUFFER buf, PFORT_BUFFER_WRITE bw)
+{
+    /* Stay on the current CPU, so its ring has the only writer */
+    KeRaiseIrql(DISPATCH_LEVEL, &bw->old_irql);
+
+    bw->use_ring = (ReadAcquire(&buf->rings_active) != 0);
+    bw->ring = NULL;
+
+    if (bw->use_ring) {
+        const UINT32 ring_index = KeGetCurrentProcessorNumberEx(NULL);
+
+        bw->ring_index = ring_index;
+        bw->paths = (buf->ring_paths != NULL && ring_index < buf->ring_count)
+                ? &buf->ring_paths[ring_index]
+                : NULL;
+    } else {
+        KeAcquireInStackQueuedSpinLockAtDpcLevel(&buf->lock, &bw->lock_queue);
+
+        bw->paths = buf->paths;
+    }
+}
+
+static NTSTATUS fort_buffer_write_reserve(PFORT_BUFFER buf, PFORT_BUFFER_WRITE bw, UINT32 len,
+        PCHAR *out, PIRP *irp, ULONG_PTR *info)
+{
+    if (bw->use_ring) {
+        *out = fort_buffer_ring_reserve(buf, bw, len);
+
+        return (*out != NULL) ? STATUS_SUCCESS : STATUS_BUFFER_OVERFLOW;
+    }
+
+    return fort_buffer_prepare(buf, len, out, irp, info);
+}
+
+static void fort_buffer_write_end(
+        PFORT_BUFFER buf, PFORT_BUFFER_WRITE bw, PIRP *irp, ULONG_PTR *info)
+{
+    if (bw->use_ring) {
+        if (bw->ring != NULL) {
+            fort_buffer_ring_commit(buf, bw, irp, info);
+        }
+    } else {
+        KeReleaseInStackQueuedSpinLockFromDpcLevel(&bw->lock_queue);
+    }
+
+    KeLowerIrql(bw->old_irql);
+}
+
 FORT_API void fort_buffer_open(PFORT_BUFFER buf)
 {
     KeInitializeSpinLock(&buf->lock);
+
+    buf->paths = fort_buffer_paths_new(1);
 }
 
 FORT_API void fort_buffer_close(PFORT_BUFFER buf)
 {
     fort_buffer_data_del(buf->data_head);
     fort_buffer_data_del(buf->data_free);
+
+    fort_buffer_paths_del(buf->paths);
+
+    fort_buffer_rings_free(buf);
 }
 
 FORT_API void fort_buffer_clear(PFORT_BUFFER buf)
@@ -85,12 +419,15 @@ FORT_API void fort_buffer_clear(PFORT_BUFFER buf)
     KLOCK_QUEUE_HANDLE lock_queue;
     KeAcquireInStackQueuedSpinLock(&buf->lock, &lock_queue);
 
-    fort_buffer_close(buf);
+    fort_buffer_data_del(buf->data_head);
+    fort_buffer_data_del(buf->data_free);
 
     buf->data_head = NULL;
     buf->data_tail = NULL;
     buf->data_free = NULL;
 
+    fort_buffer_paths_reset(buf->paths, 1);
+
     KeReleaseInStackQueuedSpinLock(&lock_queue);
 }
 
@@ -142,26 +479,95 @@ FORT_API NTSTATUS fort_buffer_blocked_write(PFORT_BUFFER buf, BOOL blocked, UINT
         path_len = 0; /* drop too long path */
     }
 
-    const UINT32 len = FORT_LOG_BLOCKED_SIZE(path_len);
+    FORT_BUFFER_WRITE bw;
+    fort_buffer_write_begin(buf, &bw);
 
-    KLOCK_QUEUE_HANDLE lock_queue;
-    KeAcquireInStackQueuedSpinLock(&buf->lock, &lock_queue);
-    {
-        PCHAR out;
-        status = fort_buffer_prepare(buf, len, &out, irp, info);
+    const UINT32 path_ref = fort_buffer_path_intern(&bw, path_len, path);
+    const UINT32 len =
+            fort_buffer_path_define_size(&bw, path_len) + FORT_LOG_BLOCKED_SIZE(path_ref);
+
+    PCHAR out;
+    status = fort_buffer_write_reserve(buf, &bw, len, &out, irp, info);
+
+    if (NT_SUCCESS(status)) {
+        out = fort_buffer_path_define(&bw, out, path_len, path);
+
+        fort_log_blocked_write(out, blocked, pid, path_ref, path);
+    }
+
+    fort_buffer_write_end(buf, &bw, irp, info);
+
+    return status;
+}
+
+static NTSTATUS fort_buffer_blocked_ip_write_ex(PFORT_BUFFER buf, BOOL inbound, BOOL inherited,
+        UCHAR block_reason, UCHAR ip_proto, UINT16 local_port, UINT16 remote_port, UINT32 local_ip,
+        UINT32 remote_ip, UINT32 pid, UINT32 repeat_count, INT64 first_time, INT64 last_time,
+        UINT32 path_len, const PVOID path, PIRP *irp, ULONG_PTR *info)
+{
+    NTSTATUS status;
+
+    if (path_len > FORT_LOG_PATH_MAX) {
+        path_len = 0; /* drop too long path */
+    }
+
+    FORT_BUFFER_WRITE bw;
+    fort_buffer_write_begin(buf, &bw);
+
+    const UINT32 path_ref = fort_buffer_path_intern(&bw, path_len, path);
+    const UINT32 len = fort_buffer_path_define_size(&bw, path_len)
+            + (repeat_count != 0 ? FORT_LOG_BLOCKED_IP_REPEAT_SIZE(path_ref)
+                                 : FORT_LOG_BLOCKED_IP_SIZE(path_ref));
+
+    PCHAR out;
+    status = fort_buffer_write_reserve(buf, &bw, len, &out, irp, info);
+
+    if (NT_SUCCESS(status)) {
+        out = fort_buffer_path_define(&bw, out, path_len, path);
+
+        fort_log_blocked_ip_header_write(out, inbound, inherited, block_reason, ip_proto,
+                local_port, remote_port, local_ip, remote_ip, pid, path_ref);
+
+        UINT32 header_size = FORT_LOG_BLOCKED_IP_HEADER_SIZE;
+
+        if (repeat_count != 0) {
+            fort_log_blocked_ip_repeat_header_write(out, repeat_count, first_time, last_time);
 
-        if (NT_SUCCESS(status)) {
-            fort_log_blocked_write(out, blocked, pid, path_len, path);
+            header_size = FORT_LOG_BLOCKED_IP_REPEAT_HEADER_SIZE;
+        }
+
+        if (fort_log_path_size(path_ref) != 0) {
+            RtlCopyMemory(out + header_size, path, path_len);
         }
     }
-    KeReleaseInStackQueuedSpinLock(&lock_queue);
+
+    fort_buffer_write_end(buf, &bw, irp, info);
 
     return status;
 }
 
-NTSTATUS fort_buffer_blocked_ip_write(PFORT_BUFFER buf, BOOL inbound, BOOL inherited,
+FORT_API NTSTATUS fort_buffer_blocked_ip_write(PFORT_BUFFER buf, BOOL inbound, BOOL inherited,
         UCHAR block_reason, UCHAR ip_proto, UINT16 local_port, UINT16 remote_port, UINT32 local_ip,
         UINT32 remote_ip, UINT32 pid, UINT32 path_len, const PVOID path, PIRP *irp, ULONG_PTR *info)
+{
+    return fort_buffer_blocked_ip_write_ex(buf, inbound, inherited, block_reason, ip_proto,
+            local_port, remote_port, local_ip, remote_ip, pid, /*repeat_count=*/0, 0, 0, path_len,
+            path, irp, info);
+}
+
+FORT_API NTSTATUS fort_buffer_blocked_ip_repeat_write(PFORT_BUFFER buf, BOOL inbound,
+        BOOL inherited, UCHAR block_reason, UCHAR ip_proto, UINT16 local_port, UINT16 remote_port,
+        UINT32 local_ip, UINT32 remote_ip, UINT32 pid, UINT32 repeat_count, INT64 first_time,
+        INT64 last_time, UINT32 path_len, const PVOID path, PIRP *irp, ULONG_PTR *info)
+{
+    return fort_buffer_blocked_ip_write_ex(buf, inbound, inherited, block_reason, ip_proto,
+            local_port, remote_port, local_ip, remote_ip, pid, repeat_count, first_time, last_time,
+            path_len, path, irp, info);
+}
+
+FORT_API NTSTATUS fort_buffer_allowed_ip_write(PFORT_BUFFER buf, BOOL inbound, BOOL inherited,
+        UCHAR ip_proto, UINT16 remote_port, UINT32 remote_ip, UINT32 pid, UINT32 conn_count,
+        UINT32 path_len, const PVOID path, PIRP *irp, ULONG_PTR *info)
 {
     NTSTATUS status;
 
@@ -169,20 +575,28 @@ NTSTATUS fort_buffer_blocked_ip_write(PFORT_BUFFER buf, BOOL inbound, BOOL inher
         path_len = 0; /* drop too long path */
     }
 
-    const UINT32 len = FORT_LOG_BLOCKED_IP_SIZE(path_len);
+    FORT_BUFFER_WRITE bw;
+    fort_buffer_write_begin(buf, &bw);
 
-    KLOCK_QUEUE_HANDLE lock_queue;
-    KeAcquireInStackQueuedSpinLock(&buf->lock, &lock_queue);
-    {
-        PCHAR out;
-        status = fort_buffer_prepare(buf, len, &out, irp, info);
+    const UINT32 path_ref = fort_buffer_path_intern(&bw, path_len, path);
+    const UINT32 len =
+            fort_buffer_path_define_size(&bw, path_len) + FORT_LOG_ALLOWED_IP_SIZE(path_ref);
+
+    PCHAR out;
+    status = fort_buffer_write_reserve(buf, &bw, len, &out, irp, info);
+
+    if (NT_SUCCESS(status)) {
+        out = fort_buffer_path_define(&bw, out, path_len, path);
 
-        if (NT_SUCCESS(status)) {
-            fort_log_blocked_ip_write(out, inbound, inherited, block_reason, ip_proto, local_port,
-                    remote_port, local_ip, remote_ip, pid, path_len, path);
+        fort_log_allowed_ip_header_write(out, inbound, inherited, ip_proto, remote_port,
+                remote_ip, pid, conn_count, path_ref);
+
+        if (fort_log_path_size(path_ref) != 0) {
+            RtlCopyMemory(out + FORT_LOG_ALLOWED_IP_HEADER_SIZE, path, path_len);
         }
     }
-    KeReleaseInStackQueuedSpinLock(&lock_queue);
+
+    fort_buffer_write_end(buf, &bw, irp, info);
 
     return status;
 }
@@ -196,31 +610,38 @@ FORT_API NTSTATUS fort_buffer_proc_new_write(
         path_len = 0; /* drop too long path */
     }
 
-    const UINT32 len = FORT_LOG_PROC_NEW_SIZE(path_len);
+    FORT_BUFFER_WRITE bw;
+    fort_buffer_write_begin(buf, &bw);
 
-    KLOCK_QUEUE_HANDLE lock_queue;
-    KeAcquireInStackQueuedSpinLock(&buf->lock, &lock_queue);
-    {
-        PCHAR out;
-        status = fort_buffer_prepare(buf, len, &out, irp, info);
+    const UINT32 path_ref = fort_buffer_path_intern(&bw, path_len, path);
+    const UINT32 len =
+            fort_buffer_path_define_size(&bw, path_len) + FORT_LOG_PROC_NEW_SIZE(path_ref);
 
-        if (NT_SUCCESS(status)) {
-            fort_log_proc_new_write(out, pid, path_len, path);
-        }
+    PCHAR out;
+    status = fort_buffer_write_reserve(buf, &bw, len, &out, irp, info);
+
+    if (NT_SUCCESS(status)) {
+        out = fort_buffer_path_define(&bw, out, path_len, path);
+
+        fort_log_proc_new_write(out, pid, path_ref, path);
     }
-    KeReleaseInStackQueuedSpinLock(&lock_queue);
+
+    fort_buffer_write_end(buf, &bw, irp, info);
 
     return status;
 }
 
 FORT_API NTSTATUS fort_buffer_xmove(
-        PFORT_BUFFER buf, PIRP irp, PVOID out, ULONG out_len, ULONG_PTR *info)
+        PFORT_BUFFER buf, PIRP irp, PVOID out, ULONG in_len, ULONG out_len, ULONG_PTR *info)
 {
     NTSTATUS status = STATUS_SUCCESS;
 
     KLOCK_QUEUE_HANDLE lock_queue;
     KeAcquireInStackQueuedSpinLock(&buf->lock, &lock_queue);
 
+    /* The input holds the rings' positions consumed by the reader */
+    fort_buffer_rings_consume(buf, out, in_len);
+
     PFORT_BUFFER_DATA data = buf->data_head;
     const UINT32 buf_top = (data ? data->top : 0);
 
@@ -229,6 +650,8 @@ FORT_API NTSTATUS fort_buffer_xmove(
     if (buf_top == 0) {
         if (buf->out_len != 0) {
             status = STATUS_UNSUCCESSFUL; /* collision */
+        } else if (fort_buffer_rings_pending(buf)) {
+            status = STATUS_SUCCESS; /* the records are in the rings */
         } else {
             buf->irp = irp;
             buf->out = out;
@@ -305,7 +728,7 @@ FORT_API void fort_buffer_dpc_flush_pending(PFORT_BUFFER buf, PIRP *irp, ULONG_P
         }
     }
 
-    if (out_top != 0) {
+    if (out_top != 0 || (buf->out_len != 0 && fort_buffer_rings_pending(buf))) {
         *info = out_top;
 
         buf->out_top = 0;
@@ -315,3 +738,66 @@ FORT_API void fort_buffer_dpc_flush_pending(PFORT_BUFFER buf, PIRP *irp, ULONG_P
         buf->irp = NULL;
     }
 }
+
+FORT_API NTSTATUS fort_buffer_rings_map(
+        PFORT_BUFFER buf, PVOID *user_addr, UINT32 *tails, ULONG tails_len)
+{
+    if (!fort_buffer_rings_alloc(buf))
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    if (tails_len < FORT_LOG_RINGS_TAILS_SIZE(buf->ring_count))
+        return STATUS_BUFFER_TOO_SMALL;
+
+    if (buf->log_rings_user == NULL) {
+        PVOID addr;
+
+        /* Map into the current process, i.e. the reader's one */
+        __try {
+            addr = MmMapLockedPagesSpecifyCache(buf->log_rings_mdl, UserMode, MmCached, NULL,
+                    FALSE, NormalPagePriority | FORT_BUFFER_MAPPING_FLAGS);
+        } __except (EXCEPTION_EXECUTE_HANDLER) {
+            addr = NULL;
+        }
+
+        if (addr == NULL)
+            return STATUS_INSUFFICIENT_RESOURCES;
+
+        /* Skip the records left from the previous reader */
+        for (UINT32 i = 0; i < buf->ring_count; ++i) {
+            PFORT_BUFFER_RING ring = &buf->rings[i];
+
+            ring->tail = ring->head;
+        }
+
+        fort_buffer_paths_reset(buf->ring_paths, buf->ring_count);
+
+        buf->log_rings_user = addr;
+
+        InterlockedExchange(&buf->rings_active, TRUE);
+    }
+
+    /* The reader starts from the driver's positions, the records after them are not skipped */
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLock(&buf->lock, &lock_queue);
+
+    for (UINT32 i = 0; i < buf->ring_count; ++i) {
+        tails[i] = buf->rings[i].tail;
+    }
+
+    KeReleaseInStackQueuedSpinLock(&lock_queue);
+
+    *user_addr = buf->log_rings_user;
+
+    return STATUS_SUCCESS;
+}
+
+FORT_API void fort_buffer_rings_unmap(PFORT_BUFFER buf)
+{
+    InterlockedExchange(&buf->rings_active, FALSE);
+
+    if (buf->log_rings_user != NULL) {
+        MmUnmapLockedPages(buf->log_rings_user, buf->log_rings_mdl);
+
+        buf->log_rings_user = NULL;
+    }
+}
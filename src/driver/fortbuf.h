@@ -13,6 +13,33 @@ typedef struct fort_buffer_data
     CHAR p[FORT_BUFFER_SIZE];
 } FORT_BUFFER_DATA, *PFORT_BUFFER_DATA;
 
+/* Complete the pending request, when a ring is filled by half */
+#define FORT_BUFFER_RING_SIGNAL_SIZE (FORT_LOG_RING_SIZE / 2)
+
+/* Driver's own copy of the ring's positions, the shared ones are never read back */
+typedef struct fort_buffer_ring
+{
+    UINT32 volatile head;
+    UINT32 volatile tail; /* consumed by the reader */
+
+    UCHAR reserved[56]; /* keep the per-CPU rings on separate cache lines */
+} FORT_BUFFER_RING, *PFORT_BUFFER_RING;
+
+/* Path known by the reader of a log stream, its id is the slot's index */
+typedef struct fort_buffer_path
+{
+    UINT32 hash;
+    UINT32 path_len; /* 0, when the slot is free */
+
+    CHAR path[FORT_LOG_PATH_MAX];
+} FORT_BUFFER_PATH, *PFORT_BUFFER_PATH;
+
+/* Direct-mapped cache of the paths, each log stream has its own */
+typedef struct fort_buffer_paths
+{
+    FORT_BUFFER_PATH slots[FORT_LOG_PATH_ID_COUNT];
+} FORT_BUFFER_PATHS, *PFORT_BUFFER_PATHS;
+
 typedef struct fort_buffer
 {
     PFORT_BUFFER_DATA data_head;
@@ -24,6 +51,18 @@ typedef struct fort_buffer
     ULONG out_len;
     UINT32 out_top;
 
+    PFORT_BUFFER_PATHS paths; /* of the locked buffer */
+
+    LONG volatile rings_active; /* mapped into the reader's process */
+
+    UINT32 ring_count;
+    PFORT_BUFFER_RING rings;
+    PFORT_BUFFER_PATHS ring_paths; /* per ring */
+
+    PFORT_LOG_RINGS log_rings;
+    PMDL log_rings_mdl;
+    PVOID log_rings_user;
+
     KSPIN_LOCK lock;
 } FORT_BUFFER, *PFORT_BUFFER;
 
@@ -48,11 +87,25 @@ FORT_API NTSTATUS fort_buffer_blocked_ip_write(PFORT_BUFFER buf, BOOL inbound, B
         UINT32 remote_ip, UINT32 pid, UINT32 path_len, const PVOID path, PIRP *irp,
         ULONG_PTR *info);
 
+FORT_API NTSTATUS fort_buffer_blocked_ip_repeat_write(PFORT_BUFFER buf, BOOL inbound,
+        BOOL inherited, UCHAR block_reason, UCHAR ip_proto, UINT16 local_port, UINT16 remote_port,
+        UINT32 local_ip, UINT32 remote_ip, UINT32 pid, UINT32 repeat_count, INT64 first_time,
+        INT64 last_time, UINT32 path_len, const PVOID path, PIRP *irp, ULONG_PTR *info);
+
+FORT_API NTSTATUS fort_buffer_allowed_ip_write(PFORT_BUFFER buf, BOOL inbound, BOOL inherited,
+        UCHAR ip_proto, UINT16 remote_port, UINT32 remote_ip, UINT32 pid, UINT32 conn_count,
+        UINT32 path_len, const PVOID path, PIRP *irp, ULONG_PTR *info);
+
 FORT_API NTSTATUS fort_buffer_proc_new_write(PFORT_BUFFER buf, UINT32 pid, UINT32 path_len,
         const PVOID path, PIRP *irp, ULONG_PTR *info);
 
 FORT_API NTSTATUS fort_buffer_xmove(
-        PFORT_BUFFER buf, PIRP irp, PVOID out, ULONG out_len, ULONG_PTR *info);
+        PFORT_BUFFER buf, PIRP irp, PVOID out, ULONG in_len, ULONG out_len, ULONG_PTR *info);
+
+FORT_API NTSTATUS fort_buffer_rings_map(
+        PFORT_BUFFER buf, PVOID *user_addr, UINT32 *tails, ULONG tails_len);
+
+FORT_API void fort_buffer_rings_unmap(PFORT_BUFFER buf);
 
 FORT_API NTSTATUS fort_buffer_cancel_pending(PFORT_BUFFER buf, PIRP irp, ULONG_PTR *info);
 
@@ -4,15 +4,21 @@
 
 #define FORT_ZONES_POOL_TAG 'ZwfF'
 
-/* Synchronize with tommy_hashdyn_node! */
+#define FORT_CONF_REF_POOL_TAG 'RwfF'
+
+#define FORT_CONF_EXE_POOL_TAG 'EwfF'
+
+#define FORT_CONF_EXE_TABLE_MIN    64
+#define FORT_CONF_EXE_MIGRATE_STEP 32
+#define FORT_CONF_EXE_DELETED      ((PFORT_CONF_EXE_NODE) (ULONG_PTR) -1)
+
 typedef struct fort_conf_exe_node
 {
-    struct fort_conf_exe_node *next;
-    struct fort_conf_exe_node *prev;
+    struct fort_conf_exe_node *next; /* in the deleted, grace or free list */
 
-    PFORT_APP_ENTRY app_entry; /* tommy_hashdyn_node::data */
+    PFORT_APP_ENTRY app_entry;
 
-    tommy_key_t path_hash; /* tommy_hashdyn_node::index */
+    tommy_key_t path_hash;
 } FORT_CONF_EXE_NODE, *PFORT_CONF_EXE_NODE;
 
 static FORT_TIME fort_current_time(void)
@@ -31,9 +37,81 @@ static FORT_TIME fort_current_time(void)
     return time;
 }
 
-FORT_API void fort_device_conf_open(PFORT_DEVICE_CONF device_conf)
+static PFORT_CONF_REF_CPU fort_conf_ref_cpus_new(UINT32 bank_count, UINT32 *cpu_count)
+{
+    const UINT32 count = KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS);
+    const SIZE_T size = bank_count * count * sizeof(FORT_CONF_REF_CPU);
+
+    PFORT_CONF_REF_CPU cpus = fort_mem_alloc(size, FORT_CONF_REF_POOL_TAG);
+
+    if (cpus != NULL) {
+        RtlZeroMemory(cpus, size);
+
+        *cpu_count = count;
+    }
+
+    return cpus;
+}
+
+static void fort_conf_ref_cpus_del(PFORT_CONF_REF_CPU cpus)
+{
+    if (cpus != NULL) {
+        fort_mem_free(cpus, FORT_CONF_REF_POOL_TAG);
+    }
+}
+
+static PFORT_CONF_REF_CPU fort_conf_ref_cpu(PFORT_CONF_REF_CPU cpus, UINT32 cpu_count)
+{
+    const UINT32 cpu_index = KeGetCurrentProcessorNumberEx(NULL);
+
+    return &cpus[(cpu_index < cpu_count) ? cpu_index : 0];
+}
+
+static LONG fort_conf_ref_cpus_sum(PFORT_CONF_REF_CPU cpus, UINT32 cpu_count)
+{
+    LONG sum = 0;
+
+    for (UINT32 i = 0; i < cpu_count; ++i) {
+        sum += cpus[i].count;
+    }
+
+    return sum;
+}
+
+FORT_API NTSTATUS fort_device_conf_open(PFORT_DEVICE_CONF device_conf)
 {
     KeInitializeSpinLock(&device_conf->ref_lock);
+
+    device_conf->conf_gen = 1;
+
+    device_conf->ref_cpus = fort_conf_ref_cpus_new(1, &device_conf->ref_cpu_count);
+
+    return (device_conf->ref_cpus != NULL) ? STATUS_SUCCESS : STATUS_INSUFFICIENT_RESOURCES;
+}
+
+static void fort_conf_ref_del(PFORT_CONF_REF conf_ref);
+
+static void fort_conf_ref_del_list(PFORT_CONF_REF conf_ref)
+{
+    while (conf_ref != NULL) {
+        PFORT_CONF_REF next = conf_ref->retired_next;
+
+        fort_conf_ref_del(conf_ref);
+
+        conf_ref = next;
+    }
+}
+
+FORT_API void fort_device_conf_close(PFORT_DEVICE_CONF device_conf)
+{
+    /* The callouts are removed, so the retired conf refs are not used */
+    fort_conf_ref_del_list(device_conf->ref_retired);
+    device_conf->ref_retired = NULL;
+
+    fort_conf_ref_cpus_del(device_conf->ref_cpus);
+
+    device_conf->ref_cpus = NULL;
+    device_conf->ref_cpu_count = 0;
 }
 
 FORT_API UCHAR fort_device_flag_set(PFORT_DEVICE_CONF device_conf, UCHAR flag, BOOL on)
@@ -52,22 +130,219 @@ FORT_API UCHAR fort_device_flag(PFORT_DEVICE_CONF device_conf, UCHAR flag)
     return fort_device_flags(device_conf) & flag;
 }
 
-static PFORT_CONF_EXE_NODE fort_conf_ref_exe_find_node(
-        PFORT_CONF_REF conf_ref, const PVOID path, UINT32 path_len, tommy_key_t path_hash)
+FORT_API void fort_device_conf_gen_inc(PFORT_DEVICE_CONF device_conf)
 {
-    PFORT_CONF_EXE_NODE node =
-            (PFORT_CONF_EXE_NODE) tommy_hashdyn_bucket(&conf_ref->exe_map, path_hash);
+    InterlockedIncrement((volatile LONG *) &device_conf->conf_gen);
+}
+
+static void fort_conf_reauth_log_add(
+        PFORT_DEVICE_CONF device_conf, UINT32 group_bits, tommy_key_t path_hash)
+{
+    PFORT_CONF_REAUTH_LOG reauth_log = &device_conf->reauth_log;
+
+    KIRQL oldIrql = ExAcquireSpinLockExclusive(&reauth_log->lock);
+    {
+        PFORT_CONF_REAUTH_CHANGE change =
+                &reauth_log->changes[reauth_log->change_n & (FORT_CONF_REAUTH_LOG_MAX - 1)];
+
+        if (reauth_log->change_n >= FORT_CONF_REAUTH_LOG_MAX) {
+            reauth_log->lost_gen = change->conf_gen;
+        }
 
-    while (node != NULL) {
-        if (node->path_hash == path_hash
+        /* Change the generation under the lock, so a classify, which read the new generation,
+         * finds the change's record in fort_conf_reauth_scoped() */
+        change->conf_gen = InterlockedIncrement((volatile LONG *) &device_conf->conf_gen);
+        change->group_bits = group_bits;
+        change->path_hash = path_hash;
+
+        ++reauth_log->change_n;
+    }
+    ExReleaseSpinLockExclusive(&reauth_log->lock, oldIrql);
+}
+
+static void fort_conf_reauth_log_all(PFORT_DEVICE_CONF device_conf)
+{
+    fort_conf_reauth_log_add(device_conf, FORT_CONF_REAUTH_GROUPS_ALL, 0);
+}
+
+FORT_API void fort_conf_reauth_log_app(PFORT_DEVICE_CONF device_conf, const PFORT_APP_ENTRY entry)
+{
+    const PVOID path = (const PVOID)(entry + 1);
+    const tommy_key_t path_hash = (tommy_key_t) tommy_hash_u64(0, path, entry->path_len);
+
+    fort_conf_reauth_log_add(device_conf, 0, path_hash);
+}
+
+static BOOL fort_conf_reauth_change_scoped(const PFORT_CONF_REAUTH_CHANGE change,
+        UINT32 group_bit, tommy_key_t path_hash)
+{
+    if (change->group_bits == 0)
+        return change->path_hash == path_hash;
+
+    return (change->group_bits & group_bit) != 0;
+}
+
+FORT_API BOOL fort_conf_reauth_scoped(PFORT_DEVICE_CONF device_conf, UINT32 conf_gen,
+        const PVOID path, UINT32 path_len, UCHAR group_index)
+{
+    PFORT_CONF_REAUTH_LOG reauth_log = &device_conf->reauth_log;
+
+    const tommy_key_t path_hash = (tommy_key_t) tommy_hash_u64(0, path, path_len);
+    const UINT32 group_bit = (1u << group_index);
+    BOOL res;
+
+    KIRQL oldIrql = ExAcquireSpinLockShared(&reauth_log->lock);
+    {
+        const UINT32 change_n = reauth_log->change_n;
+        const UINT32 count =
+                (change_n < FORT_CONF_REAUTH_LOG_MAX) ? change_n : FORT_CONF_REAUTH_LOG_MAX;
+
+        /* The changes since the flow's authorization may be dropped from the ring */
+        res = ((INT32) (reauth_log->lost_gen - conf_gen) > 0);
+
+        for (UINT32 i = 1; !res && i <= count; ++i) {
+            const PFORT_CONF_REAUTH_CHANGE change =
+                    &reauth_log->changes[(change_n - i) & (FORT_CONF_REAUTH_LOG_MAX - 1)];
+
+            if ((INT32) (change->conf_gen - conf_gen) <= 0)
+                break; /* the older changes were seen by the flow */
+
+            res = fort_conf_reauth_change_scoped(change, group_bit, path_hash);
+        }
+    }
+    ExReleaseSpinLockShared(&reauth_log->lock, oldIrql);
+
+    return res;
+}
+
+static PFORT_CONF_EXE_TABLE fort_conf_exe_table_new(UINT32 size)
+{
+    const SIZE_T table_size = FORT_CONF_EXE_TABLE_SIZE(size);
+
+    PFORT_CONF_EXE_TABLE table = fort_mem_alloc(table_size, FORT_CONF_EXE_POOL_TAG);
+
+    if (table != NULL) {
+        RtlZeroMemory(table, table_size);
+
+        table->mask = size - 1;
+    }
+
+    return table;
+}
+
+static void fort_conf_exe_table_del(PFORT_CONF_EXE_TABLE table)
+{
+    fort_mem_free(table, FORT_CONF_EXE_POOL_TAG);
+}
+
+static UINT32 fort_conf_exe_table_size(UINT32 count)
+{
+    UINT32 size = FORT_CONF_EXE_TABLE_MIN;
+
+    /* Keep the load factor below 1/2 */
+    while (size < count * 2) {
+        size *= 2;
+    }
+
+    return size;
+}
+
+/* Lock-free: slots are published with full barriers and nodes are never freed while in use */
+static PFORT_CONF_EXE_NODE fort_conf_exe_table_find(const PFORT_CONF_EXE_TABLE table,
+        const PVOID path, UINT32 path_len, tommy_key_t path_hash, UINT32 *slot_index)
+{
+    const UINT32 mask = table->mask;
+    UINT32 i = path_hash & mask;
+
+    for (;;) {
+        const PFORT_CONF_EXE_NODE node =
+                (PFORT_CONF_EXE_NODE) ReadPointerAcquire((PVOID volatile *) &table->slots[i]);
+
+        if (node == NULL)
+            return NULL;
+
+        if (node != FORT_CONF_EXE_DELETED && node->path_hash == path_hash
                 && fort_conf_app_exe_equal(node->app_entry, path, path_len)) {
+            if (slot_index != NULL) {
+                *slot_index = i;
+            }
             return node;
         }
 
-        node = node->next;
+        i = (i + 1) & mask;
+    }
+}
+
+static void fort_conf_exe_table_insert(PFORT_CONF_EXE_TABLE table, PFORT_CONF_EXE_NODE node)
+{
+    const UINT32 mask = table->mask;
+    UINT32 i = node->path_hash & mask;
+
+    for (;;) {
+        const PFORT_CONF_EXE_NODE slot_node = table->slots[i];
+
+        if (slot_node == NULL || slot_node == FORT_CONF_EXE_DELETED) {
+            if (slot_node == NULL) {
+                ++table->used_n;
+            }
+
+            InterlockedExchangePointer((PVOID volatile *) &table->slots[i], node);
+            break;
+        }
+
+        i = (i + 1) & mask;
+    }
+}
+
+static PFORT_CONF_EXE_NODE fort_conf_ref_exe_find_node(
+        PFORT_CONF_REF conf_ref, const PVOID path, UINT32 path_len, tommy_key_t path_hash)
+{
+    const PFORT_CONF_EXE_TABLE table =
+            (PFORT_CONF_EXE_TABLE) ReadPointerAcquire((PVOID volatile *) &conf_ref->exe_table);
+
+    /* Read the old table first: it is cleared only after all its nodes are moved */
+    const PFORT_CONF_EXE_TABLE old_table =
+            (PFORT_CONF_EXE_TABLE) ReadPointerAcquire((PVOID volatile *) &table->old_table);
+
+    PFORT_CONF_EXE_NODE node = fort_conf_exe_table_find(table, path, path_len, path_hash, NULL);
+
+    if (node == NULL && old_table != NULL) {
+        node = fort_conf_exe_table_find(old_table, path, path_len, path_hash, NULL);
+    }
+
+    return node;
+}
+
+static PFORT_CONF_REF_CPU fort_conf_ref_exe_readers(PFORT_CONF_REF conf_ref, UINT32 epoch)
+{
+    return conf_ref->exe_readers + (epoch & 1) * conf_ref->cpu_count;
+}
+
+/* Count the reader in the current epoch, so the deleted nodes are not freed under it */
+static PFORT_CONF_REF_CPU fort_conf_ref_exe_read_begin(PFORT_CONF_REF conf_ref)
+{
+    PFORT_CONF_REF_CPU cpu_reader;
+
+    for (;;) {
+        const UINT32 epoch = conf_ref->exe_epoch;
+
+        cpu_reader =
+                fort_conf_ref_cpu(fort_conf_ref_exe_readers(conf_ref, epoch), conf_ref->cpu_count);
+
+        InterlockedIncrement(&cpu_reader->count);
+
+        if (epoch == conf_ref->exe_epoch)
+            break;
+
+        InterlockedDecrement(&cpu_reader->count);
     }
 
-    return NULL;
+    return cpu_reader;
+}
+
+static void fort_conf_ref_exe_read_end(PFORT_CONF_REF_CPU cpu_reader)
+{
+    InterlockedDecrement(&cpu_reader->count);
 }
 
 FORT_API FORT_APP_FLAGS fort_conf_exe_find(const PFORT_CONF conf, const PVOID path, UINT32 path_len)
@@ -76,18 +351,164 @@ FORT_API FORT_APP_FLAGS fort_conf_exe_find(const PFORT_CONF conf, const PVOID pa
     const tommy_key_t path_hash = (tommy_key_t) tommy_hash_u64(0, path, path_len);
     FORT_APP_FLAGS app_flags;
 
-    KIRQL oldIrql = ExAcquireSpinLockShared(&conf_ref->conf_lock);
+    KIRQL oldIrql;
+    KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
     {
+        const PFORT_CONF_REF_CPU cpu_reader = fort_conf_ref_exe_read_begin(conf_ref);
+
         const PFORT_CONF_EXE_NODE node =
                 fort_conf_ref_exe_find_node(conf_ref, path, path_len, path_hash);
 
         app_flags.v = node ? node->app_entry->flags.v : 0;
+
+        fort_conf_ref_exe_read_end(cpu_reader);
     }
-    ExReleaseSpinLockShared(&conf_ref->conf_lock, oldIrql);
+    KeLowerIrql(oldIrql);
 
     return app_flags;
 }
 
+/* Must be called under the exe_lock, it doesn't wait for the readers */
+static void fort_conf_ref_exe_reclaim(PFORT_CONF_REF conf_ref)
+{
+    PFORT_CONF_EXE_NODE node = conf_ref->exe_grace;
+
+    if (node != NULL) {
+        const PFORT_CONF_REF_CPU cpus_reading =
+                fort_conf_ref_exe_readers(conf_ref, conf_ref->exe_epoch - 1);
+
+        if (fort_conf_ref_cpus_sum(cpus_reading, conf_ref->cpu_count) != 0)
+            return; /* the grace period is not over */
+
+        /* Free the entries after the counters of fort_conf_exe_find() are read */
+        KeMemoryBarrier();
+
+        do {
+            PFORT_CONF_EXE_NODE next = node->next;
+
+            fort_pool_free(&conf_ref->pool_list, node->app_entry);
+            node->app_entry = NULL;
+
+            node->next = conf_ref->exe_free;
+            conf_ref->exe_free = node;
+
+            node = next;
+        } while (node != NULL);
+
+        conf_ref->exe_grace = NULL;
+    }
+
+    /* The new readers can't find the deleted nodes, so wait for the current ones only */
+    if (conf_ref->exe_deleted != NULL) {
+        conf_ref->exe_grace = conf_ref->exe_deleted;
+        conf_ref->exe_deleted = NULL;
+
+        InterlockedIncrement((volatile LONG *) &conf_ref->exe_epoch);
+    }
+}
+
+static PFORT_CONF_EXE_NODE fort_conf_ref_exe_new_node(PFORT_CONF_REF conf_ref)
+{
+    PFORT_CONF_EXE_NODE node = conf_ref->exe_free;
+
+    if (node != NULL) {
+        conf_ref->exe_free = node->next;
+    } else {
+        tommy_arrayof *exe_nodes = &conf_ref->exe_nodes;
+        const UINT32 index = conf_ref->exe_nodes_n++;
+
+        tommy_arrayof_grow(exe_nodes, index + 1);
+
+        node = tommy_arrayof_ref(exe_nodes, index);
+    }
+
+    return node;
+}
+
+/* Must be called under the exe_lock, the patches replay the changes made during their copy */
+static void fort_conf_ref_exe_changed(PFORT_CONF_REF conf_ref, PFORT_CONF_EXE_NODE node)
+{
+    if (conf_ref->exe_patching == 0)
+        return;
+
+    const UINT32 change_i = conf_ref->exe_changes_n;
+
+    if (change_i > FORT_CONF_EXE_CHANGES_MAX)
+        return; /* the changes are lost already */
+
+    if (change_i < FORT_CONF_EXE_CHANGES_MAX) {
+        conf_ref->exe_changes[change_i] = node;
+    }
+
+    conf_ref->exe_changes_n = change_i + 1;
+}
+
+static void fort_conf_ref_exe_table_retire(PFORT_CONF_REF conf_ref, PFORT_CONF_EXE_TABLE table)
+{
+    /* Readers may still walk the table, so free it with the conf ref */
+    table->retired_next = conf_ref->exe_retired;
+    conf_ref->exe_retired = table;
+}
+
+/* Move some nodes from the old table, so the resize cost is spread over inserts */
+static void fort_conf_ref_exe_migrate(PFORT_CONF_REF conf_ref, UINT32 step_n)
+{
+    PFORT_CONF_EXE_TABLE table = conf_ref->exe_table;
+    PFORT_CONF_EXE_TABLE old_table = table->old_table;
+
+    if (old_table == NULL)
+        return;
+
+    UINT32 pos = conf_ref->exe_migrate_pos;
+
+    for (; step_n != 0 && pos <= old_table->mask; --step_n, ++pos) {
+        const PFORT_CONF_EXE_NODE node = old_table->slots[pos];
+
+        if (node != NULL && node != FORT_CONF_EXE_DELETED) {
+            fort_conf_exe_table_insert(table, node);
+        }
+    }
+
+    conf_ref->exe_migrate_pos = pos;
+
+    if (pos > old_table->mask) {
+        InterlockedExchangePointer((PVOID volatile *) &table->old_table, NULL);
+
+        fort_conf_ref_exe_table_retire(conf_ref, old_table);
+    }
+}
+
+static NTSTATUS fort_conf_ref_exe_reserve(PFORT_CONF_REF conf_ref)
+{
+    PFORT_CONF_EXE_TABLE table = conf_ref->exe_table;
+
+    fort_conf_ref_exe_migrate(conf_ref, FORT_CONF_EXE_MIGRATE_STEP);
+
+    /* Keep the load factor below 3/4 */
+    if ((table->used_n + 1) * 4 <= (table->mask + 1) * 3)
+        return STATUS_SUCCESS;
+
+    /* Finish the previous resize */
+    fort_conf_ref_exe_migrate(conf_ref, (UINT32) -1);
+
+    const UINT32 count = conf_ref->conf.exe_apps_n + 1;
+
+    PFORT_CONF_EXE_TABLE new_table = fort_conf_exe_table_new(fort_conf_exe_table_size(count));
+    if (new_table == NULL) {
+        /* Use the rest of the table */
+        return (table->used_n + 1 < table->mask) ? STATUS_SUCCESS
+                                                  : STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    new_table->old_table = table;
+
+    conf_ref->exe_migrate_pos = 0;
+
+    InterlockedExchangePointer((PVOID volatile *) &conf_ref->exe_table, new_table);
+
+    return STATUS_SUCCESS;
+}
+
 static NTSTATUS fort_conf_ref_exe_add_path_locked(PFORT_CONF_REF conf_ref, const PVOID path,
         UINT32 path_len, tommy_key_t path_hash, FORT_APP_FLAGS flags)
 {
@@ -95,6 +516,12 @@ static NTSTATUS fort_conf_ref_exe_add_path_locked(PFORT_CONF_REF conf_ref, const
             fort_conf_ref_exe_find_node(conf_ref, path, path_len, path_hash);
 
     if (node == NULL) {
+        fort_conf_ref_exe_reclaim(conf_ref);
+
+        const NTSTATUS status = fort_conf_ref_exe_reserve(conf_ref);
+        if (!NT_SUCCESS(status))
+            return status;
+
         const UINT16 entry_size = (UINT16) FORT_CONF_APP_ENTRY_SIZE(path_len);
         PFORT_APP_ENTRY entry = fort_pool_malloc(&conf_ref->pool_list, entry_size);
 
@@ -114,24 +541,15 @@ static NTSTATUS fort_conf_ref_exe_add_path_locked(PFORT_CONF_REF conf_ref, const
         {
             PFORT_CONF conf = &conf_ref->conf;
 
-            tommy_arrayof *exe_nodes = &conf_ref->exe_nodes;
-            tommy_hashdyn *exe_map = &conf_ref->exe_map;
+            PFORT_CONF_EXE_NODE exe_node = fort_conf_ref_exe_new_node(conf_ref);
+            exe_node->app_entry = entry;
+            exe_node->path_hash = path_hash;
 
-            tommy_hashdyn_node *exe_node = tommy_list_tail(&conf_ref->free_nodes);
-
-            if (exe_node != NULL) {
-                tommy_list_remove_existing(&conf_ref->free_nodes, exe_node);
-            } else {
-                const UINT16 index = conf->exe_apps_n;
-
-                tommy_arrayof_grow(exe_nodes, index + 1);
-
-                exe_node = tommy_arrayof_ref(exe_nodes, index);
-            }
-
-            tommy_hashdyn_insert(exe_map, exe_node, entry, path_hash);
+            fort_conf_exe_table_insert(conf_ref->exe_table, exe_node);
 
             ++conf->exe_apps_n;
+
+            fort_conf_ref_exe_changed(conf_ref, exe_node);
         }
     } else {
         if (flags.is_new)
@@ -142,6 +560,8 @@ static NTSTATUS fort_conf_ref_exe_add_path_locked(PFORT_CONF_REF conf_ref, const
             PFORT_APP_ENTRY entry = node->app_entry;
             entry->flags = flags;
         }
+
+        fort_conf_ref_exe_changed(conf_ref, node);
     }
 
     return STATUS_SUCCESS;
@@ -153,9 +573,14 @@ FORT_API NTSTATUS fort_conf_ref_exe_add_path(
     const tommy_key_t path_hash = (tommy_key_t) tommy_hash_u64(0, path, path_len);
     NTSTATUS status;
 
-    KIRQL oldIrql = ExAcquireSpinLockExclusive(&conf_ref->conf_lock);
-    status = fort_conf_ref_exe_add_path_locked(conf_ref, path, path_len, path_hash, flags);
-    ExReleaseSpinLockExclusive(&conf_ref->conf_lock, oldIrql);
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLock(&conf_ref->exe_lock, &lock_queue);
+    if (conf_ref->exe_sealed) {
+        status = STATUS_RETRY;
+    } else {
+        status = fort_conf_ref_exe_add_path_locked(conf_ref, path, path_len, path_hash, flags);
+    }
+    KeReleaseInStackQueuedSpinLock(&lock_queue);
 
     return status;
 }
@@ -191,12 +616,28 @@ static void fort_conf_ref_exe_fill(PFORT_CONF_REF conf_ref, const PFORT_CONF con
     }
 }
 
-static void fort_conf_ref_exe_del_path(PFORT_CONF_REF conf_ref, const PVOID path, UINT32 path_len)
+static void fort_conf_exe_table_mark_deleted(PFORT_CONF_EXE_TABLE table, const PVOID path,
+        UINT32 path_len, tommy_key_t path_hash)
+{
+    UINT32 slot_index;
+
+    if (fort_conf_exe_table_find(table, path, path_len, path_hash, &slot_index) != NULL) {
+        InterlockedExchangePointer(
+                (PVOID volatile *) &table->slots[slot_index], FORT_CONF_EXE_DELETED);
+    }
+}
+
+static NTSTATUS fort_conf_ref_exe_del_path(
+        PFORT_CONF_REF conf_ref, const PVOID path, UINT32 path_len)
 {
     const tommy_key_t path_hash = (tommy_key_t) tommy_hash_u64(0, path, path_len);
+    NTSTATUS status = STATUS_SUCCESS;
 
-    KIRQL oldIrql = ExAcquireSpinLockExclusive(&conf_ref->conf_lock);
-    {
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLock(&conf_ref->exe_lock, &lock_queue);
+    if (conf_ref->exe_sealed) {
+        status = STATUS_RETRY;
+    } else {
         PFORT_CONF_EXE_NODE node = fort_conf_ref_exe_find_node(conf_ref, path, path_len, path_hash);
 
         if (node != NULL) {
@@ -206,43 +647,96 @@ static void fort_conf_ref_exe_del_path(PFORT_CONF_REF conf_ref, const PVOID path
                 --conf->exe_apps_n;
             }
 
-            // Delete from pool
+            // Delete from exe tables
             {
-                PFORT_APP_ENTRY entry = node->app_entry;
-                fort_pool_free(&conf_ref->pool_list, entry);
+                PFORT_CONF_EXE_TABLE table = conf_ref->exe_table;
+
+                fort_conf_exe_table_mark_deleted(table, path, path_len, path_hash);
+
+                if (table->old_table != NULL) {
+                    fort_conf_exe_table_mark_deleted(
+                            table->old_table, path, path_len, path_hash);
+                }
             }
 
-            // Delete from exe map
-            tommy_hashdyn_remove_existing(&conf_ref->exe_map, (tommy_hashdyn_node *) node);
+            // Free the node and its entry, when the readers can't use them
+            {
+                node->next = conf_ref->exe_deleted;
+                conf_ref->exe_deleted = node;
+
+                fort_conf_ref_exe_changed(conf_ref, node);
 
-            tommy_list_insert_tail_check(&conf_ref->free_nodes, (tommy_node *) node);
+                fort_conf_ref_exe_reclaim(conf_ref);
+            }
         }
     }
-    ExReleaseSpinLockExclusive(&conf_ref->conf_lock, oldIrql);
+    KeReleaseInStackQueuedSpinLock(&lock_queue);
+
+    return status;
 }
 
-FORT_API void fort_conf_ref_exe_del_entry(PFORT_CONF_REF conf_ref, const PFORT_APP_ENTRY entry)
+FORT_API NTSTATUS fort_conf_ref_exe_del_entry(PFORT_CONF_REF conf_ref, const PFORT_APP_ENTRY entry)
 {
     const PVOID path = (const PVOID)(entry + 1);
     const UINT32 path_len = entry->path_len;
 
-    fort_conf_ref_exe_del_path(conf_ref, path, path_len);
+    return fort_conf_ref_exe_del_path(conf_ref, path, path_len);
 }
 
-static void fort_conf_ref_init(PFORT_CONF_REF conf_ref)
+static BOOL fort_conf_ref_init(PFORT_CONF_REF conf_ref, UINT16 exe_apps_n)
 {
-    conf_ref->refcount = 0;
+    conf_ref->cpu_refs = fort_conf_ref_cpus_new(1, &conf_ref->cpu_count);
+    conf_ref->exe_readers = fort_conf_ref_cpus_new(2, &conf_ref->cpu_count);
 
     fort_pool_list_init(&conf_ref->pool_list);
-    tommy_list_init(&conf_ref->free_nodes);
 
     tommy_arrayof_init(&conf_ref->exe_nodes, sizeof(FORT_CONF_EXE_NODE));
-    tommy_hashdyn_init(&conf_ref->exe_map);
+    conf_ref->exe_nodes_n = 0;
 
-    conf_ref->conf_lock = 0;
+    conf_ref->exe_epoch = 0;
+    conf_ref->exe_deleted = NULL;
+    conf_ref->exe_grace = NULL;
+    conf_ref->exe_free = NULL;
+
+    conf_ref->exe_table = fort_conf_exe_table_new(fort_conf_exe_table_size(exe_apps_n));
+    conf_ref->exe_retired = NULL;
+    conf_ref->exe_migrate_pos = 0;
+
+    conf_ref->exe_patching = 0;
+    conf_ref->exe_changes_n = 0;
+
+    conf_ref->exe_sealed = FALSE;
+    KeInitializeSpinLock(&conf_ref->exe_lock);
+
+    return conf_ref->cpu_refs != NULL && conf_ref->exe_readers != NULL
+            && conf_ref->exe_table != NULL;
 }
 
-FORT_API PFORT_CONF_REF fort_conf_ref_new(const PFORT_CONF conf, ULONG len)
+static void fort_conf_ref_exe_done(PFORT_CONF_REF conf_ref)
+{
+    PFORT_CONF_EXE_TABLE table = conf_ref->exe_table;
+
+    if (table != NULL) {
+        if (table->old_table != NULL) {
+            fort_conf_exe_table_del(table->old_table);
+        }
+        fort_conf_exe_table_del(table);
+    }
+
+    table = conf_ref->exe_retired;
+    while (table != NULL) {
+        PFORT_CONF_EXE_TABLE next = table->retired_next;
+
+        fort_conf_exe_table_del(table);
+
+        table = next;
+    }
+
+    tommy_arrayof_done(&conf_ref->exe_nodes);
+}
+
+static PFORT_CONF_REF fort_conf_ref_alloc(
+        const PFORT_CONF conf, UINT16 exe_apps_n, UINT32 exe_apps_size)
 {
     const ULONG conf_len = FORT_CONF_DATA_OFF + conf->exe_apps_off;
     const ULONG ref_len = conf_len + offsetof(FORT_CONF_REF, conf);
@@ -251,61 +745,295 @@ FORT_API PFORT_CONF_REF fort_conf_ref_new(const PFORT_CONF conf, ULONG len)
     if (conf_ref != NULL) {
         RtlCopyMemory(&conf_ref->conf, conf, conf_len);
 
-        fort_conf_ref_init(conf_ref);
-        fort_pool_init(&conf_ref->pool_list, len - conf_len);
+        if (!fort_conf_ref_init(conf_ref, exe_apps_n)) {
+            fort_conf_ref_cpus_del(conf_ref->cpu_refs);
+            fort_conf_ref_cpus_del(conf_ref->exe_readers);
+            fort_conf_ref_exe_done(conf_ref);
+            tommy_free(conf_ref);
+            return NULL;
+        }
+
+        fort_pool_init(&conf_ref->pool_list, exe_apps_size);
+    }
+
+    return conf_ref;
+}
+
+FORT_API PFORT_CONF_REF fort_conf_ref_new(const PFORT_CONF conf, ULONG len)
+{
+    const ULONG conf_len = FORT_CONF_DATA_OFF + conf->exe_apps_off;
+
+    PFORT_CONF_REF conf_ref = fort_conf_ref_alloc(conf, conf->exe_apps_n, len - conf_len);
 
+    if (conf_ref != NULL) {
         fort_conf_ref_exe_fill(conf_ref, conf);
     }
 
     return conf_ref;
 }
 
+static UINT32 fort_conf_exe_table_apps_size(const PFORT_CONF_EXE_TABLE table)
+{
+    UINT32 size = 0;
+
+    for (UINT32 i = 0; i <= table->mask; ++i) {
+        const PFORT_CONF_EXE_NODE node =
+                (PFORT_CONF_EXE_NODE) ReadPointerAcquire((PVOID volatile *) &table->slots[i]);
+
+        if (node != NULL && node != FORT_CONF_EXE_DELETED) {
+            size += FORT_CONF_APP_ENTRY_SIZE(node->app_entry->path_len);
+        }
+    }
+
+    return size;
+}
+
+static NTSTATUS fort_conf_ref_exe_copy_node(PFORT_CONF_REF conf_ref, const PFORT_CONF_EXE_NODE node)
+{
+    const PFORT_APP_ENTRY entry = node->app_entry;
+    const PVOID path = (const PVOID)(entry + 1);
+
+    /* The node may be copied again: from the old table or from the change log */
+    FORT_APP_FLAGS flags = entry->flags;
+    flags.is_new = FALSE;
+
+    return fort_conf_ref_exe_add_path_locked(
+            conf_ref, path, entry->path_len, node->path_hash, flags);
+}
+
+static NTSTATUS fort_conf_ref_exe_copy(PFORT_CONF_REF conf_ref, const PFORT_CONF_EXE_TABLE table)
+{
+    for (UINT32 i = 0; i <= table->mask; ++i) {
+        const PFORT_CONF_EXE_NODE node =
+                (PFORT_CONF_EXE_NODE) ReadPointerAcquire((PVOID volatile *) &table->slots[i]);
+
+        if (node != NULL && node != FORT_CONF_EXE_DELETED) {
+            const NTSTATUS status = fort_conf_ref_exe_copy_node(conf_ref, node);
+            if (!NT_SUCCESS(status))
+                return status;
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+/* The patch has no exe apps, they are copied from the old conf ref as its reader,
+ * without the exe_lock: the changes made meanwhile are replayed under it */
+static PFORT_CONF_REF fort_conf_ref_patch(PFORT_CONF_REF old_conf_ref, const PFORT_CONF conf)
+{
+    const PFORT_CONF_EXE_TABLE table =
+            (PFORT_CONF_EXE_TABLE) ReadPointerAcquire((PVOID volatile *) &old_conf_ref->exe_table);
+
+    /* Not yet migrated nodes are in the old table */
+    const PFORT_CONF_EXE_TABLE old_table =
+            (PFORT_CONF_EXE_TABLE) ReadPointerAcquire((PVOID volatile *) &table->old_table);
+
+    const UINT32 exe_size = fort_conf_exe_table_apps_size(table)
+            + (old_table != NULL ? fort_conf_exe_table_apps_size(old_table) : 0);
+
+    PFORT_CONF_REF conf_ref = fort_conf_ref_alloc(conf, old_conf_ref->conf.exe_apps_n, exe_size);
+
+    if (conf_ref != NULL) {
+        conf_ref->conf.exe_apps_n = 0;
+
+        NTSTATUS status = fort_conf_ref_exe_copy(conf_ref, table);
+
+        if (NT_SUCCESS(status) && old_table != NULL) {
+            status = fort_conf_ref_exe_copy(conf_ref, old_table);
+        }
+
+        if (!NT_SUCCESS(status)) {
+            fort_conf_ref_del(conf_ref);
+            conf_ref = NULL;
+        }
+    }
+
+    return conf_ref;
+}
+
+/* Must be called under the old conf ref's exe_lock, the logged nodes are not freed yet */
+static NTSTATUS fort_conf_ref_exe_replay(
+        PFORT_CONF_REF conf_ref, PFORT_CONF_REF old_conf_ref, UINT32 change_i)
+{
+    const UINT32 change_n = old_conf_ref->exe_changes_n;
+
+    if (change_n > FORT_CONF_EXE_CHANGES_MAX)
+        return STATUS_RETRY; /* too many changes, copy again */
+
+    for (; change_i < change_n; ++change_i) {
+        const PFORT_CONF_EXE_NODE node = old_conf_ref->exe_changes[change_i];
+        const PFORT_APP_ENTRY entry = node->app_entry;
+        const PVOID path = (const PVOID)(entry + 1);
+
+        /* The path's current state is copied, so the order of changes doesn't matter */
+        const PFORT_CONF_EXE_NODE live_node = fort_conf_ref_exe_find_node(
+                old_conf_ref, path, entry->path_len, node->path_hash);
+
+        const NTSTATUS status = (live_node == NULL)
+                ? fort_conf_ref_exe_del_path(conf_ref, path, entry->path_len)
+                : fort_conf_ref_exe_copy_node(conf_ref, live_node);
+
+        if (!NT_SUCCESS(status))
+            return status;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+/* Compare the parts of the confs, which affect the verdicts, except the exe apps */
+FORT_API BOOL fort_conf_ref_equal(PFORT_CONF_REF conf_ref, PFORT_CONF_REF new_conf_ref)
+{
+    const PFORT_CONF conf = &conf_ref->conf;
+    const PFORT_CONF new_conf = &new_conf_ref->conf;
+
+    return RtlCompareMemory(&conf->flags, &new_conf->flags, sizeof(FORT_CONF_FLAGS))
+                    == sizeof(FORT_CONF_FLAGS)
+            && conf->app_periods_n == new_conf->app_periods_n
+            && conf->wild_apps_n == new_conf->wild_apps_n
+            && conf->prefix_apps_n == new_conf->prefix_apps_n
+            && conf->app_perms_block_mask == new_conf->app_perms_block_mask
+            && conf->app_perms_allow_mask == new_conf->app_perms_allow_mask
+            && conf->addr_groups_off == new_conf->addr_groups_off
+            && conf->app_periods_off == new_conf->app_periods_off
+            && conf->wild_apps_off == new_conf->wild_apps_off
+            && conf->wild_index_off == new_conf->wild_index_off
+            && conf->prefix_apps_off == new_conf->prefix_apps_off
+            && conf->prefix_trie_off == new_conf->prefix_trie_off
+            && conf->exe_apps_off == new_conf->exe_apps_off
+            && RtlCompareMemory(conf->data, new_conf->data, conf->exe_apps_off)
+                    == conf->exe_apps_off;
+}
+
 static void fort_conf_ref_del(PFORT_CONF_REF conf_ref)
 {
     fort_pool_done(&conf_ref->pool_list);
 
-    tommy_hashdyn_done(&conf_ref->exe_map);
-    tommy_arrayof_done(&conf_ref->exe_nodes);
+    fort_conf_ref_exe_done(conf_ref);
+
+    fort_conf_ref_cpus_del(conf_ref->cpu_refs);
+    fort_conf_ref_cpus_del(conf_ref->exe_readers);
 
     tommy_free(conf_ref);
 }
 
-FORT_API void fort_conf_ref_put(PFORT_DEVICE_CONF device_conf, PFORT_CONF_REF conf_ref)
+/* Must be called under the ref_lock, after the retired conf ref is replaced */
+static BOOL fort_device_conf_ref_taking(PFORT_DEVICE_CONF device_conf)
 {
+    /* A fort_conf_ref_take(), which is not counted yet, will read the new ref */
+    return fort_conf_ref_cpus_sum(device_conf->ref_cpus, device_conf->ref_cpu_count) != 0;
+}
+
+static BOOL fort_conf_ref_unused(PFORT_CONF_REF conf_ref)
+{
+    /* The retired refcount can only decrease, so a zero sum is final */
+    return fort_conf_ref_cpus_sum(conf_ref->cpu_refs, conf_ref->cpu_count) == 0;
+}
+
+/* Finish the grace period of the current conf ref, also when no more apps are deleted */
+static void fort_conf_ref_exe_reclaim_current(PFORT_DEVICE_CONF device_conf)
+{
+    PFORT_CONF_REF conf_ref = fort_conf_ref_take(device_conf);
+
+    if (conf_ref == NULL)
+        return;
+
+    /* Rechecked under the lock */
+    if (conf_ref->exe_grace != NULL || conf_ref->exe_deleted != NULL) {
+        KLOCK_QUEUE_HANDLE lock_queue;
+        KeAcquireInStackQueuedSpinLock(&conf_ref->exe_lock, &lock_queue);
+        fort_conf_ref_exe_reclaim(conf_ref);
+        KeReleaseInStackQueuedSpinLock(&lock_queue);
+    }
+
+    fort_conf_ref_put(device_conf, conf_ref);
+}
+
+static void fort_conf_ref_retired_reclaim(PFORT_DEVICE_CONF device_conf)
+{
+    PFORT_CONF_REF unused_refs = NULL;
+
     KLOCK_QUEUE_HANDLE lock_queue;
     KeAcquireInStackQueuedSpinLock(&device_conf->ref_lock, &lock_queue);
-    {
-        const UINT32 refcount = --conf_ref->refcount;
 
-        if (refcount == 0 && conf_ref != device_conf->ref) {
-            fort_conf_ref_del(conf_ref);
+    if (!fort_device_conf_ref_taking(device_conf)) {
+        PFORT_CONF_REF *prev = &device_conf->ref_retired;
+        PFORT_CONF_REF conf_ref;
+
+        /* Read the refcounts after the counters of fort_conf_ref_take() */
+        KeMemoryBarrier();
+
+        while ((conf_ref = *prev) != NULL) {
+            if (fort_conf_ref_unused(conf_ref)) {
+                *prev = conf_ref->retired_next;
+
+                conf_ref->retired_next = unused_refs;
+                unused_refs = conf_ref;
+            } else {
+                prev = &conf_ref->retired_next;
+            }
         }
     }
+
     KeReleaseInStackQueuedSpinLock(&lock_queue);
+
+    fort_conf_ref_del_list(unused_refs);
+}
+
+/* Free the retired conf refs and the deleted exe nodes, which are not used anymore,
+ * without waiting for the others */
+FORT_API void fort_conf_ref_reclaim(PFORT_DEVICE_CONF device_conf)
+{
+    if (device_conf->ref_retired != NULL) {
+        fort_conf_ref_retired_reclaim(device_conf);
+    }
+
+    fort_conf_ref_exe_reclaim_current(device_conf);
+}
+
+FORT_API void fort_conf_ref_put(PFORT_DEVICE_CONF device_conf, PFORT_CONF_REF conf_ref)
+{
+    UNUSED(device_conf);
+
+    /* May run on another CPU than the fort_conf_ref_take(): only the sum of counters matters */
+    PFORT_CONF_REF_CPU cpu_ref = fort_conf_ref_cpu(conf_ref->cpu_refs, conf_ref->cpu_count);
+
+    InterlockedDecrement(&cpu_ref->count);
 }
 
 FORT_API PFORT_CONF_REF fort_conf_ref_take(PFORT_DEVICE_CONF device_conf)
 {
     PFORT_CONF_REF conf_ref;
 
-    KLOCK_QUEUE_HANDLE lock_queue;
-    KeAcquireInStackQueuedSpinLock(&device_conf->ref_lock, &lock_queue);
+    KIRQL oldIrql;
+    KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
     {
-        conf_ref = device_conf->ref;
+        PFORT_CONF_REF_CPU cpu_taking =
+                fort_conf_ref_cpu(device_conf->ref_cpus, device_conf->ref_cpu_count);
+
+        InterlockedIncrement(&cpu_taking->count);
+
+        conf_ref = ReadPointerAcquire((PVOID volatile *) &device_conf->ref);
         if (conf_ref != NULL) {
-            ++conf_ref->refcount;
+            PFORT_CONF_REF_CPU cpu_ref =
+                    fort_conf_ref_cpu(conf_ref->cpu_refs, conf_ref->cpu_count);
+
+            InterlockedIncrement(&cpu_ref->count);
         }
+
+        InterlockedDecrement(&cpu_taking->count);
     }
-    KeReleaseInStackQueuedSpinLock(&lock_queue);
+    KeLowerIrql(oldIrql);
 
     return conf_ref;
 }
 
-FORT_API FORT_CONF_FLAGS fort_conf_ref_set(PFORT_DEVICE_CONF device_conf, PFORT_CONF_REF conf_ref)
+/* Must be called under the ref_lock */
+static FORT_CONF_FLAGS fort_conf_ref_swap(PFORT_DEVICE_CONF device_conf, PFORT_CONF_REF conf_ref)
 {
     FORT_CONF_FLAGS old_conf_flags;
+    FORT_CONF_FLAGS conf_flags;
 
-    const PFORT_CONF_REF old_conf_ref = fort_conf_ref_take(device_conf);
+    PFORT_CONF_REF old_conf_ref = device_conf->ref;
 
     if (old_conf_ref != NULL) {
         old_conf_flags = old_conf_ref->conf.flags;
@@ -314,32 +1042,138 @@ FORT_API FORT_CONF_FLAGS fort_conf_ref_set(PFORT_DEVICE_CONF device_conf, PFORT_
         old_conf_flags.prov_boot = fort_device_flag(device_conf, FORT_DEVICE_PROV_BOOT) != 0;
     }
 
+    InterlockedExchangePointer((PVOID volatile *) &device_conf->ref, conf_ref);
+
+    /* Readers may still use the old ref, so it's freed later */
+    if (old_conf_ref != NULL) {
+        old_conf_ref->retired_next = device_conf->ref_retired;
+        device_conf->ref_retired = old_conf_ref;
+    }
+
+    if (conf_ref != NULL) {
+        PFORT_CONF conf = &conf_ref->conf;
+
+        conf_flags = conf->flags;
+        fort_device_flag_set(device_conf, FORT_DEVICE_PROV_BOOT, conf_flags.prov_boot);
+    } else {
+        RtlZeroMemory((void *) &conf_flags, sizeof(FORT_CONF_FLAGS));
+        conf_flags.prov_boot = fort_device_flag(device_conf, FORT_DEVICE_PROV_BOOT) != 0;
+    }
+
+    device_conf->conf_flags = conf_flags;
+
+    return old_conf_flags;
+}
+
+FORT_API FORT_CONF_FLAGS fort_conf_ref_set(PFORT_DEVICE_CONF device_conf, PFORT_CONF_REF conf_ref)
+{
+    FORT_CONF_FLAGS old_conf_flags;
+
     KLOCK_QUEUE_HANDLE lock_queue;
     KeAcquireInStackQueuedSpinLock(&device_conf->ref_lock, &lock_queue);
-    {
-        FORT_CONF_FLAGS conf_flags;
+    old_conf_flags = fort_conf_ref_swap(device_conf, conf_ref);
+    KeReleaseInStackQueuedSpinLock(&lock_queue);
 
-        device_conf->ref = conf_ref;
+    fort_conf_reauth_log_all(device_conf);
 
-        if (conf_ref != NULL) {
-            PFORT_CONF conf = &conf_ref->conf;
+    fort_conf_ref_reclaim(device_conf);
 
-            conf_flags = conf->flags;
-            fort_device_flag_set(device_conf, FORT_DEVICE_PROV_BOOT, conf_flags.prov_boot);
-        } else {
-            RtlZeroMemory((void *) &conf_flags, sizeof(FORT_CONF_FLAGS));
-            conf_flags.prov_boot = fort_device_flag(device_conf, FORT_DEVICE_PROV_BOOT) != 0;
-        }
+    return old_conf_flags;
+}
 
-        device_conf->conf_flags = conf_flags;
+/* Must be called under the old conf ref's exe_lock, not to lose the exe changes */
+static NTSTATUS fort_conf_ref_patch_publish(PFORT_DEVICE_CONF device_conf,
+        PFORT_CONF_REF old_conf_ref, PFORT_CONF_REF conf_ref, UINT32 change_i,
+        PFORT_CONF_FLAGS old_conf_flags)
+{
+    if (old_conf_ref->exe_sealed)
+        return STATUS_RETRY; /* replaced by another patch */
+
+    NTSTATUS status = fort_conf_ref_exe_replay(conf_ref, old_conf_ref, change_i);
+    if (!NT_SUCCESS(status))
+        return status;
+
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLock(&device_conf->ref_lock, &lock_queue);
+    if (device_conf->ref != old_conf_ref) {
+        status = STATUS_RETRY; /* replaced by the whole conf */
+    } else {
+        *old_conf_flags = fort_conf_ref_swap(device_conf, conf_ref);
     }
     KeReleaseInStackQueuedSpinLock(&lock_queue);
 
-    if (old_conf_ref != NULL) {
+    if (NT_SUCCESS(status)) {
+        old_conf_ref->exe_sealed = TRUE;
+    }
+
+    return status;
+}
+
+/* Replace the current conf ref with the patched one, keeping its exe apps */
+FORT_API NTSTATUS fort_conf_ref_patch_set(PFORT_DEVICE_CONF device_conf, const PFORT_CONF conf,
+        PFORT_CONF_FLAGS old_conf_flags, BOOL *conf_changed)
+{
+    NTSTATUS status;
+
+    do {
+        PFORT_CONF_REF old_conf_ref = fort_conf_ref_take(device_conf);
+
+        if (old_conf_ref == NULL)
+            return STATUS_UNSUCCESSFUL; /* the whole conf must be set first */
+
+        PFORT_CONF_REF_CPU cpu_reader = NULL;
+        UINT32 change_i = 0;
+
+        /* Log the exe changes, while the exe apps are copied without the exe_lock */
+        KLOCK_QUEUE_HANDLE exe_lock_queue;
+        KeAcquireInStackQueuedSpinLock(&old_conf_ref->exe_lock, &exe_lock_queue);
+        if (!old_conf_ref->exe_sealed) {
+            if (old_conf_ref->exe_patching++ == 0) {
+                old_conf_ref->exe_changes_n = 0;
+            }
+            change_i = old_conf_ref->exe_changes_n;
+
+            /* The nodes, deleted from now on, are not freed until the replay */
+            cpu_reader = fort_conf_ref_exe_read_begin(old_conf_ref);
+        }
+        KeReleaseInStackQueuedSpinLock(&exe_lock_queue);
+
+        if (cpu_reader == NULL) {
+            status = STATUS_RETRY; /* replaced by another patch */
+        } else {
+            PFORT_CONF_REF conf_ref = fort_conf_ref_patch(old_conf_ref, conf);
+
+            if (conf_ref != NULL) {
+                *conf_changed = !fort_conf_ref_equal(old_conf_ref, conf_ref);
+            }
+
+            KeAcquireInStackQueuedSpinLock(&old_conf_ref->exe_lock, &exe_lock_queue);
+            status = (conf_ref == NULL) ? STATUS_INSUFFICIENT_RESOURCES
+                                        : fort_conf_ref_patch_publish(device_conf, old_conf_ref,
+                                                conf_ref, change_i, old_conf_flags);
+            --old_conf_ref->exe_patching;
+            KeReleaseInStackQueuedSpinLock(&exe_lock_queue);
+
+            fort_conf_ref_exe_read_end(cpu_reader);
+
+            if (!NT_SUCCESS(status) && conf_ref != NULL) {
+                fort_conf_ref_del(conf_ref);
+            }
+        }
+
         fort_conf_ref_put(device_conf, old_conf_ref);
+    } while (status == STATUS_RETRY);
+
+    if (NT_SUCCESS(status)) {
+        /* The apps' verdicts are the same, when only the exe apps are kept */
+        if (*conf_changed) {
+            fort_conf_reauth_log_all(device_conf);
+        }
+
+        fort_conf_ref_reclaim(device_conf);
     }
 
-    return old_conf_flags;
+    return status;
 }
 
 FORT_API FORT_CONF_FLAGS fort_conf_ref_flags_set(
@@ -372,6 +1206,8 @@ FORT_API FORT_CONF_FLAGS fort_conf_ref_flags_set(
     }
     KeReleaseInStackQueuedSpinLock(&lock_queue);
 
+    fort_conf_reauth_log_all(device_conf);
+
     return old_conf_flags;
 }
 
@@ -389,11 +1225,19 @@ FORT_API BOOL fort_conf_ref_period_update(PFORT_DEVICE_CONF device_conf, BOOL fo
         const FORT_TIME time = fort_current_time();
         const UINT16 period_bits = fort_conf_app_period_bits(conf, time, periods_n);
 
-        if (force || device_conf->conf_flags.group_bits != period_bits) {
+        const UINT16 old_period_bits = device_conf->conf_flags.group_bits;
+
+        if (force || old_period_bits != period_bits) {
             device_conf->conf_flags.group_bits = period_bits;
 
             fort_conf_app_perms_mask_init(conf, period_bits);
 
+            if (old_period_bits != period_bits) {
+                fort_conf_reauth_log_add(device_conf, (old_period_bits ^ period_bits), 0);
+            } else {
+                fort_device_conf_gen_inc(device_conf);
+            }
+
             res = TRUE;
         }
     }
@@ -425,6 +1269,8 @@ FORT_API void fort_conf_zones_set(PFORT_DEVICE_CONF device_conf, PFORT_CONF_ZONE
     fort_conf_zones_free(device_conf->zones);
     device_conf->zones = zones;
     ExReleaseSpinLockExclusive(&device_conf->zones_lock, oldIrql);
+
+    fort_conf_reauth_log_all(device_conf);
 }
 
 FORT_API void fort_conf_zone_flag_set(PFORT_DEVICE_CONF device_conf, PFORT_CONF_ZONE_FLAG zone_flag)
@@ -440,29 +1286,18 @@ FORT_API void fort_conf_zone_flag_set(PFORT_DEVICE_CONF device_conf, PFORT_CONF_
         }
     }
     ExReleaseSpinLockExclusive(&device_conf->zones_lock, oldIrql);
+
+    fort_conf_reauth_log_all(device_conf);
 }
 
-FORT_API BOOL fort_conf_zones_ip_included(
-        PFORT_DEVICE_CONF device_conf, UINT32 zones_mask, UINT32 remote_ip)
+FORT_API UINT32 fort_conf_zones_ip_mask(PFORT_DEVICE_CONF device_conf, UINT32 remote_ip)
 {
-    BOOL res = FALSE;
+    UINT32 res = 0;
 
     KIRQL oldIrql = ExAcquireSpinLockShared(&device_conf->zones_lock);
     PFORT_CONF_ZONES zones = device_conf->zones;
     if (zones != NULL) {
-        zones_mask &= (zones->mask & zones->enabled_mask);
-        while (zones_mask != 0) {
-            const int zone_index = bit_scan_forward(zones_mask);
-            PFORT_CONF_ADDR_LIST addr_list =
-                    (PFORT_CONF_ADDR_LIST) (zones->data + zones->addr_off[zone_index]);
-
-            if (fort_conf_ip_inlist(remote_ip, addr_list)) {
-                res = TRUE;
-                break;
-            }
-
-            zones_mask ^= (1u << zone_index);
-        }
+        res = fort_conf_zones_ip_find(zones, remote_ip) & (zones->mask & zones->enabled_mask);
     }
     ExReleaseSpinLockShared(&device_conf->zones_lock, oldIrql);
 
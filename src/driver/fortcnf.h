@@ -7,21 +7,85 @@
 #include "fortpool.h"
 #include "forttds.h"
 
+/* Open addressing table of exe nodes, readers probe it without locking */
+typedef struct fort_conf_exe_table
+{
+    struct fort_conf_exe_table *volatile old_table; /* being migrated from while resizing */
+    struct fort_conf_exe_table *retired_next;
+
+    UINT32 mask;
+    UINT32 used_n; /* non-empty slots, including the deleted ones */
+
+    struct fort_conf_exe_node *volatile slots[1];
+} FORT_CONF_EXE_TABLE, *PFORT_CONF_EXE_TABLE;
+
+#define FORT_CONF_EXE_TABLE_SIZE(n)                                                                \
+    (offsetof(FORT_CONF_EXE_TABLE, slots) + (n) * sizeof(struct fort_conf_exe_node *))
+
+#define FORT_CONF_EXE_CHANGES_MAX 64
+
+typedef struct fort_conf_ref_cpu
+{
+    LONG volatile count;
+
+    UCHAR reserved[60]; /* keep the per-CPU counter on its own cache line */
+} FORT_CONF_REF_CPU, *PFORT_CONF_REF_CPU;
+
 typedef struct fort_conf_ref
 {
-    UINT32 volatile refcount;
+    struct fort_conf_ref *retired_next; /* replaced, but may be still in use */
+
+    PFORT_CONF_REF_CPU cpu_refs; /* per-CPU reference counters, their sum is the refcount */
+    UINT32 cpu_count;
 
     FORT_POOL_LIST pool_list;
-    tommy_list free_nodes;
 
     tommy_arrayof exe_nodes;
-    tommy_hashdyn exe_map;
+    UINT32 exe_nodes_n;
+
+    PFORT_CONF_REF_CPU exe_readers; /* per-CPU counters of fort_conf_exe_find() in progress, x2 */
+    UINT32 volatile exe_epoch; /* selects the half of exe_readers for new fort_conf_exe_find() */
+
+    struct fort_conf_exe_node *exe_deleted; /* waiting for the next grace period */
+    struct fort_conf_exe_node *exe_grace; /* waiting for the readers of the previous epoch */
+    struct fort_conf_exe_node *exe_free; /* reusable nodes, their entries are freed */
 
-    EX_SPIN_LOCK conf_lock;
+    PFORT_CONF_EXE_TABLE volatile exe_table;
+    PFORT_CONF_EXE_TABLE exe_retired;
+    UINT32 exe_migrate_pos;
+
+    UINT32 exe_patching; /* count of the patches, which copy the exe apps outside the exe_lock */
+    UINT32 exe_changes_n; /* logged for the patches, more than the max when some are lost */
+    struct fort_conf_exe_node *exe_changes[FORT_CONF_EXE_CHANGES_MAX];
+
+    BOOL exe_sealed; /* replaced by a patch, the writers must retry with the new ref */
+    KSPIN_LOCK exe_lock; /* serializes writers only */
 
     FORT_CONF conf;
 } FORT_CONF_REF, *PFORT_CONF_REF;
 
+#define FORT_CONF_REAUTH_LOG_MAX 32 /* Must be power of 2 */
+
+#define FORT_CONF_REAUTH_GROUPS_ALL 0xFFFFFFFF
+
+/* Change of the apps' verdicts, the reauthorized flows of unchanged apps are kept */
+typedef struct fort_conf_reauth_change
+{
+    UINT32 conf_gen; /* after the change */
+    UINT32 group_bits; /* of the changed app groups, 0 for the change of app */
+    tommy_key_t path_hash; /* of the changed app */
+} FORT_CONF_REAUTH_CHANGE, *PFORT_CONF_REAUTH_CHANGE;
+
+typedef struct fort_conf_reauth_log
+{
+    UINT32 change_n;
+    UINT32 lost_gen; /* of the last change, dropped from the ring */
+
+    FORT_CONF_REAUTH_CHANGE changes[FORT_CONF_REAUTH_LOG_MAX];
+
+    EX_SPIN_LOCK lock;
+} FORT_CONF_REAUTH_LOG, *PFORT_CONF_REAUTH_LOG;
+
 #define FORT_DEVICE_PROV_BOOT        0x01
 #define FORT_DEVICE_IS_OPENED        0x02
 #define FORT_DEVICE_IS_VALIDATED     0x04
@@ -34,22 +98,38 @@ typedef struct fort_device_conf
 
     FORT_CONF_FLAGS volatile conf_flags;
     PFORT_CONF_REF volatile ref;
-    KSPIN_LOCK ref_lock;
+    PFORT_CONF_REF ref_retired; /* freed by fort_conf_ref_reclaim(), when unused */
+    PFORT_CONF_REF_CPU ref_cpus; /* per-CPU counters of fort_conf_ref_take() in progress */
+    UINT32 ref_cpu_count;
+    KSPIN_LOCK ref_lock; /* serializes the conf writers */
 
     PFORT_CONF_ZONES zones;
     EX_SPIN_LOCK zones_lock;
+
+    UINT32 volatile conf_gen; /* changed on every conf/zones update, with the reauth. log */
+
+    FORT_CONF_REAUTH_LOG reauth_log;
 } FORT_DEVICE_CONF, *PFORT_DEVICE_CONF;
 
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
-FORT_API void fort_device_conf_open(PFORT_DEVICE_CONF device_conf);
+FORT_API NTSTATUS fort_device_conf_open(PFORT_DEVICE_CONF device_conf);
+
+FORT_API void fort_device_conf_close(PFORT_DEVICE_CONF device_conf);
 
 FORT_API UCHAR fort_device_flag_set(PFORT_DEVICE_CONF device_conf, UCHAR flag, BOOL on);
 
 FORT_API UCHAR fort_device_flag(PFORT_DEVICE_CONF device_conf, UCHAR flag);
 
+FORT_API void fort_device_conf_gen_inc(PFORT_DEVICE_CONF device_conf);
+
+FORT_API void fort_conf_reauth_log_app(PFORT_DEVICE_CONF device_conf, const PFORT_APP_ENTRY entry);
+
+FORT_API BOOL fort_conf_reauth_scoped(PFORT_DEVICE_CONF device_conf, UINT32 conf_gen,
+        const PVOID path, UINT32 path_len, UCHAR group_index);
+
 FORT_API FORT_APP_FLAGS fort_conf_exe_find(
         const PFORT_CONF conf, const PVOID path, UINT32 path_len);
 
@@ -59,16 +139,23 @@ FORT_API NTSTATUS fort_conf_ref_exe_add_path(
 FORT_API NTSTATUS fort_conf_ref_exe_add_entry(
         PFORT_CONF_REF conf_ref, const PFORT_APP_ENTRY entry, BOOL locked);
 
-FORT_API void fort_conf_ref_exe_del_entry(PFORT_CONF_REF conf_ref, const PFORT_APP_ENTRY entry);
+FORT_API NTSTATUS fort_conf_ref_exe_del_entry(PFORT_CONF_REF conf_ref, const PFORT_APP_ENTRY entry);
 
 FORT_API PFORT_CONF_REF fort_conf_ref_new(const PFORT_CONF conf, ULONG len);
 
+FORT_API BOOL fort_conf_ref_equal(PFORT_CONF_REF conf_ref, PFORT_CONF_REF new_conf_ref);
+
 FORT_API void fort_conf_ref_put(PFORT_DEVICE_CONF device_conf, PFORT_CONF_REF conf_ref);
 
 FORT_API PFORT_CONF_REF fort_conf_ref_take(PFORT_DEVICE_CONF device_conf);
 
 FORT_API FORT_CONF_FLAGS fort_conf_ref_set(PFORT_DEVICE_CONF device_conf, PFORT_CONF_REF conf_ref);
 
+FORT_API NTSTATUS fort_conf_ref_patch_set(PFORT_DEVICE_CONF device_conf, const PFORT_CONF conf,
+        PFORT_CONF_FLAGS old_conf_flags, BOOL *conf_changed);
+
+FORT_API void fort_conf_ref_reclaim(PFORT_DEVICE_CONF device_conf);
+
 FORT_API FORT_CONF_FLAGS fort_conf_ref_flags_set(
         PFORT_DEVICE_CONF device_conf, const PFORT_CONF_FLAGS conf_flags);
 
@@ -82,8 +169,7 @@ FORT_API void fort_conf_zones_set(PFORT_DEVICE_CONF device_conf, PFORT_CONF_ZONE
 FORT_API void fort_conf_zone_flag_set(
         PFORT_DEVICE_CONF device_conf, PFORT_CONF_ZONE_FLAG zone_flag);
 
-FORT_API BOOL fort_conf_zones_ip_included(
-        PFORT_DEVICE_CONF device_conf, UINT32 zones_mask, UINT32 remote_ip);
+FORT_API UINT32 fort_conf_zones_ip_mask(PFORT_DEVICE_CONF device_conf, UINT32 remote_ip);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -0,0 +1,115 @@
+/* Fort Firewall Per-CPU Callout Counters */
+
+#include "fortcnt.h"
+
+#define FORT_CALLOUT_COUNTERS_POOL_TAG 'OwfF'
+
+FORT_API void fort_callout_counters_open(PFORT_CALLOUT_COUNTERS counters, BOOL enabled)
+{
+    if (!enabled)
+        return;
+
+    const UINT32 cpu_count = KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS);
+    const SIZE_T size = cpu_count * sizeof(FORT_CALLOUT_COUNTERS_CPU);
+
+    counters->cpus = fort_mem_alloc(size, FORT_CALLOUT_COUNTERS_POOL_TAG);
+
+    if (counters->cpus != NULL) {
+        RtlZeroMemory(counters->cpus, size);
+
+        counters->cpu_count = cpu_count;
+
+        LARGE_INTEGER perf_freq;
+        KeQueryPerformanceCounter(&perf_freq);
+
+        counters->ticks_freq = perf_freq.QuadPart;
+    }
+}
+
+FORT_API void fort_callout_counters_close(PFORT_CALLOUT_COUNTERS counters)
+{
+    if (counters->cpus != NULL) {
+        fort_mem_free(counters->cpus, FORT_CALLOUT_COUNTERS_POOL_TAG);
+
+        counters->cpus = NULL;
+        counters->cpu_count = 0;
+    }
+}
+
+static UCHAR fort_callout_counters_bucket(INT64 ticks)
+{
+    const ULONG mask = (ticks > 0xFFFFFFFF) ? 0xFFFFFFFF : (ULONG) ticks;
+
+    ULONG index;
+    if (!_BitScanReverse(&index, mask))
+        return 0; /* no ticks */
+
+    return (index + 1 < FORT_CALLOUT_LATENCY_BUCKETS) ? (UCHAR) (index + 1)
+                                                      : (FORT_CALLOUT_LATENCY_BUCKETS - 1);
+}
+
+FORT_API void fort_callout_counters_add(
+        PFORT_CALLOUT_COUNTERS counters, UCHAR callout_id, UCHAR action, INT64 start_ticks)
+{
+    if (counters->cpus == NULL)
+        return;
+
+    const INT64 ticks = KeQueryPerformanceCounter(NULL).QuadPart - start_ticks;
+
+    /* Stay on the current CPU, so its counters are updated without locks */
+    KIRQL oldIrql;
+    KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+    {
+        const UINT32 cpu_index = KeGetCurrentProcessorNumberEx(NULL);
+
+        if (cpu_index < counters->cpu_count) {
+            PFORT_CALLOUT_STAT stat = &counters->cpus[cpu_index].callouts[callout_id];
+
+            ++stat->calls;
+
+            if ((action & FORT_CALLOUT_ACTION_PERMIT)) {
+                ++stat->permits;
+            }
+            if ((action & FORT_CALLOUT_ACTION_BLOCK)) {
+                ++stat->blocks;
+            }
+            if ((action & FORT_CALLOUT_ACTION_DEFER)) {
+                ++stat->defers;
+            }
+            if ((action & FORT_CALLOUT_ACTION_REAUTH)) {
+                ++stat->reauths;
+            }
+
+            ++stat->latency[fort_callout_counters_bucket(ticks)];
+        }
+    }
+    KeLowerIrql(oldIrql);
+}
+
+FORT_API void fort_callout_counters_stat(
+        PFORT_CALLOUT_COUNTERS counters, PFORT_CALLOUT_STATS stats)
+{
+    RtlZeroMemory(stats, sizeof(FORT_CALLOUT_STATS));
+
+    stats->ticks_freq = counters->ticks_freq;
+
+    /* The counters are read without locks, so the sums may lag behind by a few calls */
+    for (UINT32 i = 0; i < counters->cpu_count; ++i) {
+        const PFORT_CALLOUT_COUNTERS_CPU cpu = &counters->cpus[i];
+
+        for (int id = 0; id < FORT_CALLOUT_COUNT; ++id) {
+            const PFORT_CALLOUT_STAT cpu_stat = &cpu->callouts[id];
+            PFORT_CALLOUT_STAT stat = &stats->callouts[id];
+
+            stat->calls += cpu_stat->calls;
+            stat->permits += cpu_stat->permits;
+            stat->blocks += cpu_stat->blocks;
+            stat->defers += cpu_stat->defers;
+            stat->reauths += cpu_stat->reauths;
+
+            for (int b = 0; b < FORT_CALLOUT_LATENCY_BUCKETS; ++b) {
+                stat->latency[b] += cpu_stat->latency[b];
+            }
+        }
+    }
+}
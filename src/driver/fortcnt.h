@@ -0,0 +1,51 @@
+#ifndef FORTCNT_H
+#define FORTCNT_H
+
+#include "fortdrv.h"
+
+#include "common/fortconf.h"
+
+#define FORT_CALLOUT_COUNTERS_DEFAULT 1 /* 0 to disable the counters */
+
+#define FORT_CALLOUT_ACTION_PERMIT 0x01
+#define FORT_CALLOUT_ACTION_BLOCK  0x02
+#define FORT_CALLOUT_ACTION_DEFER  0x04
+#define FORT_CALLOUT_ACTION_REAUTH 0x08
+
+typedef struct fort_callout_counters_cpu
+{
+    FORT_CALLOUT_STAT callouts[FORT_CALLOUT_COUNT];
+
+    UCHAR reserved[40]; /* round the per-CPU counters up to the cache lines */
+} FORT_CALLOUT_COUNTERS_CPU, *PFORT_CALLOUT_COUNTERS_CPU;
+
+typedef struct fort_callout_counters
+{
+    UINT32 cpu_count;
+
+    INT64 ticks_freq;
+
+    PFORT_CALLOUT_COUNTERS_CPU cpus;
+} FORT_CALLOUT_COUNTERS, *PFORT_CALLOUT_COUNTERS;
+
+#define fort_callout_counters_enabled(counters) ((counters)->cpus != NULL)
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+FORT_API void fort_callout_counters_open(PFORT_CALLOUT_COUNTERS counters, BOOL enabled);
+
+FORT_API void fort_callout_counters_close(PFORT_CALLOUT_COUNTERS counters);
+
+FORT_API void fort_callout_counters_add(
+        PFORT_CALLOUT_COUNTERS counters, UCHAR callout_id, UCHAR action, INT64 start_ticks);
+
+FORT_API void fort_callout_counters_stat(
+        PFORT_CALLOUT_COUNTERS counters, PFORT_CALLOUT_STATS stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // FORTCNT_H
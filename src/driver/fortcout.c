@@ -36,13 +36,43 @@ static void fort_callout_classify_continue(FWPS_CLASSIFY_OUT0 *classifyOut)
     classifyOut->actionType = FWP_ACTION_CONTINUE;
 }
 
+static INT64 fort_callout_stat_start(void)
+{
+    return fort_callout_counters_enabled(&fort_device()->callout_counters)
+            ? KeQueryPerformanceCounter(NULL).QuadPart
+            : 0;
+}
+
+static void fort_callout_stat_end(
+        UCHAR callout_id, const FWPS_CLASSIFY_OUT0 *classifyOut, BOOL is_reauth, INT64 start_ticks)
+{
+    PFORT_CALLOUT_COUNTERS counters = &fort_device()->callout_counters;
+
+    if (!fort_callout_counters_enabled(counters))
+        return;
+
+    UCHAR action = is_reauth ? FORT_CALLOUT_ACTION_REAUTH : 0;
+
+    if (classifyOut != NULL) {
+        if ((classifyOut->flags & FWPS_CLASSIFY_OUT_FLAG_ABSORB)) {
+            action |= FORT_CALLOUT_ACTION_DEFER;
+        } else if (classifyOut->actionType == FWP_ACTION_BLOCK) {
+            action |= FORT_CALLOUT_ACTION_BLOCK;
+        } else {
+            action |= FORT_CALLOUT_ACTION_PERMIT;
+        }
+    }
+
+    fort_callout_counters_add(counters, callout_id, action, start_ticks);
+}
+
 static BOOL fort_callout_classify_v4_blocked_log_stat(const FWPS_INCOMING_VALUES0 *inFixedValues,
         const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, const FWPS_FILTER0 *filter,
         FWPS_CLASSIFY_OUT0 *classifyOut, int flagsField, int localIpField, int remoteIpField,
         int localPortField, int remotePortField, int ipProtoField, BOOL inbound,
-        UINT32 classify_flags, UINT32 remote_ip, FORT_CONF_FLAGS conf_flags, UINT32 process_id,
-        PCUNICODE_STRING real_path, PFORT_CONF_REF conf_ref, INT8 *block_reason, BOOL blocked,
-        FORT_APP_FLAGS app_flags, PIRP *irp, ULONG_PTR *info)
+        UINT32 classify_flags, UINT32 remote_ip, FORT_CONF_FLAGS conf_flags, UINT32 conf_gen,
+        UINT32 process_id, PCUNICODE_STRING real_path, PFORT_CONF_REF conf_ref,
+        PFORT_VERDICT verdict, BOOL blocked, FORT_APP_FLAGS app_flags, PIRP *irp, ULONG_PTR *info)
 {
     const UINT64 flow_id = inMetaValues->flowHandle;
 
@@ -50,16 +80,17 @@ static BOOL fort_callout_classify_v4_blocked_log_stat(const FWPS_INCOMING_VALUES
     const BOOL is_tcp = (ip_proto == IPPROTO_TCP);
 
     const UCHAR group_index = app_flags.group_index;
+    const BOOL is_continue = (verdict->block_reason == FORT_BLOCK_REASON_NONE);
     const BOOL is_reauth = (classify_flags & FWP_CONDITION_FLAG_IS_REAUTHORIZE);
 
     BOOL is_new_proc = FALSE;
 
     const NTSTATUS status = fort_flow_associate(&fort_device()->stat, flow_id, process_id,
-            group_index, is_tcp, is_reauth, &is_new_proc);
+            group_index, conf_gen, is_continue, is_tcp, is_reauth, &is_new_proc);
 
     if (!NT_SUCCESS(status)) {
         if (status == FORT_STATUS_FLOW_BLOCK) {
-            *block_reason = FORT_BLOCK_REASON_REAUTH;
+            verdict->block_reason = FORT_BLOCK_REASON_REAUTH;
             return TRUE; /* block (Reauth) */
         }
 
@@ -72,39 +103,106 @@ static BOOL fort_callout_classify_v4_blocked_log_stat(const FWPS_INCOMING_VALUES
     return FALSE;
 }
 
+static BOOL fort_callout_classify_v4_app_new(FORT_APP_FLAGS app_flags, FORT_CONF_FLAGS conf_flags)
+{
+    return app_flags.v == 0 && (conf_flags.allow_all_new || conf_flags.log_blocked)
+            && conf_flags.filter_enabled;
+}
+
+static void fort_callout_classify_v4_app(FORT_CONF_FLAGS conf_flags, UINT32 conf_gen,
+        UINT32 process_id, PCUNICODE_STRING path, PFORT_CONF_REF conf_ref,
+        PFORT_PSVERDICT ps_verdict)
+{
+    if (ps_verdict->conf_gen == conf_gen)
+        return; /* cached for the process */
+
+    const FORT_APP_FLAGS app_flags =
+            fort_conf_app_find(&conf_ref->conf, path->Buffer, path->Length, fort_conf_exe_find);
+
+    ps_verdict->app_flags = app_flags;
+    ps_verdict->blocked =
+            (UCHAR) fort_conf_app_blocked(&conf_ref->conf, app_flags, &ps_verdict->block_reason);
+
+    /* Don't cache for unknown process or the new app, which will be added to the conf */
+    if (ps_verdict->proc_seq == 0 || fort_callout_classify_v4_app_new(app_flags, conf_flags))
+        return;
+
+    ps_verdict->conf_gen = conf_gen;
+
+    fort_pstree_set_proc_verdict(&fort_device()->ps_tree, process_id, ps_verdict);
+}
+
+static NTSTATUS fort_callout_classify_v4_app_add(
+        PFORT_CONF_REF conf_ref, PCUNICODE_STRING path, FORT_APP_FLAGS app_flags)
+{
+    NTSTATUS status = fort_conf_ref_exe_add_path(conf_ref, path->Buffer, path->Length, app_flags);
+
+    /* The conf ref is replaced by a patch, so add to the current one */
+    while (status == STATUS_RETRY) {
+        PFORT_DEVICE_CONF device_conf = &fort_device()->conf;
+
+        conf_ref = fort_conf_ref_take(device_conf);
+        if (conf_ref == NULL)
+            return STATUS_UNSUCCESSFUL;
+
+        status = fort_conf_ref_exe_add_path(conf_ref, path->Buffer, path->Length, app_flags);
+
+        fort_conf_ref_put(device_conf, conf_ref);
+    }
+
+    return status;
+}
+
+static BOOL fort_callout_classify_v4_app_blocked(
+        const PFORT_PSVERDICT ps_verdict, INT8 *block_reason)
+{
+    *block_reason = ps_verdict->block_reason;
+
+    return ps_verdict->blocked;
+}
+
 static BOOL fort_callout_classify_v4_blocked_log(const FWPS_INCOMING_VALUES0 *inFixedValues,
         const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, const FWPS_FILTER0 *filter,
         FWPS_CLASSIFY_OUT0 *classifyOut, int flagsField, int localIpField, int remoteIpField,
         int localPortField, int remotePortField, int ipProtoField, BOOL inbound,
-        UINT32 classify_flags, UINT32 remote_ip, FORT_CONF_FLAGS conf_flags, UINT32 process_id,
-        PCUNICODE_STRING path, PCUNICODE_STRING real_path, PFORT_CONF_REF conf_ref,
-        INT8 *block_reason, BOOL blocked, PIRP *irp, ULONG_PTR *info)
+        UINT32 classify_flags, UINT32 remote_ip, FORT_CONF_FLAGS conf_flags, UINT32 conf_gen,
+        UINT32 process_id, PCUNICODE_STRING path, PCUNICODE_STRING real_path,
+        PFORT_CONF_REF conf_ref, PFORT_PSVERDICT ps_verdict, PFORT_VERDICT verdict, BOOL blocked,
+        PIRP *irp, ULONG_PTR *info)
 {
-    FORT_APP_FLAGS app_flags =
-            fort_conf_app_find(&conf_ref->conf, path->Buffer, path->Length, fort_conf_exe_find);
+    fort_callout_classify_v4_app(conf_flags, conf_gen, process_id, path, conf_ref, ps_verdict);
+
+    FORT_APP_FLAGS app_flags = ps_verdict->app_flags;
+
+    verdict->app_flags = app_flags;
 
     if (!blocked /* collect traffic, when Filter Disabled */
             || (app_flags.v == 0 && conf_flags.allow_all_new) /* collect new Blocked Programs */
-            || !fort_conf_app_blocked(&conf_ref->conf, app_flags, block_reason)) {
-        if (conf_flags.log_stat
-                && fort_callout_classify_v4_blocked_log_stat(inFixedValues, inMetaValues, filter,
+            || !fort_callout_classify_v4_app_blocked(ps_verdict, &verdict->block_reason)) {
+        if (conf_flags.log_stat) {
+            verdict->flow_assoc = TRUE;
+
+            if (fort_callout_classify_v4_blocked_log_stat(inFixedValues, inMetaValues, filter,
                         classifyOut, flagsField, localIpField, remoteIpField, localPortField,
                         remotePortField, ipProtoField, inbound, classify_flags, remote_ip,
-                        conf_flags, process_id, real_path, conf_ref, block_reason, blocked,
-                        app_flags, irp, info))
-            return TRUE; /* blocked */
+                        conf_flags, conf_gen, process_id, real_path, conf_ref, verdict, blocked,
+                        app_flags, irp, info)) {
+                verdict->no_cache = TRUE;
+                return TRUE; /* blocked */
+            }
+        }
 
         blocked = FALSE; /* allow */
     }
 
-    if (app_flags.v == 0 && (conf_flags.allow_all_new || conf_flags.log_blocked)
-            && conf_flags.filter_enabled) {
+    if (fort_callout_classify_v4_app_new(app_flags, conf_flags)) {
+        verdict->no_cache = TRUE; /* the app will be added */
+
         app_flags.blocked = (UCHAR) blocked;
         app_flags.alerted = 1;
         app_flags.is_new = 1;
 
-        if (NT_SUCCESS(
-                    fort_conf_ref_exe_add_path(conf_ref, path->Buffer, path->Length, app_flags))) {
+        if (NT_SUCCESS(fort_callout_classify_v4_app_add(conf_ref, path, app_flags))) {
             fort_buffer_blocked_write(&fort_device()->buffer, blocked, process_id,
                     real_path->Length, real_path->Buffer, irp, info);
         }
@@ -117,9 +215,10 @@ static BOOL fort_callout_classify_v4_blocked(const FWPS_INCOMING_VALUES0 *inFixe
         const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, const FWPS_FILTER0 *filter,
         FWPS_CLASSIFY_OUT0 *classifyOut, int flagsField, int localIpField, int remoteIpField,
         int localPortField, int remotePortField, int ipProtoField, BOOL inbound,
-        UINT32 classify_flags, UINT32 remote_ip, FORT_CONF_FLAGS conf_flags, UINT32 process_id,
-        PUNICODE_STRING path, PUNICODE_STRING real_path, PFORT_CONF_REF conf_ref,
-        INT8 *block_reason, PIRP *irp, ULONG_PTR *info)
+        UINT32 classify_flags, UINT32 remote_ip, FORT_CONF_FLAGS conf_flags, UINT32 conf_gen,
+        UINT32 process_id, PUNICODE_STRING path, PUNICODE_STRING real_path,
+        PFORT_CONF_REF conf_ref, PFORT_PSVERDICT ps_verdict, PFORT_VERDICT verdict, PIRP *irp,
+        ULONG_PTR *info)
 {
     BOOL blocked = TRUE;
 
@@ -128,7 +227,7 @@ static BOOL fort_callout_classify_v4_blocked(const FWPS_INCOMING_VALUES0 *inFixe
             return TRUE; /* block all */
 
         if (!fort_conf_ip_is_inet(&conf_ref->conf,
-                    (fort_conf_zones_ip_included_func *) fort_conf_zones_ip_included,
+                    (fort_conf_zones_ip_mask_func *) fort_conf_zones_ip_mask,
                     &fort_device()->conf, remote_ip))
             return FALSE; /* allow LocalNetwork */
 
@@ -136,9 +235,9 @@ static BOOL fort_callout_classify_v4_blocked(const FWPS_INCOMING_VALUES0 *inFixe
             return TRUE; /* block Internet */
 
         if (!fort_conf_ip_inet_included(&conf_ref->conf,
-                    (fort_conf_zones_ip_included_func *) fort_conf_zones_ip_included,
+                    (fort_conf_zones_ip_mask_func *) fort_conf_zones_ip_mask,
                     &fort_device()->conf, remote_ip)) {
-            *block_reason = FORT_BLOCK_REASON_IP_INET;
+            verdict->block_reason = FORT_BLOCK_REASON_IP_INET;
             return TRUE; /* block address */
         }
     } else {
@@ -150,15 +249,92 @@ static BOOL fort_callout_classify_v4_blocked(const FWPS_INCOMING_VALUES0 *inFixe
 
     return fort_callout_classify_v4_blocked_log(inFixedValues, inMetaValues, filter, classifyOut,
             flagsField, localIpField, remoteIpField, localPortField, remotePortField, ipProtoField,
-            inbound, classify_flags, remote_ip, conf_flags, process_id, path, real_path, conf_ref,
-            block_reason, blocked, irp, info);
+            inbound, classify_flags, remote_ip, conf_flags, conf_gen, process_id, path, real_path,
+            conf_ref, ps_verdict, verdict, blocked, irp, info);
+}
+
+static BOOL fort_callout_classify_v4_cached(const FWPS_INCOMING_VALUES0 *inFixedValues,
+        const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, const FWPS_FILTER0 *filter,
+        FWPS_CLASSIFY_OUT0 *classifyOut, int flagsField, int localIpField, int remoteIpField,
+        int localPortField, int remotePortField, int ipProtoField, BOOL inbound,
+        UINT32 classify_flags, UINT32 remote_ip, FORT_CONF_FLAGS conf_flags, UINT32 conf_gen,
+        UINT32 process_id, PUNICODE_STRING path, PUNICODE_STRING real_path,
+        PFORT_CONF_REF conf_ref, PFORT_PSVERDICT ps_verdict, PFORT_VERDICT verdict, PIRP *irp,
+        ULONG_PTR *info)
+{
+    PFORT_VERDICT_CACHE verdict_cache = &fort_device()->verdict_cache;
+
+    FORT_VERDICT_KEY key;
+    fort_verdict_key_init(&key, path);
+    key.remote_ip = remote_ip;
+    key.remote_port = inFixedValues->incomingValue[remotePortField].value.uint16;
+    key.ip_proto = inFixedValues->incomingValue[ipProtoField].value.uint8;
+    key.inbound = (UCHAR) inbound;
+
+    if (fort_verdict_cache_lookup(verdict_cache, &key, path, conf_gen, verdict)) {
+        if (verdict->blocked)
+            return TRUE;
+
+        /* The flow must be associated on every connection */
+        return verdict->flow_assoc
+                && fort_callout_classify_v4_blocked_log_stat(inFixedValues, inMetaValues, filter,
+                        classifyOut, flagsField, localIpField, remoteIpField, localPortField,
+                        remotePortField, ipProtoField, inbound, classify_flags, remote_ip,
+                        conf_flags, conf_gen, process_id, real_path, conf_ref, verdict, FALSE,
+                        verdict->app_flags, irp, info);
+    }
+
+    const BOOL blocked = fort_callout_classify_v4_blocked(inFixedValues, inMetaValues, filter,
+            classifyOut, flagsField, localIpField, remoteIpField, localPortField, remotePortField,
+            ipProtoField, inbound, classify_flags, remote_ip, conf_flags, conf_gen, process_id,
+            path, real_path, conf_ref, ps_verdict, verdict, irp, info);
+
+    if (!verdict->no_cache) {
+        verdict->blocked = (UCHAR) blocked;
+
+        fort_verdict_cache_add(verdict_cache, &key, path, conf_gen, verdict);
+    }
+
+    return blocked;
+}
+
+static BOOL fort_callout_classify_v4_reauth_kept(
+        const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, const FWPS_FILTER0 *filter,
+        FWPS_CLASSIFY_OUT0 *classifyOut, UINT32 classify_flags, UINT32 conf_gen,
+        PCUNICODE_STRING path)
+{
+    if (!(classify_flags & FWP_CONDITION_FLAG_IS_REAUTHORIZE))
+        return FALSE;
+
+    PFORT_STAT stat = &fort_device()->stat;
+    const UINT64 flow_id = inMetaValues->flowHandle;
+
+    FORT_FLOW_OPT opt;
+    UINT32 flow_conf_gen;
+    if (!fort_flow_auth(stat, flow_id, &opt, &flow_conf_gen))
+        return FALSE; /* the flow is not associated */
+
+    if (fort_conf_reauth_scoped(&fort_device()->conf, flow_conf_gen, path->Buffer, path->Length,
+                opt.group_index))
+        return FALSE; /* the app's verdict may be changed */
+
+    fort_flow_auth_update(stat, flow_id, conf_gen);
+
+    if (opt.flags & FORT_FLOW_CONTINUE) {
+        fort_callout_classify_continue(classifyOut);
+    } else {
+        fort_callout_classify_permit(filter, classifyOut);
+    }
+
+    return TRUE;
 }
 
 static void fort_callout_classify_v4_check(const FWPS_INCOMING_VALUES0 *inFixedValues,
         const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, const FWPS_FILTER0 *filter,
         FWPS_CLASSIFY_OUT0 *classifyOut, int flagsField, int localIpField, int remoteIpField,
         int localPortField, int remotePortField, int ipProtoField, BOOL inbound,
-        UINT32 classify_flags, UINT32 remote_ip, PFORT_CONF_REF conf_ref, PIRP *irp,
+        UINT32 classify_flags, UINT32 remote_ip, UINT32 conf_gen, PFORT_CONF_REF conf_ref,
+        PFORT_TRACE_RECORD trace_rec, PUNICODE_STRING trace_path, BOOL *ps_named, PIRP *irp,
         ULONG_PTR *info)
 {
     const FORT_CONF_FLAGS conf_flags = conf_ref->conf.flags;
@@ -171,20 +347,42 @@ static void fort_callout_classify_v4_check(const FWPS_INCOMING_VALUES0 *inFixedV
     real_path.MaximumLength = real_path.Length;
     real_path.Buffer = (PWSTR) inMetaValues->processPath->data;
 
+    FORT_PSVERDICT ps_verdict;
+    RtlZeroMemory(&ps_verdict, sizeof(FORT_PSVERDICT));
+
     BOOL inherited = FALSE;
     UNICODE_STRING path;
-    if (!fort_pstree_get_proc_name(
-                &fort_device()->ps_tree, conf_ref, process_id, &path, &inherited)) {
+    /* The process's name is kept till the end of the classify */
+    *ps_named = fort_pstree_get_proc_name(
+            &fort_device()->ps_tree, process_id, &path, &inherited, &ps_verdict);
+
+    if (!*ps_named) {
         path = real_path;
     } else if (!inherited) {
         real_path = path;
     }
 
-    INT8 block_reason = FORT_BLOCK_REASON_UNKNOWN;
-    const BOOL blocked = fort_callout_classify_v4_blocked(inFixedValues, inMetaValues, filter,
+    *trace_path = path;
+
+    /* Keep the reauthorized flow of the unchanged app as is */
+    if (fort_callout_classify_v4_reauth_kept(
+                inMetaValues, filter, classifyOut, classify_flags, conf_gen, &path)) {
+        trace_rec->flags |= FORT_TRACE_KEPT;
+        return;
+    }
+
+    FORT_VERDICT verdict;
+    RtlZeroMemory(&verdict, sizeof(FORT_VERDICT));
+    verdict.block_reason = FORT_BLOCK_REASON_UNKNOWN;
+
+    const BOOL blocked = fort_callout_classify_v4_cached(inFixedValues, inMetaValues, filter,
             classifyOut, flagsField, localIpField, remoteIpField, localPortField, remotePortField,
-            ipProtoField, inbound, classify_flags, remote_ip, conf_flags, process_id, &path,
-            &real_path, conf_ref, &block_reason, irp, info);
+            ipProtoField, inbound, classify_flags, remote_ip, conf_flags, conf_gen, process_id,
+            &path, &real_path, conf_ref, &ps_verdict, &verdict, irp, info);
+
+    const INT8 block_reason = verdict.block_reason;
+
+    trace_rec->block_reason = block_reason;
 
     if (blocked) {
         /* Log the blocked connection */
@@ -195,9 +393,9 @@ static void fort_callout_classify_v4_check(const FWPS_INCOMING_VALUES0 *inFixedV
             const IPPROTO ip_proto =
                     (IPPROTO) inFixedValues->incomingValue[ipProtoField].value.uint8;
 
-            fort_buffer_blocked_ip_write(&fort_device()->buffer, inbound, inherited, block_reason,
-                    ip_proto, local_port, remote_port, local_ip, remote_ip, process_id,
-                    real_path.Length, real_path.Buffer, irp, info);
+            fort_log_dedup_blocked_ip_write(&fort_device()->log_dedup, &fort_device()->buffer,
+                    inbound, inherited, block_reason, ip_proto, local_port, remote_port, local_ip,
+                    remote_ip, process_id, real_path.Length, real_path.Buffer, irp, info);
         }
 
         /* Block the connection */
@@ -207,12 +405,48 @@ static void fort_callout_classify_v4_check(const FWPS_INCOMING_VALUES0 *inFixedV
             /* Continue the search */
             fort_callout_classify_continue(classifyOut);
         } else {
+            /* Log the allowed connection */
+            if (conf_flags.log_allowed_ip) {
+                const UINT16 remote_port =
+                        inFixedValues->incomingValue[remotePortField].value.uint16;
+                const IPPROTO ip_proto =
+                        (IPPROTO) inFixedValues->incomingValue[ipProtoField].value.uint8;
+
+                fort_log_dedup_allowed_ip_write(&fort_device()->log_dedup,
+                        &fort_device()->buffer, inbound, inherited, ip_proto, remote_port,
+                        remote_ip, process_id, real_path.Length, real_path.Buffer, irp, info);
+            }
+
             /* Allow the connection */
             fort_callout_classify_permit(filter, classifyOut);
         }
     }
 }
 
+static void fort_callout_classify_v4_trace(const FWPS_INCOMING_VALUES0 *inFixedValues,
+        const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, FWPS_CLASSIFY_OUT0 *classifyOut,
+        int localIpField, int localPortField, int remotePortField, int ipProtoField,
+        BOOL inbound, UINT32 classify_flags, UINT32 remote_ip, UINT32 conf_gen,
+        PFORT_TRACE_RECORD rec, PCUNICODE_STRING path, INT64 start_ticks)
+{
+    rec->ticks = (UINT32) (KeQueryPerformanceCounter(NULL).QuadPart - start_ticks);
+
+    rec->flags |= (inbound ? FORT_TRACE_INBOUND : 0)
+            | ((classify_flags & FWP_CONDITION_FLAG_IS_REAUTHORIZE) ? FORT_TRACE_REAUTH : 0)
+            | (classifyOut->actionType == FWP_ACTION_BLOCK ? FORT_TRACE_BLOCKED : 0)
+            | (classifyOut->actionType == FWP_ACTION_CONTINUE ? FORT_TRACE_CONTINUE : 0);
+
+    rec->ip_proto = inFixedValues->incomingValue[ipProtoField].value.uint8;
+    rec->process_id = (UINT32) inMetaValues->processId;
+    rec->conf_gen = conf_gen;
+    rec->local_ip = inFixedValues->incomingValue[localIpField].value.uint32;
+    rec->remote_ip = remote_ip;
+    rec->local_port = inFixedValues->incomingValue[localPortField].value.uint16;
+    rec->remote_port = inFixedValues->incomingValue[remotePortField].value.uint16;
+
+    fort_trace_classify_write(&fort_device()->trace, rec, path->Buffer, path->Length);
+}
+
 static void fort_callout_classify_v4(const FWPS_INCOMING_VALUES0 *inFixedValues,
         const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, const FWPS_FILTER0 *filter,
         FWPS_CLASSIFY_OUT0 *classifyOut, int flagsField, int localIpField, int remoteIpField,
@@ -231,6 +465,12 @@ static void fort_callout_classify_v4(const FWPS_INCOMING_VALUES0 *inFixedValues,
         return;
     }
 
+    const BOOL is_traced = fort_trace_enabled(&fort_device()->trace);
+    const INT64 start_ticks = is_traced ? KeQueryPerformanceCounter(NULL).QuadPart : 0;
+
+    /* Read the generation before the conf, so a concurrent update invalidates the verdict */
+    const UINT32 conf_gen = fort_device()->conf.conf_gen;
+
     PFORT_CONF_REF conf_ref = fort_conf_ref_take(&fort_device()->conf);
 
     if (conf_ref == NULL) {
@@ -242,17 +482,43 @@ static void fort_callout_classify_v4(const FWPS_INCOMING_VALUES0 *inFixedValues,
         return;
     }
 
+    FORT_TRACE_RECORD trace_rec;
+    RtlZeroMemory(&trace_rec, sizeof(FORT_TRACE_RECORD));
+
+    UNICODE_STRING trace_path;
+    BOOL ps_named;
+
     fort_callout_classify_v4_check(inFixedValues, inMetaValues, filter, classifyOut, flagsField,
             localIpField, remoteIpField, localPortField, remotePortField, ipProtoField, inbound,
-            classify_flags, remote_ip, conf_ref, &irp, &info);
+            classify_flags, remote_ip, conf_gen, conf_ref, &trace_rec, &trace_path, &ps_named,
+            &irp, &info);
 
     fort_conf_ref_put(&fort_device()->conf, conf_ref);
 
+    if (is_traced) {
+        fort_callout_classify_v4_trace(inFixedValues, inMetaValues, classifyOut, localIpField,
+                localPortField, remotePortField, ipProtoField, inbound, classify_flags, remote_ip,
+                conf_gen, &trace_rec, &trace_path, start_ticks);
+    }
+
+    if (ps_named) {
+        fort_pstree_put_proc_name(&fort_device()->ps_tree, &trace_path);
+    }
+
     if (irp != NULL) {
         fort_request_complete_info(irp, STATUS_SUCCESS, info);
     }
 }
 
+static void fort_callout_classify_v4_stat(const FWPS_INCOMING_VALUES0 *inFixedValues,
+        const FWPS_CLASSIFY_OUT0 *classifyOut, int flagsField, UCHAR callout_id, INT64 start_ticks)
+{
+    const UINT32 classify_flags = inFixedValues->incomingValue[flagsField].value.uint32;
+
+    fort_callout_stat_end(callout_id, classifyOut,
+            (classify_flags & FWP_CONDITION_FLAG_IS_REAUTHORIZE) != 0, start_ticks);
+}
+
 static void NTAPI fort_callout_connect_v4(const FWPS_INCOMING_VALUES0 *inFixedValues,
         const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, void *layerData,
         const FWPS_FILTER0 *filter, const UINT64 flowContext, FWPS_CLASSIFY_OUT0 *classifyOut)
@@ -260,12 +526,17 @@ static void NTAPI fort_callout_connect_v4(const FWPS_INCOMING_VALUES0 *inFixedVa
     UNUSED(layerData);
     UNUSED(flowContext);
 
+    const INT64 start_ticks = fort_callout_stat_start();
+
     fort_callout_classify_v4(inFixedValues, inMetaValues, filter, classifyOut,
             FWPS_FIELD_ALE_AUTH_CONNECT_V4_FLAGS, FWPS_FIELD_ALE_AUTH_CONNECT_V4_IP_LOCAL_ADDRESS,
             FWPS_FIELD_ALE_AUTH_CONNECT_V4_IP_REMOTE_ADDRESS,
             FWPS_FIELD_ALE_AUTH_CONNECT_V4_IP_LOCAL_PORT,
             FWPS_FIELD_ALE_AUTH_CONNECT_V4_IP_REMOTE_PORT,
             FWPS_FIELD_ALE_AUTH_CONNECT_V4_IP_PROTOCOL, FALSE);
+
+    fort_callout_classify_v4_stat(inFixedValues, classifyOut, FWPS_FIELD_ALE_AUTH_CONNECT_V4_FLAGS,
+            FORT_CALLOUT_CONNECT_V4, start_ticks);
 }
 
 static void NTAPI fort_callout_accept_v4(const FWPS_INCOMING_VALUES0 *inFixedValues,
@@ -275,6 +546,8 @@ static void NTAPI fort_callout_accept_v4(const FWPS_INCOMING_VALUES0 *inFixedVal
     UNUSED(layerData);
     UNUSED(flowContext);
 
+    const INT64 start_ticks = fort_callout_stat_start();
+
     fort_callout_classify_v4(inFixedValues, inMetaValues, filter, classifyOut,
             FWPS_FIELD_ALE_AUTH_RECV_ACCEPT_V4_FLAGS,
             FWPS_FIELD_ALE_AUTH_RECV_ACCEPT_V4_IP_LOCAL_ADDRESS,
@@ -282,6 +555,9 @@ static void NTAPI fort_callout_accept_v4(const FWPS_INCOMING_VALUES0 *inFixedVal
             FWPS_FIELD_ALE_AUTH_RECV_ACCEPT_V4_IP_LOCAL_PORT,
             FWPS_FIELD_ALE_AUTH_RECV_ACCEPT_V4_IP_REMOTE_PORT,
             FWPS_FIELD_ALE_AUTH_RECV_ACCEPT_V4_IP_PROTOCOL, TRUE);
+
+    fort_callout_classify_v4_stat(inFixedValues, classifyOut,
+            FWPS_FIELD_ALE_AUTH_RECV_ACCEPT_V4_FLAGS, FORT_CALLOUT_ACCEPT_V4, start_ticks);
 }
 
 static NTSTATUS NTAPI fort_callout_notify(
@@ -306,6 +582,12 @@ static void fort_callout_defer_packet_flush(UINT32 list_bits, BOOL dispatchLevel
             &fort_device()->defer, fort_packet_inject_complete, list_bits, dispatchLevel);
 }
 
+static void fort_callout_defer_datagram_flush(UINT32 list_bits, BOOL dispatchLevel)
+{
+    fort_defer_datagram_flush(
+            &fort_device()->defer, fort_packet_inject_complete, list_bits, dispatchLevel);
+}
+
 static void fort_callout_defer_stream_flush(UINT64 flow_id, BOOL dispatchLevel)
 {
     UNUSED(dispatchLevel);
@@ -316,10 +598,11 @@ static void fort_callout_defer_stream_flush(UINT64 flow_id, BOOL dispatchLevel)
 FORT_API void fort_callout_defer_flush(void)
 {
     fort_callout_defer_packet_flush(FORT_DEFER_FLUSH_ALL, FALSE);
+    fort_callout_defer_datagram_flush(FORT_DEFER_FLUSH_ALL, FALSE);
     fort_callout_defer_stream_flush(FORT_DEFER_STREAM_ALL, FALSE);
 }
 
-static void fort_callout_flow_classify_v4(const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues,
+static UCHAR fort_callout_flow_classify_v4(const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues,
         UINT64 flowContext, FWPS_CLASSIFY_OUT0 *classifyOut, UINT32 dataSize, BOOL is_tcp,
         BOOL inbound)
 {
@@ -327,7 +610,8 @@ static void fort_callout_flow_classify_v4(const FWPS_INCOMING_METADATA_VALUES0 *
 
     UNUSED(classifyOut);
 
-    fort_flow_classify(&fort_device()->stat, flowContext, headerSize + dataSize, is_tcp, inbound);
+    return fort_flow_classify(
+            &fort_device()->stat, flowContext, headerSize + dataSize, is_tcp, inbound);
 }
 
 static BOOL fort_callout_stream_classify_v4_fragment(const FWPS_INCOMING_VALUES0 *inFixedValues,
@@ -385,6 +669,8 @@ static void NTAPI fort_callout_stream_classify_v4(const FWPS_INCOMING_VALUES0 *i
 
     UNUSED(inFixedValues);
 
+    const INT64 start_ticks = fort_callout_stat_start();
+
     fort_callout_flow_classify_v4(inMetaValues, flowContext, classifyOut, dataSize, TRUE, inbound);
 
 /* Flush flow's deferred TCP packets on FIN */
@@ -413,11 +699,45 @@ static void NTAPI fort_callout_stream_classify_v4(const FWPS_INCOMING_VALUES0 *i
 
     /* permit: */
     fort_callout_classify_permit(filter, classifyOut);
-    return;
+    goto end;
 
 drop:
     fort_callout_classify_drop(classifyOut);
-    return;
+
+end:
+    fort_callout_stat_end(FORT_CALLOUT_STREAM_V4, classifyOut, FALSE, start_ticks);
+}
+
+/* Queue or drop the datagram of speed limited app. group */
+static BOOL fort_callout_datagram_classify_v4_shape(const FWPS_INCOMING_VALUES0 *inFixedValues,
+        const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, const PNET_BUFFER_LIST netBufList,
+        UINT64 flowContext, UCHAR shape, BOOL inbound)
+{
+    if (fort_device_flag(&fort_device()->conf, FORT_DEVICE_POWER_OFF))
+        return FALSE;
+
+    PFORT_FLOW flow = (PFORT_FLOW) flowContext;
+
+    const UCHAR group_index = flow->opt.group_index;
+
+    BOOL dropped = (shape == FORT_STAT_SHAPE_DROP);
+
+    if (!dropped) {
+        const NTSTATUS status = fort_defer_datagram_add(&fort_device()->defer, inFixedValues,
+                inMetaValues, netBufList, inbound, group_index);
+
+        if (!NT_SUCCESS(status)) {
+            if (status != STATUS_QUOTA_EXCEEDED)
+                return FALSE;
+
+            /* Drop the tail of the full queue */
+            dropped = TRUE;
+        }
+    }
+
+    fort_stat_shaper_count(&fort_device()->stat, group_index, inbound, dropped);
+
+    return TRUE;
 }
 
 static void NTAPI fort_callout_datagram_classify_v4(const FWPS_INCOMING_VALUES0 *inFixedValues,
@@ -432,9 +752,29 @@ static void NTAPI fort_callout_datagram_classify_v4(const FWPS_INCOMING_VALUES0
                     .value.uint8;
     const BOOL inbound = (direction == FWP_DIRECTION_INBOUND);
 
-    fort_callout_flow_classify_v4(inMetaValues, flowContext, classifyOut, dataSize, FALSE, inbound);
+    const INT64 start_ticks = fort_callout_stat_start();
+
+    /* Skip the shaped datagram, re-injected after its queue */
+    if (fort_defer_injected_by_self(&fort_device()->defer, netBufList))
+        goto permit;
+
+    const UCHAR shape = fort_callout_flow_classify_v4(
+            inMetaValues, flowContext, classifyOut, dataSize, FALSE, inbound);
+
+    if (shape != FORT_STAT_SHAPE_PASS
+            && fort_callout_datagram_classify_v4_shape(
+                    inFixedValues, inMetaValues, netBufList, flowContext, shape, inbound))
+        goto drop;
 
+permit:
     fort_callout_classify_permit(filter, classifyOut);
+    goto end;
+
+drop:
+    fort_callout_classify_drop(classifyOut);
+
+end:
+    fort_callout_stat_end(FORT_CALLOUT_DATAGRAM_V4, classifyOut, FALSE, start_ticks);
 }
 
 static void NTAPI fort_callout_flow_delete_v4(UINT16 layerId, UINT32 calloutId, UINT64 flowContext)
@@ -442,7 +782,11 @@ static void NTAPI fort_callout_flow_delete_v4(UINT16 layerId, UINT32 calloutId,
     UNUSED(layerId);
     UNUSED(calloutId);
 
+    const INT64 start_ticks = fort_callout_stat_start();
+
     fort_flow_delete(&fort_device()->stat, flowContext);
+
+    fort_callout_stat_end(FORT_CALLOUT_FLOW_DELETE_V4, NULL, FALSE, start_ticks);
 }
 
 static BOOL fort_callout_transport_classify_v4_packet(const FWPS_INCOMING_VALUES0 *inFixedValues,
@@ -522,16 +866,24 @@ static void NTAPI fort_callout_in_transport_classify_v4(const FWPS_INCOMING_VALU
         const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, const PNET_BUFFER_LIST netBufList,
         const FWPS_FILTER0 *filter, UINT64 flowContext, FWPS_CLASSIFY_OUT0 *classifyOut)
 {
+    const INT64 start_ticks = fort_callout_stat_start();
+
     fort_callout_transport_classify_v4(
             inFixedValues, inMetaValues, netBufList, filter, flowContext, classifyOut, TRUE);
+
+    fort_callout_stat_end(FORT_CALLOUT_IN_TRANSPORT_V4, classifyOut, FALSE, start_ticks);
 }
 
 static void NTAPI fort_callout_out_transport_classify_v4(const FWPS_INCOMING_VALUES0 *inFixedValues,
         const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, const PNET_BUFFER_LIST netBufList,
         const FWPS_FILTER0 *filter, UINT64 flowContext, FWPS_CLASSIFY_OUT0 *classifyOut)
 {
+    const INT64 start_ticks = fort_callout_stat_start();
+
     fort_callout_transport_classify_v4(
             inFixedValues, inMetaValues, netBufList, filter, flowContext, classifyOut, FALSE);
+
+    fort_callout_stat_end(FORT_CALLOUT_OUT_TRANSPORT_V4, classifyOut, FALSE, start_ticks);
 }
 
 static void NTAPI fort_callout_delete_v4(UINT16 layerId, UINT32 calloutId, UINT64 flowContext)
@@ -736,6 +1088,7 @@ FORT_API NTSTATUS fort_callout_force_reauth(
 
     if (defer_flush_bits != 0) {
         fort_callout_defer_packet_flush(defer_flush_bits, FALSE);
+        fort_callout_defer_datagram_flush(defer_flush_bits, FALSE);
     }
 
     /* Open provider */
@@ -752,7 +1105,10 @@ FORT_API NTSTATUS fort_callout_force_reauth(
     if (NT_SUCCESS(status)) {
         fort_timer_update(&fort_device()->log_timer,
                 (conf_flags.allow_all_new || conf_flags.log_blocked || conf_flags.log_stat
-                        || conf_flags.log_blocked_ip));
+                        || conf_flags.log_blocked_ip || conf_flags.log_allowed_ip));
+
+        fort_timer_update(&fort_device()->shaper_timer,
+                (conf_flags.log_stat && fort_device()->stat.conf_group.limit_bits != 0));
     } else {
         LOG("Callout Reauth: Error: %x\n", status);
     }
@@ -771,6 +1127,9 @@ FORT_API void NTAPI fort_callout_timer(void)
     PIRP irp = NULL;
     ULONG_PTR info;
 
+    /* Flush the folded repeats of blocked connections */
+    fort_log_dedup_flush(&fort_device()->log_dedup, buf, &irp, &info);
+
     /* Lock buffer */
     fort_buffer_dpc_begin(buf, &buf_lock_queue);
 
@@ -815,9 +1174,6 @@ FORT_API void NTAPI fort_callout_timer(void)
         fort_stat_dpc_traf_flush(stat, proc_count, out);
     }
 
-    /* Flush process group statistics */
-    const UINT32 defer_flush_bits = fort_stat_dpc_group_flush(stat);
-
     /* Unlock stat */
     fort_stat_dpc_end(&stat_lock_queue);
 
@@ -832,7 +1188,23 @@ FORT_API void NTAPI fort_callout_timer(void)
     if (irp != NULL) {
         fort_request_complete_info(irp, STATUS_SUCCESS, info);
     }
+}
+
+FORT_API void NTAPI fort_callout_shaper_timer(void)
+{
+    PFORT_STAT stat = &fort_device()->stat;
+    PFORT_DEFER defer = &fort_device()->defer;
+
+    /* Groups, which still have the datagrams queued */
+    const UINT32 queued_bits = (UINT32) ReadNoFence((PLONG) &defer->datagram_bits);
+
+    /* Flush deferred packets of the groups, which are out of debt */
+    const UINT32 debt_bits = fort_stat_dpc_shaper_flush(stat, queued_bits);
+
+    /* Flush counterpart ACK-s (i.e. flush outbound ACK-s for inbound and vice versa) */
+    const UINT32 ack_debt_bits =
+            ((debt_bits & 0x55555555) << 1) | ((debt_bits >> 1) & 0x55555555);
 
-    /* Flush deferred packets */
-    fort_callout_defer_packet_flush(defer_flush_bits, TRUE);
+    /* Flush own datagrams too, in the same batch */
+    fort_defer_batch_flush(defer, fort_packet_inject_complete, ~ack_debt_bits, ~debt_bits);
 }
@@ -20,6 +20,8 @@ FORT_API NTSTATUS fort_callout_force_reauth(
 
 FORT_API void NTAPI fort_callout_timer(void);
 
+FORT_API void NTAPI fort_callout_shaper_timer(void);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
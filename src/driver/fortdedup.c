@@ -0,0 +1,280 @@
+/* Fort Firewall Per-CPU Deduplication of Connections Log */
+
+#include "fortdedup.h"
+
+#include "common/fortdef.h"
+
+#include "forttds.h"
+
+#define FORT_LOG_DEDUP_POOL_TAG 'DwfF'
+
+#define FORT_LOG_DEDUP_ALLOWED ((UCHAR) FORT_BLOCK_REASON_NONE)
+
+static UINT32 fort_log_dedup_key_index(const PFORT_LOG_DEDUP_KEY key)
+{
+    const UINT32 port_proto = ((UINT32) key->remote_port << 16) | ((UINT32) key->ip_proto << 8)
+            | key->block_reason;
+
+    const UINT32 hash = key->pid ^ tommy_inthash_u32(key->remote_ip) ^ port_proto;
+
+    return tommy_inthash_u32(hash) & (FORT_LOG_DEDUP_SIZE - 1);
+}
+
+static BOOL fort_log_dedup_key_equal(const PFORT_LOG_DEDUP_KEY k1, const PFORT_LOG_DEDUP_KEY k2)
+{
+    return k1->pid == k2->pid && k1->remote_ip == k2->remote_ip
+            && k1->remote_port == k2->remote_port && k1->ip_proto == k2->ip_proto
+            && k1->block_reason == k2->block_reason;
+}
+
+static BOOL fort_log_dedup_expired(PFORT_LOG_DEDUP dedup, PFORT_LOG_DEDUP_ENTRY entry, INT64 now)
+{
+    const INT64 age = now - entry->log_time;
+
+    /* The system time may be changed backwards */
+    return age < 0 || age >= dedup->window;
+}
+
+static void fort_log_dedup_entry_flush(
+        PFORT_LOG_DEDUP_ENTRY entry, PFORT_BUFFER buf, PIRP *irp, ULONG_PTR *info)
+{
+    if (entry->repeat_count == 0)
+        return;
+
+    /* Don't overwrite the request, taken by a previous write */
+    if (entry->key.block_reason == FORT_LOG_DEDUP_ALLOWED) {
+        fort_buffer_allowed_ip_write(buf, entry->inbound, entry->inherited, entry->key.ip_proto,
+                entry->key.remote_port, entry->key.remote_ip, entry->key.pid,
+                entry->repeat_count, entry->path_len, entry->path, (*irp == NULL ? irp : NULL),
+                info);
+    } else {
+        fort_buffer_blocked_ip_repeat_write(buf, entry->inbound, entry->inherited,
+                entry->key.block_reason, entry->key.ip_proto, entry->local_port,
+                entry->key.remote_port, entry->local_ip, entry->key.remote_ip, entry->key.pid,
+                entry->repeat_count, fort_system_to_unix_time(entry->first_time),
+                fort_system_to_unix_time(entry->last_time), entry->path_len, entry->path,
+                (*irp == NULL ? irp : NULL), info);
+    }
+
+    entry->repeat_count = 0;
+}
+
+static PFORT_LOG_DEDUP_CPU fort_log_dedup_cpu(PFORT_LOG_DEDUP dedup)
+{
+    const UINT32 cpu_index = KeGetCurrentProcessorNumberEx(NULL);
+
+    return (cpu_index < dedup->cpu_count) ? &dedup->cpus[cpu_index] : NULL;
+}
+
+FORT_API void fort_log_dedup_open(PFORT_LOG_DEDUP dedup, UINT32 window_ms)
+{
+    RtlZeroMemory(dedup, sizeof(FORT_LOG_DEDUP));
+
+    /* Disabled */
+    if (window_ms == 0)
+        return;
+
+    const UINT32 cpu_count = KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS);
+    const SIZE_T size = cpu_count * sizeof(FORT_LOG_DEDUP_CPU);
+
+    dedup->cpus = fort_mem_alloc(size, FORT_LOG_DEDUP_POOL_TAG);
+
+    if (dedup->cpus != NULL) {
+        RtlZeroMemory(dedup->cpus, size);
+
+        for (UINT32 i = 0; i < cpu_count; ++i) {
+            KeInitializeSpinLock(&dedup->cpus[i].lock);
+        }
+
+        dedup->window = (INT64) window_ms * 10000;
+        dedup->cpu_count = cpu_count;
+    }
+}
+
+FORT_API void fort_log_dedup_close(PFORT_LOG_DEDUP dedup)
+{
+    if (dedup->cpus != NULL) {
+        fort_mem_free(dedup->cpus, FORT_LOG_DEDUP_POOL_TAG);
+
+        dedup->cpus = NULL;
+        dedup->cpu_count = 0;
+    }
+}
+
+static BOOL fort_log_dedup_entry_fold(PFORT_LOG_DEDUP dedup, PFORT_LOG_DEDUP_ENTRY entry,
+        const PFORT_LOG_DEDUP_KEY key, INT64 now, PFORT_BUFFER buf, PIRP *irp, ULONG_PTR *info)
+{
+    if (entry->log_time != 0 && fort_log_dedup_key_equal(&entry->key, key)) {
+        if (!fort_log_dedup_expired(dedup, entry, now)) {
+            if (entry->repeat_count++ == 0) {
+                entry->first_time = now;
+            }
+            entry->last_time = now;
+
+            return TRUE;
+        }
+
+        /* Report the repeats of the previous window */
+        fort_log_dedup_entry_flush(entry, buf, irp, info);
+    } else {
+        /* Report the repeats of the evicted connection */
+        fort_log_dedup_entry_flush(entry, buf, irp, info);
+
+        entry->key = *key;
+    }
+
+    entry->log_time = now;
+
+    return FALSE;
+}
+
+/* Returns TRUE, when the connection is counted by its entry instead of being logged */
+static BOOL fort_log_dedup_fold(PFORT_LOG_DEDUP dedup, const PFORT_LOG_DEDUP_KEY key, BOOL inbound,
+        BOOL inherited, UINT16 local_port, UINT32 local_ip, UINT32 path_len, const PVOID path,
+        PFORT_BUFFER buf, PIRP *irp, ULONG_PTR *info)
+{
+    PFORT_LOG_DEDUP_CPU cpu = fort_log_dedup_cpu(dedup);
+    if (cpu == NULL)
+        return FALSE;
+
+    LARGE_INTEGER system_time;
+    KeQuerySystemTime(&system_time);
+
+    const INT64 now = system_time.QuadPart;
+
+    PFORT_LOG_DEDUP_ENTRY entry = &cpu->entries[fort_log_dedup_key_index(key)];
+
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLockAtDpcLevel(&cpu->lock, &lock_queue);
+
+    BOOL folded = fort_log_dedup_entry_fold(dedup, entry, key, now, buf, irp, info);
+
+    /* The repeats are reported with the fields of the logged connection */
+    if (!folded) {
+        entry->inbound = (UCHAR) inbound;
+        entry->inherited = (UCHAR) inherited;
+        entry->local_port = local_port;
+        entry->local_ip = local_ip;
+
+        entry->path_len = (path_len <= FORT_LOG_PATH_MAX) ? path_len : 0;
+        RtlCopyMemory(entry->path, path, entry->path_len);
+
+        /* The allowed connections are only reported on flush */
+        if (key->block_reason == FORT_LOG_DEDUP_ALLOWED) {
+            entry->repeat_count = 1;
+            entry->first_time = entry->last_time = now;
+
+            folded = TRUE;
+        }
+    }
+
+    KeReleaseInStackQueuedSpinLockFromDpcLevel(&lock_queue);
+
+    return folded;
+}
+
+FORT_API NTSTATUS fort_log_dedup_blocked_ip_write(PFORT_LOG_DEDUP dedup, PFORT_BUFFER buf,
+        BOOL inbound, BOOL inherited, UCHAR block_reason, UCHAR ip_proto, UINT16 local_port,
+        UINT16 remote_port, UINT32 local_ip, UINT32 remote_ip, UINT32 pid, UINT32 path_len,
+        const PVOID path, PIRP *irp, ULONG_PTR *info)
+{
+    if (dedup->cpus == NULL) {
+        return fort_buffer_blocked_ip_write(buf, inbound, inherited, block_reason, ip_proto,
+                local_port, remote_port, local_ip, remote_ip, pid, path_len, path, irp, info);
+    }
+
+    FORT_LOG_DEDUP_KEY key;
+    key.pid = pid;
+    key.remote_ip = remote_ip;
+    key.remote_port = remote_port;
+    key.ip_proto = ip_proto;
+    key.block_reason = block_reason;
+
+    NTSTATUS status = STATUS_SUCCESS;
+
+    /* Stay on the current CPU to take its own slice */
+    KIRQL oldIrql;
+    KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+
+    if (!fort_log_dedup_fold(dedup, &key, inbound, inherited, local_port, local_ip, path_len,
+                path, buf, irp, info)) {
+        status = fort_buffer_blocked_ip_write(buf, inbound, inherited, block_reason, ip_proto,
+                local_port, remote_port, local_ip, remote_ip, pid, path_len, path,
+                (*irp == NULL ? irp : NULL), info);
+    }
+
+    KeLowerIrql(oldIrql);
+
+    return status;
+}
+
+FORT_API NTSTATUS fort_log_dedup_allowed_ip_write(PFORT_LOG_DEDUP dedup, PFORT_BUFFER buf,
+        BOOL inbound, BOOL inherited, UCHAR ip_proto, UINT16 remote_port, UINT32 remote_ip,
+        UINT32 pid, UINT32 path_len, const PVOID path, PIRP *irp, ULONG_PTR *info)
+{
+    if (dedup->cpus == NULL) {
+        return fort_buffer_allowed_ip_write(buf, inbound, inherited, ip_proto, remote_port,
+                remote_ip, pid, /*conn_count=*/1, path_len, path, irp, info);
+    }
+
+    FORT_LOG_DEDUP_KEY key;
+    key.pid = pid;
+    key.remote_ip = remote_ip;
+    key.remote_port = remote_port;
+    key.ip_proto = ip_proto;
+    key.block_reason = FORT_LOG_DEDUP_ALLOWED;
+
+    NTSTATUS status = STATUS_SUCCESS;
+
+    /* Stay on the current CPU to take its own slice */
+    KIRQL oldIrql;
+    KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+
+    if (!fort_log_dedup_fold(dedup, &key, inbound, inherited, /*local_port=*/0, /*local_ip=*/0,
+                path_len, path, buf, irp, info)) {
+        status = fort_buffer_allowed_ip_write(buf, inbound, inherited, ip_proto, remote_port,
+                remote_ip, pid, /*conn_count=*/1, path_len, path, (*irp == NULL ? irp : NULL),
+                info);
+    }
+
+    KeLowerIrql(oldIrql);
+
+    return status;
+}
+
+FORT_API void fort_log_dedup_flush(
+        PFORT_LOG_DEDUP dedup, PFORT_BUFFER buf, PIRP *irp, ULONG_PTR *info)
+{
+    if (dedup->cpus == NULL)
+        return;
+
+    LARGE_INTEGER system_time;
+    KeQuerySystemTime(&system_time);
+
+    const INT64 now = system_time.QuadPart;
+
+    for (UINT32 i = 0; i < dedup->cpu_count; ++i) {
+        PFORT_LOG_DEDUP_CPU cpu = &dedup->cpus[i];
+
+        KLOCK_QUEUE_HANDLE lock_queue;
+        KeAcquireInStackQueuedSpinLockAtDpcLevel(&cpu->lock, &lock_queue);
+
+        for (int j = 0; j < FORT_LOG_DEDUP_SIZE; ++j) {
+            PFORT_LOG_DEDUP_ENTRY entry = &cpu->entries[j];
+
+            if (entry->log_time == 0 || !fort_log_dedup_expired(dedup, entry, now))
+                continue;
+
+            if (entry->repeat_count != 0) {
+                fort_log_dedup_entry_flush(entry, buf, irp, info);
+
+                /* Keep folding the ongoing repeats */
+                entry->log_time = now;
+            } else {
+                entry->log_time = 0;
+            }
+        }
+
+        KeReleaseInStackQueuedSpinLockFromDpcLevel(&lock_queue);
+    }
+}
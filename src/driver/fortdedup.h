@@ -0,0 +1,82 @@
+#ifndef FORTDEDUP_H
+#define FORTDEDUP_H
+
+#include "fortdrv.h"
+
+#include "fortbuf.h"
+
+#define FORT_LOG_DEDUP_SIZE 16 /* Must be power of 2 */
+
+#define FORT_LOG_DEDUP_WINDOW_DEFAULT 1000 /* milliseconds */
+
+typedef struct fort_log_dedup_key
+{
+    UINT32 pid;
+    UINT32 remote_ip;
+    UINT16 remote_port;
+    UCHAR ip_proto;
+    UCHAR block_reason; /* FORT_LOG_DEDUP_ALLOWED for the allowed connections */
+} FORT_LOG_DEDUP_KEY, *PFORT_LOG_DEDUP_KEY;
+
+typedef struct fort_log_dedup_entry
+{
+    FORT_LOG_DEDUP_KEY key;
+
+    UCHAR inbound : 1;
+    UCHAR inherited : 1;
+    UINT16 local_port;
+    UINT32 local_ip;
+
+    UINT32 repeat_count; /* folded since the last record; all connections, when allowed */
+
+    INT64 log_time; /* of the last record, 0 when the slot is free */
+    INT64 first_time; /* of the folded repeats */
+    INT64 last_time;
+
+    UINT32 path_len;
+    CHAR path[FORT_LOG_PATH_MAX];
+} FORT_LOG_DEDUP_ENTRY, *PFORT_LOG_DEDUP_ENTRY;
+
+typedef struct fort_log_dedup_cpu
+{
+    KSPIN_LOCK lock; /* taken by the timer's flush too */
+
+    UCHAR reserved[56]; /* keep the per-CPU locks on their own cache line */
+
+    FORT_LOG_DEDUP_ENTRY entries[FORT_LOG_DEDUP_SIZE];
+} FORT_LOG_DEDUP_CPU, *PFORT_LOG_DEDUP_CPU;
+
+typedef struct fort_log_dedup
+{
+    INT64 window; /* in 100-nanosecond units */
+
+    UINT32 cpu_count;
+
+    PFORT_LOG_DEDUP_CPU cpus;
+} FORT_LOG_DEDUP, *PFORT_LOG_DEDUP;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+FORT_API void fort_log_dedup_open(PFORT_LOG_DEDUP dedup, UINT32 window_ms);
+
+FORT_API void fort_log_dedup_close(PFORT_LOG_DEDUP dedup);
+
+FORT_API NTSTATUS fort_log_dedup_blocked_ip_write(PFORT_LOG_DEDUP dedup, PFORT_BUFFER buf,
+        BOOL inbound, BOOL inherited, UCHAR block_reason, UCHAR ip_proto, UINT16 local_port,
+        UINT16 remote_port, UINT32 local_ip, UINT32 remote_ip, UINT32 pid, UINT32 path_len,
+        const PVOID path, PIRP *irp, ULONG_PTR *info);
+
+FORT_API NTSTATUS fort_log_dedup_allowed_ip_write(PFORT_LOG_DEDUP dedup, PFORT_BUFFER buf,
+        BOOL inbound, BOOL inherited, UCHAR ip_proto, UINT16 remote_port, UINT32 remote_ip,
+        UINT32 pid, UINT32 path_len, const PVOID path, PIRP *irp, ULONG_PTR *info);
+
+FORT_API void fort_log_dedup_flush(
+        PFORT_LOG_DEDUP dedup, PFORT_BUFFER buf, PIRP *irp, ULONG_PTR *info);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // FORTDEDUP_H
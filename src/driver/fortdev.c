@@ -9,6 +9,7 @@
 
 #include "fortcout.h"
 #include "fortscb.h"
+#include "fortutl.h"
 
 static PFORT_DEVICE g_device = NULL;
 
@@ -22,6 +23,13 @@ static void fort_device_set(PFORT_DEVICE device)
     g_device = device;
 }
 
+#if !defined(FORT_DRIVER)
+FORT_API void fort_device_um_set(PFORT_DEVICE device)
+{
+    fort_device_set(device);
+}
+#endif
+
 static void NTAPI fort_worker_reauth(void)
 {
     const FORT_CONF_FLAGS conf_flags = g_device->conf.conf_flags;
@@ -41,6 +49,13 @@ FORT_API void NTAPI fort_app_period_timer(void)
     }
 }
 
+/* Retry freeing the retired conf refs and the deleted apps, which were still used by
+ * the classifies */
+FORT_API void NTAPI fort_conf_reclaim_timer(void)
+{
+    fort_conf_ref_reclaim(&g_device->conf);
+}
+
 FORT_API NTSTATUS fort_device_create(PDEVICE_OBJECT device, PIRP irp)
 {
     NTSTATUS status = STATUS_SUCCESS;
@@ -89,6 +104,9 @@ FORT_API NTSTATUS fort_device_cleanup(PDEVICE_OBJECT device, PIRP irp)
         fort_callout_force_reauth(old_conf_flags, FORT_DEFER_FLUSH_ALL);
     }
 
+    /* Unmap log rings from the closing process */
+    fort_buffer_rings_unmap(&g_device->buffer);
+
     /* Clear buffer */
     fort_buffer_clear(&g_device->buffer);
 
@@ -123,6 +141,27 @@ static NTSTATUS fort_device_control_validate(const PFORT_CONF_VERSION conf_ver,
     return STATUS_UNSUCCESSFUL;
 }
 
+static NTSTATUS fort_device_control_conf_update(
+        const PFORT_CONF_IO conf_io, FORT_CONF_FLAGS old_conf_flags, BOOL conf_changed)
+{
+    PFORT_STAT stat = &g_device->stat;
+    const PFORT_CONF_GROUP conf_group = &conf_io->conf_group;
+
+    if (conf_changed) {
+        fort_pstree_conf_update(&g_device->ps_tree, &g_device->conf);
+    }
+
+    const UINT32 defer_flush_bits = (stat->conf_group.limit_2bits ^ conf_group->limit_2bits);
+
+    const BOOL reauth = conf_changed || defer_flush_bits != 0
+            || stat->conf_group.fragment_bits != conf_group->fragment_bits;
+
+    fort_stat_conf_update(stat, conf_io);
+
+    /* Keep the flows, when only the speed limits' values or logging of app groups changed */
+    return reauth ? fort_callout_force_reauth(old_conf_flags, defer_flush_bits) : STATUS_SUCCESS;
+}
+
 static NTSTATUS fort_device_control_setconf(const PFORT_CONF_IO conf_io, ULONG len)
 {
     if (len > sizeof(FORT_CONF_IO)) {
@@ -132,16 +171,31 @@ static NTSTATUS fort_device_control_setconf(const PFORT_CONF_IO conf_io, ULONG l
         if (conf_ref == NULL) {
             return STATUS_INSUFFICIENT_RESOURCES;
         } else {
-            PFORT_STAT stat = &g_device->stat;
-
             const FORT_CONF_FLAGS old_conf_flags = fort_conf_ref_set(&g_device->conf, conf_ref);
 
-            const UINT32 defer_flush_bits =
-                    (stat->conf_group.limit_2bits ^ conf_io->conf_group.limit_2bits);
+            return fort_device_control_conf_update(conf_io, old_conf_flags, /*conf_changed=*/TRUE);
+        }
+    }
+
+    return STATUS_UNSUCCESSFUL;
+}
+
+static NTSTATUS fort_device_control_patchconf(const PFORT_CONF_IO conf_io, ULONG len)
+{
+    const PFORT_CONF conf = &conf_io->conf;
+
+    if (len > sizeof(FORT_CONF_IO)
+            && len - FORT_CONF_IO_CONF_OFF >= FORT_CONF_DATA_OFF + conf->exe_apps_off) {
+        FORT_CONF_FLAGS old_conf_flags;
+        BOOL conf_changed;
 
-            fort_stat_conf_update(stat, conf_io);
+        const NTSTATUS status =
+                fort_conf_ref_patch_set(&g_device->conf, conf, &old_conf_flags, &conf_changed);
 
-            return fort_callout_force_reauth(old_conf_flags, defer_flush_bits);
+        if (!NT_SUCCESS(status)) {
+            return status;
+        } else {
+            return fort_device_control_conf_update(conf_io, old_conf_flags, conf_changed);
         }
     }
 
@@ -162,12 +216,14 @@ static NTSTATUS fort_device_control_setflags(const PFORT_CONF_FLAGS conf_flags,
     return STATUS_UNSUCCESSFUL;
 }
 
-static NTSTATUS fort_device_control_getlog(PVOID out, ULONG out_len, PIRP irp, ULONG_PTR *info)
+static NTSTATUS fort_device_control_getlog(
+        PVOID out, ULONG in_len, ULONG out_len, PIRP irp, ULONG_PTR *info)
 {
     if (out_len < FORT_BUFFER_SIZE) {
         return STATUS_BUFFER_TOO_SMALL;
     } else {
-        const NTSTATUS status = fort_buffer_xmove(&g_device->buffer, irp, out, out_len, info);
+        const NTSTATUS status =
+                fort_buffer_xmove(&g_device->buffer, irp, out, in_len, out_len, info);
 
         if (status == STATUS_PENDING) {
             KIRQL cirq;
@@ -189,28 +245,31 @@ static NTSTATUS fort_device_control_getlog(PVOID out, ULONG out_len, PIRP irp, U
 static NTSTATUS fort_device_control_app(const PFORT_APP_ENTRY app_entry, ULONG len, BOOL is_adding)
 {
     if (len > sizeof(FORT_APP_ENTRY) && len >= (sizeof(FORT_APP_ENTRY) + app_entry->path_len)) {
-        PFORT_CONF_REF conf_ref = fort_conf_ref_take(&g_device->conf);
+        NTSTATUS status;
 
-        if (conf_ref == NULL) {
-            return STATUS_INSUFFICIENT_RESOURCES;
-        } else {
-            NTSTATUS status;
+        /* Retry with the current conf ref, when the taken one is replaced by a patch */
+        do {
+            PFORT_CONF_REF conf_ref = fort_conf_ref_take(&g_device->conf);
+
+            if (conf_ref == NULL)
+                return STATUS_INSUFFICIENT_RESOURCES;
 
             if (is_adding) {
                 status = fort_conf_ref_exe_add_entry(conf_ref, app_entry, FALSE);
             } else {
-                fort_conf_ref_exe_del_entry(conf_ref, app_entry);
-                status = STATUS_SUCCESS;
+                status = fort_conf_ref_exe_del_entry(conf_ref, app_entry);
             }
 
             fort_conf_ref_put(&g_device->conf, conf_ref);
+        } while (status == STATUS_RETRY);
 
-            if (NT_SUCCESS(status)) {
-                fort_worker_reauth();
-            }
+        if (NT_SUCCESS(status)) {
+            fort_conf_reauth_log_app(&g_device->conf, app_entry);
 
-            return status;
+            fort_worker_reauth();
         }
+
+        return status;
     }
 
     return STATUS_UNSUCCESSFUL;
@@ -218,7 +277,8 @@ static NTSTATUS fort_device_control_app(const PFORT_APP_ENTRY app_entry, ULONG l
 
 static NTSTATUS fort_device_control_setzones(const PFORT_CONF_ZONES zones, ULONG len)
 {
-    if (len >= FORT_CONF_ZONES_DATA_OFF) {
+    if (len >= FORT_CONF_ZONES_DATA_OFF && zones->interval_n <= len / sizeof(UINT32)
+            && len >= fort_conf_zones_size(zones->interval_n)) {
         PFORT_CONF_ZONES conf_zones = fort_conf_zones_new(zones, len);
 
         if (conf_zones == NULL) {
@@ -248,6 +308,63 @@ static NTSTATUS fort_device_control_setzoneflag(const PFORT_CONF_ZONE_FLAG zone_
     return STATUS_UNSUCCESSFUL;
 }
 
+static NTSTATUS fort_device_control_gettrace(
+        const PVOID in, ULONG in_len, PVOID out, ULONG out_len, ULONG_PTR *info)
+{
+    if (out_len < sizeof(FORT_TRACE_HEADER))
+        return STATUS_BUFFER_TOO_SMALL;
+
+    /* The input shares the system buffer with the output */
+    const UINT32 flags = (in_len == sizeof(UINT32)) ? *((const UINT32 *) in) : 0;
+
+    *info = fort_trace_drain(&g_device->trace, out, out_len, flags);
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fort_device_control_getstats(PVOID out, ULONG out_len, ULONG_PTR *info)
+{
+    if (out_len < sizeof(FORT_STATS))
+        return STATUS_BUFFER_TOO_SMALL;
+
+    PFORT_STATS stats = out;
+
+    fort_callout_counters_stat(&g_device->callout_counters, &stats->callout);
+
+    RtlZeroMemory(&stats->driver, sizeof(FORT_DRIVER_STATS));
+
+    fort_stat_driver_stats(&g_device->stat, &stats->driver);
+
+    fort_verdict_cache_stat(&g_device->verdict_cache, &stats->driver);
+
+    fort_defer_driver_stats(&g_device->defer, &stats->driver);
+
+    *info = sizeof(FORT_STATS);
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fort_device_control_maplog(PVOID out, ULONG out_len, ULONG_PTR *info)
+{
+    if (out_len < sizeof(UINT64))
+        return STATUS_BUFFER_TOO_SMALL;
+
+    PFORT_BUFFER buf = &g_device->buffer;
+    UINT32 *tails = (UINT32 *) ((PCHAR) out + sizeof(UINT64));
+
+    PVOID user_addr;
+    const NTSTATUS status =
+            fort_buffer_rings_map(buf, &user_addr, tails, out_len - sizeof(UINT64));
+
+    if (NT_SUCCESS(status)) {
+        *((UINT64 *) out) = (UINT64) (ULONG_PTR) user_addr;
+
+        *info = FORT_LOG_RINGS_MAP_SIZE(buf->ring_count);
+    }
+
+    return status;
+}
+
 static NTSTATUS fort_device_control_process(
         const PIO_STACK_LOCATION irp_stack, PIRP irp, ULONG_PTR *info)
 {
@@ -266,10 +383,12 @@ static NTSTATUS fort_device_control_process(
         return fort_device_control_validate(buffer, in_len);
     case FORT_IOCTL_SETCONF:
         return fort_device_control_setconf(buffer, in_len);
+    case FORT_IOCTL_PATCHCONF:
+        return fort_device_control_patchconf(buffer, in_len);
     case FORT_IOCTL_SETFLAGS:
         return fort_device_control_setflags(buffer, in_len);
     case FORT_IOCTL_GETLOG:
-        return fort_device_control_getlog(buffer, out_len, irp, info);
+        return fort_device_control_getlog(buffer, in_len, out_len, irp, info);
     case FORT_IOCTL_ADDAPP:
     case FORT_IOCTL_DELAPP:
         return fort_device_control_app(buffer, in_len, (control_code == FORT_IOCTL_ADDAPP));
@@ -277,6 +396,12 @@ static NTSTATUS fort_device_control_process(
         return fort_device_control_setzones(buffer, in_len);
     case FORT_IOCTL_SETZONEFLAG:
         return fort_device_control_setzoneflag(buffer, in_len);
+    case FORT_IOCTL_MAPLOG:
+        return fort_device_control_maplog(buffer, out_len, info);
+    case FORT_IOCTL_GETTRACE:
+        return fort_device_control_gettrace(buffer, in_len, buffer, out_len, info);
+    case FORT_IOCTL_GETSTATS:
+        return fort_device_control_getstats(buffer, out_len, info);
     default:
         return STATUS_UNSUCCESSFUL;
     }
@@ -302,7 +427,7 @@ FORT_API NTSTATUS fort_device_control(PDEVICE_OBJECT device, PIRP irp)
     return status;
 }
 
-FORT_API NTSTATUS fort_device_load(PDEVICE_OBJECT device)
+FORT_API NTSTATUS fort_device_load(PDEVICE_OBJECT device, PUNICODE_STRING reg_path)
 {
     NTSTATUS status = STATUS_UNSUCCESSFUL;
 
@@ -310,13 +435,26 @@ FORT_API NTSTATUS fort_device_load(PDEVICE_OBJECT device)
 
     RtlZeroMemory(fort_device(), sizeof(FORT_DEVICE));
 
-    fort_device_conf_open(&fort_device()->conf);
+    status = fort_device_conf_open(&fort_device()->conf);
     fort_buffer_open(&fort_device()->buffer);
-    fort_stat_open(&fort_device()->stat);
-    fort_defer_open(&fort_device()->defer);
+    fort_log_dedup_open(&fort_device()->log_dedup,
+            fort_reg_dword(reg_path, L"LogDedupWindow", FORT_LOG_DEDUP_WINDOW_DEFAULT));
+    fort_stat_open(&fort_device()->stat,
+            fort_reg_dword(reg_path, L"FlowCapacity", FORT_FLOW_CAPACITY_DEFAULT),
+            fort_reg_dword(reg_path, L"ShaperBurst", FORT_STAT_SHAPER_BURST_DEFAULT));
+    fort_defer_open(&fort_device()->defer,
+            fort_reg_dword(reg_path, L"DeferBatch", FORT_DEFER_BATCH_DEFAULT));
     fort_timer_open(&fort_device()->log_timer, 500, FALSE, &fort_callout_timer);
     fort_timer_open(&fort_device()->app_timer, 60000, TRUE, &fort_app_period_timer);
+    fort_timer_open(&fort_device()->shaper_timer, FORT_STAT_SHAPER_PERIOD, FALSE,
+            &fort_callout_shaper_timer);
+    fort_timer_open(&fort_device()->reclaim_timer, 1000, TRUE, &fort_conf_reclaim_timer);
     fort_pstree_open(&fort_device()->ps_tree);
+    fort_verdict_cache_open(&fort_device()->verdict_cache);
+    fort_trace_open(&fort_device()->trace,
+            fort_reg_dword(reg_path, L"TraceRecords", FORT_TRACE_RECORDS_DEFAULT));
+    fort_callout_counters_open(&fort_device()->callout_counters,
+            fort_reg_dword(reg_path, L"CalloutCounters", FORT_CALLOUT_COUNTERS_DEFAULT) != 0);
 
     /* Unregister old filters provider */
     {
@@ -326,7 +464,9 @@ FORT_API NTSTATUS fort_device_load(PDEVICE_OBJECT device)
     }
 
     /* Install callouts */
-    status = fort_callout_install(device);
+    if (NT_SUCCESS(status)) {
+        status = fort_callout_install(device);
+    }
 
     /* Register worker */
     if (NT_SUCCESS(status)) {
@@ -350,6 +490,11 @@ FORT_API NTSTATUS fort_device_load(PDEVICE_OBJECT device)
         status = fort_syscb_time_register();
     }
 
+    /* Run the conf refs' reclaim */
+    if (NT_SUCCESS(status)) {
+        fort_timer_update(&fort_device()->reclaim_timer, TRUE);
+    }
+
     /* Enumerate processes in background */
     if (NT_SUCCESS(status)) {
         fort_worker_queue(&fort_device()->worker, FORT_WORKER_PSTREE, &fort_pstree_enum_processes);
@@ -366,11 +511,17 @@ FORT_API void fort_device_unload()
     fort_callout_defer_flush();
 
     fort_pstree_close(&fort_device()->ps_tree);
+    fort_timer_close(&fort_device()->reclaim_timer);
+    fort_timer_close(&fort_device()->shaper_timer);
     fort_timer_close(&fort_device()->app_timer);
     fort_timer_close(&fort_device()->log_timer);
     fort_defer_close(&fort_device()->defer);
     fort_stat_close(&fort_device()->stat);
     fort_buffer_close(&fort_device()->buffer);
+    fort_log_dedup_close(&fort_device()->log_dedup);
+    fort_verdict_cache_close(&fort_device()->verdict_cache);
+    fort_trace_close(&fort_device()->trace);
+    fort_callout_counters_close(&fort_device()->callout_counters);
 
     fort_worker_unregister(&fort_device()->worker);
 
@@ -383,5 +534,7 @@ FORT_API void fort_device_unload()
 
     fort_callout_remove();
 
+    fort_device_conf_close(&fort_device()->conf);
+
     fort_device_set(NULL);
 }
@@ -5,10 +5,14 @@
 
 #include "fortbuf.h"
 #include "fortcnf.h"
+#include "fortcnt.h"
+#include "fortdedup.h"
 #include "fortpkt.h"
 #include "fortps.h"
 #include "fortstat.h"
 #include "forttmr.h"
+#include "forttrc.h"
+#include "fortvch.h"
 #include "fortwrk.h"
 
 typedef struct fort_device
@@ -24,12 +28,18 @@ typedef struct fort_device
 
     FORT_DEVICE_CONF conf;
     FORT_BUFFER buffer;
+    FORT_LOG_DEDUP log_dedup;
     FORT_STAT stat;
     FORT_DEFER defer;
     FORT_PSTREE ps_tree;
     FORT_TIMER log_timer;
     FORT_TIMER app_timer;
+    FORT_TIMER shaper_timer;
+    FORT_TIMER reclaim_timer;
     FORT_WORKER worker;
+    FORT_VERDICT_CACHE verdict_cache;
+    FORT_TRACE trace;
+    FORT_CALLOUT_COUNTERS callout_counters;
 } FORT_DEVICE, *PFORT_DEVICE;
 
 #if defined(__cplusplus)
@@ -40,6 +50,8 @@ FORT_API PFORT_DEVICE fort_device();
 
 FORT_API void NTAPI fort_app_period_timer(void);
 
+FORT_API void NTAPI fort_conf_reclaim_timer(void);
+
 FORT_API NTSTATUS fort_device_create(PDEVICE_OBJECT device, PIRP irp);
 
 FORT_API NTSTATUS fort_device_close(PDEVICE_OBJECT device, PIRP irp);
@@ -48,10 +60,15 @@ FORT_API NTSTATUS fort_device_cleanup(PDEVICE_OBJECT device, PIRP irp);
 
 FORT_API NTSTATUS fort_device_control(PDEVICE_OBJECT device, PIRP irp);
 
-FORT_API NTSTATUS fort_device_load(PDEVICE_OBJECT device);
+FORT_API NTSTATUS fort_device_load(PDEVICE_OBJECT device, PUNICODE_STRING reg_path);
 
 FORT_API void fort_device_unload();
 
+#if !defined(FORT_DRIVER)
+/* User Mode: the device without registered provider and callbacks for benchmarks */
+FORT_API void fort_device_um_set(PFORT_DEVICE device);
+#endif
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -59,7 +59,7 @@ static NTSTATUS fort_driver_load(PDRIVER_OBJECT driver, PUNICODE_STRING reg_path
     driver->MajorFunction[IRP_MJ_CLEANUP] = fort_device_cleanup;
     driver->MajorFunction[IRP_MJ_DEVICE_CONTROL] = fort_device_control;
 
-    return fort_device_load(device_obj);
+    return fort_device_load(device_obj, reg_path);
 }
 
 NTSTATUS DriverCallbacksSetup(PFORT_PROXYCB_INFO cb_info)
@@ -14,7 +14,10 @@
 #include "forttds.c"
 #include "fortcb.c"
 #include "fortcnf.c"
+#include "fortcnt.c"
+#include "fortflow.c"
 #include "fortbuf.c"
+#include "fortdedup.c"
 #include "fortmod.c"
 #include "fortpkt.c"
 #include "fortpool.c"
@@ -22,7 +25,9 @@
 #include "fortstat.c"
 #include "fortscb.c"
 #include "forttmr.c"
+#include "forttrc.c"
 #include "fortutl.c"
+#include "fortvch.c"
 #include "fortwrk.c"
 #include "fortcout.c"
 #include "fortdev.c"
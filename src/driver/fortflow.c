@@ -0,0 +1,325 @@
+/* Fort Firewall Flow Table */
+
+#include "fortflow.h"
+
+#include "forttds.h"
+
+#define FORT_FLOW_POOL_TAG 'FwfF'
+
+#define FORT_FLOW_DELETED ((PFORT_FLOW) (ULONG_PTR) -1)
+
+#define FORT_FLOW_INDEX_MIN    64 /* Must be power of 2 */
+#define FORT_FLOW_INDEX_MAX    (4 * FORT_FLOW_CAPACITY_MAX) /* Must be power of 2 */
+#define FORT_FLOW_MIGRATE_STEP 64 /* slots moved to the new index per add/remove */
+
+#define FORT_FLOW_CHUNK_MIN 256
+#define FORT_FLOW_CHUNK_MAX 16384
+
+#define FORT_FLOW_INDEX_SIZE(n) (offsetof(FORT_FLOW_INDEX, slots) + (n) * sizeof(PFORT_FLOW))
+#define FORT_FLOW_CHUNK_SIZE(n) (offsetof(FORT_FLOW_CHUNK, flows) + (n) * sizeof(FORT_FLOW))
+
+#define fort_flow_index_hash(flow_id) ((UINT32) tommy_inthash_u64((UINT64) (flow_id)))
+
+/* Keep the load factor below 1/2 after (re)building, the size is bounded by the max */
+static UINT32 fort_flow_index_size(UINT32 count, UINT32 min_size)
+{
+    UINT32 size = min_size;
+
+    while (size < count * 2 && size < FORT_FLOW_INDEX_MAX) {
+        size <<= 1;
+    }
+
+    return size;
+}
+
+static PFORT_FLOW_INDEX fort_flow_index_new(UINT32 size)
+{
+    const SIZE_T index_size = FORT_FLOW_INDEX_SIZE(size);
+
+    PFORT_FLOW_INDEX index = fort_mem_alloc(index_size, FORT_FLOW_POOL_TAG);
+    if (index != NULL) {
+        RtlZeroMemory(index, index_size);
+
+        index->mask = size - 1;
+    }
+
+    return index;
+}
+
+static void fort_flow_index_del(PFORT_FLOW_INDEX index)
+{
+    if (index != NULL) {
+        fort_mem_free(index, FORT_FLOW_POOL_TAG);
+    }
+}
+
+static PFORT_FLOW *fort_flow_index_find(PFORT_FLOW_INDEX index, UINT64 flow_id)
+{
+    if (index == NULL)
+        return NULL;
+
+    const UINT32 mask = index->mask;
+    UINT32 i = fort_flow_index_hash(flow_id) & mask;
+
+    for (;;) {
+        PFORT_FLOW *slot = &index->slots[i];
+        PFORT_FLOW flow = *slot;
+
+        if (flow == NULL)
+            return NULL;
+
+        if (flow != FORT_FLOW_DELETED && flow->flow_id == flow_id)
+            return slot;
+
+        i = (i + 1) & mask;
+    }
+}
+
+static void fort_flow_index_insert(PFORT_FLOW_INDEX index, PFORT_FLOW flow)
+{
+    const UINT32 mask = index->mask;
+    UINT32 i = fort_flow_index_hash(flow->flow_id) & mask;
+
+    for (;;) {
+        PFORT_FLOW *slot = &index->slots[i];
+        PFORT_FLOW old_flow = *slot;
+
+        if (old_flow == NULL) {
+            ++index->used_n;
+        }
+
+        if (old_flow == NULL || old_flow == FORT_FLOW_DELETED) {
+            *slot = flow;
+            return;
+        }
+
+        i = (i + 1) & mask;
+    }
+}
+
+static void fort_flow_table_migrate(PFORT_FLOW_TABLE table, UINT32 step)
+{
+    PFORT_FLOW_INDEX old_index = table->old_index;
+    if (old_index == NULL)
+        return;
+
+    const UINT32 old_size = old_index->mask + 1;
+    UINT32 pos = table->migrate_pos;
+
+    for (; step != 0 && pos < old_size; --step, ++pos) {
+        PFORT_FLOW flow = old_index->slots[pos];
+
+        if (flow != NULL && flow != FORT_FLOW_DELETED) {
+            /* Leave a tombstone to keep the old index's probe chains intact */
+            old_index->slots[pos] = FORT_FLOW_DELETED;
+
+            fort_flow_index_insert(table->index, flow);
+        }
+    }
+
+    if (pos < old_size) {
+        table->migrate_pos = pos;
+        return;
+    }
+
+    fort_flow_index_del(old_index);
+
+    table->old_index = NULL;
+    table->migrate_pos = 0;
+}
+
+static BOOL fort_flow_table_reserve(PFORT_FLOW_TABLE table)
+{
+    PFORT_FLOW_INDEX index = table->index;
+
+    /* Keep the load factor (deleted slots included) below 3/4 */
+    if (index != NULL && (index->used_n + 1) * 4 <= (index->mask + 1) * 3)
+        return TRUE;
+
+    /* The max index is full of active flows, so rebuilding it doesn't help */
+    if ((table->flow_count + 1) * 4 > FORT_FLOW_INDEX_MAX * 3)
+        return FALSE;
+
+    /* Finish the previous resize */
+    fort_flow_table_migrate(table, (UINT32) -1);
+
+    const UINT32 size = fort_flow_index_size(table->flow_count + 1, table->index_min);
+
+    PFORT_FLOW_INDEX new_index = fort_flow_index_new(size);
+    if (new_index == NULL) {
+        /* Keep at least one empty slot to terminate the probes */
+        return index != NULL && index->used_n + 1 < index->mask;
+    }
+
+    table->index = new_index;
+    table->old_index = index;
+    table->migrate_pos = 0;
+
+    return TRUE;
+}
+
+static BOOL fort_flow_table_chunk_add(PFORT_FLOW_TABLE table, UINT32 count)
+{
+    PFORT_FLOW_CHUNK chunk = fort_mem_alloc(FORT_FLOW_CHUNK_SIZE(count), FORT_FLOW_POOL_TAG);
+    if (chunk == NULL)
+        return FALSE;
+
+    chunk->next = table->chunks;
+    table->chunks = chunk;
+
+    table->node_count += count;
+
+    /* Add to free chain */
+    PFORT_FLOW flow = &chunk->flows[count];
+
+    do {
+        --flow;
+
+        flow->next_free = table->flow_free;
+        table->flow_free = flow;
+    } while (flow != chunk->flows);
+
+    return TRUE;
+}
+
+static PFORT_FLOW fort_flow_table_node_new(PFORT_FLOW_TABLE table)
+{
+    if (table->flow_free == NULL) {
+        UINT32 count = table->node_count / 2;
+
+        if (count < FORT_FLOW_CHUNK_MIN) {
+            count = FORT_FLOW_CHUNK_MIN;
+        } else if (count > FORT_FLOW_CHUNK_MAX) {
+            count = FORT_FLOW_CHUNK_MAX;
+        }
+
+        if (!fort_flow_table_chunk_add(table, count))
+            return NULL;
+    }
+
+    PFORT_FLOW flow = table->flow_free;
+    table->flow_free = flow->next_free;
+
+    return flow;
+}
+
+static void fort_flow_table_full(PFORT_FLOW_TABLE table)
+{
+    if (table->full_count++ == 0) {
+        LOG("Flow Table: Full: flows=%d nodes=%d\n", table->flow_count, table->node_count);
+    }
+}
+
+FORT_API void fort_flow_table_open(PFORT_FLOW_TABLE table, UINT32 capacity)
+{
+    RtlZeroMemory(table, sizeof(FORT_FLOW_TABLE));
+
+    if (capacity == 0 || capacity > FORT_FLOW_CAPACITY_MAX) {
+        capacity = FORT_FLOW_CAPACITY_DEFAULT;
+    }
+
+    table->index_min = fort_flow_index_size(capacity, FORT_FLOW_INDEX_MIN);
+
+    /* Preallocate, the table grows lazily on failure */
+    table->index = fort_flow_index_new(table->index_min);
+
+    fort_flow_table_chunk_add(table, capacity);
+}
+
+FORT_API void fort_flow_table_close(PFORT_FLOW_TABLE table)
+{
+    fort_flow_index_del(table->index);
+    fort_flow_index_del(table->old_index);
+
+    PFORT_FLOW_CHUNK chunk = table->chunks;
+
+    while (chunk != NULL) {
+        PFORT_FLOW_CHUNK next = chunk->next;
+
+        fort_mem_free(chunk, FORT_FLOW_POOL_TAG);
+
+        chunk = next;
+    }
+
+    RtlZeroMemory(table, sizeof(FORT_FLOW_TABLE));
+}
+
+FORT_API PFORT_FLOW fort_flow_table_get(PFORT_FLOW_TABLE table, UINT64 flow_id)
+{
+    PFORT_FLOW *slot = fort_flow_index_find(table->index, flow_id);
+
+    if (slot == NULL) {
+        slot = fort_flow_index_find(table->old_index, flow_id);
+    }
+
+    return (slot != NULL) ? *slot : NULL;
+}
+
+FORT_API PFORT_FLOW fort_flow_table_add(PFORT_FLOW_TABLE table, UINT64 flow_id)
+{
+    if (!fort_flow_table_reserve(table)) {
+        fort_flow_table_full(table);
+        return NULL;
+    }
+
+    PFORT_FLOW flow = fort_flow_table_node_new(table);
+    if (flow == NULL) {
+        fort_flow_table_full(table);
+        return NULL;
+    }
+
+    flow->flow_id = flow_id;
+
+    fort_flow_index_insert(table->index, flow);
+
+    ++table->flow_count;
+
+    fort_flow_table_migrate(table, FORT_FLOW_MIGRATE_STEP);
+
+    return flow;
+}
+
+FORT_API void fort_flow_table_remove(PFORT_FLOW_TABLE table, PFORT_FLOW flow)
+{
+    PFORT_FLOW *slot = fort_flow_index_find(table->index, flow->flow_id);
+
+    if (slot == NULL) {
+        slot = fort_flow_index_find(table->old_index, flow->flow_id);
+    }
+
+    NT_ASSERT(slot != NULL && *slot == flow);
+
+    *slot = FORT_FLOW_DELETED;
+
+    --table->flow_count;
+
+    /* Add to free chain */
+    flow->next_free = table->flow_free;
+    table->flow_free = flow;
+
+    fort_flow_table_migrate(table, FORT_FLOW_MIGRATE_STEP);
+}
+
+static void fort_flow_index_foreach(
+        PFORT_FLOW_INDEX index, FORT_FLOW_TABLE_FOREACH_FUNC func, PVOID arg)
+{
+    if (index == NULL)
+        return;
+
+    const UINT32 size = index->mask + 1;
+
+    for (UINT32 i = 0; i < size; ++i) {
+        PFORT_FLOW flow = index->slots[i];
+
+        if (flow != NULL && flow != FORT_FLOW_DELETED) {
+            func(arg, flow);
+        }
+    }
+}
+
+FORT_API void fort_flow_table_foreach(
+        PFORT_FLOW_TABLE table, FORT_FLOW_TABLE_FOREACH_FUNC func, PVOID arg)
+{
+    fort_flow_index_foreach(table->index, func, arg);
+    fort_flow_index_foreach(table->old_index, func, arg);
+}
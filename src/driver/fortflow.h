@@ -0,0 +1,96 @@
+#ifndef FORTFLOW_H
+#define FORTFLOW_H
+
+#include "fortdrv.h"
+
+#define FORT_FLOW_SPEED_LIMIT_IN  0x01
+#define FORT_FLOW_SPEED_LIMIT_OUT 0x02
+#define FORT_FLOW_SPEED_LIMIT     (FORT_FLOW_SPEED_LIMIT_IN | FORT_FLOW_SPEED_LIMIT_OUT)
+#define FORT_FLOW_DEFER_IN        0x04
+#define FORT_FLOW_DEFER_OUT       0x08
+#define FORT_FLOW_FRAGMENT        0x10
+#define FORT_FLOW_FRAGMENT_DEFER  0x20
+#define FORT_FLOW_FRAGMENTED      0x40
+#define FORT_FLOW_CONTINUE        0x80 /* the callout continued the search of filters */
+#define FORT_FLOW_XFLAGS          (FORT_FLOW_FRAGMENT_DEFER | FORT_FLOW_FRAGMENTED)
+#define FORT_FLOW_TRANSPORT       (FORT_FLOW_SPEED_LIMIT | FORT_FLOW_FRAGMENT)
+
+#define FORT_FLOW_CAPACITY_DEFAULT 4096
+#define FORT_FLOW_CAPACITY_MAX     0x100000 /* 1M flows, the default is used when greater */
+
+typedef struct fort_flow_opt
+{
+    UCHAR volatile flags;
+    UCHAR group_index;
+    UINT16 proc_index;
+} FORT_FLOW_OPT, *PFORT_FLOW_OPT;
+
+/* The flow's address is its WFP flow-context, so it never moves */
+typedef struct fort_flow
+{
+    UINT64 flow_id;
+
+    FORT_FLOW_OPT opt;
+
+    UINT32 conf_gen; /* of the last authorization */
+
+    struct fort_flow *next_free;
+} FORT_FLOW, *PFORT_FLOW;
+
+typedef struct fort_flow_chunk
+{
+    struct fort_flow_chunk *next;
+
+    FORT_FLOW flows[1];
+} FORT_FLOW_CHUNK, *PFORT_FLOW_CHUNK;
+
+typedef struct fort_flow_index
+{
+    UINT32 mask;
+    UINT32 used_n; /* non-empty slots, including the deleted ones */
+
+    PFORT_FLOW slots[1];
+} FORT_FLOW_INDEX, *PFORT_FLOW_INDEX;
+
+/* Open addressing table of flows, must be guarded by the caller */
+typedef struct fort_flow_table
+{
+    UINT32 flow_count;
+    UINT32 node_count; /* allocated flows */
+
+    UINT32 index_min; /* preallocated index size */
+    UINT32 migrate_pos;
+
+    UINT32 full_count; /* failed flow additions */
+
+    PFORT_FLOW flow_free;
+    PFORT_FLOW_CHUNK chunks;
+
+    PFORT_FLOW_INDEX index;
+    PFORT_FLOW_INDEX old_index; /* being migrated from while resizing */
+} FORT_FLOW_TABLE, *PFORT_FLOW_TABLE;
+
+typedef void (*FORT_FLOW_TABLE_FOREACH_FUNC)(PVOID arg, PFORT_FLOW flow);
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+FORT_API void fort_flow_table_open(PFORT_FLOW_TABLE table, UINT32 capacity);
+
+FORT_API void fort_flow_table_close(PFORT_FLOW_TABLE table);
+
+FORT_API PFORT_FLOW fort_flow_table_get(PFORT_FLOW_TABLE table, UINT64 flow_id);
+
+FORT_API PFORT_FLOW fort_flow_table_add(PFORT_FLOW_TABLE table, UINT64 flow_id);
+
+FORT_API void fort_flow_table_remove(PFORT_FLOW_TABLE table, PFORT_FLOW flow);
+
+FORT_API void fort_flow_table_foreach(
+        PFORT_FLOW_TABLE table, FORT_FLOW_TABLE_FOREACH_FUNC func, PVOID arg);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // FORTFLOW_H
@@ -1,4 +1,4 @@
-/* Fort Firewall ACK Packets Deferring & Re-injection */
+/* Fort Firewall ACK & Datagram Packets Deferring & Re-injection */
 
 #include "fortpkt.h"
 
@@ -91,7 +91,7 @@ static NTSTATUS fort_packet_inject_stream(PFORT_DEFER defer, PFORT_PACKET pkt,
     return status;
 }
 
-static BOOL fort_packet_injected_by_self(PFORT_DEFER defer, PNET_BUFFER_LIST netBufList)
+FORT_API BOOL fort_defer_injected_by_self(PFORT_DEFER defer, PNET_BUFFER_LIST netBufList)
 {
     const FWPS_PACKET_INJECTION_STATE state =
             FwpsQueryPacketInjectionState0(defer->transport_injection4_id, netBufList, NULL);
@@ -126,10 +126,16 @@ static void fort_defer_packet_put(PFORT_DEFER defer, PFORT_PACKET pkt)
     defer->packet_free = pkt;
 }
 
-FORT_API void fort_defer_open(PFORT_DEFER defer)
+FORT_API void fort_defer_open(PFORT_DEFER defer, UINT32 batch_max)
 {
     NTSTATUS status;
 
+    LARGE_INTEGER perf_freq;
+    KeQueryPerformanceCounter(&perf_freq);
+
+    defer->perf_freq = perf_freq.QuadPart;
+    defer->batch_max = batch_max;
+
     status = FwpsInjectionHandleCreate0(
             AF_INET, FWPS_INJECTION_TYPE_TRANSPORT, &defer->transport_injection4_id);
 
@@ -169,6 +175,12 @@ static void fort_defer_list_add(PFORT_DEFER_LIST defer_list, PFORT_PACKET pkt)
         defer_list->packet_tail->next = pkt;
         defer_list->packet_tail = pkt;
     }
+
+    pkt->defer_time = KeQueryPerformanceCounter(NULL).QuadPart;
+
+    if (++defer_list->packet_count > defer_list->packet_count_max) {
+        defer_list->packet_count_max = defer_list->packet_count;
+    }
 }
 
 static PFORT_PACKET fort_defer_list_get(PFORT_DEFER_LIST defer_list, PFORT_PACKET pkt_chain)
@@ -178,11 +190,58 @@ static PFORT_PACKET fort_defer_list_get(PFORT_DEFER_LIST defer_list, PFORT_PACKE
         pkt_chain = defer_list->packet_head;
 
         defer_list->packet_head = defer_list->packet_tail = NULL;
+        defer_list->packet_count = 0;
     }
 
     return pkt_chain;
 }
 
+static void fort_defer_list_wait_add(
+        PFORT_DEFER defer, PFORT_DEFER_LIST defer_list, PFORT_PACKET pkt, INT64 now)
+{
+    const UINT32 wait_us = (UINT32) ((now - pkt->defer_time) * 1000000 / defer->perf_freq);
+
+    defer_list->wait_count++;
+    defer_list->wait_sum += wait_us;
+
+    if (wait_us > defer_list->wait_max) {
+        defer_list->wait_max = wait_us;
+    }
+}
+
+/* Take up to packet_max packets from the list's head */
+static PFORT_PACKET fort_defer_list_take(PFORT_DEFER defer, PFORT_DEFER_LIST defer_list,
+        PFORT_PACKET pkt_chain, UINT32 *packet_max, INT64 now)
+{
+    PFORT_PACKET pkt_head = defer_list->packet_head;
+    PFORT_PACKET pkt_last = NULL;
+    PFORT_PACKET pkt = pkt_head;
+    UINT32 count = 0;
+
+    while (pkt != NULL && count < *packet_max) {
+        fort_defer_list_wait_add(defer, defer_list, pkt, now);
+
+        pkt_last = pkt;
+        pkt = pkt->next;
+        ++count;
+    }
+
+    if (pkt_last == NULL)
+        return pkt_chain;
+
+    defer_list->packet_head = pkt;
+    if (pkt == NULL) {
+        defer_list->packet_tail = NULL;
+    }
+
+    defer_list->packet_count -= count;
+    *packet_max -= count;
+
+    pkt_last->next = pkt_chain;
+
+    return pkt_head;
+}
+
 static PFORT_PACKET fort_defer_list_flow_get(
         PFORT_DEFER_LIST defer_list, PFORT_PACKET pkt_chain, UINT64 flow_id)
 {
@@ -199,6 +258,8 @@ static PFORT_PACKET fort_defer_list_flow_get(
             PFORT_PACKET pkt_next = pkt->next;
 
             if (flow_id == pkt->stream.flow_id) {
+                defer_list->packet_count--;
+
                 if (pkt_prev == NULL) {
                     pkt_chain = pkt;
                 } else {
@@ -225,8 +286,56 @@ static PFORT_PACKET fort_defer_list_flow_get(
     return pkt_chain;
 }
 
-FORT_API NTSTATUS fort_defer_packet_add(PFORT_DEFER defer,
-        const FWPS_INCOMING_VALUES0 *inFixedValues,
+static void fort_defer_packet_fill(PFORT_PACKET pkt, const FWPS_INCOMING_VALUES0 *inFixedValues,
+        const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, PNET_BUFFER_LIST netBufList,
+        BOOL inbound)
+{
+    const BOOL is_datagram = (inFixedValues->layerId == FWPS_LAYER_DATAGRAM_DATA_V4);
+
+    pkt->inbound = inbound;
+    pkt->is_stream = FALSE;
+    pkt->dataOffset = 0;
+    pkt->dataSize = 0; /* not used */
+    pkt->netBufList = netBufList;
+    pkt->next = NULL;
+
+    if (inbound) {
+        PFORT_PACKET_IN pkt_in = &pkt->in;
+
+        pkt_in->compartmentId = inMetaValues->compartmentId;
+
+        const int interfaceField = is_datagram ? FWPS_FIELD_DATAGRAM_DATA_V4_INTERFACE_INDEX
+                                               : FWPS_FIELD_INBOUND_TRANSPORT_V4_INTERFACE_INDEX;
+        const int subInterfaceField = is_datagram
+                ? FWPS_FIELD_DATAGRAM_DATA_V4_SUB_INTERFACE_INDEX
+                : FWPS_FIELD_INBOUND_TRANSPORT_V4_SUB_INTERFACE_INDEX;
+
+        pkt_in->interfaceIndex = inFixedValues->incomingValue[interfaceField].value.uint32;
+        pkt_in->subInterfaceIndex = inFixedValues->incomingValue[subInterfaceField].value.uint32;
+
+        pkt_in->ipHeaderSize = (UINT16) inMetaValues->ipHeaderSize;
+        pkt_in->transportHeaderSize = (UINT16) inMetaValues->transportHeaderSize;
+
+        pkt->dataOffset = (UINT16) NET_BUFFER_DATA_OFFSET(NET_BUFFER_LIST_FIRST_NB(netBufList));
+    } else {
+        PFORT_PACKET_OUT pkt_out = &pkt->out;
+
+        pkt_out->compartmentId = inMetaValues->compartmentId;
+
+        const int remoteAddrField = is_datagram
+                ? FWPS_FIELD_DATAGRAM_DATA_V4_IP_REMOTE_ADDRESS
+                : FWPS_FIELD_OUTBOUND_TRANSPORT_V4_IP_REMOTE_ADDRESS;
+
+        /* host-order -> network-order conversion */
+        pkt_out->remoteAddr4 = HTONL(inFixedValues->incomingValue[remoteAddrField].value.uint32);
+
+        pkt_out->remoteScopeId = inMetaValues->remoteScopeId;
+        pkt_out->endpointHandle = inMetaValues->transportEndpointHandle;
+    }
+}
+
+static NTSTATUS fort_defer_packet_queue(PFORT_DEFER defer, PFORT_DEFER_LIST lists,
+        UINT32 *list_bits, UINT32 packet_max, const FWPS_INCOMING_VALUES0 *inFixedValues,
         const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, PNET_BUFFER_LIST netBufList,
         BOOL inbound, UCHAR group_index)
 {
@@ -236,7 +345,7 @@ FORT_API NTSTATUS fort_defer_packet_add(PFORT_DEFER defer,
         return STATUS_FWP_TCPIP_NOT_READY;
 
     /* Skip self injected packet */
-    if (fort_packet_injected_by_self(defer, netBufList))
+    if (fort_defer_injected_by_self(defer, netBufList))
         return STATUS_CANT_TERMINATE_SELF;
 
     /* Skip IpSec protected packet */
@@ -260,7 +369,12 @@ FORT_API NTSTATUS fort_defer_packet_add(PFORT_DEFER defer,
     KLOCK_QUEUE_HANDLE lock_queue;
     KeAcquireInStackQueuedSpinLock(&defer->lock, &lock_queue);
 
-    PFORT_DEFER_LIST defer_list = &defer->lists[list_index];
+    PFORT_DEFER_LIST defer_list = &lists[list_index];
+
+    if (defer_list->packet_count >= packet_max) {
+        status = STATUS_QUOTA_EXCEEDED;
+        goto end;
+    }
 
     PFORT_PACKET pkt = fort_defer_packet_get(defer);
     if (pkt == NULL) {
@@ -270,46 +384,12 @@ FORT_API NTSTATUS fort_defer_packet_add(PFORT_DEFER defer,
 
     fort_defer_list_add(defer_list, pkt);
 
-    pkt->inbound = inbound;
-    pkt->is_stream = FALSE;
-    pkt->dataOffset = 0;
-    pkt->dataSize = 0; /* not used */
-    pkt->netBufList = netBufList;
-    pkt->next = NULL;
-
-    if (inbound) {
-        PFORT_PACKET_IN pkt_in = &pkt->in;
-
-        pkt_in->compartmentId = inMetaValues->compartmentId;
-
-        const int interfaceField = FWPS_FIELD_INBOUND_TRANSPORT_V4_INTERFACE_INDEX;
-        const int subInterfaceField = FWPS_FIELD_INBOUND_TRANSPORT_V4_SUB_INTERFACE_INDEX;
-
-        pkt_in->interfaceIndex = inFixedValues->incomingValue[interfaceField].value.uint32;
-        pkt_in->subInterfaceIndex = inFixedValues->incomingValue[subInterfaceField].value.uint32;
-
-        pkt_in->ipHeaderSize = (UINT16) inMetaValues->ipHeaderSize;
-        pkt_in->transportHeaderSize = (UINT16) inMetaValues->transportHeaderSize;
-
-        pkt->dataOffset = (UINT16) NET_BUFFER_DATA_OFFSET(NET_BUFFER_LIST_FIRST_NB(netBufList));
-    } else {
-        PFORT_PACKET_OUT pkt_out = &pkt->out;
-
-        pkt_out->compartmentId = inMetaValues->compartmentId;
-
-        const int remoteAddrField = FWPS_FIELD_OUTBOUND_TRANSPORT_V4_IP_REMOTE_ADDRESS;
-
-        /* host-order -> network-order conversion */
-        pkt_out->remoteAddr4 = HTONL(inFixedValues->incomingValue[remoteAddrField].value.uint32);
-
-        pkt_out->remoteScopeId = inMetaValues->remoteScopeId;
-        pkt_out->endpointHandle = inMetaValues->transportEndpointHandle;
-    }
+    fort_defer_packet_fill(pkt, inFixedValues, inMetaValues, netBufList, inbound);
 
     FwpsReferenceNetBufferList0(pkt->netBufList, TRUE);
 
     /* Set to be flushed bit */
-    defer->list_bits |= (1 << list_index);
+    *list_bits |= (1 << list_index);
 
     status = STATUS_SUCCESS;
 
@@ -319,6 +399,26 @@ end:
     return status;
 }
 
+FORT_API NTSTATUS fort_defer_packet_add(PFORT_DEFER defer,
+        const FWPS_INCOMING_VALUES0 *inFixedValues,
+        const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, PNET_BUFFER_LIST netBufList,
+        BOOL inbound, UCHAR group_index)
+{
+    return fort_defer_packet_queue(defer, defer->lists, &defer->list_bits,
+            /*packet_max=*/(UINT32) -1, inFixedValues, inMetaValues, netBufList, inbound,
+            group_index);
+}
+
+FORT_API NTSTATUS fort_defer_datagram_add(PFORT_DEFER defer,
+        const FWPS_INCOMING_VALUES0 *inFixedValues,
+        const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, PNET_BUFFER_LIST netBufList,
+        BOOL inbound, UCHAR group_index)
+{
+    return fort_defer_packet_queue(defer, defer->datagram_lists, &defer->datagram_bits,
+            FORT_DEFER_DATAGRAM_MAX, inFixedValues, inMetaValues, netBufList, inbound,
+            group_index);
+}
+
 FORT_API NTSTATUS fort_defer_stream_add(PFORT_DEFER defer,
         const FWPS_INCOMING_VALUES0 *inFixedValues,
         const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, const FWPS_STREAM_DATA0 *streamData,
@@ -437,13 +537,17 @@ static void fort_defer_packet_inject(PFORT_DEFER defer, PFORT_PACKET pkt,
     }
 }
 
-FORT_API void fort_defer_packet_flush(PFORT_DEFER defer, FORT_INJECT_COMPLETE_FUNC complete_func,
-        UINT32 list_bits, BOOL dispatchLevel)
+/* Re-inject up to packet_max packets, the budget is decreased by the taken ones */
+static void fort_defer_lists_flush(PFORT_DEFER defer, PFORT_DEFER_LIST lists,
+        UINT32 *defer_list_bits, FORT_INJECT_COMPLETE_FUNC complete_func, UINT32 list_bits,
+        UINT32 *packet_max, BOOL dispatchLevel)
 {
-    list_bits &= defer->list_bits;
-    if (list_bits == 0)
+    list_bits &= *defer_list_bits;
+    if (list_bits == 0 || *packet_max == 0)
         return;
 
+    const INT64 now = KeQueryPerformanceCounter(NULL).QuadPart;
+
     PFORT_PACKET pkt_chain = NULL;
 
     KLOCK_QUEUE_HANDLE lock_queue;
@@ -453,20 +557,25 @@ FORT_API void fort_defer_packet_flush(PFORT_DEFER defer, FORT_INJECT_COMPLETE_FU
         KeAcquireInStackQueuedSpinLock(&defer->lock, &lock_queue);
     }
 
-    for (int i = 0; list_bits != 0; ++i) {
-        const UINT32 list_bit = (list_bits & 1);
+    /* Start from the next list on each flush to share the batches */
+    const int list_first = defer->flush_index++ % FORT_DEFER_LIST_MAX;
 
-        list_bits >>= 1;
-        if (list_bit == 0)
+    for (int n = 0; n < FORT_DEFER_LIST_MAX && *packet_max != 0; ++n) {
+        const int i = (list_first + n) % FORT_DEFER_LIST_MAX;
+        const UINT32 list_bit = (1 << i);
+
+        if ((list_bits & list_bit) == 0)
             continue;
 
-        PFORT_DEFER_LIST defer_list = &defer->lists[i];
+        PFORT_DEFER_LIST defer_list = &lists[i];
 
-        pkt_chain = fort_defer_list_get(defer_list, pkt_chain);
-    }
+        pkt_chain = fort_defer_list_take(defer, defer_list, pkt_chain, packet_max, now);
 
-    /* Clear flushed bits */
-    defer->list_bits &= ~list_bits;
+        /* Clear flushed bit */
+        if (defer_list->packet_head == NULL) {
+            *defer_list_bits &= ~list_bit;
+        }
+    }
 
     if (dispatchLevel) {
         KeReleaseInStackQueuedSpinLockFromDpcLevel(&lock_queue);
@@ -477,6 +586,79 @@ FORT_API void fort_defer_packet_flush(PFORT_DEFER defer, FORT_INJECT_COMPLETE_FU
     fort_defer_packet_inject(defer, pkt_chain, complete_func, dispatchLevel);
 }
 
+FORT_API void fort_defer_packet_flush(PFORT_DEFER defer, FORT_INJECT_COMPLETE_FUNC complete_func,
+        UINT32 list_bits, BOOL dispatchLevel)
+{
+    UINT32 packet_max = (UINT32) -1;
+
+    fort_defer_lists_flush(defer, defer->lists, &defer->list_bits, complete_func, list_bits,
+            &packet_max, dispatchLevel);
+}
+
+FORT_API void fort_defer_datagram_flush(PFORT_DEFER defer,
+        FORT_INJECT_COMPLETE_FUNC complete_func, UINT32 list_bits, BOOL dispatchLevel)
+{
+    UINT32 packet_max = (UINT32) -1;
+
+    fort_defer_lists_flush(defer, defer->datagram_lists, &defer->datagram_bits, complete_func,
+            list_bits, &packet_max, dispatchLevel);
+}
+
+/* The timer's DPC re-injects one batch of the packets and datagrams, the rest waits for its
+ * next period */
+FORT_API void fort_defer_batch_flush(PFORT_DEFER defer, FORT_INJECT_COMPLETE_FUNC complete_func,
+        UINT32 list_bits, UINT32 datagram_bits)
+{
+    UINT32 packet_max = (defer->batch_max != 0) ? defer->batch_max : (UINT32) -1;
+
+    /* Alternate the first kind, so one can't take the whole batch on each period */
+    const BOOL datagrams_first = (defer->batch_index++ & 1) != 0;
+
+    if (datagrams_first) {
+        fort_defer_lists_flush(defer, defer->datagram_lists, &defer->datagram_bits,
+                complete_func, datagram_bits, &packet_max, TRUE);
+    }
+
+    fort_defer_lists_flush(defer, defer->lists, &defer->list_bits, complete_func, list_bits,
+            &packet_max, TRUE);
+
+    if (!datagrams_first) {
+        fort_defer_lists_flush(defer, defer->datagram_lists, &defer->datagram_bits,
+                complete_func, datagram_bits, &packet_max, TRUE);
+    }
+}
+
+static void fort_defer_list_stats(PFORT_DEFER_LIST defer_list, PFORT_DRIVER_STATS stats)
+{
+    UINT64 *values = stats->values;
+
+    if (defer_list->packet_count_max > values[FORT_DRIVER_STAT_DEFER_QUEUE_MAX]) {
+        values[FORT_DRIVER_STAT_DEFER_QUEUE_MAX] = defer_list->packet_count_max;
+    }
+
+    values[FORT_DRIVER_STAT_DEFER_WAITS] += defer_list->wait_count;
+    values[FORT_DRIVER_STAT_DEFER_WAIT_SUM] += defer_list->wait_sum;
+
+    if (defer_list->wait_max > values[FORT_DRIVER_STAT_DEFER_WAIT_MAX]) {
+        values[FORT_DRIVER_STAT_DEFER_WAIT_MAX] = defer_list->wait_max;
+    }
+}
+
+FORT_API void fort_defer_driver_stats(PFORT_DEFER defer, PFORT_DRIVER_STATS stats)
+{
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLock(&defer->lock, &lock_queue);
+    {
+        fort_defer_list_stats(&defer->stream_list, stats);
+
+        for (int i = 0; i < FORT_DEFER_LIST_MAX; ++i) {
+            fort_defer_list_stats(&defer->lists[i], stats);
+            fort_defer_list_stats(&defer->datagram_lists[i], stats);
+        }
+    }
+    KeReleaseInStackQueuedSpinLock(&lock_queue);
+}
+
 FORT_API void fort_defer_stream_flush(PFORT_DEFER defer, FORT_INJECT_COMPLETE_FUNC complete_func,
         UINT64 flow_id, BOOL dispatchLevel)
 {
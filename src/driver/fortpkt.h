@@ -11,6 +11,10 @@
 
 #define FORT_DEFER_STREAM_ALL ((UINT64)((INT64) -1))
 
+#define FORT_DEFER_DATAGRAM_MAX 256 /* per list, the newer datagrams are dropped */
+
+#define FORT_DEFER_BATCH_DEFAULT 64 /* packets re-injected per timer's DPC, datagrams included */
+
 #define TCP_FLAG_FIN 0x0001
 #define TCP_FLAG_SYN 0x0002
 #define TCP_FLAG_RST 0x0004
@@ -78,6 +82,8 @@ typedef struct fort_packet
 
     PNET_BUFFER_LIST netBufList;
 
+    INT64 defer_time; /* performance counter ticks */
+
     struct fort_packet *next;
 
     union {
@@ -91,11 +97,25 @@ typedef struct fort_defer_list
 {
     PFORT_PACKET packet_head;
     PFORT_PACKET packet_tail;
+
+    UINT32 packet_count;
+    UINT32 packet_count_max; /* the deepest queue */
+
+    UINT32 wait_count; /* re-injected packets */
+    UINT32 wait_max; /* the longest time in queue, in microseconds */
+    UINT64 wait_sum; /* in microseconds */
 } FORT_DEFER_LIST, *PFORT_DEFER_LIST;
 
 typedef struct fort_defer
 {
     UINT32 list_bits;
+    UINT32 datagram_bits;
+
+    UINT32 batch_max;
+    UCHAR batch_index; /* of the timer's flushes, to alternate the kinds of lists */
+    UCHAR flush_index; /* of the first list to flush */
+
+    INT64 perf_freq;
 
     HANDLE transport_injection4_id;
     HANDLE stream_injection4_id;
@@ -106,6 +126,7 @@ typedef struct fort_defer
 
     FORT_DEFER_LIST stream_list;
     FORT_DEFER_LIST lists[FORT_DEFER_LIST_MAX]; /* in/out-bounds */
+    FORT_DEFER_LIST datagram_lists[FORT_DEFER_LIST_MAX]; /* shaped UDP, in/out-bounds */
 
     KSPIN_LOCK lock;
 } FORT_DEFER, *PFORT_DEFER;
@@ -118,15 +139,22 @@ typedef NTSTATUS (*FORT_INJECT_FUNC)(
 extern "C" {
 #endif
 
-FORT_API void fort_defer_open(PFORT_DEFER defer);
+FORT_API void fort_defer_open(PFORT_DEFER defer, UINT32 batch_max);
 
 FORT_API void fort_defer_close(PFORT_DEFER defer);
 
+FORT_API BOOL fort_defer_injected_by_self(PFORT_DEFER defer, PNET_BUFFER_LIST netBufList);
+
 FORT_API NTSTATUS fort_defer_packet_add(PFORT_DEFER defer,
         const FWPS_INCOMING_VALUES0 *inFixedValues,
         const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, PNET_BUFFER_LIST netBufList,
         BOOL inbound, UCHAR group_index);
 
+FORT_API NTSTATUS fort_defer_datagram_add(PFORT_DEFER defer,
+        const FWPS_INCOMING_VALUES0 *inFixedValues,
+        const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, PNET_BUFFER_LIST netBufList,
+        BOOL inbound, UCHAR group_index);
+
 FORT_API NTSTATUS fort_defer_stream_add(PFORT_DEFER defer,
         const FWPS_INCOMING_VALUES0 *inFixedValues,
         const FWPS_INCOMING_METADATA_VALUES0 *inMetaValues, const FWPS_STREAM_DATA0 *streamData,
@@ -138,6 +166,14 @@ FORT_API void fort_defer_packet_free(
 FORT_API void fort_defer_packet_flush(PFORT_DEFER defer, FORT_INJECT_COMPLETE_FUNC complete_func,
         UINT32 list_bits, BOOL dispatchLevel);
 
+FORT_API void fort_defer_datagram_flush(PFORT_DEFER defer,
+        FORT_INJECT_COMPLETE_FUNC complete_func, UINT32 list_bits, BOOL dispatchLevel);
+
+FORT_API void fort_defer_batch_flush(PFORT_DEFER defer, FORT_INJECT_COMPLETE_FUNC complete_func,
+        UINT32 list_bits, UINT32 datagram_bits);
+
+FORT_API void fort_defer_driver_stats(PFORT_DEFER defer, PFORT_DRIVER_STATS stats);
+
 FORT_API void fort_defer_stream_flush(PFORT_DEFER defer, FORT_INJECT_COMPLETE_FUNC complete_func,
         UINT64 flow_id, BOOL dispatchLevel);
 
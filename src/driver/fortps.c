@@ -18,14 +18,14 @@
 
 typedef struct fort_psname
 {
-    UINT16 refcount;
+    SHORT volatile refcount; /* the classifies take it under the shared lock */
     UINT16 size;
     WCHAR data[1];
 } FORT_PSNAME, *PFORT_PSNAME;
 
-#define FORT_PSNODE_PARENT_NAME_CHECKED 0x0001
-#define FORT_PSNODE_NAME_INHERIT        0x0002
-#define FORT_PSNODE_NAME_INHERITED      0x0004
+#define FORT_PSNODE_IS_SERVICE     0x0001
+#define FORT_PSNODE_NAME_INHERIT   0x0002
+#define FORT_PSNODE_NAME_INHERITED 0x0004
 
 /* Synchronize with tommy_hashdyn_node! */
 typedef struct fort_psnode
@@ -41,9 +41,19 @@ typedef struct fort_psnode
     UINT32 parent_process_id;
 
     UINT16 volatile flags;
-    UINT16 conf_chn;
+    UINT16 conf_chn; /* of the last resolving of the name */
+
+    PFORT_PSNAME ps_path; /* kernel path of the image to check in the conf */
+
+    FORT_PSVERDICT verdict; /* cached on the first classify */
 } FORT_PSNODE, *PFORT_PSNODE;
 
+typedef struct fort_pstree_resolve
+{
+    PFORT_PSTREE ps_tree;
+    PFORT_CONF_REF conf_ref;
+} FORT_PSTREE_RESOLVE, *PFORT_PSTREE_RESOLVE;
+
 typedef struct _SYSTEM_PROCESSES
 {
     ULONG NextEntryOffset;
@@ -133,9 +143,15 @@ static PFORT_PSNAME fort_pstree_name_new(PFORT_PSTREE ps_tree, UINT16 name_size)
     return ps_name;
 }
 
+static void fort_pstree_name_add_ref(PFORT_PSNAME ps_name)
+{
+    InterlockedIncrement16(&ps_name->refcount);
+}
+
+/* Must be called under the exclusive lock */
 static void fort_pstree_name_del(PFORT_PSTREE ps_tree, PFORT_PSNAME ps_name)
 {
-    if (ps_name != NULL && --ps_name->refcount == 0) {
+    if (ps_name != NULL && InterlockedDecrement16(&ps_name->refcount) == 0) {
         fort_pool_free(&ps_tree->pool_list, ps_name);
     }
 }
@@ -272,6 +288,7 @@ static void fort_pstree_proc_del(PFORT_PSTREE ps_tree, PFORT_PSNODE proc)
 
     // Delete from pool
     fort_pstree_name_del(ps_tree, proc->ps_name);
+    fort_pstree_name_del(ps_tree, proc->ps_path);
 
     // Delete from procs map
     tommy_hashdyn_remove_existing(&ps_tree->procs_map, (tommy_hashdyn_node *) proc);
@@ -302,8 +319,138 @@ static PFORT_PSNODE fort_pstree_find_proc(PFORT_PSTREE ps_tree, DWORD processId)
     return fort_pstree_find_proc_hash(ps_tree, processId, pid_hash);
 }
 
-static void fort_pstree_handle_new_proc(PFORT_PSTREE ps_tree, PCUNICODE_STRING path,
-        PCUNICODE_STRING commandLine, tommy_key_t pid_hash, DWORD processId, DWORD parentProcessId)
+static NTSTATUS GetProcessImageName(HANDLE processHandle, PUNICODE_STRING path)
+{
+    NTSTATUS status;
+
+    const USHORT bufferSize = sizeof(UNICODE_STRING) + FORT_CONF_APP_PATH_MAX * sizeof(WCHAR);
+    PUNICODE_STRING bufferPath = fort_mem_alloc(bufferSize, FORT_PSTREE_POOL_TAG);
+    if (bufferPath == NULL)
+        return STATUS_BUFFER_TOO_SMALL;
+
+    ULONG outLength;
+    status = ZwQueryInformationProcess(
+            processHandle, ProcessImageFileName, bufferPath, bufferSize, &outLength);
+    if (NT_SUCCESS(status)) {
+        const USHORT pathLength = bufferPath->Length;
+
+        if (outLength == 0 || pathLength == 0) {
+            status = STATUS_OBJECT_NAME_NOT_FOUND;
+        } else if (path->MaximumLength < pathLength) {
+            status = STATUS_BUFFER_TOO_SMALL;
+        } else {
+            path->Length = pathLength;
+            RtlDowncaseUnicodeString(path, bufferPath, FALSE);
+            path->Buffer[pathLength / sizeof(WCHAR)] = L'\0';
+
+            status = STATUS_SUCCESS;
+        }
+    }
+
+    fort_mem_free(bufferPath, FORT_PSTREE_POOL_TAG);
+
+    return status;
+}
+
+static HANDLE OpenProcessByPointer(PEPROCESS peProcess, DWORD processId)
+{
+    HANDLE processHandle;
+    const NTSTATUS status =
+            ObOpenObjectByPointer(peProcess, 0, NULL, 0, 0, KernelMode, &processHandle);
+
+    if (!NT_SUCCESS(status)) {
+        LOG("PsTree: Open Process Object Error: pid=%d %x\n", processId, status);
+        return NULL;
+    }
+
+    return processHandle;
+}
+
+static HANDLE OpenProcessById(DWORD processId)
+{
+    NTSTATUS status;
+
+    PEPROCESS peProcess;
+    status = PsLookupProcessByProcessId((HANDLE) (ptrdiff_t) processId, &peProcess);
+    if (!NT_SUCCESS(status)) {
+        LOG("PsTree: Lookup Process Error: pid=%d %x\n", processId, status);
+        return NULL;
+    }
+
+    const HANDLE processHandle = OpenProcessByPointer(peProcess, processId);
+
+    ObDereferenceObject(peProcess);
+
+    return processHandle;
+}
+
+static PFORT_PSNAME fort_pstree_add_path(PFORT_PSTREE ps_tree, PCUNICODE_STRING path)
+{
+    if (path->Length == 0)
+        return NULL;
+
+    PFORT_PSNAME ps_path = fort_pstree_name_new(ps_tree, path->Length);
+    if (ps_path != NULL) {
+        RtlCopyMemory(ps_path->data, path->Buffer, path->Length);
+    }
+
+    return ps_path;
+}
+
+/* Inherit the parent's name or take own path, when the conf applies it to the children */
+static void fort_pstree_proc_resolve(
+        PFORT_PSTREE ps_tree, PFORT_CONF_REF conf_ref, PFORT_PSNODE proc)
+{
+    if (proc->conf_chn == ps_tree->conf_chn)
+        return;
+
+    proc->conf_chn = ps_tree->conf_chn;
+
+    /* Services can't inherit parent's name */
+    if ((proc->flags & FORT_PSNODE_IS_SERVICE) != 0)
+        return;
+
+    fort_pstree_name_del(ps_tree, proc->ps_name);
+    proc->ps_name = NULL;
+    proc->flags &= ~(FORT_PSNODE_NAME_INHERIT | FORT_PSNODE_NAME_INHERITED);
+
+    PFORT_PSNODE parent = fort_pstree_find_proc(ps_tree, proc->parent_process_id);
+    if (parent != NULL) {
+        fort_pstree_proc_resolve(ps_tree, conf_ref, parent);
+
+        if ((parent->flags & (FORT_PSNODE_NAME_INHERIT | FORT_PSNODE_NAME_INHERITED)) != 0) {
+            PFORT_PSNAME ps_name = parent->ps_name;
+            if (ps_name != NULL) {
+                fort_pstree_name_add_ref(ps_name);
+                proc->ps_name = ps_name;
+                proc->flags |= FORT_PSNODE_NAME_INHERITED;
+                return;
+            }
+        }
+    }
+
+    PFORT_PSNAME ps_path = proc->ps_path;
+    if (conf_ref == NULL || ps_path == NULL)
+        return;
+
+    const FORT_APP_FLAGS app_flags =
+            fort_conf_app_find(&conf_ref->conf, ps_path->data, ps_path->size, fort_conf_exe_find);
+
+    if (app_flags.apply_child) {
+        fort_pstree_name_add_ref(ps_path);
+        proc->ps_name = ps_path;
+        proc->flags |= FORT_PSNODE_NAME_INHERIT;
+    }
+}
+
+static void fort_pstree_proc_resolve_node(PFORT_PSTREE_RESOLVE resolve, PFORT_PSNODE proc)
+{
+    fort_pstree_proc_resolve(resolve->ps_tree, resolve->conf_ref, proc);
+}
+
+static void fort_pstree_handle_new_proc(PFORT_PSTREE ps_tree, PFORT_CONF_REF conf_ref,
+        PCUNICODE_STRING path, PCUNICODE_STRING commandLine, PCUNICODE_STRING imagePath,
+        tommy_key_t pid_hash, DWORD processId, DWORD parentProcessId)
 {
     PFORT_PSNAME ps_name = fort_pstree_add_service_name(ps_tree, path, commandLine);
 
@@ -316,9 +463,56 @@ static void fort_pstree_handle_new_proc(PFORT_PSTREE ps_tree, PCUNICODE_STRING p
     proc->process_id = processId;
     proc->parent_process_id = parentProcessId;
 
-    /* Services can't inherit parent's name */
-    proc->flags = (ps_name != NULL) ? FORT_PSNODE_PARENT_NAME_CHECKED : 0;
-    proc->conf_chn = 0;
+    proc->flags = (ps_name != NULL) ? FORT_PSNODE_IS_SERVICE : 0;
+    proc->conf_chn = ps_tree->conf_chn - 1;
+
+    proc->ps_path = (ps_name != NULL) ? NULL : fort_pstree_add_path(ps_tree, imagePath);
+
+    RtlZeroMemory(&proc->verdict, sizeof(FORT_PSVERDICT));
+
+    /* Distinguish the process from the previous one with the same pid */
+    if (++ps_tree->proc_seq == 0) {
+        ++ps_tree->proc_seq;
+    }
+    proc->verdict.proc_seq = ps_tree->proc_seq;
+
+    fort_pstree_proc_resolve(ps_tree, conf_ref, proc);
+}
+
+static void fort_pstree_proc_closed(PFORT_PSTREE ps_tree, DWORD processId)
+{
+    KIRQL oldIrql = ExAcquireSpinLockExclusive(&ps_tree->lock);
+    {
+        PFORT_PSNODE proc = fort_pstree_find_proc(ps_tree, processId);
+        if (proc != NULL) {
+            fort_pstree_proc_del(ps_tree, proc);
+        }
+    }
+    ExReleaseSpinLockExclusive(&ps_tree->lock, oldIrql);
+}
+
+/* Must be called at PASSIVE_LEVEL */
+static void fort_pstree_proc_created(PFORT_PSTREE ps_tree, DWORD processId,
+        DWORD parentProcessId, PCUNICODE_STRING path, PCUNICODE_STRING commandLine,
+        PCUNICODE_STRING imagePath)
+{
+    const tommy_key_t pid_hash = (tommy_key_t) tommy_hash_u32(0, &processId, sizeof(DWORD));
+
+    PFORT_CONF_REF conf_ref = fort_conf_ref_take(&fort_device()->conf);
+
+    KIRQL oldIrql = ExAcquireSpinLockExclusive(&ps_tree->lock);
+    {
+        PFORT_PSNODE proc = fort_pstree_find_proc_hash(ps_tree, processId, pid_hash);
+        if (proc == NULL) {
+            fort_pstree_handle_new_proc(ps_tree, conf_ref, path, commandLine, imagePath, pid_hash,
+                    processId, parentProcessId);
+        }
+    }
+    ExReleaseSpinLockExclusive(&ps_tree->lock, oldIrql);
+
+    if (conf_ref != NULL) {
+        fort_conf_ref_put(&fort_device()->conf, conf_ref);
+    }
 }
 
 static void NTAPI fort_pstree_notify(
@@ -326,15 +520,7 @@ static void NTAPI fort_pstree_notify(
 {
     PFORT_PSTREE ps_tree = &fort_device()->ps_tree;
 
-    UNUSED(process);
-
     const DWORD processId = (DWORD) (ptrdiff_t) processHandle;
-    const tommy_key_t pid_hash = (tommy_key_t) tommy_hash_u32(0, &processId, sizeof(DWORD));
-
-    KLOCK_QUEUE_HANDLE lock_queue;
-    KeAcquireInStackQueuedSpinLock(&ps_tree->lock, &lock_queue);
-
-    PFORT_PSNODE proc = fort_pstree_find_proc_hash(ps_tree, processId, pid_hash);
 
     if (createInfo == NULL) {
         /* Process Closed */
@@ -342,29 +528,47 @@ static void NTAPI fort_pstree_notify(
         LOG("PsTree: pid=%d CLOSED\n", processId);
 #endif
 
-        if (proc != NULL) {
-            fort_pstree_proc_del(ps_tree, proc);
-        }
+        fort_pstree_proc_closed(ps_tree, processId);
+        return;
     }
+
     /* Process Created */
-    else if (createInfo->ImageFileName != NULL && createInfo->CommandLine != NULL) {
-        const DWORD parentProcessId = (DWORD) (ptrdiff_t) createInfo->ParentProcessId;
+    if (createInfo->ImageFileName == NULL || createInfo->CommandLine == NULL)
+        return;
+
+    const DWORD parentProcessId = (DWORD) (ptrdiff_t) createInfo->ParentProcessId;
 
 #ifdef FORT_DEBUG
-        LOG("PsTree: pid=%d ppid=%d IMG=[%wZ] CMD=[%wZ]\n", processId, parentProcessId,
-                createInfo->ImageFileName, createInfo->CommandLine);
+    LOG("PsTree: pid=%d ppid=%d IMG=[%wZ] CMD=[%wZ]\n", processId, parentProcessId,
+            createInfo->ImageFileName, createInfo->CommandLine);
 #endif
 
-        if (proc == NULL) {
-            UNICODE_STRING path = *createInfo->ImageFileName;
-            fort_path_prefix_adjust(&path);
+    UNICODE_STRING path = *createInfo->ImageFileName;
+    fort_path_prefix_adjust(&path);
+
+    /* The conf has the kernel paths of apps, resolve it before the process starts */
+    const USHORT bufferSize = FORT_CONF_APP_PATH_MAX * sizeof(WCHAR);
+    PWSTR buffer = fort_mem_alloc(bufferSize, FORT_PSTREE_POOL_TAG);
+
+    UNICODE_STRING imagePath = { .Length = 0, .MaximumLength = bufferSize, .Buffer = buffer };
+
+    if (buffer != NULL) {
+        const HANDLE imageHandle = OpenProcessByPointer(process, processId);
+        if (imageHandle != NULL) {
+            if (!NT_SUCCESS(GetProcessImageName(imageHandle, &imagePath))) {
+                imagePath.Length = 0;
+            }
 
-            fort_pstree_handle_new_proc(
-                    ps_tree, &path, createInfo->CommandLine, pid_hash, processId, parentProcessId);
+            ZwClose(imageHandle);
         }
     }
 
-    KeReleaseInStackQueuedSpinLock(&lock_queue);
+    fort_pstree_proc_created(
+            ps_tree, processId, parentProcessId, &path, createInfo->CommandLine, &imagePath);
+
+    if (buffer != NULL) {
+        fort_mem_free(buffer, FORT_PSTREE_POOL_TAG);
+    }
 }
 
 static void fort_pstree_update(PFORT_PSTREE ps_tree, BOOL active)
@@ -394,8 +598,6 @@ FORT_API void fort_pstree_open(PFORT_PSTREE ps_tree)
     tommy_arrayof_init(&ps_tree->procs, sizeof(FORT_PSNODE));
     tommy_hashdyn_init(&ps_tree->procs_map);
 
-    KeInitializeSpinLock(&ps_tree->lock);
-
     fort_pstree_update(ps_tree, TRUE); /* Start process monitor */
 }
 
@@ -403,72 +605,39 @@ FORT_API void fort_pstree_close(PFORT_PSTREE ps_tree)
 {
     fort_pstree_update(ps_tree, FALSE); /* Stop process monitor */
 
-    KLOCK_QUEUE_HANDLE lock_queue;
-    KeAcquireInStackQueuedSpinLock(&ps_tree->lock, &lock_queue);
+    KIRQL oldIrql = ExAcquireSpinLockExclusive(&ps_tree->lock);
     {
         fort_pool_done(&ps_tree->pool_list);
 
         tommy_arrayof_done(&ps_tree->procs);
         tommy_hashdyn_done(&ps_tree->procs_map);
     }
-    KeReleaseInStackQueuedSpinLock(&lock_queue);
+    ExReleaseSpinLockExclusive(&ps_tree->lock, oldIrql);
 }
 
-static NTSTATUS GetProcessImageName(HANDLE processHandle, PUNICODE_STRING path)
+FORT_API void fort_pstree_conf_update(PFORT_PSTREE ps_tree, PFORT_DEVICE_CONF device_conf)
 {
-    NTSTATUS status;
-
-    const USHORT bufferSize = sizeof(UNICODE_STRING) + FORT_CONF_APP_PATH_MAX * sizeof(WCHAR);
-    PUNICODE_STRING bufferPath = fort_mem_alloc(bufferSize, FORT_PSTREE_POOL_TAG);
-    if (bufferPath == NULL)
-        return STATUS_BUFFER_TOO_SMALL;
-
-    ULONG outLength;
-    status = ZwQueryInformationProcess(
-            processHandle, ProcessImageFileName, bufferPath, bufferSize, &outLength);
-    if (NT_SUCCESS(status)) {
-        const USHORT pathLength = bufferPath->Length;
-
-        if (outLength == 0 || pathLength == 0) {
-            status = STATUS_OBJECT_NAME_NOT_FOUND;
-        } else if (path->MaximumLength < pathLength) {
-            status = STATUS_BUFFER_TOO_SMALL;
-        } else {
-            path->Length = pathLength;
-            RtlDowncaseUnicodeString(path, bufferPath, FALSE);
-            path->Buffer[pathLength / sizeof(WCHAR)] = L'\0';
-
-            status = STATUS_SUCCESS;
-        }
-    }
-
-    fort_mem_free(bufferPath, FORT_PSTREE_POOL_TAG);
-
-    return status;
-}
+    FORT_PSTREE_RESOLVE resolve = {
+        .ps_tree = ps_tree,
+        .conf_ref = fort_conf_ref_take(device_conf),
+    };
 
-static HANDLE OpenProcessById(DWORD processId)
-{
-    NTSTATUS status;
+    KIRQL oldIrql = ExAcquireSpinLockExclusive(&ps_tree->lock);
+    {
+        /* Resolve the names of all processes again */
+        ++ps_tree->conf_chn;
 
-    PEPROCESS peProcess;
-    status = PsLookupProcessByProcessId((HANDLE) (ptrdiff_t) processId, &peProcess);
-    if (!NT_SUCCESS(status)) {
-        LOG("PsTree: Lookup Process Error: pid=%d %x\n", processId, status);
-        return NULL;
+        tommy_hashdyn_foreach_node_arg(&ps_tree->procs_map,
+                (tommy_foreach_node_arg_func *) &fort_pstree_proc_resolve_node, &resolve);
     }
+    ExReleaseSpinLockExclusive(&ps_tree->lock, oldIrql);
 
-    HANDLE processHandle;
-    status = ObOpenObjectByPointer(peProcess, 0, NULL, 0, 0, KernelMode, &processHandle);
-
-    ObDereferenceObject(peProcess);
+    /* Invalidate the verdicts of processes, classified with the old names */
+    fort_device_conf_gen_inc(device_conf);
 
-    if (!NT_SUCCESS(status)) {
-        LOG("PsTree: Open Process Object Error: pid=%d %x\n", processId, status);
-        return NULL;
+    if (resolve.conf_ref != NULL) {
+        fort_conf_ref_put(device_conf, resolve.conf_ref);
     }
-
-    return processHandle;
 }
 
 static PWCHAR GetUnicodeStringBuffer(PCUNICODE_STRING string, PRTL_USER_PROCESS_PARAMETERS params)
@@ -573,6 +742,11 @@ static void fort_pstree_enum_process(PSYSTEM_PROCESSES processEntry, HANDLE proc
 {
     NTSTATUS status;
 
+    WCHAR imagePathBuffer[256];
+    UNICODE_STRING imagePath = {
+        .Length = 0, .MaximumLength = sizeof(imagePathBuffer), .Buffer = imagePathBuffer
+    };
+
     WCHAR pathBuffer[256];
     UNICODE_STRING path = {
         .Length = 0, .MaximumLength = sizeof(pathBuffer), .Buffer = pathBuffer
@@ -583,28 +757,20 @@ static void fort_pstree_enum_process(PSYSTEM_PROCESSES processEntry, HANDLE proc
         .Length = 0, .MaximumLength = sizeof(commandLineBuffer), .Buffer = commandLineBuffer
     };
 
-    status = GetProcessImageName(processHandle, &path);
+    status = GetProcessImageName(processHandle, &imagePath);
     if (!NT_SUCCESS(status))
         return;
 
-    if (fort_pstree_svchost_path_check(&path)) {
+    if (fort_pstree_svchost_path_check(&imagePath)) {
         status = GetProcessPathArgs(processHandle, &path, &commandLine);
         if (!NT_SUCCESS(status)) {
             LOG("PsTree: Process Args Error: pid=%d %x\n", processEntry->ProcessId, status);
             return;
         }
-    } else {
-        path.Length = 0;
     }
 
-    const HANDLE processId = (HANDLE) (ptrdiff_t) processEntry->ProcessId;
-    const HANDLE parentProcessId = (HANDLE) (ptrdiff_t) processEntry->ParentProcessId;
-
-    PS_CREATE_NOTIFY_INFO createInfo = {
-        .ParentProcessId = parentProcessId, .ImageFileName = &path, .CommandLine = &commandLine
-    };
-
-    fort_pstree_notify(/*process=*/NULL, processId, &createInfo);
+    fort_pstree_proc_created(&fort_device()->ps_tree, (DWORD) processEntry->ProcessId,
+            (DWORD) processEntry->ParentProcessId, &path, &commandLine, &imagePath);
 }
 
 static void fort_pstree_enum_processes_loop(PSYSTEM_PROCESSES processEntry)
@@ -656,90 +822,22 @@ FORT_API void NTAPI fort_pstree_enum_processes(void)
     fort_mem_free(buffer, FORT_PSTREE_POOL_TAG);
 }
 
-static void fort_pstree_check_proc_conf_exe(
-        PFORT_PSTREE ps_tree, PFORT_CONF_REF conf_ref, PFORT_PSNODE proc, PCUNICODE_STRING path)
-{
-    const FORT_APP_FLAGS app_flags =
-            fort_conf_app_find(&conf_ref->conf, path->Buffer, path->Length, fort_conf_exe_find);
-
-    if (app_flags.apply_child) {
-        PFORT_PSNAME ps_name = fort_pstree_name_new(ps_tree, path->Length);
-        if (ps_name != NULL) {
-            RtlCopyMemory(ps_name->data, path->Buffer, path->Length);
-
-            proc->ps_name = ps_name;
-            proc->flags |= FORT_PSNODE_NAME_INHERIT;
-        }
-    }
-}
-
-static void fort_pstree_check_proc_conf(
-        PFORT_PSTREE ps_tree, PFORT_CONF_REF conf_ref, PFORT_PSNODE proc, HANDLE processHandle)
-{
-    NTSTATUS status;
-
-    const USHORT bufferSize = FORT_CONF_APP_PATH_MAX * sizeof(WCHAR);
-    PWSTR buffer = fort_mem_alloc(bufferSize, FORT_PSTREE_POOL_TAG);
-    if (buffer == NULL)
-        return;
-
-    UNICODE_STRING path = { .Length = 0, .MaximumLength = bufferSize, .Buffer = buffer };
-
-    status = GetProcessImageName(processHandle, &path);
-    if (NT_SUCCESS(status)) {
-        fort_pstree_check_proc_conf_exe(ps_tree, conf_ref, proc, &path);
-    }
-
-    fort_mem_free(buffer, FORT_PSTREE_POOL_TAG);
-}
-
-static void fort_pstree_check_proc_parent(
-        PFORT_PSTREE ps_tree, PFORT_CONF_REF conf_ref, PFORT_PSNODE proc)
-{
-    if ((proc->flags & FORT_PSNODE_PARENT_NAME_CHECKED) != 0)
-        return;
-
-    proc->flags |= FORT_PSNODE_PARENT_NAME_CHECKED;
-
-    PFORT_PSNODE parent = fort_pstree_find_proc(ps_tree, proc->parent_process_id);
-    if (parent != NULL) {
-        fort_pstree_check_proc_parent(ps_tree, conf_ref, parent);
-
-        if ((parent->flags & (FORT_PSNODE_NAME_INHERIT | FORT_PSNODE_NAME_INHERITED)) != 0) {
-            PFORT_PSNAME ps_name = parent->ps_name;
-            if (ps_name != NULL) {
-                ++ps_name->refcount;
-                proc->ps_name = ps_name;
-                proc->flags |= FORT_PSNODE_NAME_INHERITED;
-                return;
-            }
-        }
-    }
-
-    NT_ASSERT(proc->ps_name == NULL);
-
-    const HANDLE processHandle = OpenProcessById(proc->process_id);
-    if (processHandle != NULL) {
-        fort_pstree_check_proc_conf(ps_tree, conf_ref, proc, processHandle);
-
-        ZwClose(processHandle);
-    }
-}
-
-FORT_API BOOL fort_pstree_get_proc_name(PFORT_PSTREE ps_tree, PFORT_CONF_REF conf_ref,
-        DWORD processId, PUNICODE_STRING path, BOOL *inherited)
+FORT_API BOOL fort_pstree_get_proc_name(PFORT_PSTREE ps_tree, DWORD processId,
+        PUNICODE_STRING path, BOOL *inherited, PFORT_PSVERDICT verdict)
 {
     BOOL res = FALSE;
 
-    KLOCK_QUEUE_HANDLE lock_queue;
-    KeAcquireInStackQueuedSpinLock(&ps_tree->lock, &lock_queue);
+    KIRQL oldIrql = ExAcquireSpinLockShared(&ps_tree->lock);
     {
         PFORT_PSNODE proc = fort_pstree_find_proc(ps_tree, processId);
         if (proc != NULL) {
-            fort_pstree_check_proc_parent(ps_tree, conf_ref, proc);
+            *verdict = proc->verdict;
 
             PFORT_PSNAME ps_name = proc->ps_name;
             if (ps_name != NULL) {
+                /* The name may be freed by the tree's update, so keep it for the caller */
+                fort_pstree_name_add_ref(ps_name);
+
                 path->Length = ps_name->size;
                 path->MaximumLength = ps_name->size;
                 path->Buffer = ps_name->data;
@@ -750,7 +848,34 @@ FORT_API BOOL fort_pstree_get_proc_name(PFORT_PSTREE ps_tree, PFORT_CONF_REF con
             }
         }
     }
-    KeReleaseInStackQueuedSpinLock(&lock_queue);
+    ExReleaseSpinLockShared(&ps_tree->lock, oldIrql);
 
     return res;
 }
+
+/* Release the name of fort_pstree_get_proc_name() */
+FORT_API void fort_pstree_put_proc_name(PFORT_PSTREE ps_tree, PCUNICODE_STRING path)
+{
+    PFORT_PSNAME ps_name = (PFORT_PSNAME) ((PCHAR) path->Buffer - FORT_PSNAME_DATA_OFF);
+
+    /* The tree doesn't refer to the name, when the caller's ref is the last one */
+    if (InterlockedDecrement16(&ps_name->refcount) != 0)
+        return;
+
+    KIRQL oldIrql = ExAcquireSpinLockExclusive(&ps_tree->lock);
+    fort_pool_free(&ps_tree->pool_list, ps_name);
+    ExReleaseSpinLockExclusive(&ps_tree->lock, oldIrql);
+}
+
+FORT_API void fort_pstree_set_proc_verdict(
+        PFORT_PSTREE ps_tree, DWORD processId, const PFORT_PSVERDICT verdict)
+{
+    KIRQL oldIrql = ExAcquireSpinLockExclusive(&ps_tree->lock);
+    {
+        PFORT_PSNODE proc = fort_pstree_find_proc(ps_tree, processId);
+        if (proc != NULL && proc->verdict.proc_seq == verdict->proc_seq) {
+            proc->verdict = *verdict;
+        }
+    }
+    ExReleaseSpinLockExclusive(&ps_tree->lock, oldIrql);
+}
@@ -7,11 +7,25 @@
 #include "fortpool.h"
 #include "forttds.h"
 
+/* App's verdict of the process, valid while the conf generation is the same */
+typedef struct fort_psverdict
+{
+    UINT32 proc_seq; /* of the process node, 0 if the process is unknown */
+    UINT32 conf_gen; /* 0 if the verdict is not set */
+
+    FORT_APP_FLAGS app_flags;
+    INT8 block_reason;
+    UCHAR blocked;
+} FORT_PSVERDICT, *PFORT_PSVERDICT;
+
 typedef struct fort_pstree
 {
     UINT8 active : 1;
 
     UINT16 procs_n;
+    UINT16 conf_chn; /* changed on every conf update */
+
+    UINT32 proc_seq; /* of the last created process node */
 
     FORT_POOL_LIST pool_list;
     tommy_list free_procs;
@@ -19,7 +33,7 @@ typedef struct fort_pstree
     tommy_arrayof procs;
     tommy_hashdyn procs_map;
 
-    KSPIN_LOCK lock;
+    EX_SPIN_LOCK lock; /* shared by the classify */
 } FORT_PSTREE, *PFORT_PSTREE;
 
 #if defined(__cplusplus)
@@ -32,8 +46,15 @@ FORT_API void fort_pstree_close(PFORT_PSTREE ps_tree);
 
 FORT_API void NTAPI fort_pstree_enum_processes(void);
 
-FORT_API BOOL fort_pstree_get_proc_name(PFORT_PSTREE ps_tree, PFORT_CONF_REF conf_ref,
-        DWORD processId, PUNICODE_STRING path, BOOL *inherited);
+FORT_API void fort_pstree_conf_update(PFORT_PSTREE ps_tree, PFORT_DEVICE_CONF device_conf);
+
+FORT_API BOOL fort_pstree_get_proc_name(PFORT_PSTREE ps_tree, DWORD processId,
+        PUNICODE_STRING path, BOOL *inherited, PFORT_PSVERDICT verdict);
+
+FORT_API void fort_pstree_put_proc_name(PFORT_PSTREE ps_tree, PCUNICODE_STRING path);
+
+FORT_API void fort_pstree_set_proc_verdict(
+        PFORT_PSTREE ps_tree, DWORD processId, const PFORT_PSVERDICT verdict);
 
 #ifdef __cplusplus
 } // extern "C"
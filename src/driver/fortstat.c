@@ -10,7 +10,6 @@
 #define FORT_PROC_COUNT_MAX 0x7FFF
 
 #define fort_stat_proc_hash(process_id) tommy_inthash_u32((UINT32) (process_id))
-#define fort_flow_hash(flow_id)         tommy_inthash_u32((UINT32) (flow_id))
 
 #define fort_stat_group_fragment(stat, group_index)                                                \
     ((((stat)->conf_group.fragment_bits >> (group_index)) & 1) != 0 ? FORT_FLOW_FRAGMENT : 0)
@@ -18,6 +17,8 @@
 #define fort_stat_group_speed_limit(stat, group_index)                                             \
     (((stat)->conf_group.limit_bits >> (group_index)) & 1)
 
+#define fort_stat_bucket_rate(limit_bytes) ((INT64) (limit_bytes) * 2) /* bytes per second */
+
 static void fort_stat_proc_active_add(PFORT_STAT stat, PFORT_STAT_PROC proc)
 {
     if (proc->active)
@@ -71,6 +72,9 @@ static void fort_stat_proc_free(PFORT_STAT stat, PFORT_STAT_PROC proc)
 {
     tommy_hashdyn_remove_existing(&stat->procs_map, (tommy_hashdyn_node *) proc);
 
+    /* Drop the not merged per-CPU traffic */
+    ++proc->gen;
+
     /* Add to free chain */
     proc->next = stat->proc_free;
     stat->proc_free = proc;
@@ -106,6 +110,8 @@ static PFORT_STAT_PROC fort_stat_proc_add(PFORT_STAT stat, UINT32 process_id)
     proc->process_id = process_id;
     proc->traf.v = 0;
 
+    ++proc->gen;
+
     return proc;
 }
 
@@ -119,19 +125,40 @@ FORT_API UCHAR fort_flow_flags(PFORT_FLOW flow)
     return fort_flow_flags_set(flow, 0, TRUE);
 }
 
-static void fort_flow_context_set(PFORT_STAT stat, PFORT_FLOW flow, BOOL is_tcp)
+static void fort_flow_context_transport_set(PFORT_STAT stat, PFORT_FLOW flow)
+{
+    const UINT64 flow_id = flow->flow_id;
+    const UINT64 flowContext = (UINT64) flow;
+
+    FwpsFlowAssociateContext0(
+            flow_id, FWPS_LAYER_INBOUND_TRANSPORT_V4, stat->in_transport4_id, flowContext);
+    FwpsFlowAssociateContext0(
+            flow_id, FWPS_LAYER_OUTBOUND_TRANSPORT_V4, stat->out_transport4_id, flowContext);
+}
+
+static NTSTATUS fort_flow_context_set(PFORT_STAT stat, PFORT_FLOW flow, UCHAR flags, BOOL is_tcp)
 {
     const UINT64 flow_id = flow->flow_id;
     const UINT64 flowContext = (UINT64) flow;
 
     if (is_tcp) {
-        FwpsFlowAssociateContext0(flow_id, FWPS_LAYER_STREAM_V4, stat->stream4_id, flowContext);
-        FwpsFlowAssociateContext0(
-                flow_id, FWPS_LAYER_INBOUND_TRANSPORT_V4, stat->in_transport4_id, flowContext);
-        FwpsFlowAssociateContext0(
-                flow_id, FWPS_LAYER_OUTBOUND_TRANSPORT_V4, stat->out_transport4_id, flowContext);
+        const NTSTATUS status = FwpsFlowAssociateContext0(
+                flow_id, FWPS_LAYER_STREAM_V4, stat->stream4_id, flowContext);
+
+        /* The flow must not be referenced by other layers, when it's not associated */
+        if (!NT_SUCCESS(status))
+            return status;
+
+        /* Transport layers are needed by the speed limit and the fragmentation only */
+        if (flags & FORT_FLOW_TRANSPORT) {
+            fort_flow_context_transport_set(stat, flow);
+        } else {
+            stat->flow_layers_avoided += 2;
+        }
+
+        return STATUS_SUCCESS;
     } else {
-        FwpsFlowAssociateContext0(
+        return FwpsFlowAssociateContext0(
                 flow_id, FWPS_LAYER_DATAGRAM_DATA_V4, stat->datagram4_id, flowContext);
     }
 }
@@ -146,22 +173,11 @@ static void fort_flow_context_remove(PFORT_STAT stat, PFORT_FLOW flow)
     FwpsFlowRemoveContext0(flow_id, FWPS_LAYER_OUTBOUND_TRANSPORT_V4, stat->out_transport4_id);
 }
 
-static void fort_flow_close(PFORT_FLOW flow)
+static void fort_flow_close(PFORT_STAT stat, PFORT_FLOW flow)
 {
-    flow->opt.proc_index = FORT_PROC_BAD_INDEX;
-}
+    UNUSED(stat);
 
-static PFORT_FLOW fort_flow_get(PFORT_STAT stat, UINT64 flow_id, tommy_key_t flow_hash)
-{
-    PFORT_FLOW flow = (PFORT_FLOW) tommy_hashdyn_bucket(&stat->flows_map, flow_hash);
-
-    while (flow != NULL) {
-        if (flow->flow_hash == flow_hash && flow->flow_id == flow_id)
-            return flow;
-
-        flow = flow->next;
-    }
-    return NULL;
+    flow->opt.proc_index = FORT_PROC_BAD_INDEX;
 }
 
 static void fort_flow_free(PFORT_STAT stat, PFORT_FLOW flow)
@@ -172,81 +188,120 @@ static void fort_flow_free(PFORT_STAT stat, PFORT_FLOW flow)
         fort_stat_proc_dec(stat, proc_index);
     }
 
-    tommy_hashdyn_remove_existing(&stat->flows_map, (tommy_hashdyn_node *) flow);
-
-    /* Add to free chain */
-    flow->next = stat->flow_free;
-    stat->flow_free = flow;
+    fort_flow_table_remove(&stat->flows, flow);
 }
 
-static PFORT_FLOW fort_flow_new(
-        PFORT_STAT stat, UINT64 flow_id, const tommy_key_t flow_hash, BOOL is_tcp)
+static NTSTATUS fort_flow_new(
+        PFORT_STAT stat, UINT64 flow_id, UCHAR flags, BOOL is_tcp, PFORT_FLOW *flow)
 {
-    PFORT_FLOW flow;
+    *flow = fort_flow_table_add(&stat->flows, flow_id);
+    if (*flow == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
 
-    if (stat->flow_free != NULL) {
-        flow = stat->flow_free;
-        stat->flow_free = flow->next;
-    } else {
-        const tommy_size_t size = tommy_arrayof_size(&stat->flows);
-
-        /* TODO: tommy_arrayof_grow(): check calloc()'s result for NULL */
-        if (tommy_arrayof_grow(&stat->flows, size + 1), 0)
-            return NULL;
+    const NTSTATUS status = fort_flow_context_set(stat, *flow, flags, is_tcp);
 
-        flow = tommy_arrayof_ref(&stat->flows, size);
+    if (!NT_SUCCESS(status)) {
+        /* The flow without context would never be deleted */
+        fort_flow_table_remove(&stat->flows, *flow);
     }
 
-    tommy_hashdyn_insert(&stat->flows_map, (tommy_hashdyn_node *) flow, 0, flow_hash);
-
-    flow->flow_id = flow_id;
-
-    fort_flow_context_set(stat, flow, is_tcp);
-
-    return flow;
+    return status;
 }
 
 static NTSTATUS fort_flow_add(PFORT_STAT stat, UINT64 flow_id, UCHAR group_index, UINT16 proc_index,
-        UCHAR fragment, UCHAR speed_limit, BOOL is_tcp, BOOL is_reauth)
+        UCHAR flags, UINT32 conf_gen, BOOL is_tcp, BOOL is_reauth)
 {
-    const tommy_key_t flow_hash = fort_flow_hash(flow_id);
-    PFORT_FLOW flow = fort_flow_get(stat, flow_id, flow_hash);
+    PFORT_FLOW flow = fort_flow_table_get(&stat->flows, flow_id);
     BOOL is_new_flow = FALSE;
 
     if (flow == NULL) {
-        if (is_reauth) {
-            /* Block existing flow after reauth. to be able to associate a flow-context */
-            return FORT_STATUS_FLOW_BLOCK;
-        }
+        /* Re-associate the existing flow after reauth. too */
+        const NTSTATUS status = fort_flow_new(stat, flow_id, flags, is_tcp, &flow);
 
-        flow = fort_flow_new(stat, flow_id, flow_hash, is_tcp);
-        if (flow == NULL)
-            return STATUS_INSUFFICIENT_RESOURCES;
+        if (!NT_SUCCESS(status)) {
+            if (is_reauth && status != STATUS_INSUFFICIENT_RESOURCES) {
+                /* Block the existing flow to associate a flow-context on reconnect */
+                return FORT_STATUS_FLOW_BLOCK;
+            }
+
+            return status;
+        }
 
         is_new_flow = TRUE;
     } else {
         is_new_flow = (flow->opt.proc_index == FORT_PROC_BAD_INDEX);
+
+        /* Attach the transport layers, when the flow needs them now */
+        if (is_tcp && (flags & FORT_FLOW_TRANSPORT) && !(flow->opt.flags & FORT_FLOW_TRANSPORT)) {
+            fort_flow_context_transport_set(stat, flow);
+        }
     }
 
     if (is_new_flow) {
         fort_stat_proc_inc(stat, proc_index);
+
+        if (is_reauth) {
+            ++stat->flow_reassoc_count;
+        }
     }
 
-    flow->opt.flags =
-            fragment | speed_limit | (is_new_flow ? 0 : (flow->opt.flags & FORT_FLOW_XFLAGS));
+    flow->opt.flags = flags | (is_new_flow ? 0 : (flow->opt.flags & FORT_FLOW_XFLAGS));
     flow->opt.group_index = group_index;
     flow->opt.proc_index = proc_index;
 
+    flow->conf_gen = conf_gen;
+
     return STATUS_SUCCESS;
 }
 
-FORT_API void fort_stat_open(PFORT_STAT stat)
+static void fort_stat_cpus_open(PFORT_STAT stat)
+{
+    const UINT32 cpu_count = KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS);
+    const SIZE_T size = cpu_count * sizeof(FORT_STAT_CPU);
+
+    stat->cpus = fort_mem_alloc(size, FORT_STAT_POOL_TAG);
+
+    if (stat->cpus != NULL) {
+        RtlZeroMemory(stat->cpus, size);
+
+        for (UINT32 i = 0; i < cpu_count; ++i) {
+            KeInitializeSpinLock(&stat->cpus[i].lock);
+        }
+
+        stat->cpu_count = cpu_count;
+    }
+}
+
+static void fort_stat_cpus_close(PFORT_STAT stat)
 {
+    if (stat->cpus != NULL) {
+        fort_mem_free(stat->cpus, FORT_STAT_POOL_TAG);
+
+        stat->cpus = NULL;
+        stat->cpu_count = 0;
+    }
+}
+
+FORT_API void fort_stat_open(PFORT_STAT stat, UINT32 flow_capacity, UINT32 burst_ms)
+{
+    LARGE_INTEGER perf_freq;
+    KeQueryPerformanceCounter(&perf_freq);
+
+    stat->perf_freq = perf_freq.QuadPart;
+
+    if (burst_ms < FORT_STAT_SHAPER_BURST_MIN) {
+        burst_ms = FORT_STAT_SHAPER_BURST_MIN;
+    } else if (burst_ms > FORT_STAT_SHAPER_BURST_MAX) {
+        burst_ms = FORT_STAT_SHAPER_BURST_MAX;
+    }
+    stat->burst_ms = burst_ms;
+
     tommy_arrayof_init(&stat->procs, sizeof(FORT_STAT_PROC));
     tommy_hashdyn_init(&stat->procs_map);
 
-    tommy_arrayof_init(&stat->flows, sizeof(FORT_FLOW));
-    tommy_hashdyn_init(&stat->flows_map);
+    fort_flow_table_open(&stat->flows, flow_capacity);
+
+    fort_stat_cpus_open(stat);
 
     KeInitializeSpinLock(&stat->lock);
 }
@@ -258,13 +313,15 @@ FORT_API void fort_stat_close(PFORT_STAT stat)
 
     stat->closed = TRUE;
 
-    tommy_hashdyn_foreach_node_arg(&stat->flows_map, fort_flow_context_remove, stat);
+    fort_flow_table_foreach(
+            &stat->flows, (FORT_FLOW_TABLE_FOREACH_FUNC) &fort_flow_context_remove, stat);
 
     tommy_arrayof_done(&stat->procs);
     tommy_hashdyn_done(&stat->procs_map);
 
-    tommy_arrayof_done(&stat->flows);
-    tommy_hashdyn_done(&stat->flows_map);
+    fort_flow_table_close(&stat->flows);
+
+    fort_stat_cpus_close(stat);
 
     KeReleaseInStackQueuedSpinLock(&lock_queue);
 }
@@ -274,9 +331,10 @@ static void fort_stat_clear(PFORT_STAT stat)
     fort_stat_proc_active_clear(stat);
 
     tommy_hashdyn_foreach_node_arg(&stat->procs_map, fort_stat_proc_free, stat);
-    tommy_hashdyn_foreach_node(&stat->flows_map, fort_flow_close);
+    fort_flow_table_foreach(&stat->flows, (FORT_FLOW_TABLE_FOREACH_FUNC) &fort_flow_close, stat);
 
-    RtlZeroMemory(stat->groups, sizeof(stat->groups));
+    RtlZeroMemory(stat->buckets, sizeof(stat->buckets));
+    stat->group_flush_bits = 0;
 }
 
 FORT_API void fort_stat_update(PFORT_STAT stat, BOOL log_stat)
@@ -299,12 +357,36 @@ FORT_API void fort_stat_conf_update(PFORT_STAT stat, PFORT_CONF_IO conf_io)
     KeAcquireInStackQueuedSpinLock(&stat->lock, &lock_queue);
     {
         stat->conf_group = conf_io->conf_group;
+
+        /* Fill the buckets on the next use */
+        RtlZeroMemory(stat->buckets, sizeof(stat->buckets));
     }
     KeReleaseInStackQueuedSpinLock(&lock_queue);
 }
 
-static NTSTATUS fort_flow_associate_proc(PFORT_STAT stat, UINT32 process_id, BOOL is_reauth,
-        BOOL *is_new_proc, PFORT_STAT_PROC *proc)
+FORT_API void fort_stat_driver_stats(PFORT_STAT stat, PFORT_DRIVER_STATS stats)
+{
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLock(&stat->lock, &lock_queue);
+    {
+        stats->values[FORT_DRIVER_STAT_FLOWS] = stat->flows.flow_count;
+        stats->values[FORT_DRIVER_STAT_FLOWS_FULL] = stat->flows.full_count;
+        stats->values[FORT_DRIVER_STAT_FLOW_REASSOC] = stat->flow_reassoc_count;
+        stats->values[FORT_DRIVER_STAT_FLOW_LAYERS_AVOIDED] = stat->flow_layers_avoided;
+    }
+    KeReleaseInStackQueuedSpinLock(&lock_queue);
+
+    /* The shaper's counters are incremented without the lock */
+    for (int i = 0; i < FORT_CONF_GROUP_MAX * 2; ++i) {
+        const PFORT_STAT_SHAPER_COUNT count = &stat->shaper_counts[i];
+
+        stats->values[FORT_DRIVER_STAT_SHAPER_DEFERS] += (ULONG) count->defer_count;
+        stats->values[FORT_DRIVER_STAT_SHAPER_DROPS] += (ULONG) count->drop_count;
+    }
+}
+
+static NTSTATUS fort_flow_associate_proc(
+        PFORT_STAT stat, UINT32 process_id, BOOL *is_new_proc, PFORT_STAT_PROC *proc)
 {
     if (!stat->log_stat)
         return STATUS_DEVICE_DATA_ERROR;
@@ -314,11 +396,6 @@ static NTSTATUS fort_flow_associate_proc(PFORT_STAT stat, UINT32 process_id, BOO
     *proc = fort_stat_proc_get(stat, process_id, proc_hash);
 
     if (*proc == NULL) {
-        if (is_reauth) {
-            /* Block existing flow after reauth. to be able to associate a flow-context */
-            return FORT_STATUS_FLOW_BLOCK;
-        }
-
         *proc = fort_stat_proc_add(stat, process_id);
 
         if (*proc == NULL)
@@ -331,7 +408,8 @@ static NTSTATUS fort_flow_associate_proc(PFORT_STAT stat, UINT32 process_id, BOO
 }
 
 FORT_API NTSTATUS fort_flow_associate(PFORT_STAT stat, UINT64 flow_id, UINT32 process_id,
-        UCHAR group_index, BOOL is_tcp, BOOL is_reauth, BOOL *is_new_proc)
+        UCHAR group_index, UINT32 conf_gen, BOOL is_continue, BOOL is_tcp, BOOL is_reauth,
+        BOOL *is_new_proc)
 {
     NTSTATUS status;
 
@@ -339,14 +417,15 @@ FORT_API NTSTATUS fort_flow_associate(PFORT_STAT stat, UINT64 flow_id, UINT32 pr
     KeAcquireInStackQueuedSpinLock(&stat->lock, &lock_queue);
 
     PFORT_STAT_PROC proc = NULL;
-    status = fort_flow_associate_proc(stat, process_id, is_reauth, is_new_proc, &proc);
+    status = fort_flow_associate_proc(stat, process_id, is_new_proc, &proc);
 
     /* Add flow */
     if (NT_SUCCESS(status)) {
         const UCHAR fragment = fort_stat_group_fragment(stat, group_index);
         const UCHAR speed_limit = fort_stat_group_speed_limit(stat, group_index);
+        const UCHAR flags = fragment | speed_limit | (is_continue ? FORT_FLOW_CONTINUE : 0);
 
-        status = fort_flow_add(stat, flow_id, group_index, proc->proc_index, fragment, speed_limit,
+        status = fort_flow_add(stat, flow_id, group_index, proc->proc_index, flags, conf_gen,
                 is_tcp, is_reauth);
 
         if (!NT_SUCCESS(status) && *is_new_proc) {
@@ -359,6 +438,48 @@ FORT_API NTSTATUS fort_flow_associate(PFORT_STAT stat, UINT64 flow_id, UINT32 pr
     return status;
 }
 
+FORT_API BOOL fort_flow_auth(
+        PFORT_STAT stat, UINT64 flow_id, PFORT_FLOW_OPT opt, UINT32 *conf_gen)
+{
+    BOOL res = FALSE;
+
+    if (stat->closed)
+        return FALSE;
+
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLock(&stat->lock, &lock_queue);
+    if (!stat->closed) {
+        const PFORT_FLOW flow = fort_flow_table_get(&stat->flows, flow_id);
+
+        if (flow != NULL && flow->opt.proc_index != FORT_PROC_BAD_INDEX) {
+            *opt = flow->opt;
+            *conf_gen = flow->conf_gen;
+
+            res = TRUE;
+        }
+    }
+    KeReleaseInStackQueuedSpinLock(&lock_queue);
+
+    return res;
+}
+
+FORT_API void fort_flow_auth_update(PFORT_STAT stat, UINT64 flow_id, UINT32 conf_gen)
+{
+    if (stat->closed)
+        return;
+
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLock(&stat->lock, &lock_queue);
+    if (!stat->closed) {
+        const PFORT_FLOW flow = fort_flow_table_get(&stat->flows, flow_id);
+
+        if (flow != NULL) {
+            flow->conf_gen = conf_gen;
+        }
+    }
+    KeReleaseInStackQueuedSpinLock(&lock_queue);
+}
+
 FORT_API void fort_flow_delete(PFORT_STAT stat, UINT64 flowContext)
 {
     PFORT_FLOW flow = (PFORT_FLOW) flowContext;
@@ -374,26 +495,106 @@ FORT_API void fort_flow_delete(PFORT_STAT stat, UINT64 flowContext)
     KeReleaseInStackQueuedSpinLock(&lock_queue);
 }
 
-static void fort_flow_speed_limit(PFORT_STAT stat, PFORT_FLOW flow, const FORT_FLOW_OPT opt,
-        UINT32 data_len, BOOL is_tcp, BOOL inbound)
+static INT64 fort_stat_perf_time(void)
 {
-    if (!is_tcp)
-        return; /* TODO: Shape UDP traffic */
+    return KeQueryPerformanceCounter(NULL).QuadPart;
+}
 
-    const UCHAR group_index = opt.group_index;
+/* Bytes of the bucket's depth, saturated to keep the tokens' additions from the overflow */
+static INT64 fort_stat_bucket_depth(INT64 rate, UINT32 burst_ms)
+{
+    const UINT64 depth_max = MAXLONGLONG / 2;
+
+    if (burst_ms != 0 && (UINT64) rate > depth_max / burst_ms)
+        return depth_max;
+
+    return (INT64) ((UINT64) rate * burst_ms / 1000);
+}
+
+static void fort_stat_bucket_refill(
+        PFORT_STAT stat, PFORT_STAT_BUCKET bucket, UINT32 limit_bytes, INT64 now)
+{
+    const INT64 rate = fort_stat_bucket_rate(limit_bytes);
+    const INT64 burst = fort_stat_bucket_depth(rate, stat->burst_ms);
+
+    if (bucket->time == 0) {
+        bucket->tokens = burst;
+        bucket->time = now;
+        return;
+    }
+
+    INT64 elapsed = now - bucket->time;
+
+    /* Avoid the overflow, a debt is paid off in a few seconds */
+    const INT64 elapsed_max = stat->perf_freq * 16;
+    if (elapsed > elapsed_max) {
+        elapsed = elapsed_max;
+    }
+
+    const INT64 add = elapsed * rate / stat->perf_freq;
+
+    /* Keep the time of the fractional byte */
+    if (add <= 0)
+        return;
+
+    bucket->tokens += add;
+    if (bucket->tokens > burst) {
+        bucket->tokens = burst;
+    }
+
+    bucket->time = now;
+}
 
-    PFORT_STAT_GROUP group = &stat->groups[group_index];
-    UINT32 *group_bytes = inbound ? &group->traf.in_bytes : &group->traf.out_bytes;
+/* Datagrams are queued while the group is in debt, to keep their order */
+static UCHAR fort_stat_bucket_datagram(PFORT_STAT stat, PFORT_STAT_BUCKET bucket, UINT32 list_bit,
+        UINT32 limit_bytes, UINT32 data_len)
+{
+    if (limit_bytes == 0)
+        return FORT_STAT_SHAPE_PASS;
+
+    const BOOL in_debt = (bucket->tokens < 0 || (stat->group_flush_bits & list_bit) != 0);
+
+    if (in_debt) {
+        const INT64 delay_max =
+                fort_stat_bucket_rate(limit_bytes) * FORT_STAT_SHAPER_DELAY_MAX / 1000;
+
+        /* Drop the datagram, which would wait longer than the queue delay budget */
+        if (data_len - bucket->tokens > delay_max)
+            return FORT_STAT_SHAPE_DROP;
+    }
+
+    bucket->tokens -= data_len;
+
+    if (bucket->tokens < 0) {
+        stat->group_flush_bits |= list_bit;
+    }
+
+    return in_debt ? FORT_STAT_SHAPE_DEFER : FORT_STAT_SHAPE_PASS;
+}
+
+static UCHAR fort_flow_speed_limit(PFORT_STAT stat, PFORT_FLOW flow, const FORT_FLOW_OPT opt,
+        UINT32 data_len, BOOL is_tcp, BOOL inbound)
+{
+    const UCHAR group_index = opt.group_index;
 
     const PFORT_TRAF group_limit = &stat->conf_group.limits[group_index];
     const UINT32 limit_bytes = inbound ? group_limit->in_bytes : group_limit->out_bytes;
 
     const UINT16 list_index = group_index * 2 + (inbound ? 0 : 1);
+    const UINT32 list_bit = (1 << list_index);
 
-    /* Add traffic to app. group */
-    *group_bytes += data_len;
+    PFORT_STAT_BUCKET bucket = &stat->buckets[list_index];
 
-    const BOOL defer_flow = (*group_bytes >= limit_bytes);
+    /* Take the traffic's tokens from app. group */
+    fort_stat_bucket_refill(stat, bucket, limit_bytes, fort_stat_perf_time());
+
+    if (!is_tcp) {
+        return fort_stat_bucket_datagram(stat, bucket, list_bit, limit_bytes, data_len);
+    }
+
+    bucket->tokens -= data_len;
+
+    const BOOL defer_flow = (limit_bytes != 0 && bucket->tokens < 0);
 
     /* Defer ACK */
     {
@@ -402,13 +603,17 @@ static void fort_flow_speed_limit(PFORT_STAT stat, PFORT_FLOW flow, const FORT_F
         fort_flow_flags_set(flow, defer_flag, defer_flow);
     }
 
-    stat->group_flush_bits |= (1 << list_index);
+    if (defer_flow) {
+        stat->group_flush_bits |= list_bit;
+    }
+
+    return FORT_STAT_SHAPE_PASS;
 }
 
-FORT_API void fort_flow_classify(
-        PFORT_STAT stat, UINT64 flowContext, UINT32 data_len, BOOL is_tcp, BOOL inbound)
+static UCHAR fort_flow_classify_locked(
+        PFORT_STAT stat, PFORT_FLOW flow, UINT32 data_len, BOOL is_tcp, BOOL inbound)
 {
-    PFORT_FLOW flow = (PFORT_FLOW) flowContext;
+    UCHAR shape = FORT_STAT_SHAPE_PASS;
 
     KLOCK_QUEUE_HANDLE lock_queue;
     KeAcquireInStackQueuedSpinLock(&stat->lock, &lock_queue);
@@ -417,29 +622,156 @@ FORT_API void fort_flow_classify(
         const FORT_FLOW_OPT opt = flow->opt;
 
         if (opt.proc_index != FORT_PROC_BAD_INDEX) {
-            PFORT_STAT_PROC proc = tommy_arrayof_ref(&stat->procs, opt.proc_index);
-            UINT32 *proc_bytes = inbound ? &proc->traf.in_bytes : &proc->traf.out_bytes;
-
-            /* Add traffic to process */
-            *proc_bytes += data_len;
-
             const UCHAR flow_speed_limit =
                     inbound ? FORT_FLOW_SPEED_LIMIT_IN : FORT_FLOW_SPEED_LIMIT_OUT;
 
             if ((fort_flow_flags(flow) & flow_speed_limit) != 0) {
-                fort_flow_speed_limit(stat, flow, opt, data_len, is_tcp, inbound);
+                shape = fort_flow_speed_limit(stat, flow, opt, data_len, is_tcp, inbound);
             }
 
-            fort_stat_proc_active_add(stat, proc);
+            /* Add traffic to process, unless dropped */
+            if (shape != FORT_STAT_SHAPE_DROP) {
+                PFORT_STAT_PROC proc = tommy_arrayof_ref(&stat->procs, opt.proc_index);
+                UINT32 *proc_bytes = inbound ? &proc->traf.in_bytes : &proc->traf.out_bytes;
+
+                *proc_bytes += data_len;
+
+                fort_stat_proc_active_add(stat, proc);
+            }
         }
     }
 
     KeReleaseInStackQueuedSpinLock(&lock_queue);
+
+    return shape;
+}
+
+static PFORT_STAT_CPU_PROC fort_stat_cpu_proc_get(
+        PFORT_STAT_CPU cpu, UINT16 proc_index, UINT16 proc_gen)
+{
+    const UINT16 proc_id = proc_index + 1;
+    UINT16 i = proc_index;
+
+    for (int n = 0; n < FORT_STAT_CPU_PROC_COUNT; ++n, ++i) {
+        PFORT_STAT_CPU_PROC cpu_proc = &cpu->procs[i & (FORT_STAT_CPU_PROC_COUNT - 1)];
+
+        if (cpu_proc->proc_id == 0) {
+            cpu_proc->proc_id = proc_id;
+            cpu_proc->proc_gen = proc_gen;
+            return cpu_proc;
+        }
+
+        if (cpu_proc->proc_id == proc_id && cpu_proc->proc_gen == proc_gen)
+            return cpu_proc;
+    }
+
+    return NULL;
+}
+
+/* Add traffic to the current CPU's shard, returns FALSE when the shard is full */
+static BOOL fort_flow_classify_cpu(
+        PFORT_STAT stat, UINT16 proc_index, UINT32 data_len, BOOL inbound)
+{
+    if (stat->cpus == NULL)
+        return FALSE;
+
+    const PFORT_STAT_PROC proc = tommy_arrayof_ref(&stat->procs, proc_index);
+    const UINT16 proc_gen = proc->gen;
+
+    if ((proc_gen & 1) == 0)
+        return TRUE; /* the process is freed */
+
+    const UINT32 cpu_index = KeGetCurrentProcessorNumberEx(NULL);
+    PFORT_STAT_CPU cpu = &stat->cpus[(cpu_index < stat->cpu_count) ? cpu_index : 0];
+    BOOL res = FALSE;
+
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLock(&cpu->lock, &lock_queue);
+    {
+        PFORT_STAT_CPU_PROC cpu_proc = fort_stat_cpu_proc_get(cpu, proc_index, proc_gen);
+
+        if (cpu_proc != NULL) {
+            UINT32 *proc_bytes = inbound ? &cpu_proc->traf.in_bytes : &cpu_proc->traf.out_bytes;
+
+            /* Add traffic to process */
+            *proc_bytes += data_len;
+
+            res = TRUE;
+        }
+    }
+    KeReleaseInStackQueuedSpinLock(&lock_queue);
+
+    return res;
+}
+
+FORT_API UCHAR fort_flow_classify(
+        PFORT_STAT stat, UINT64 flowContext, UINT32 data_len, BOOL is_tcp, BOOL inbound)
+{
+    PFORT_FLOW flow = (PFORT_FLOW) flowContext;
+
+    if (!stat->log_stat)
+        return FORT_STAT_SHAPE_PASS;
+
+    const FORT_FLOW_OPT opt = flow->opt;
+
+    if (opt.proc_index == FORT_PROC_BAD_INDEX)
+        return FORT_STAT_SHAPE_PASS;
+
+    const UCHAR flow_speed_limit = inbound ? FORT_FLOW_SPEED_LIMIT_IN : FORT_FLOW_SPEED_LIMIT_OUT;
+
+    /* Speed limited flows share the group's budget, so they are counted under the lock */
+    if ((opt.flags & flow_speed_limit) == 0
+            && fort_flow_classify_cpu(stat, opt.proc_index, data_len, inbound))
+        return FORT_STAT_SHAPE_PASS;
+
+    return fort_flow_classify_locked(stat, flow, data_len, is_tcp, inbound);
+}
+
+FORT_API void fort_stat_shaper_count(
+        PFORT_STAT stat, UCHAR group_index, BOOL inbound, BOOL dropped)
+{
+    const UINT16 list_index = group_index * 2 + (inbound ? 0 : 1);
+
+    PFORT_STAT_SHAPER_COUNT count = &stat->shaper_counts[list_index];
+
+    InterlockedIncrement(dropped ? &count->drop_count : &count->defer_count);
+}
+
+static void fort_stat_dpc_cpu_merge(PFORT_STAT stat, PFORT_STAT_CPU cpu)
+{
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLockAtDpcLevel(&cpu->lock, &lock_queue);
+
+    for (int i = 0; i < FORT_STAT_CPU_PROC_COUNT; ++i) {
+        PFORT_STAT_CPU_PROC cpu_proc = &cpu->procs[i];
+
+        if (cpu_proc->proc_id == 0)
+            continue;
+
+        PFORT_STAT_PROC proc = tommy_arrayof_ref(&stat->procs, cpu_proc->proc_id - 1);
+
+        if (proc->gen == cpu_proc->proc_gen) {
+            proc->traf.in_bytes += cpu_proc->traf.in_bytes;
+            proc->traf.out_bytes += cpu_proc->traf.out_bytes;
+
+            fort_stat_proc_active_add(stat, proc);
+        }
+
+        cpu_proc->proc_id = 0;
+        cpu_proc->traf.v = 0;
+    }
+
+    KeReleaseInStackQueuedSpinLockFromDpcLevel(&lock_queue);
 }
 
 FORT_API void fort_stat_dpc_begin(PFORT_STAT stat, PKLOCK_QUEUE_HANDLE lock_queue)
 {
     KeAcquireInStackQueuedSpinLockAtDpcLevel(&stat->lock, lock_queue);
+
+    /* Merge the per-CPU traffic */
+    for (UINT32 i = 0; i < stat->cpu_count; ++i) {
+        fort_stat_dpc_cpu_merge(stat, &stat->cpus[i]);
+    }
 }
 
 FORT_API void fort_stat_dpc_end(PKLOCK_QUEUE_HANDLE lock_queue)
@@ -484,62 +816,47 @@ FORT_API void fort_stat_dpc_traf_flush(PFORT_STAT stat, UINT16 proc_count, PCHAR
     stat->proc_active = proc;
 }
 
-static void fort_stat_group_flush_limit_bytes(UINT32 *defer_flush_bits, UINT32 *flush_bit,
-        UINT32 *traf_bytes, UINT32 limit_bytes, int group_index, int flush_index, int defer_offset)
+static UINT32 fort_stat_group_flush(PFORT_STAT stat, UINT32 queued_bits)
 {
-    if ((*flush_bit & flush_index) == 0) {
-        *traf_bytes = 0;
-        return;
-    }
-
-    if (limit_bytes == 0 || *traf_bytes <= limit_bytes) {
-        *traf_bytes = 0;
-    } else {
-        *traf_bytes -= limit_bytes;
-    }
-
-    if (*traf_bytes < limit_bytes) {
-        /* Flush counterpart ACK-s (i.e. flush outbound ACK-s for inbound and vice versa) */
-        *defer_flush_bits |= (1 << (group_index * 2 + defer_offset));
-    } else {
-        *flush_bit ^= flush_index;
-    }
-}
+    const INT64 now = fort_stat_perf_time();
 
-FORT_API UINT32 fort_stat_dpc_group_flush(PFORT_STAT stat)
-{
-    UINT32 defer_flush_bits = 0;
+    UINT32 debt_bits = 0;
     UINT32 flush_bits = stat->group_flush_bits;
 
-    /* Handle process group's bytes */
-    for (int i = 0; flush_bits != 0; ++i) {
-        PFORT_STAT_GROUP group;
-        PFORT_TRAF group_limit;
-        FORT_TRAF traf;
-        UINT32 flush_bit = (flush_bits & 3);
-
-        flush_bits >>= 2;
-        if (flush_bit == 0)
+    /* Refill the buckets in debt */
+    for (int i = 0; flush_bits != 0; ++i, flush_bits >>= 1) {
+        if ((flush_bits & 1) == 0)
             continue;
 
-        group = &stat->groups[i];
-        group_limit = &stat->conf_group.limits[i];
+        const PFORT_TRAF group_limit = &stat->conf_group.limits[i / 2];
+        const UINT32 limit_bytes = (i & 1) == 0 ? group_limit->in_bytes : group_limit->out_bytes;
 
-        traf = group->traf;
+        PFORT_STAT_BUCKET bucket = &stat->buckets[i];
 
-        // Inbound
-        fort_stat_group_flush_limit_bytes(
-                &defer_flush_bits, &flush_bit, &traf.in_bytes, group_limit->in_bytes, i, 1, 1);
+        fort_stat_bucket_refill(stat, bucket, limit_bytes, now);
 
-        // Outbound
-        fort_stat_group_flush_limit_bytes(
-                &defer_flush_bits, &flush_bit, &traf.out_bytes, group_limit->out_bytes, i, 2, 0);
+        if (limit_bytes != 0 && bucket->tokens < 0) {
+            debt_bits |= (1 << i);
+        }
+    }
+
+    /* Keep the groups with queued datagrams in debt, so the new datagrams go behind them */
+    stat->group_flush_bits = debt_bits | (stat->group_flush_bits & queued_bits);
 
-        // Adjust flushed bytes
-        group->traf = traf;
+    return debt_bits;
+}
 
-        stat->group_flush_bits &= ~(flush_bit << (i * 2));
+/* Returns the bits of buckets, which are still in debt */
+FORT_API UINT32 fort_stat_dpc_shaper_flush(PFORT_STAT stat, UINT32 queued_bits)
+{
+    UINT32 debt_bits;
+
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLockAtDpcLevel(&stat->lock, &lock_queue);
+    {
+        debt_bits = fort_stat_group_flush(stat, queued_bits);
     }
+    KeReleaseInStackQueuedSpinLockFromDpcLevel(&lock_queue);
 
-    return defer_flush_bits;
+    return debt_bits;
 }
@@ -4,14 +4,35 @@
 #include "fortdrv.h"
 
 #include "common/fortconf.h"
+#include "fortflow.h"
 #include "forttds.h"
 
 #define FORT_STATUS_FLOW_BLOCK STATUS_NOT_SAME_DEVICE
 
-typedef struct fort_stat_group
+#define FORT_STAT_SHAPER_PERIOD        10 /* milliseconds */
+#define FORT_STAT_SHAPER_BURST_DEFAULT 100 /* milliseconds of the group's speed limit */
+#define FORT_STAT_SHAPER_BURST_MIN     FORT_STAT_SHAPER_PERIOD /* to pass between the refills */
+#define FORT_STAT_SHAPER_BURST_MAX     10000 /* milliseconds, the ShaperBurst is clamped */
+#define FORT_STAT_SHAPER_DELAY_MAX     200 /* milliseconds of a datagram in the queue */
+
+/* Verdicts of the speed limit for datagrams */
+#define FORT_STAT_SHAPE_PASS  0
+#define FORT_STAT_SHAPE_DEFER 1
+#define FORT_STAT_SHAPE_DROP  2
+
+/* Token bucket of app. group's speed limit */
+typedef struct fort_stat_bucket
 {
-    FORT_TRAF traf;
-} FORT_STAT_GROUP, *PFORT_STAT_GROUP;
+    INT64 tokens; /* bytes, negative while the group is in debt */
+    INT64 time; /* of the last refill in performance counter ticks, 0 to fill */
+} FORT_STAT_BUCKET, *PFORT_STAT_BUCKET;
+
+/* Shaped datagrams of app. group */
+typedef struct fort_stat_shaper_count
+{
+    LONG volatile defer_count;
+    LONG volatile drop_count; /* on queue delay budget and queue overflow */
+} FORT_STAT_SHAPER_COUNT, *PFORT_STAT_SHAPER_COUNT;
 
 /* Synchronize with tommy_hashdyn_node! */
 typedef struct fort_stat_proc
@@ -41,49 +62,30 @@ typedef struct fort_stat_proc
     FORT_TRAF traf;
 #endif
 
+    UINT16 gen; /* odd while the process is in use */
+
     struct fort_stat_proc *next_active;
 } FORT_STAT_PROC, *PFORT_STAT_PROC;
 
-#define FORT_FLOW_SPEED_LIMIT_IN  0x01
-#define FORT_FLOW_SPEED_LIMIT_OUT 0x02
-#define FORT_FLOW_SPEED_LIMIT     (FORT_FLOW_SPEED_LIMIT_IN | FORT_FLOW_SPEED_LIMIT_OUT)
-#define FORT_FLOW_DEFER_IN        0x04
-#define FORT_FLOW_DEFER_OUT       0x08
-#define FORT_FLOW_FRAGMENT        0x10
-#define FORT_FLOW_FRAGMENT_DEFER  0x20
-#define FORT_FLOW_FRAGMENTED      0x40
-#define FORT_FLOW_XFLAGS          (FORT_FLOW_FRAGMENT_DEFER | FORT_FLOW_FRAGMENTED)
-
-typedef struct fort_flow_opt
-{
-    UCHAR volatile flags;
-    UCHAR group_index;
-    UINT16 proc_index;
-} FORT_FLOW_OPT, *PFORT_FLOW_OPT;
+#define FORT_STAT_CPU_PROC_COUNT 64 /* Must be power of 2 */
 
-/* Synchronize with tommy_hashdyn_node! */
-typedef struct fort_flow
+typedef struct fort_stat_cpu_proc
 {
-    struct fort_flow *next;
-    struct fort_flow *prev;
+    UINT16 proc_id; /* proc_index + 1, 0 for the empty entry */
+    UINT16 proc_gen;
 
-    union {
-#if defined(_WIN64)
-        UINT64 flow_id;
-#else
-        FORT_FLOW_OPT opt;
-#endif
-        void *data; /* tommy_hashdyn_node::data */
-    };
+    FORT_TRAF traf;
+} FORT_STAT_CPU_PROC, *PFORT_STAT_CPU_PROC;
 
-    tommy_key_t flow_hash; /* tommy_hashdyn_node::index */
+/* Per-CPU traffic of processes, merged into FORT_STAT_PROC by the timer */
+typedef struct fort_stat_cpu
+{
+    KSPIN_LOCK lock;
 
-#if defined(_WIN64)
-    FORT_FLOW_OPT opt;
-#else
-    UINT64 flow_id;
-#endif
-} FORT_FLOW, *PFORT_FLOW;
+    FORT_STAT_CPU_PROC procs[FORT_STAT_CPU_PROC_COUNT];
+
+    UCHAR reserved[48]; /* keep the per-CPU shards on separate cache lines */
+} FORT_STAT_CPU, *PFORT_STAT_CPU;
 
 typedef struct fort_stat
 {
@@ -93,7 +95,10 @@ typedef struct fort_stat
 
     UINT16 proc_active_count;
 
-    UINT32 group_flush_bits;
+    UINT32 group_flush_bits; /* buckets in debt */
+
+    UINT32 flow_reassoc_count; /* existing flows, associated on reauth. */
+    UINT32 flow_layers_avoided; /* flow-context associations, not needed by the flows */
 
     UINT32 stream4_id;
     UINT32 datagram4_id;
@@ -103,20 +108,24 @@ typedef struct fort_stat
     PFORT_STAT_PROC proc_free;
     PFORT_STAT_PROC proc_active;
 
-    PFORT_FLOW flow_free;
-
     tommy_arrayof procs;
     tommy_hashdyn procs_map;
 
-    tommy_arrayof flows;
-    tommy_hashdyn flows_map;
+    FORT_FLOW_TABLE flows;
 
     FORT_CONF_GROUP conf_group;
 
-    FORT_STAT_GROUP groups[FORT_CONF_GROUP_MAX];
+    FORT_STAT_BUCKET buckets[FORT_CONF_GROUP_MAX * 2]; /* in/out-bounds */
+    FORT_STAT_SHAPER_COUNT shaper_counts[FORT_CONF_GROUP_MAX * 2]; /* in/out-bounds */
+
+    INT64 perf_freq;
+    UINT32 burst_ms;
 
     LARGE_INTEGER system_time;
 
+    UINT32 cpu_count;
+    PFORT_STAT_CPU cpus;
+
     KSPIN_LOCK lock;
 } FORT_STAT, *PFORT_STAT;
 
@@ -128,7 +137,7 @@ FORT_API UCHAR fort_flow_flags_set(PFORT_FLOW flow, UCHAR flags, BOOL on);
 
 FORT_API UCHAR fort_flow_flags(PFORT_FLOW flow);
 
-FORT_API void fort_stat_open(PFORT_STAT stat);
+FORT_API void fort_stat_open(PFORT_STAT stat, UINT32 flow_capacity, UINT32 burst_ms);
 
 FORT_API void fort_stat_close(PFORT_STAT stat);
 
@@ -136,21 +145,32 @@ FORT_API void fort_stat_update(PFORT_STAT stat, BOOL log_stat);
 
 FORT_API void fort_stat_conf_update(PFORT_STAT stat, PFORT_CONF_IO conf_io);
 
+FORT_API void fort_stat_driver_stats(PFORT_STAT stat, PFORT_DRIVER_STATS stats);
+
 FORT_API NTSTATUS fort_flow_associate(PFORT_STAT stat, UINT64 flow_id, UINT32 process_id,
-        UCHAR group_index, BOOL is_tcp, BOOL is_reauth, BOOL *is_new_proc);
+        UCHAR group_index, UINT32 conf_gen, BOOL is_continue, BOOL is_tcp, BOOL is_reauth,
+        BOOL *is_new_proc);
+
+FORT_API BOOL fort_flow_auth(
+        PFORT_STAT stat, UINT64 flow_id, PFORT_FLOW_OPT opt, UINT32 *conf_gen);
+
+FORT_API void fort_flow_auth_update(PFORT_STAT stat, UINT64 flow_id, UINT32 conf_gen);
 
 FORT_API void fort_flow_delete(PFORT_STAT stat, UINT64 flowContext);
 
-FORT_API void fort_flow_classify(
+FORT_API UCHAR fort_flow_classify(
         PFORT_STAT stat, UINT64 flowContext, UINT32 data_len, BOOL is_tcp, BOOL inbound);
 
+FORT_API void fort_stat_shaper_count(
+        PFORT_STAT stat, UCHAR group_index, BOOL inbound, BOOL dropped);
+
 FORT_API void fort_stat_dpc_begin(PFORT_STAT stat, PKLOCK_QUEUE_HANDLE lock_queue);
 
 FORT_API void fort_stat_dpc_end(PKLOCK_QUEUE_HANDLE lock_queue);
 
 FORT_API void fort_stat_dpc_traf_flush(PFORT_STAT stat, UINT16 proc_count, PCHAR out);
 
-FORT_API UINT32 fort_stat_dpc_group_flush(PFORT_STAT stat);
+FORT_API UINT32 fort_stat_dpc_shaper_flush(PFORT_STAT stat, UINT32 queued_bits);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -0,0 +1,177 @@
+/* Fort Firewall Classify Trace */
+
+#include "forttrc.h"
+
+#include "forttds.h"
+
+#define FORT_TRACE_POOL_TAG 'CwfF'
+
+#define FORT_TRACE_RECORD_SIZE sizeof(FORT_TRACE_RECORD)
+
+FORT_API void fort_trace_open(PFORT_TRACE trace, UINT32 record_n)
+{
+    KeInitializeSpinLock(&trace->lock);
+
+    if (record_n == 0)
+        return;
+
+    if (record_n > FORT_TRACE_RECORDS_MAX) {
+        record_n = FORT_TRACE_RECORDS_MAX;
+    }
+
+    /* Don't wrap the size on 32-bit */
+    if (record_n > (SIZE_T) -1 / FORT_TRACE_RECORD_SIZE)
+        return;
+
+    trace->records =
+            fort_mem_alloc((SIZE_T) record_n * FORT_TRACE_RECORD_SIZE, FORT_TRACE_POOL_TAG);
+
+    if (trace->records != NULL) {
+        trace->record_n = record_n;
+
+        LARGE_INTEGER perf_freq;
+        KeQueryPerformanceCounter(&perf_freq);
+
+        trace->ticks_freq = perf_freq.QuadPart;
+    }
+}
+
+FORT_API void fort_trace_close(PFORT_TRACE trace)
+{
+    if (trace->records != NULL) {
+        fort_mem_free(trace->records, FORT_TRACE_POOL_TAG);
+
+        trace->records = NULL;
+        trace->record_n = 0;
+    }
+}
+
+static void fort_trace_put(PFORT_TRACE trace, const PVOID data, UINT32 size)
+{
+    UINT32 write_index = trace->read_index + trace->count;
+    if (write_index >= trace->record_n) {
+        write_index -= trace->record_n;
+    }
+
+    PFORT_TRACE_RECORD rec = &trace->records[write_index];
+
+    RtlCopyMemory(rec, data, size);
+
+    if (size < FORT_TRACE_RECORD_SIZE) {
+        RtlZeroMemory((PCHAR) rec + size, FORT_TRACE_RECORD_SIZE - size);
+    }
+
+    ++trace->count;
+}
+
+static void fort_trace_path_put(
+        PFORT_TRACE trace, UINT16 path_id, const PVOID path, UINT32 path_len)
+{
+    FORT_TRACE_RECORD rec;
+    RtlZeroMemory(&rec, FORT_TRACE_RECORD_SIZE);
+
+    rec.type = FORT_TRACE_PATH;
+    rec.path_id = path_id;
+    rec.path_len = path_len;
+
+    fort_trace_put(trace, &rec, FORT_TRACE_RECORD_SIZE);
+
+    for (UINT32 off = 0; off < path_len; off += FORT_TRACE_RECORD_SIZE) {
+        const UINT32 size = path_len - off;
+
+        fort_trace_put(trace, (PCHAR) path + off,
+                (size < FORT_TRACE_RECORD_SIZE) ? size : FORT_TRACE_RECORD_SIZE);
+    }
+}
+
+FORT_API void fort_trace_classify_write(
+        PFORT_TRACE trace, PFORT_TRACE_RECORD rec, const PVOID path, UINT32 path_len)
+{
+    const UINT64 path_hash = tommy_hash_u64(0, path, path_len) | 1; /* 0 is for undefined */
+    const UINT16 path_id = (UINT16) (path_hash >> 32) & (FORT_TRACE_PATH_SLOTS - 1);
+
+    const UINT32 path_data_n = (path_len + FORT_TRACE_RECORD_SIZE - 1) / FORT_TRACE_RECORD_SIZE;
+
+    rec->type = FORT_TRACE_CLASSIFY;
+    rec->path_id = path_id;
+
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLock(&trace->lock, &lock_queue);
+
+    const BOOL is_new_path = (trace->path_hashes[path_id] != path_hash);
+    const UINT32 rec_n = 1 + (is_new_path ? 1 + path_data_n : 0);
+
+    /* Drop the new records, so the pending ones keep their paths' definitions */
+    if (rec_n > trace->record_n - trace->count) {
+        ++trace->lost_n;
+    } else {
+        if (is_new_path) {
+            fort_trace_path_put(trace, path_id, path, path_len);
+
+            trace->path_hashes[path_id] = path_hash;
+        }
+
+        fort_trace_put(trace, rec, FORT_TRACE_RECORD_SIZE);
+    }
+
+    KeReleaseInStackQueuedSpinLock(&lock_queue);
+}
+
+static void fort_trace_restart(PFORT_TRACE trace)
+{
+    trace->read_index = 0;
+    trace->count = 0;
+    trace->lost_n = 0;
+
+    RtlZeroMemory(trace->path_hashes, sizeof(trace->path_hashes));
+}
+
+static UINT32 fort_trace_read(PFORT_TRACE trace, PFORT_TRACE_RECORD out, UINT32 out_n)
+{
+    const UINT32 n = (out_n < trace->count) ? out_n : trace->count;
+
+    /* Copy the records up to the ring's end, then from its start */
+    const UINT32 tail_n = trace->record_n - trace->read_index;
+    const UINT32 n1 = (n < tail_n) ? n : tail_n;
+
+    RtlCopyMemory(out, &trace->records[trace->read_index], n1 * FORT_TRACE_RECORD_SIZE);
+    RtlCopyMemory(out + n1, trace->records, (n - n1) * FORT_TRACE_RECORD_SIZE);
+
+    trace->read_index += n;
+    if (trace->read_index >= trace->record_n) {
+        trace->read_index -= trace->record_n;
+    }
+
+    trace->count -= n;
+
+    return n;
+}
+
+FORT_API UINT32 fort_trace_drain(PFORT_TRACE trace, PVOID out, ULONG out_len, UINT32 flags)
+{
+    PFORT_TRACE_HEADER header = out;
+    const UINT32 out_n = (out_len - sizeof(FORT_TRACE_HEADER)) / FORT_TRACE_RECORD_SIZE;
+
+    header->record_n = 0;
+    header->lost_n = 0;
+    header->ticks_freq = trace->ticks_freq;
+
+    if (!fort_trace_enabled(trace))
+        return sizeof(FORT_TRACE_HEADER);
+
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLock(&trace->lock, &lock_queue);
+
+    if ((flags & FORT_TRACE_RESTART)) {
+        fort_trace_restart(trace);
+    }
+
+    header->record_n = fort_trace_read(trace, (PFORT_TRACE_RECORD) (header + 1), out_n);
+    header->lost_n = trace->lost_n;
+
+    trace->lost_n = 0;
+
+    KeReleaseInStackQueuedSpinLock(&lock_queue);
+
+    return sizeof(FORT_TRACE_HEADER) + header->record_n * FORT_TRACE_RECORD_SIZE;
+}
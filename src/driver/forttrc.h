@@ -0,0 +1,48 @@
+#ifndef FORTTRC_H
+#define FORTTRC_H
+
+#include "fortdrv.h"
+
+#include "common/fortconf.h"
+
+#define FORT_TRACE_RECORDS_DEFAULT 0 /* records of the ring, 0 to disable the trace */
+#define FORT_TRACE_RECORDS_MAX     0x100000 /* 1M records, the TraceRecords is clamped */
+
+#define FORT_TRACE_PATH_SLOTS 256 /* Must be power of 2 */
+
+typedef struct fort_trace
+{
+    UINT32 record_n; /* capacity of the ring */
+    UINT32 read_index;
+    UINT32 count;
+    UINT32 lost_n;
+
+    INT64 ticks_freq;
+
+    PFORT_TRACE_RECORD records;
+
+    UINT64 path_hashes[FORT_TRACE_PATH_SLOTS]; /* hash of the path, defined by the slot's id */
+
+    KSPIN_LOCK lock;
+} FORT_TRACE, *PFORT_TRACE;
+
+#define fort_trace_enabled(trace) ((trace)->records != NULL)
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+FORT_API void fort_trace_open(PFORT_TRACE trace, UINT32 record_n);
+
+FORT_API void fort_trace_close(PFORT_TRACE trace);
+
+FORT_API void fort_trace_classify_write(
+        PFORT_TRACE trace, PFORT_TRACE_RECORD rec, const PVOID path, UINT32 path_len);
+
+FORT_API UINT32 fort_trace_drain(PFORT_TRACE trace, PVOID out, ULONG out_len, UINT32 flags);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // FORTTRC_H
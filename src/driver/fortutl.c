@@ -80,6 +80,38 @@ FORT_API NTSTATUS fort_driver_path(
     return status;
 }
 
+FORT_API DWORD fort_reg_dword(PUNICODE_STRING regPath, PCWSTR name, DWORD defaultValue)
+{
+    DWORD value = defaultValue;
+
+    HANDLE regKey;
+    OBJECT_ATTRIBUTES objectAttr;
+
+    InitializeObjectAttributes(
+            &objectAttr, regPath, OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE, NULL, NULL);
+
+    if (!NT_SUCCESS(ZwOpenKey(&regKey, KEY_QUERY_VALUE, &objectAttr)))
+        return value;
+
+    UNICODE_STRING valueName;
+    RtlInitUnicodeString(&valueName, name);
+
+    KEY_VALUE_FULL_INFORMATION keyInfo[FORT_KEY_INFO_PATH_SIZE];
+    ULONG keyInfoSize;
+
+    const NTSTATUS status = ZwQueryValueKey(
+            regKey, &valueName, KeyValueFullInformation, keyInfo, sizeof(keyInfo), &keyInfoSize);
+
+    if (NT_SUCCESS(status) && keyInfo->Type == REG_DWORD
+            && keyInfo->DataLength == sizeof(DWORD)) {
+        value = *(const DWORD *) ((const PUCHAR) keyInfo + keyInfo->DataOffset);
+    }
+
+    ZwClose(regKey);
+
+    return value;
+}
+
 static void fort_system_drive_init(PCUNICODE_STRING path)
 {
     UNICODE_STRING linkPath = {
@@ -0,0 +1,146 @@
+/* Fort Firewall Per-CPU Verdict Cache */
+
+#include "fortvch.h"
+
+#include "forttds.h"
+
+#define FORT_VERDICT_CACHE_POOL_TAG 'VwfF'
+
+static UINT32 fort_verdict_key_index(const PFORT_VERDICT_KEY key)
+{
+    const UINT32 port_proto = ((UINT32) key->remote_port << 16) | ((UINT32) key->ip_proto << 1)
+            | key->inbound;
+
+    const UINT32 hash = (UINT32) key->path_hash ^ (UINT32) (key->path_hash >> 32)
+            ^ tommy_inthash_u32(key->remote_ip) ^ port_proto;
+
+    return tommy_inthash_u32(hash) & (FORT_VERDICT_CACHE_SIZE - 1);
+}
+
+static BOOL fort_verdict_key_equal(const PFORT_VERDICT_KEY k1, const PFORT_VERDICT_KEY k2)
+{
+    return k1->path_hash == k2->path_hash && k1->path_len == k2->path_len
+            && k1->remote_ip == k2->remote_ip && k1->remote_port == k2->remote_port
+            && k1->ip_proto == k2->ip_proto && k1->inbound == k2->inbound;
+}
+
+static BOOL fort_verdict_path_cached(PCUNICODE_STRING path)
+{
+    return path->Length <= FORT_VERDICT_PATH_MAX * sizeof(WCHAR);
+}
+
+static BOOL fort_verdict_entry_equal(
+        const PFORT_VERDICT_ENTRY entry, const PFORT_VERDICT_KEY key, PCUNICODE_STRING path)
+{
+    return fort_verdict_key_equal(&entry->key, key)
+            && RtlCompareMemory(entry->path, path->Buffer, path->Length) == path->Length;
+}
+
+FORT_API void fort_verdict_key_init(PFORT_VERDICT_KEY key, PCUNICODE_STRING path)
+{
+    key->path_hash = tommy_hash_u64(0, path->Buffer, path->Length);
+    key->path_len = path->Length;
+}
+
+FORT_API void fort_verdict_cache_open(PFORT_VERDICT_CACHE cache)
+{
+    const UINT32 cpu_count = KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS);
+    const SIZE_T size = cpu_count * sizeof(FORT_VERDICT_CACHE_CPU);
+
+    cache->cpus = fort_mem_alloc(size, FORT_VERDICT_CACHE_POOL_TAG);
+
+    if (cache->cpus != NULL) {
+        RtlZeroMemory(cache->cpus, size);
+
+        cache->cpu_count = cpu_count;
+    }
+}
+
+FORT_API void fort_verdict_cache_close(PFORT_VERDICT_CACHE cache)
+{
+    if (cache->cpus != NULL) {
+        fort_mem_free(cache->cpus, FORT_VERDICT_CACHE_POOL_TAG);
+
+        cache->cpus = NULL;
+        cache->cpu_count = 0;
+    }
+}
+
+static PFORT_VERDICT_CACHE_CPU fort_verdict_cache_cpu(PFORT_VERDICT_CACHE cache)
+{
+    const UINT32 cpu_index = KeGetCurrentProcessorNumberEx(NULL);
+
+    return (cpu_index < cache->cpu_count) ? &cache->cpus[cpu_index] : NULL;
+}
+
+FORT_API BOOL fort_verdict_cache_lookup(PFORT_VERDICT_CACHE cache, const PFORT_VERDICT_KEY key,
+        PCUNICODE_STRING path, UINT32 conf_gen, PFORT_VERDICT verdict)
+{
+    BOOL res = FALSE;
+
+    if (cache->cpus == NULL || !fort_verdict_path_cached(path))
+        return FALSE;
+
+    /* Stay on the current CPU, so its slice is accessed without locks */
+    KIRQL oldIrql;
+    KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+    {
+        PFORT_VERDICT_CACHE_CPU cpu = fort_verdict_cache_cpu(cache);
+
+        if (cpu != NULL) {
+            const PFORT_VERDICT_ENTRY entry = &cpu->entries[fort_verdict_key_index(key)];
+
+            if (entry->conf_gen == conf_gen && fort_verdict_entry_equal(entry, key, path)) {
+                *verdict = entry->verdict;
+                res = TRUE;
+
+                ++cpu->hits;
+            } else {
+                ++cpu->misses;
+            }
+        }
+    }
+    KeLowerIrql(oldIrql);
+
+    return res;
+}
+
+FORT_API void fort_verdict_cache_add(PFORT_VERDICT_CACHE cache, const PFORT_VERDICT_KEY key,
+        PCUNICODE_STRING path, UINT32 conf_gen, const PFORT_VERDICT verdict)
+{
+    if (cache->cpus == NULL || !fort_verdict_path_cached(path))
+        return;
+
+    KIRQL oldIrql;
+    KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+    {
+        PFORT_VERDICT_CACHE_CPU cpu = fort_verdict_cache_cpu(cache);
+
+        if (cpu != NULL) {
+            PFORT_VERDICT_ENTRY entry = &cpu->entries[fort_verdict_key_index(key)];
+
+            entry->key = *key;
+            entry->conf_gen = conf_gen;
+            entry->verdict = *verdict;
+
+            RtlCopyMemory(entry->path, path->Buffer, path->Length);
+        }
+    }
+    KeLowerIrql(oldIrql);
+}
+
+FORT_API void fort_verdict_cache_stat(PFORT_VERDICT_CACHE cache, PFORT_DRIVER_STATS stats)
+{
+    UINT64 hits = 0;
+    UINT64 misses = 0;
+
+    for (UINT32 i = 0; i < cache->cpu_count; ++i) {
+        const PFORT_VERDICT_CACHE_CPU cpu = &cache->cpus[i];
+
+        hits += cpu->hits;
+        misses += cpu->misses;
+    }
+
+    stats->values[FORT_DRIVER_STAT_CACHE_HITS] = hits;
+    stats->values[FORT_DRIVER_STAT_CACHE_MISSES] = misses;
+}
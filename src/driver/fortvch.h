@@ -0,0 +1,84 @@
+#ifndef FORTVCH_H
+#define FORTVCH_H
+
+#include "fortdrv.h"
+
+#include "common/fortconf.h"
+
+#define FORT_VERDICT_CACHE_SIZE 256 /* Must be power of 2 */
+
+#define FORT_VERDICT_PATH_MAX 112 /* chars, the longer paths are not cached */
+
+typedef struct fort_verdict_key
+{
+    UINT64 path_hash;
+    UINT16 path_len; /* in bytes */
+
+    UINT32 remote_ip;
+    UINT16 remote_port;
+    UCHAR ip_proto;
+    UCHAR inbound;
+} FORT_VERDICT_KEY, *PFORT_VERDICT_KEY;
+
+typedef struct fort_verdict
+{
+    FORT_APP_FLAGS app_flags;
+
+    INT8 block_reason;
+
+    UCHAR blocked : 1;
+    UCHAR flow_assoc : 1; /* associate the flow, when allowed */
+    UCHAR no_cache : 1; /* verdict has side effects, don't cache it */
+} FORT_VERDICT, *PFORT_VERDICT;
+
+typedef struct fort_verdict_entry
+{
+    FORT_VERDICT_KEY key;
+
+    UINT32 conf_gen;
+
+    FORT_VERDICT verdict;
+
+    WCHAR path[FORT_VERDICT_PATH_MAX]; /* the hashes may collide, so the paths are compared */
+} FORT_VERDICT_ENTRY, *PFORT_VERDICT_ENTRY;
+
+typedef struct fort_verdict_cache_cpu
+{
+    UINT64 hits;
+    UINT64 misses;
+
+    UCHAR reserved[48]; /* keep the per-CPU counters on their own cache line */
+
+    FORT_VERDICT_ENTRY entries[FORT_VERDICT_CACHE_SIZE];
+} FORT_VERDICT_CACHE_CPU, *PFORT_VERDICT_CACHE_CPU;
+
+typedef struct fort_verdict_cache
+{
+    UINT32 cpu_count;
+
+    PFORT_VERDICT_CACHE_CPU cpus;
+} FORT_VERDICT_CACHE, *PFORT_VERDICT_CACHE;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+FORT_API void fort_verdict_cache_open(PFORT_VERDICT_CACHE cache);
+
+FORT_API void fort_verdict_cache_close(PFORT_VERDICT_CACHE cache);
+
+FORT_API void fort_verdict_key_init(PFORT_VERDICT_KEY key, PCUNICODE_STRING path);
+
+FORT_API BOOL fort_verdict_cache_lookup(PFORT_VERDICT_CACHE cache, const PFORT_VERDICT_KEY key,
+        PCUNICODE_STRING path, UINT32 conf_gen, PFORT_VERDICT verdict);
+
+FORT_API void fort_verdict_cache_add(PFORT_VERDICT_CACHE cache, const PFORT_VERDICT_KEY key,
+        PCUNICODE_STRING path, UINT32 conf_gen, const PFORT_VERDICT verdict);
+
+FORT_API void fort_verdict_cache_stat(PFORT_VERDICT_CACHE cache, PFORT_DRIVER_STATS stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // FORTVCH_H
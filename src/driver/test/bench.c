@@ -0,0 +1,772 @@
+/* Fort Firewall Driver: Classify Benchmark
+ *
+ * Calls the registered callouts with synthesized classify requests from N threads
+ * and reports the throughput and p50/p99 latencies of each classify path.
+ *
+ * Usage: bench [threads=4] [procs=64] [flows=1024] [apps=1000] [zones=256] [iterations=100000]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/fortioctl.h"
+#include "../fortcout.h"
+#include "../fortdev.h"
+
+#define BENCH_THREADS_MAX 64
+#define BENCH_GROUP_COUNT 8
+#define BENCH_PATH_MAX    64 /* chars */
+#define BENCH_DATA_SIZE   1400
+
+#define BENCH_LOCAL_IP   0xC0A80002 /* 192.168.0.2 */
+#define BENCH_REMOTE_IP  0x0A000000 /* 10.0.0.0 */
+#define BENCH_ZONE_STEP  0x100 /* addresses in the zones' interval */
+#define BENCH_ZONE_BLOCK 0x1 /* mask of the zone with blocked addresses */
+
+typedef enum BENCH_PATH_ID {
+    BENCH_PATH_CONNECT = 0, /* ALE connect of the new flow */
+    BENCH_PATH_REAUTH, /* ALE reauth. of the existing flow */
+    BENCH_PATH_STREAM, /* TCP data of the associated flow */
+    BENCH_PATH_DATAGRAM, /* UDP data of the associated flow */
+    BENCH_PATH_COUNT
+} BENCH_PATH_ID;
+
+static const char *const g_benchPathNames[BENCH_PATH_COUNT] = {
+    "connect",
+    "reauth",
+    "stream",
+    "datagram",
+};
+
+typedef struct bench_opts
+{
+    UINT32 threads;
+    UINT32 procs;
+    UINT32 flows; /* per thread and protocol */
+    UINT32 apps; /* rules of programs */
+    UINT32 zones; /* IP intervals of zones */
+    UINT32 iterations; /* per thread and classify path */
+} BENCH_OPTS, *PBENCH_OPTS;
+
+typedef struct bench_opt
+{
+    const char *name;
+    size_t offset;
+} BENCH_OPT;
+
+static const BENCH_OPT g_benchOpts[] = {
+    { "threads", offsetof(BENCH_OPTS, threads) },
+    { "procs", offsetof(BENCH_OPTS, procs) },
+    { "flows", offsetof(BENCH_OPTS, flows) },
+    { "apps", offsetof(BENCH_OPTS, apps) },
+    { "zones", offsetof(BENCH_OPTS, zones) },
+    { "iterations", offsetof(BENCH_OPTS, iterations) },
+};
+
+typedef struct bench_proc
+{
+    UINT32 process_id;
+
+    FWP_BYTE_BLOB path;
+
+    WCHAR path_buf[BENCH_PATH_MAX];
+} BENCH_PROC, *PBENCH_PROC;
+
+typedef struct bench_flow
+{
+    UINT64 flow_id;
+    UINT64 flowContext; /* 0, if the flow is not associated */
+
+    UINT32 proc_index;
+    UINT32 remote_ip;
+} BENCH_FLOW, *PBENCH_FLOW;
+
+typedef struct bench_thread
+{
+    struct bench *bench;
+
+    UINT32 rand;
+
+    UINT64 flow_id_next;
+
+    PBENCH_FLOW tcp_flows;
+    PBENCH_FLOW udp_flows;
+
+    UINT32 *samples; /* performance counter ticks of the classify calls */
+    UINT32 sample_n;
+} BENCH_THREAD, *PBENCH_THREAD;
+
+typedef struct bench
+{
+    BENCH_OPTS opts;
+
+    PBENCH_PROC procs;
+
+    const FWPS_CALLOUT0 *connect_callout;
+    const FWPS_CALLOUT0 *stream_callout;
+    const FWPS_CALLOUT0 *datagram_callout;
+
+    BENCH_PATH_ID path_id;
+
+    volatile LONG started;
+    volatile LONG go;
+
+    BENCH_THREAD threads[BENCH_THREADS_MAX];
+} BENCH, *PBENCH;
+
+typedef struct bench_conf_data
+{
+    UINT32 addr_group_offs[2];
+
+    FORT_CONF_ADDR_GROUP addr_groups[2];
+} BENCH_CONF_DATA;
+
+static FORT_DEVICE g_benchDevice;
+
+static BOOL bench_opts_parse(PBENCH_OPTS opts, int argc, char *argv[])
+{
+    opts->threads = 4;
+    opts->procs = 64;
+    opts->flows = 1024;
+    opts->apps = 1000;
+    opts->zones = 256;
+    opts->iterations = 100000;
+
+    for (int i = 0; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = strchr(arg, '=');
+        BOOL found = FALSE;
+
+        if (value == NULL)
+            return FALSE;
+
+        const size_t name_len = value - arg;
+
+        for (int j = 0; j < (int) (sizeof(g_benchOpts) / sizeof(BENCH_OPT)); ++j) {
+            const BENCH_OPT *opt = &g_benchOpts[j];
+
+            if (strlen(opt->name) == name_len && strncmp(opt->name, arg, name_len) == 0) {
+                *(UINT32 *) ((PCHAR) opts + opt->offset) = strtoul(value + 1, NULL, 10);
+                found = TRUE;
+                break;
+            }
+        }
+
+        if (!found)
+            return FALSE;
+    }
+
+    return opts->threads != 0 && opts->threads <= BENCH_THREADS_MAX && opts->procs != 0
+            && opts->flows != 0 && opts->iterations != 0;
+}
+
+static UINT32 bench_rand(PBENCH_THREAD thread)
+{
+    /* xorshift32 */
+    UINT32 x = thread->rand;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return (thread->rand = x);
+}
+
+static UINT32 bench_app_path(WCHAR *path, UINT32 app_index)
+{
+    const int len = _snwprintf_s(path, BENCH_PATH_MAX, _TRUNCATE,
+            L"\\device\\harddiskvolume1\\bench\\app%u.exe", app_index);
+
+    return (UINT32) len * sizeof(WCHAR);
+}
+
+static void bench_procs_init(PBENCH bench)
+{
+    const BENCH_OPTS *opts = &bench->opts;
+
+    bench->procs = calloc(opts->procs, sizeof(BENCH_PROC));
+
+    for (UINT32 i = 0; i < opts->procs; ++i) {
+        PBENCH_PROC proc = &bench->procs[i];
+
+        /* Every second process runs the program without rules */
+        const UINT32 app_index = (i % 2 == 0) ? (i / 2) : (opts->apps + i);
+        const UINT32 path_len = bench_app_path(proc->path_buf, app_index);
+
+        proc->process_id = 1000 + i * 4;
+        proc->path.size = path_len + sizeof(WCHAR); /* with terminating zero */
+        proc->path.data = (UINT8 *) proc->path_buf;
+    }
+}
+
+static PFORT_CONF_REF bench_conf_new(const PBENCH_OPTS opts)
+{
+    const ULONG conf_len = FORT_CONF_DATA_OFF + sizeof(BENCH_CONF_DATA);
+
+    PFORT_CONF conf = calloc(1, conf_len);
+
+    conf->flags.filter_enabled = 1;
+    conf->flags.log_stat = 1;
+    conf->flags.group_bits = 0xFFFF;
+
+    conf->addr_groups_off = 0;
+    conf->exe_apps_off = sizeof(BENCH_CONF_DATA);
+
+    BENCH_CONF_DATA *data = (BENCH_CONF_DATA *) conf->data;
+
+    data->addr_group_offs[0] = offsetof(BENCH_CONF_DATA, addr_groups[0]);
+    data->addr_group_offs[1] = offsetof(BENCH_CONF_DATA, addr_groups[1]);
+
+    /* Internet addresses */
+    data->addr_groups[0].include_all = 1;
+    data->addr_groups[0].include_is_empty = 1;
+    data->addr_groups[0].exclude_is_empty = 1;
+
+    /* Allowed Internet addresses, except the blocked zone */
+    data->addr_groups[1].include_all = 1;
+    data->addr_groups[1].include_is_empty = 1;
+    data->addr_groups[1].exclude_is_empty = 1;
+    data->addr_groups[1].exclude_zones = BENCH_ZONE_BLOCK;
+
+    PFORT_CONF_REF conf_ref = fort_conf_ref_new(conf, conf_len);
+
+    free(conf);
+
+    if (conf_ref == NULL)
+        return NULL;
+
+    fort_conf_app_perms_mask_init(&conf_ref->conf, conf_ref->conf.flags.group_bits);
+
+    /* Rules of programs: every 4th program is blocked */
+    for (UINT32 i = 0; i < opts->apps; ++i) {
+        WCHAR path[BENCH_PATH_MAX];
+        const UINT32 path_len = bench_app_path(path, i);
+
+        FORT_APP_FLAGS app_flags;
+        app_flags.v = 0;
+        app_flags.group_index = (UCHAR) (i % BENCH_GROUP_COUNT);
+        app_flags.use_group_perm = 1;
+        app_flags.blocked = (i % 4 == 3);
+        app_flags.found = 1;
+
+        fort_conf_ref_exe_add_path(conf_ref, path, path_len, app_flags);
+    }
+
+    return conf_ref;
+}
+
+static PFORT_CONF_ZONES bench_zones_new(UINT32 interval_n)
+{
+    const UINT32 len = fort_conf_zones_size(interval_n);
+
+    PFORT_CONF_ZONES zones = calloc(1, len);
+
+    zones->mask = BENCH_ZONE_BLOCK;
+    zones->enabled_mask = BENCH_ZONE_BLOCK;
+    zones->interval_n = interval_n;
+
+    /* Every second interval is in the blocked zone */
+    for (UINT32 i = 0; i < interval_n; ++i) {
+        zones->ip[i] = BENCH_REMOTE_IP + i * BENCH_ZONE_STEP;
+        zones->ip[interval_n + i] = (i % 2 == 1) ? BENCH_ZONE_BLOCK : 0;
+    }
+
+    fort_conf_ip_index_build(zones->ip, interval_n, &zones->ip[interval_n * 2]);
+
+    PFORT_CONF_ZONES conf_zones = fort_conf_zones_new(zones, len);
+
+    free(zones);
+
+    return conf_zones;
+}
+
+static NTSTATUS bench_device_open(PBENCH bench)
+{
+    const BENCH_OPTS *opts = &bench->opts;
+    PFORT_DEVICE device = &g_benchDevice;
+
+    RtlZeroMemory(device, sizeof(FORT_DEVICE));
+
+    fort_device_um_set(device);
+
+    NTSTATUS status = fort_device_conf_open(&device->conf);
+    if (!NT_SUCCESS(status))
+        return status;
+
+    fort_buffer_open(&device->buffer);
+    fort_log_dedup_open(&device->log_dedup, FORT_LOG_DEDUP_WINDOW_DEFAULT);
+    fort_stat_open(&device->stat, opts->threads * opts->flows * 2, FORT_STAT_SHAPER_BURST_DEFAULT);
+    fort_defer_open(&device->defer, FORT_DEFER_BATCH_DEFAULT);
+    fort_pstree_open(&device->ps_tree);
+    fort_verdict_cache_open(&device->verdict_cache);
+    fort_callout_counters_open(&device->callout_counters, FORT_CALLOUT_COUNTERS_DEFAULT);
+
+    status = fort_callout_install(NULL);
+    if (!NT_SUCCESS(status))
+        return status;
+
+    bench->connect_callout = um_fwps_callout(&FORT_GUID_CALLOUT_CONNECT_V4);
+    bench->stream_callout = um_fwps_callout(&FORT_GUID_CALLOUT_STREAM_V4);
+    bench->datagram_callout = um_fwps_callout(&FORT_GUID_CALLOUT_DATAGRAM_V4);
+
+    PFORT_CONF_REF conf_ref = bench_conf_new(&bench->opts);
+    if (conf_ref == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    fort_conf_ref_set(&device->conf, conf_ref);
+
+    if (opts->zones != 0) {
+        fort_conf_zones_set(&device->conf, bench_zones_new(opts->zones));
+    }
+
+    fort_stat_update(&device->stat, /*log_stat=*/TRUE);
+
+    return STATUS_SUCCESS;
+}
+
+static void bench_device_close(void)
+{
+    PFORT_DEVICE device = &g_benchDevice;
+
+    fort_conf_ref_set(&device->conf, NULL);
+    fort_conf_zones_set(&device->conf, NULL);
+
+    fort_pstree_close(&device->ps_tree);
+    fort_defer_close(&device->defer);
+    fort_stat_close(&device->stat);
+    fort_buffer_close(&device->buffer);
+    fort_log_dedup_close(&device->log_dedup);
+    fort_verdict_cache_close(&device->verdict_cache);
+    fort_callout_counters_close(&device->callout_counters);
+
+    fort_callout_remove();
+
+    fort_device_conf_close(&device->conf);
+
+    fort_device_um_set(NULL);
+}
+
+static UINT32 bench_ticks(LONGLONG start)
+{
+    LARGE_INTEGER end;
+    QueryPerformanceCounter(&end);
+
+    return (UINT32) (end.QuadPart - start);
+}
+
+static UINT32 bench_connect(
+        PBENCH bench, const PBENCH_FLOW flow, UCHAR ip_proto, UINT32 classify_flags)
+{
+    const PBENCH_PROC proc = &bench->procs[flow->proc_index];
+
+    FWPS_INCOMING_VALUE0 values[FWPS_FIELD_ALE_AUTH_CONNECT_V4_MAX];
+    RtlZeroMemory(values, sizeof(values));
+
+    values[FWPS_FIELD_ALE_AUTH_CONNECT_V4_FLAGS].value.uint32 = classify_flags;
+    values[FWPS_FIELD_ALE_AUTH_CONNECT_V4_IP_LOCAL_ADDRESS].value.uint32 = BENCH_LOCAL_IP;
+    values[FWPS_FIELD_ALE_AUTH_CONNECT_V4_IP_REMOTE_ADDRESS].value.uint32 = flow->remote_ip;
+    values[FWPS_FIELD_ALE_AUTH_CONNECT_V4_IP_LOCAL_PORT].value.uint16 =
+            (UINT16) (50000 + flow->flow_id % 10000);
+    values[FWPS_FIELD_ALE_AUTH_CONNECT_V4_IP_REMOTE_PORT].value.uint16 = 443;
+    values[FWPS_FIELD_ALE_AUTH_CONNECT_V4_IP_PROTOCOL].value.uint8 = ip_proto;
+
+    FWPS_INCOMING_VALUES0 inFixedValues;
+    inFixedValues.layerId = FWPS_LAYER_ALE_AUTH_CONNECT_V4;
+    inFixedValues.valueCount = FWPS_FIELD_ALE_AUTH_CONNECT_V4_MAX;
+    inFixedValues.incomingValue = values;
+
+    FWPS_INCOMING_METADATA_VALUES0 inMetaValues;
+    RtlZeroMemory(&inMetaValues, sizeof(inMetaValues));
+    inMetaValues.currentMetadataValues = FWPS_METADATA_FIELD_PROCESS_ID
+            | FWPS_METADATA_FIELD_PROCESS_PATH | FWPS_METADATA_FIELD_FLOW_HANDLE;
+    inMetaValues.processId = proc->process_id;
+    inMetaValues.processPath = &proc->path;
+    inMetaValues.flowHandle = flow->flow_id;
+
+    FWPS_FILTER0 filter;
+    RtlZeroMemory(&filter, sizeof(filter));
+
+    FWPS_CLASSIFY_OUT0 classifyOut;
+    RtlZeroMemory(&classifyOut, sizeof(classifyOut));
+    classifyOut.rights = FWPS_RIGHT_ACTION_WRITE;
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+
+    bench->connect_callout->classifyFn(
+            &inFixedValues, &inMetaValues, NULL, &filter, 0, &classifyOut);
+
+    return bench_ticks(start.QuadPart);
+}
+
+static UINT32 bench_stream(PBENCH bench, const PBENCH_FLOW flow)
+{
+    FWPS_STREAM_DATA0 streamData;
+    RtlZeroMemory(&streamData, sizeof(streamData));
+    streamData.flags = FWPS_STREAM_FLAG_SEND;
+    streamData.dataLength = BENCH_DATA_SIZE;
+
+    FWPS_STREAM_CALLOUT_IO_PACKET0 packet;
+    RtlZeroMemory(&packet, sizeof(packet));
+    packet.streamData = &streamData;
+
+    FWPS_INCOMING_VALUES0 inFixedValues;
+    RtlZeroMemory(&inFixedValues, sizeof(inFixedValues));
+    inFixedValues.layerId = FWPS_LAYER_STREAM_V4;
+
+    FWPS_INCOMING_METADATA_VALUES0 inMetaValues;
+    RtlZeroMemory(&inMetaValues, sizeof(inMetaValues));
+
+    FWPS_FILTER0 filter;
+    RtlZeroMemory(&filter, sizeof(filter));
+
+    FWPS_CLASSIFY_OUT0 classifyOut;
+    RtlZeroMemory(&classifyOut, sizeof(classifyOut));
+    classifyOut.rights = FWPS_RIGHT_ACTION_WRITE;
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+
+    bench->stream_callout->classifyFn(
+            &inFixedValues, &inMetaValues, &packet, &filter, flow->flowContext, &classifyOut);
+
+    return bench_ticks(start.QuadPart);
+}
+
+static UINT32 bench_datagram(PBENCH bench, const PBENCH_FLOW flow)
+{
+    NET_BUFFER netBuf;
+    RtlZeroMemory(&netBuf, sizeof(netBuf));
+    netBuf.DataLength = BENCH_DATA_SIZE;
+
+    NET_BUFFER_LIST netBufList;
+    RtlZeroMemory(&netBufList, sizeof(netBufList));
+    netBufList.FirstNetBuffer = &netBuf;
+
+    FWPS_INCOMING_VALUE0 values[FWPS_FIELD_DATAGRAM_DATA_V4_MAX];
+    RtlZeroMemory(values, sizeof(values));
+
+    values[FWPS_FIELD_DATAGRAM_DATA_V4_DIRECTION].value.uint8 = FWP_DIRECTION_OUTBOUND;
+
+    FWPS_INCOMING_VALUES0 inFixedValues;
+    inFixedValues.layerId = FWPS_LAYER_DATAGRAM_DATA_V4;
+    inFixedValues.valueCount = FWPS_FIELD_DATAGRAM_DATA_V4_MAX;
+    inFixedValues.incomingValue = values;
+
+    FWPS_INCOMING_METADATA_VALUES0 inMetaValues;
+    RtlZeroMemory(&inMetaValues, sizeof(inMetaValues));
+
+    FWPS_FILTER0 filter;
+    RtlZeroMemory(&filter, sizeof(filter));
+
+    FWPS_CLASSIFY_OUT0 classifyOut;
+    RtlZeroMemory(&classifyOut, sizeof(classifyOut));
+    classifyOut.rights = FWPS_RIGHT_ACTION_WRITE;
+
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+
+    bench->datagram_callout->classifyFn(&inFixedValues, &inMetaValues, &netBufList, &filter,
+            flow->flowContext, &classifyOut);
+
+    return bench_ticks(start.QuadPart);
+}
+
+static UINT64 bench_flow_context(UINT64 flow_id)
+{
+    PFORT_STAT stat = &fort_device()->stat;
+    PFORT_FLOW flow;
+
+    KLOCK_QUEUE_HANDLE lock_queue;
+    KeAcquireInStackQueuedSpinLock(&stat->lock, &lock_queue);
+    flow = fort_flow_table_get(&stat->flows, flow_id);
+    KeReleaseInStackQueuedSpinLock(&lock_queue);
+
+    return (UINT64) flow;
+}
+
+static void bench_flow_delete(PBENCH bench, UINT64 flowContext)
+{
+    bench->stream_callout->flowDeleteFn(
+            FWPS_LAYER_STREAM_V4, fort_device()->stat.stream4_id, flowContext);
+}
+
+static void bench_flow_init(PBENCH_THREAD thread, PBENCH_FLOW flow)
+{
+    const BENCH_OPTS *opts = &thread->bench->opts;
+
+    flow->flow_id = thread->flow_id_next++;
+    flow->flowContext = 0;
+
+    flow->proc_index = bench_rand(thread) % opts->procs;
+
+    /* Spread the remote addresses over the zones' intervals */
+    const UINT32 zones_size = (opts->zones != 0 ? opts->zones : 1) * BENCH_ZONE_STEP;
+    flow->remote_ip = BENCH_REMOTE_IP + bench_rand(thread) % zones_size;
+}
+
+static void bench_flows_connect(PBENCH_THREAD thread, PBENCH_FLOW flows, UCHAR ip_proto)
+{
+    PBENCH bench = thread->bench;
+
+    for (UINT32 i = 0; i < bench->opts.flows; ++i) {
+        PBENCH_FLOW flow = &flows[i];
+
+        bench_flow_init(thread, flow);
+        bench_connect(bench, flow, ip_proto, 0);
+
+        flow->flowContext = bench_flow_context(flow->flow_id);
+    }
+}
+
+static BOOL bench_thread_open(PBENCH bench, PBENCH_THREAD thread, UINT32 index)
+{
+    const BENCH_OPTS *opts = &bench->opts;
+
+    thread->bench = bench;
+    thread->rand = 0x9E3779B9 * (index + 1);
+    thread->flow_id_next = ((UINT64) (index + 1) << 40) + 1;
+
+    thread->tcp_flows = calloc(opts->flows, sizeof(BENCH_FLOW));
+    thread->udp_flows = calloc(opts->flows, sizeof(BENCH_FLOW));
+    thread->samples = calloc(opts->iterations, sizeof(UINT32));
+
+    if (thread->tcp_flows == NULL || thread->udp_flows == NULL || thread->samples == NULL)
+        return FALSE;
+
+    bench_flows_connect(thread, thread->tcp_flows, IPPROTO_TCP);
+    bench_flows_connect(thread, thread->udp_flows, IPPROTO_UDP);
+
+    return TRUE;
+}
+
+static void bench_thread_close(PBENCH_THREAD thread)
+{
+    free(thread->tcp_flows);
+    free(thread->udp_flows);
+    free(thread->samples);
+}
+
+static BOOL bench_path_classify(PBENCH bench, PBENCH_THREAD thread, UINT32 i, UINT32 *ticks)
+{
+    const BENCH_OPTS *opts = &bench->opts;
+
+    switch (bench->path_id) {
+    case BENCH_PATH_CONNECT: {
+        BENCH_FLOW flow;
+        bench_flow_init(thread, &flow);
+
+        *ticks = bench_connect(bench, &flow, IPPROTO_TCP, 0);
+
+        /* Close the connection */
+        const UINT64 flowContext = bench_flow_context(flow.flow_id);
+        if (flowContext != 0) {
+            bench_flow_delete(bench, flowContext);
+        }
+        return TRUE;
+    }
+    case BENCH_PATH_REAUTH: {
+        const PBENCH_FLOW flow = &thread->tcp_flows[i % opts->flows];
+
+        *ticks = bench_connect(bench, flow, IPPROTO_TCP, FWP_CONDITION_FLAG_IS_REAUTHORIZE);
+        return TRUE;
+    }
+    case BENCH_PATH_STREAM: {
+        const PBENCH_FLOW flow = &thread->tcp_flows[i % opts->flows];
+        if (flow->flowContext == 0)
+            return FALSE; /* blocked */
+
+        *ticks = bench_stream(bench, flow);
+        return TRUE;
+    }
+    case BENCH_PATH_DATAGRAM: {
+        const PBENCH_FLOW flow = &thread->udp_flows[i % opts->flows];
+        if (flow->flowContext == 0)
+            return FALSE; /* blocked */
+
+        *ticks = bench_datagram(bench, flow);
+        return TRUE;
+    }
+    default:
+        return FALSE;
+    }
+}
+
+static DWORD WINAPI bench_thread_run(LPVOID param)
+{
+    PBENCH_THREAD thread = param;
+    PBENCH bench = thread->bench;
+
+    thread->sample_n = 0;
+
+    InterlockedIncrement(&bench->started);
+
+    while (bench->go == 0) {
+        YieldProcessor();
+    }
+
+    for (UINT32 i = 0; i < bench->opts.iterations; ++i) {
+        UINT32 ticks;
+
+        if (bench_path_classify(bench, thread, i, &ticks)) {
+            thread->samples[thread->sample_n++] = ticks;
+        }
+    }
+
+    return 0;
+}
+
+static int bench_ticks_cmp(const void *p1, const void *p2)
+{
+    const UINT32 t1 = *(const UINT32 *) p1;
+    const UINT32 t2 = *(const UINT32 *) p2;
+
+    return (t1 > t2) - (t1 < t2);
+}
+
+static void bench_path_report(PBENCH bench, double secs)
+{
+    const BENCH_OPTS *opts = &bench->opts;
+    const char *path_name = g_benchPathNames[bench->path_id];
+
+    UINT32 *samples = calloc((SIZE_T) opts->threads * opts->iterations, sizeof(UINT32));
+    UINT32 sample_n = 0;
+
+    for (UINT32 i = 0; i < opts->threads; ++i) {
+        const PBENCH_THREAD thread = &bench->threads[i];
+
+        memcpy(&samples[sample_n], thread->samples, thread->sample_n * sizeof(UINT32));
+        sample_n += thread->sample_n;
+    }
+
+    if (sample_n == 0) {
+        printf("bench %-8s: no associated flows\n", path_name);
+    } else {
+        qsort(samples, sample_n, sizeof(UINT32), bench_ticks_cmp);
+
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+
+        const double ns_per_tick = 1e9 / freq.QuadPart;
+        const double p50 = samples[sample_n / 2] * ns_per_tick;
+        const double p99 = samples[(UINT32) ((UINT64) sample_n * 99 / 100)] * ns_per_tick;
+
+        printf("bench %-8s: calls=%u time=%.3fs throughput=%.0f/s p50=%.0fns p99=%.0fns\n",
+                path_name, sample_n, secs, sample_n / secs, p50, p99);
+    }
+
+    fflush(stdout);
+
+    free(samples);
+}
+
+static void bench_callouts_report(void)
+{
+    static FORT_CALLOUT_STATS stats;
+
+    fort_callout_counters_stat(&fort_device()->callout_counters, &stats);
+
+    for (int id = 0; id < FORT_CALLOUT_COUNT; ++id) {
+        const PFORT_CALLOUT_STAT stat = &stats.callouts[id];
+
+        if (stat->calls == 0)
+            continue;
+
+        printf("bench callout %d: calls=%llu permits=%llu blocks=%llu defers=%llu reauths=%llu\n",
+                id, stat->calls, stat->permits, stat->blocks, stat->defers, stat->reauths);
+    }
+}
+
+static void bench_path_run(PBENCH bench, BENCH_PATH_ID path_id)
+{
+    const UINT32 thread_count = bench->opts.threads;
+    HANDLE handles[BENCH_THREADS_MAX];
+
+    bench->path_id = path_id;
+    bench->started = 0;
+    bench->go = 0;
+
+    for (UINT32 i = 0; i < thread_count; ++i) {
+        handles[i] = CreateThread(NULL, 0, bench_thread_run, &bench->threads[i], 0, NULL);
+    }
+
+    /* Start the threads at once */
+    while (bench->started != (LONG) thread_count) {
+        YieldProcessor();
+    }
+
+    LARGE_INTEGER freq, start, end;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+
+    InterlockedExchange(&bench->go, 1);
+
+    WaitForMultipleObjects(thread_count, handles, TRUE, INFINITE);
+
+    QueryPerformanceCounter(&end);
+
+    for (UINT32 i = 0; i < thread_count; ++i) {
+        CloseHandle(handles[i]);
+    }
+
+    const double secs = (double) (end.QuadPart - start.QuadPart) / freq.QuadPart;
+
+    bench_path_report(bench, secs);
+}
+
+FORT_API int bench_main(int argc, char *argv[])
+{
+    static BENCH bench;
+
+    RtlZeroMemory(&bench, sizeof(BENCH));
+
+    BENCH_OPTS *opts = &bench.opts;
+
+    if (!bench_opts_parse(opts, argc, argv)) {
+        printf("Usage: bench [threads=N] [procs=N] [flows=N] [apps=N] [zones=N] "
+               "[iterations=N]\n");
+        return 1;
+    }
+
+    printf("bench: threads=%u procs=%u flows=%u apps=%u zones=%u iterations=%u\n", opts->threads,
+            opts->procs, opts->flows, opts->apps, opts->zones, opts->iterations);
+
+    bench_procs_init(&bench);
+
+    int res = 1;
+
+    if (NT_SUCCESS(bench_device_open(&bench))) {
+        BOOL opened = TRUE;
+
+        for (UINT32 i = 0; opened && i < opts->threads; ++i) {
+            opened = bench_thread_open(&bench, &bench.threads[i], i);
+        }
+
+        if (opened) {
+            for (int path_id = 0; path_id < BENCH_PATH_COUNT; ++path_id) {
+                bench_path_run(&bench, (BENCH_PATH_ID) path_id);
+            }
+
+            const PFORT_STAT stat = &fort_device()->stat;
+
+            printf("bench: flows=%u full=%u reassoc=%u layers_avoided=%u\n",
+                    stat->flows.flow_count, stat->flows.full_count, stat->flow_reassoc_count,
+                    stat->flow_layers_avoided);
+
+            bench_callouts_report();
+
+            res = 0;
+        }
+
+        for (UINT32 i = 0; i < opts->threads; ++i) {
+            bench_thread_close(&bench.threads[i]);
+        }
+    }
+
+    bench_device_close();
+
+    free(bench.procs);
+
+    return res;
+}
@@ -0,0 +1,17 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "../fortdrv.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* Run the classify benchmark with "name=value" options, see bench.c */
+FORT_API int bench_main(int argc, char *argv[]);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // BENCH_H
@@ -2,11 +2,15 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "../fortcb.h"
+#include "../fortcnf.h"
 #include "../proxycb/fortpcb_drv.h"
 #include "../proxycb/fortpcb_src.h"
 
+#include "bench.h"
+
 #define TEST_CALLBACK_ID 33
 
 typedef int (*TestCallbackFunc)(PVOID p, int i);
@@ -60,13 +64,111 @@ static void test_major(void)
     assert(res == STATUS_SUCCESS);
 }
 
+#define TEST_CONF_REF_THREADS_MAX 16
+#define TEST_CONF_REF_TAKE_COUNT  (1000 * 1000)
+
+typedef struct test_conf_ref_thread
+{
+    PFORT_DEVICE_CONF device_conf;
+
+    volatile LONG *started;
+} TEST_CONF_REF_THREAD, *PTEST_CONF_REF_THREAD;
+
+static DWORD WINAPI test_conf_ref_thread(LPVOID param)
+{
+    PTEST_CONF_REF_THREAD thread = param;
+    PFORT_DEVICE_CONF device_conf = thread->device_conf;
+
+    InterlockedIncrement(thread->started);
+
+    for (int i = 0; i < TEST_CONF_REF_TAKE_COUNT; ++i) {
+        PFORT_CONF_REF conf_ref = fort_conf_ref_take(device_conf);
+        assert(conf_ref != NULL);
+
+        fort_conf_ref_put(device_conf, conf_ref);
+    }
+
+    return 0;
+}
+
+static PFORT_CONF_REF test_conf_ref_new(void)
+{
+    FORT_CONF conf;
+    RtlZeroMemory(&conf, sizeof(FORT_CONF));
+
+    PFORT_CONF_REF conf_ref = fort_conf_ref_new(&conf, FORT_CONF_DATA_OFF);
+    assert(conf_ref != NULL);
+
+    return conf_ref;
+}
+
+static void test_conf_ref_contention(int thread_count)
+{
+    FORT_DEVICE_CONF device_conf;
+    RtlZeroMemory(&device_conf, sizeof(FORT_DEVICE_CONF));
+
+    fort_device_conf_open(&device_conf);
+    fort_conf_ref_set(&device_conf, test_conf_ref_new());
+
+    volatile LONG started = 0;
+
+    TEST_CONF_REF_THREAD threads[TEST_CONF_REF_THREADS_MAX];
+    HANDLE handles[TEST_CONF_REF_THREADS_MAX];
+
+    LARGE_INTEGER freq, start, end;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+
+    for (int i = 0; i < thread_count; ++i) {
+        threads[i].device_conf = &device_conf;
+        threads[i].started = &started;
+
+        handles[i] = CreateThread(NULL, 0, test_conf_ref_thread, &threads[i], 0, NULL);
+        assert(handles[i] != NULL);
+    }
+
+    /* Replace the conf while the threads are taking it */
+    int swap_count = 0;
+    while (WaitForMultipleObjects(thread_count, handles, TRUE, 1) == WAIT_TIMEOUT) {
+        if (started == thread_count) {
+            fort_conf_ref_set(&device_conf, test_conf_ref_new());
+            ++swap_count;
+        }
+    }
+
+    QueryPerformanceCounter(&end);
+
+    for (int i = 0; i < thread_count; ++i) {
+        CloseHandle(handles[i]);
+    }
+
+    fort_conf_ref_set(&device_conf, NULL);
+    fort_device_conf_close(&device_conf);
+
+    const double secs = (double) (end.QuadPart - start.QuadPart) / freq.QuadPart;
+    const double ns_per_take = secs * 1e9 / TEST_CONF_REF_TAKE_COUNT;
+
+    printf("test_conf_ref_contention: threads=%d swaps=%d time=%.3fs take+put=%.1fns\n",
+            thread_count, swap_count, secs, ns_per_take);
+
+    fflush(stdout);
+}
+
+static void test_conf_ref(void)
+{
+    for (int thread_count = 1; thread_count <= TEST_CONF_REF_THREADS_MAX; thread_count *= 2) {
+        test_conf_ref_contention(thread_count);
+    }
+}
+
 int main(int argc, char *argv[])
 {
-    (void) argc;
-    (void) argv;
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+        return bench_main(argc - 2, argv + 2);
 
     test_proxycb();
     test_major();
+    test_conf_ref();
 
     return 0;
 }
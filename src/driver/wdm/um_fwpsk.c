@@ -1,20 +1,46 @@
 #include "um_fwpsk.h"
 
+#define UM_FWPS_CALLOUT_MAX 16
+
+static FWPS_CALLOUT0 g_callouts[UM_FWPS_CALLOUT_MAX];
+
 NTSTATUS NTAPI FwpsCalloutRegister0(
         void *deviceObject, const FWPS_CALLOUT0 *callout, UINT32 *calloutId)
 {
     UNUSED(deviceObject);
-    UNUSED(callout);
-    UNUSED(calloutId);
-    return STATUS_SUCCESS;
+
+    for (UINT32 i = 0; i < UM_FWPS_CALLOUT_MAX; ++i) {
+        if (g_callouts[i].classifyFn == NULL) {
+            g_callouts[i] = *callout;
+            *calloutId = i + 1;
+            return STATUS_SUCCESS;
+        }
+    }
+
+    return STATUS_INSUFFICIENT_RESOURCES;
 }
 
 NTSTATUS NTAPI FwpsCalloutUnregisterById0(const UINT32 calloutId)
 {
-    UNUSED(calloutId);
+    if (calloutId == 0 || calloutId > UM_FWPS_CALLOUT_MAX)
+        return STATUS_INVALID_PARAMETER;
+
+    RtlZeroMemory(&g_callouts[calloutId - 1], sizeof(FWPS_CALLOUT0));
     return STATUS_SUCCESS;
 }
 
+const FWPS_CALLOUT0 *um_fwps_callout(const GUID *calloutKey)
+{
+    for (UINT32 i = 0; i < UM_FWPS_CALLOUT_MAX; ++i) {
+        const FWPS_CALLOUT0 *callout = &g_callouts[i];
+
+        if (callout->classifyFn != NULL && IsEqualGUID(&callout->calloutKey, calloutKey))
+            return callout;
+    }
+
+    return NULL;
+}
+
 NTSTATUS NTAPI FwpsGetPacketListSecurityInformation0(NET_BUFFER_LIST *packetList, UINT32 queryFlags,
         FWPS_PACKET_LIST_INFORMATION0 *packetInformation)
 {
@@ -2840,6 +2840,9 @@ _IRQL_requires_max_(DISPATCH_LEVEL) void NTAPI
         FwpsDiscardClonedStreamData0(_Inout_ NET_BUFFER_LIST *netBufferListChain,
                 _In_ UINT32 allocateCloneFlags, _In_ BOOLEAN dispatchLevel);
 
+/* User Mode: the callout, registered by FwpsCalloutRegister0(), to call it from benchmarks */
+FORT_API const FWPS_CALLOUT0 *um_fwps_callout(const GUID *calloutKey);
+
 #ifdef __cplusplus
 }
 #endif
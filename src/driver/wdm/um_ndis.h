@@ -7,8 +7,6 @@
 extern "C" {
 #endif
 
-typedef PVOID MDL, *PMDL;
-
 typedef PVOID NDIS_HANDLE, *PNDIS_HANDLE;
 typedef int NDIS_STATUS, *PNDIS_STATUS;
 
@@ -145,31 +145,45 @@ LONG_PTR ObDereferenceObject(PVOID object)
     return 0;
 }
 
+/* Spin locks are real to measure the contention in benchmarks */
+static void um_spin_lock_acquire(PKSPIN_LOCK lock)
+{
+    while (InterlockedExchangePointer((PVOID volatile *) lock, (PVOID) 1) != NULL) {
+        YieldProcessor();
+    }
+}
+
+static void um_spin_lock_release(PKSPIN_LOCK lock)
+{
+    InterlockedExchangePointer((PVOID volatile *) lock, NULL);
+}
+
 void KeInitializeSpinLock(PKSPIN_LOCK lock)
 {
-    UNUSED(lock);
+    *lock = 0;
 }
 
 void KeAcquireInStackQueuedSpinLock(PKSPIN_LOCK lock, PKLOCK_QUEUE_HANDLE handle)
 {
-    UNUSED(lock);
-    UNUSED(handle);
+    um_spin_lock_acquire(lock);
+
+    handle->lock = lock;
+    handle->OldIrql = PASSIVE_LEVEL;
 }
 
 void KeReleaseInStackQueuedSpinLock(PKLOCK_QUEUE_HANDLE handle)
 {
-    UNUSED(handle);
+    um_spin_lock_release(handle->lock);
 }
 
 void KeAcquireInStackQueuedSpinLockAtDpcLevel(PKSPIN_LOCK lock, PKLOCK_QUEUE_HANDLE handle)
 {
-    UNUSED(lock);
-    UNUSED(handle);
+    KeAcquireInStackQueuedSpinLock(lock, handle);
 }
 
 void KeReleaseInStackQueuedSpinLockFromDpcLevel(PKLOCK_QUEUE_HANDLE handle)
 {
-    UNUSED(handle);
+    KeReleaseInStackQueuedSpinLock(handle);
 }
 
 void IoAcquireCancelSpinLock(PKIRQL irql)
@@ -182,28 +196,43 @@ void IoReleaseCancelSpinLock(KIRQL irql)
     UNUSED(irql);
 }
 
+#define UM_EX_SPIN_LOCK_EXCLUSIVE ((LONG) 0x80000000)
+
 KIRQL ExAcquireSpinLockShared(PEX_SPIN_LOCK lock)
 {
-    UNUSED(lock);
-    return 0;
+    for (;;) {
+        const LONG value = *lock;
+
+        if (value >= 0 && InterlockedCompareExchange(lock, value + 1, value) == value)
+            break;
+
+        YieldProcessor();
+    }
+
+    return PASSIVE_LEVEL;
 }
 
 KIRQL ExAcquireSpinLockExclusive(PEX_SPIN_LOCK lock)
 {
-    UNUSED(lock);
-    return 0;
+    while (InterlockedCompareExchange(lock, UM_EX_SPIN_LOCK_EXCLUSIVE, 0) != 0) {
+        YieldProcessor();
+    }
+
+    return PASSIVE_LEVEL;
 }
 
 void ExReleaseSpinLockShared(PEX_SPIN_LOCK lock, KIRQL oldIrql)
 {
-    UNUSED(lock);
     UNUSED(oldIrql);
+
+    InterlockedDecrement(lock);
 }
 
 void ExReleaseSpinLockExclusive(PEX_SPIN_LOCK lock, KIRQL oldIrql)
 {
-    UNUSED(lock);
     UNUSED(oldIrql);
+
+    InterlockedExchange(lock, 0);
 }
 
 KIRQL KeGetCurrentIrql(VOID)
@@ -211,6 +240,28 @@ KIRQL KeGetCurrentIrql(VOID)
     return 0;
 }
 
+void KeRaiseIrql(KIRQL newIrql, PKIRQL oldIrql)
+{
+    UNUSED(newIrql);
+    *oldIrql = PASSIVE_LEVEL;
+}
+
+void KeLowerIrql(KIRQL newIrql)
+{
+    UNUSED(newIrql);
+}
+
+ULONG KeQueryMaximumProcessorCountEx(USHORT groupNumber)
+{
+    return GetMaximumProcessorCount(groupNumber);
+}
+
+ULONG KeGetCurrentProcessorNumberEx(PPROCESSOR_NUMBER procNumber)
+{
+    UNUSED(procNumber);
+    return GetCurrentProcessorNumber();
+}
+
 void IoCompleteRequest(PIRP irp, CCHAR priorityBoost)
 {
     UNUSED(irp);
@@ -264,6 +315,17 @@ void KeQuerySystemTime(PLARGE_INTEGER time)
     UNUSED(time);
 }
 
+LARGE_INTEGER KeQueryPerformanceCounter(PLARGE_INTEGER performanceFrequency)
+{
+    if (performanceFrequency != NULL) {
+        QueryPerformanceFrequency(performanceFrequency);
+    }
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter;
+}
+
 void ExSystemTimeToLocalTime(PLARGE_INTEGER systemTime, PLARGE_INTEGER localTime)
 {
     UNUSED(systemTime);
@@ -411,6 +473,44 @@ NTSTATUS MmCopyVirtualMemory(PEPROCESS sourceProcess, PVOID sourceAddress, PEPRO
     return STATUS_SUCCESS;
 }
 
+PMDL IoAllocateMdl(
+        PVOID virtualAddress, ULONG length, BOOLEAN secondaryBuffer, BOOLEAN chargeQuota, PIRP irp)
+{
+    UNUSED(length);
+    UNUSED(secondaryBuffer);
+    UNUSED(chargeQuota);
+    UNUSED(irp);
+    return (PMDL) virtualAddress;
+}
+
+void IoFreeMdl(PMDL mdl)
+{
+    UNUSED(mdl);
+}
+
+void MmBuildMdlForNonPagedPool(PMDL mdl)
+{
+    UNUSED(mdl);
+}
+
+PVOID MmMapLockedPagesSpecifyCache(PMDL mdl, KPROCESSOR_MODE accessMode,
+        MEMORY_CACHING_TYPE cacheType, PVOID requestedAddress, ULONG bugCheckOnFailure,
+        ULONG priority)
+{
+    UNUSED(accessMode);
+    UNUSED(cacheType);
+    UNUSED(requestedAddress);
+    UNUSED(bugCheckOnFailure);
+    UNUSED(priority);
+    return (PVOID) mdl; /* the same process */
+}
+
+void MmUnmapLockedPages(PVOID baseAddress, PMDL mdl)
+{
+    UNUSED(baseAddress);
+    UNUSED(mdl);
+}
+
 POBJECT_TYPE *PsProcessType = NULL;
 
 NTSTATUS ObReferenceObjectByHandle(HANDLE handle, ACCESS_MASK desiredAccess,
@@ -18,6 +18,8 @@ extern "C" {
 
 typedef LARGE_INTEGER PHYSICAL_ADDRESS, *PPHYSICAL_ADDRESS;
 
+typedef PVOID MDL, *PMDL;
+
 typedef LONG *PCALLBACK_OBJECT;
 
 typedef UCHAR KIRQL, *PKIRQL;
@@ -155,7 +157,12 @@ typedef DRIVER_CANCEL *PDRIVER_CANCEL;
 typedef VOID CALLBACK_FUNCTION(PVOID context, PVOID arg1, PVOID arg2);
 typedef CALLBACK_FUNCTION *PCALLBACK_FUNCTION;
 
-typedef LONG KLOCK_QUEUE_HANDLE, *PKLOCK_QUEUE_HANDLE;
+typedef struct
+{
+    PKSPIN_LOCK lock;
+    KIRQL OldIrql;
+} KLOCK_QUEUE_HANDLE, *PKLOCK_QUEUE_HANDLE;
+
 typedef volatile LONG EX_SPIN_LOCK, *PEX_SPIN_LOCK;
 
 typedef LONG KTIMER, *PKTIMER;
@@ -283,6 +290,17 @@ FORT_API void ExReleaseSpinLockExclusive(PEX_SPIN_LOCK lock, KIRQL oldIrql);
 
 FORT_API KIRQL KeGetCurrentIrql(VOID);
 
+#define PASSIVE_LEVEL  0
+#define DISPATCH_LEVEL 2
+FORT_API void KeRaiseIrql(KIRQL newIrql, PKIRQL oldIrql);
+FORT_API void KeLowerIrql(KIRQL newIrql);
+
+#define KeMemoryBarrier() MemoryBarrier()
+
+#define ALL_PROCESSOR_GROUPS 0xffff
+FORT_API ULONG KeQueryMaximumProcessorCountEx(USHORT groupNumber);
+FORT_API ULONG KeGetCurrentProcessorNumberEx(PPROCESSOR_NUMBER procNumber);
+
 #define IO_NO_INCREMENT 0
 FORT_API void IoCompleteRequest(PIRP irp, CCHAR priorityBoost);
 
@@ -299,6 +317,7 @@ FORT_API void IoQueueWorkItemEx(
         PIO_WORKITEM workItem, PIO_WORKITEM_ROUTINE_EX routine, int queueType, PVOID context);
 
 FORT_API void KeQuerySystemTime(PLARGE_INTEGER time);
+FORT_API LARGE_INTEGER KeQueryPerformanceCounter(PLARGE_INTEGER performanceFrequency);
 FORT_API void ExSystemTimeToLocalTime(PLARGE_INTEGER systemTime, PLARGE_INTEGER localTime);
 FORT_API void RtlTimeToTimeFields(PLARGE_INTEGER time, PTIME_FIELDS timeFields);
 
@@ -342,6 +361,25 @@ FORT_API NTSTATUS MmCopyVirtualMemory(PEPROCESS sourceProcess, PVOID sourceAddre
         PEPROCESS targetProcess, PVOID targetAddress, SIZE_T bufferSize,
         KPROCESSOR_MODE previousMode, PSIZE_T returnSize);
 
+#define PAGE_SIZE 0x1000
+#define ROUND_TO_PAGES(size) (((ULONG_PTR) (size) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+typedef enum { MmNonCached, MmCached, MmWriteCombined } MEMORY_CACHING_TYPE;
+
+#define NormalPagePriority  16
+#define MdlMappingNoWrite   0x80000000
+#define MdlMappingNoExecute 0x40000000
+
+FORT_API PMDL IoAllocateMdl(
+        PVOID virtualAddress, ULONG length, BOOLEAN secondaryBuffer, BOOLEAN chargeQuota, PIRP irp);
+FORT_API void IoFreeMdl(PMDL mdl);
+
+FORT_API void MmBuildMdlForNonPagedPool(PMDL mdl);
+FORT_API PVOID MmMapLockedPagesSpecifyCache(PMDL mdl, KPROCESSOR_MODE accessMode,
+        MEMORY_CACHING_TYPE cacheType, PVOID requestedAddress, ULONG bugCheckOnFailure,
+        ULONG priority);
+FORT_API void MmUnmapLockedPages(PVOID baseAddress, PMDL mdl);
+
 extern POBJECT_TYPE *PsProcessType;
 
 FORT_API NTSTATUS ObReferenceObjectByHandle(HANDLE handle, ACCESS_MASK desiredAccess,
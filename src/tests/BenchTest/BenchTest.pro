@@ -0,0 +1,8 @@
+include(../Common/Common.pri)
+
+HEADERS += \
+    tst_addrlist.h \
+    tst_apppath.h
+
+SOURCES += \
+    tst_main.cpp
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+
+#include <googletest.h>
+
+#include <common/fortconf.h>
+#include <driver/drivercommon.h>
+#include <util/conf/confutil.h>
+#include <util/net/ip4range.h>
+
+class AddrListBenchTest : public Test
+{
+    // Test interface
+protected:
+    void SetUp();
+    void TearDown();
+
+    void benchRanges(int rangeCount);
+    void benchAddrList(int ipCount, int rangeCount);
+};
+
+void AddrListBenchTest::SetUp() { }
+
+void AddrListBenchTest::TearDown() { }
+
+namespace {
+
+constexpr int lookupCount = 1000 * 1000;
+
+// Binary search over the flat arrays, as it was before the index layout
+bool flatIpInRange(quint32 ip, int count, const quint32 *iprange)
+{
+    if (count == 0)
+        return false;
+
+    int low = 0;
+    int high = count - 1;
+
+    do {
+        const int mid = (low + high) / 2;
+        const quint32 mid_ip = iprange[mid];
+
+        if (ip < mid_ip)
+            high = mid - 1;
+        else if (ip > mid_ip)
+            low = mid + 1;
+        else
+            return true;
+    } while (low <= high);
+
+    return high >= 0 && ip >= iprange[high] && ip <= iprange[count + high];
+}
+
+bool flatIpInList(quint32 ip, const QVector<quint32> &ips, int rangeCount, const quint32 *iprange)
+{
+    return std::binary_search(ips.constBegin(), ips.constEnd(), ip)
+            || flatIpInRange(ip, rangeCount, iprange);
+}
+
+void fillRandomRanges(Ip4Range &ip4Range, int rangeCount, QRandomGenerator &rand)
+{
+    const quint32 step = quint32((quint64(1) << 32) / rangeCount);
+
+    ip4Range.pairFromArray().resize(rangeCount);
+    ip4Range.pairToArray().resize(rangeCount);
+
+    for (int i = 0; i < rangeCount; ++i) {
+        const quint32 from = quint32(i) * step + rand.bounded(step / 2);
+        const quint32 to = from + rand.bounded(step / 2);
+
+        ip4Range.pairFromArray()[i] = from;
+        ip4Range.pairToArray()[i] = to;
+    }
+}
+
+// Sorted single IP-s, one per slot as the ranges
+void fillRandomIps(Ip4Range &ip4Range, int ipCount, QRandomGenerator &rand)
+{
+    const quint32 step = quint32((quint64(1) << 32) / ipCount);
+
+    ip4Range.ipArray().resize(ipCount);
+
+    for (int i = 0; i < ipCount; ++i) {
+        ip4Range.ipArray()[i] = quint32(i) * step + step / 2 + rand.bounded(step / 2);
+    }
+}
+
+void printLookupTimes(const char *caseName, int count, qint64 flatNsecs, qint64 indexNsecs)
+{
+    qDebug() << caseName << count << "flat>" << (flatNsecs / lookupCount)
+             << "nsec/lookup, index>" << (indexNsecs / lookupCount) << "nsec/lookup";
+}
+
+}
+
+void AddrListBenchTest::benchRanges(int rangeCount)
+{
+    QRandomGenerator rand(rangeCount);
+
+    Ip4Range ip4Range;
+    fillRandomRanges(ip4Range, rangeCount, rand);
+
+    ConfUtil confUtil;
+
+    QByteArray buf;
+    buf.resize(confUtil.writeZone(ip4Range, buf));
+
+    QVector<quint32> ips(lookupCount);
+    for (quint32 &ip : ips) {
+        ip = rand.generate();
+    }
+
+    // Flat arrays of ranges: from IP-s, then to IP-s
+    QVector<quint32> flatRanges = ip4Range.pairFromArray();
+    flatRanges.append(ip4Range.pairToArray());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int flatFound = 0;
+    for (const quint32 ip : ips) {
+        flatFound += flatIpInRange(ip, rangeCount, flatRanges.constData());
+    }
+
+    const qint64 flatNsecs = timer.nsecsElapsed();
+    timer.restart();
+
+    int indexFound = 0;
+    for (const quint32 ip : ips) {
+        indexFound += DriverCommon::confIpInList(buf.constData(), ip);
+    }
+
+    const qint64 indexNsecs = timer.nsecsElapsed();
+
+    ASSERT_EQ(flatFound, indexFound);
+
+    for (const quint32 ip : ips) {
+        ASSERT_EQ(flatIpInRange(ip, rangeCount, flatRanges.constData()),
+                DriverCommon::confIpInList(buf.constData(), ip));
+    }
+
+    printLookupTimes("ranges>", rangeCount, flatNsecs, indexNsecs);
+}
+
+void AddrListBenchTest::benchAddrList(int ipCount, int rangeCount)
+{
+    QRandomGenerator rand(ipCount + rangeCount);
+
+    Ip4Range ip4Range;
+    fillRandomRanges(ip4Range, rangeCount, rand);
+    fillRandomIps(ip4Range, ipCount, rand);
+
+    ConfUtil confUtil;
+
+    QByteArray buf;
+    buf.resize(confUtil.writeZone(ip4Range, buf));
+
+    // Half of the lookups hit the single IP-s, else the random IP-s mostly check the ranges
+    const QVector<quint32> &ipArray = ip4Range.ipArray();
+
+    QVector<quint32> ips(lookupCount);
+    for (int i = 0; i < lookupCount; ++i) {
+        ips[i] = (i & 1) ? ipArray[rand.bounded(ipCount)] : rand.generate();
+    }
+
+    QVector<quint32> flatRanges = ip4Range.pairFromArray();
+    flatRanges.append(ip4Range.pairToArray());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int flatFound = 0;
+    for (const quint32 ip : ips) {
+        flatFound += flatIpInList(ip, ipArray, rangeCount, flatRanges.constData());
+    }
+
+    const qint64 flatNsecs = timer.nsecsElapsed();
+    timer.restart();
+
+    int indexFound = 0;
+    for (const quint32 ip : ips) {
+        indexFound += DriverCommon::confIpInList(buf.constData(), ip);
+    }
+
+    const qint64 indexNsecs = timer.nsecsElapsed();
+
+    ASSERT_EQ(flatFound, indexFound);
+
+    for (const quint32 ip : ips) {
+        ASSERT_EQ(flatIpInList(ip, ipArray, rangeCount, flatRanges.constData()),
+                DriverCommon::confIpInList(buf.constData(), ip));
+    }
+
+    printLookupTimes("ips+ranges>", ipCount + rangeCount, flatNsecs, indexNsecs);
+}
+
+TEST_F(AddrListBenchTest, lookup1K)
+{
+    benchRanges(1000);
+}
+
+TEST_F(AddrListBenchTest, lookup100K)
+{
+    benchRanges(100 * 1000);
+}
+
+TEST_F(AddrListBenchTest, lookup2M)
+{
+    benchRanges(FORT_CONF_IP_MAX);
+}
+
+TEST_F(AddrListBenchTest, addrList1K)
+{
+    benchAddrList(500, 500);
+}
+
+TEST_F(AddrListBenchTest, addrList100K)
+{
+    benchAddrList(50 * 1000, 50 * 1000);
+}
+
+TEST_F(AddrListBenchTest, addrList2M)
+{
+    benchAddrList(FORT_CONF_IP_MAX / 2, FORT_CONF_IP_MAX / 2);
+}
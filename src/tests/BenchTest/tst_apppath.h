@@ -0,0 +1,153 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+
+#include <googletest.h>
+
+#include <conf/addressgroup.h>
+#include <conf/appgroup.h>
+#include <conf/firewallconf.h>
+#include <driver/drivercommon.h>
+#include <manager/envmanager.h>
+#include <util/conf/confutil.h>
+#include <util/fileutil.h>
+
+class AppPathBenchTest : public Test
+{
+    // Test interface
+protected:
+    void SetUp();
+    void TearDown();
+
+    void benchAppPaths(int exeCount);
+};
+
+void AppPathBenchTest::SetUp() { }
+
+void AppPathBenchTest::TearDown() { }
+
+namespace {
+
+constexpr int appLookupCount = 100 * 1000;
+constexpr int wildAppCount = 16;
+
+QString exeAppPath(int i)
+{
+    return QString("C:\\Apps\\App%1\\Bin\\app%1.exe").arg(i);
+}
+
+QString prefixAppPath(int i)
+{
+    return QString("D:\\Tools%1\\**").arg(i);
+}
+
+QString wildAppPath(int i)
+{
+    return QString("E:\\**\\Games%1\\*.exe").arg(i);
+}
+
+}
+
+void AppPathBenchTest::benchAppPaths(int exeCount)
+{
+    QRandomGenerator rand(exeCount);
+
+    const int prefixCount = exeCount / 10;
+
+    QStringList allowLines;
+    for (int i = 0; i < exeCount; ++i) {
+        allowLines.append(exeAppPath(i));
+    }
+    for (int i = 0; i < prefixCount; ++i) {
+        allowLines.append(prefixAppPath(i));
+    }
+    for (int i = 0; i < wildAppCount; ++i) {
+        allowLines.append(wildAppPath(i));
+    }
+
+    EnvManager envManager;
+    FirewallConf conf;
+
+    conf.inetAddressGroup()->setIncludeAll(true);
+
+    conf.setAppBlockAll(true);
+    conf.setAppAllowAll(false);
+
+    AppGroup *appGroup = new AppGroup();
+    appGroup->setName("Bench");
+    appGroup->setEnabled(true);
+    appGroup->setAllowText(allowLines.join('\n'));
+
+    conf.addAppGroup(appGroup);
+
+    conf.resetEdited(true);
+    conf.prepareToSave();
+
+    ConfUtil confUtil;
+
+    QByteArray buf;
+    ASSERT_NE(confUtil.write(conf, nullptr, envManager, buf), 0);
+
+    const char *data = buf.constData() + DriverCommon::confIoConfOff();
+
+    // Exe, prefix and wildcard apps are hit, each fourth path is not found
+    QStringList paths;
+    QVector<bool> allowed;
+    for (int i = 0; i < appLookupCount; ++i) {
+        QString path;
+        switch (i & 3) {
+        case 0:
+            path = exeAppPath(rand.bounded(exeCount));
+            break;
+        case 1:
+            path = QString("D:\\Tools%1\\Sub\\tool.exe").arg(rand.bounded(prefixCount));
+            break;
+        case 2:
+            path = QString("E:\\Dir\\Games%1\\game.exe").arg(rand.bounded(wildAppCount));
+            break;
+        default:
+            path = QString("C:\\Apps\\App%1\\Bin\\other.exe").arg(rand.bounded(exeCount));
+        }
+        paths.append(FileUtil::pathToKernelPath(path).toLower());
+        allowed.append((i & 3) != 3);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    quint32 flagsSum = 0;
+    for (const QString &path : qAsConst(paths)) {
+        flagsSum += DriverCommon::confAppFind(data, path);
+    }
+
+    const qint64 nsecs = timer.nsecsElapsed();
+
+    ASSERT_NE(flagsSum, 0);
+
+    qint8 blockReason = FORT_BLOCK_REASON_UNKNOWN;
+
+    for (int i = 0; i < appLookupCount; ++i) {
+        ASSERT_EQ(DriverCommon::confAppBlocked(
+                          data, DriverCommon::confAppFind(data, paths[i]), &blockReason),
+                !allowed[i]);
+    }
+
+    qDebug() << "exe apps>" << exeCount << "prefix apps>" << prefixCount << "wild apps>"
+             << wildAppCount << "find>" << (nsecs / appLookupCount) << "nsec/lookup";
+}
+
+TEST_F(AppPathBenchTest, find1K)
+{
+    benchAppPaths(1000);
+}
+
+TEST_F(AppPathBenchTest, find10K)
+{
+    benchAppPaths(10 * 1000);
+}
+
+TEST_F(AppPathBenchTest, find100K)
+{
+    benchAppPaths(100 * 1000);
+}
@@ -2,11 +2,14 @@ TEMPLATE = subdirs
 
 SUBDIRS = \
     Common \
+    BenchTest \
     LogBufferTest \
     LogReaderTest \
     StatTest \
+    TraceReplay \
     UtilTest
 
+BenchTest.depends = Common
 LogBufferTest.depends = Common
 LogReaderTest.depends = Common
 StatTest.depends = Common
@@ -109,6 +109,134 @@ TEST_F(LogBufferTest, blockedIpWriteRead)
     ASSERT_EQ(index, testCount);
 }
 
+TEST_F(LogBufferTest, pathDefineWriteRead)
+{
+    const QString path("C:\\test\\");
+    const quint16 pathId = 3;
+
+    const quint32 pathLen = path.size() * sizeof(wchar_t);
+    const quint32 pathRef = DriverCommon::logPathRef(pathId);
+
+    const int testCount = 3;
+
+    const int entrySize = DriverCommon::logPathDefineSize(pathLen)
+            + DriverCommon::logBlockedSize(pathRef) * testCount;
+
+    LogBuffer buf(entrySize);
+
+    LogEntryBlocked entry(1, path);
+
+    // Write
+    LogPathTable writeTable;
+    buf.setPathTable(&writeTable);
+
+    buf.writeEntryPathDefine(pathId, path);
+
+    for (int i = 0; i < testCount; ++i) {
+        buf.writeEntryBlocked(&entry);
+    }
+    ASSERT_EQ(buf.top(), entrySize);
+
+    // Read
+    LogPathTable readTable;
+    buf.setPathTable(&readTable);
+
+    ASSERT_EQ(buf.peekEntryType(), FORT_LOG_TYPE_PATH_DEFINE);
+    buf.readEntryPathDefine();
+    ASSERT_EQ(readTable.value(pathId), path);
+
+    int readCount = 0;
+    while (buf.peekEntryType() == FORT_LOG_TYPE_BLOCKED) {
+        entry.setKernelPath(QString());
+        buf.readEntryBlocked(&entry);
+
+        ASSERT_EQ(entry.kernelPath(), path);
+
+        ++readCount;
+    }
+    ASSERT_EQ(readCount, testCount);
+}
+
+TEST_F(LogBufferTest, blockedIpRepeatWriteRead)
+{
+    const QString path("C:\\test\\");
+    const quint32 pathLen = path.size() * sizeof(wchar_t);
+
+    const int entrySize = DriverCommon::logBlockedIpRepeatSize(pathLen);
+
+    LogBuffer buf(entrySize);
+
+    const qint64 unixTime = DateUtil::getUnixTime();
+
+    LogEntryBlockedIp entry;
+    entry.setKernelPath(path);
+    entry.setBlockReason(2);
+    entry.setRemoteIp(0x7F000001);
+    entry.setRemotePort(443);
+    entry.setPid(4);
+    entry.setRepeatCount(99);
+    entry.setFirstTime(unixTime - 3);
+    entry.setLastTime(unixTime);
+
+    // Write
+    buf.writeEntryBlockedIpRepeat(&entry);
+    ASSERT_EQ(buf.top(), entrySize);
+
+    // Read
+    LogEntryBlockedIp readEntry;
+
+    ASSERT_EQ(buf.peekEntryType(), FORT_LOG_TYPE_BLOCKED_IP_REPEAT);
+    buf.readEntryBlockedIpRepeat(&readEntry);
+
+    ASSERT_EQ(readEntry.kernelPath(), path);
+    ASSERT_EQ(readEntry.blockReason(), 2);
+    ASSERT_EQ(readEntry.remoteIp(), 0x7F000001);
+    ASSERT_EQ(readEntry.remotePort(), 443);
+    ASSERT_EQ(readEntry.pid(), 4);
+    ASSERT_EQ(readEntry.repeatCount(), 99);
+    ASSERT_EQ(readEntry.firstTime(), unixTime - 3);
+    ASSERT_EQ(readEntry.lastTime(), unixTime);
+}
+
+TEST_F(LogBufferTest, allowedIpWriteRead)
+{
+    const QString path("C:\\test\\");
+    const quint32 pathLen = path.size() * sizeof(wchar_t);
+
+    const int entrySize = DriverCommon::logAllowedIpSize(pathLen);
+
+    LogBuffer buf(entrySize);
+
+    LogEntryBlockedIp entry;
+    entry.setBlocked(false);
+    entry.setKernelPath(path);
+    entry.setInbound(true);
+    entry.setIpProto(6);
+    entry.setRemoteIp(0x7F000001);
+    entry.setRemotePort(443);
+    entry.setPid(4);
+    entry.setRepeatCount(5000);
+
+    // Write
+    buf.writeEntryAllowedIp(&entry);
+    ASSERT_EQ(buf.top(), entrySize);
+
+    // Read
+    LogEntryBlockedIp readEntry;
+
+    ASSERT_EQ(buf.peekEntryType(), FORT_LOG_TYPE_ALLOWED_IP);
+    buf.readEntryAllowedIp(&readEntry);
+
+    ASSERT_FALSE(readEntry.blocked());
+    ASSERT_TRUE(readEntry.inbound());
+    ASSERT_EQ(readEntry.kernelPath(), path);
+    ASSERT_EQ(readEntry.ipProto(), 6);
+    ASSERT_EQ(readEntry.remoteIp(), 0x7F000001);
+    ASSERT_EQ(readEntry.remotePort(), 443);
+    ASSERT_EQ(readEntry.pid(), 4);
+    ASSERT_EQ(readEntry.repeatCount(), 5000);
+}
+
 TEST_F(LogBufferTest, timeWriteRead)
 {
     const int entrySize = DriverCommon::logTimeSize();
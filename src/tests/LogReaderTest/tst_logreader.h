@@ -85,6 +85,11 @@ void printLogs(LogBuffer &buf)
         if (logType == FORT_LOG_TYPE_NONE)
             break;
 
+        if (logType == FORT_LOG_TYPE_PATH_DEFINE) {
+            buf.readEntryPathDefine();
+            continue;
+        }
+
         if (logType == FORT_LOG_TYPE_TIME) {
             LogEntryTime entry;
             buf.readEntryTime(&entry);
@@ -113,6 +118,9 @@ TEST_F(LogReaderTest, logRead)
 
     LogBuffer buf(DriverCommon::bufferSize());
 
+    LogPathTable pathTable;
+    buf.setPathTable(&pathTable);
+
     for (;;) {
         int nr;
         QByteArray &array = buf.array();
@@ -0,0 +1,12 @@
+include(../../global.pri)
+
+include(../../ui/FortFirewallUI.pri)
+
+CONFIG += console
+CONFIG -= app_bundle debug_and_release
+
+TARGET = TraceReplay
+TEMPLATE = app
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,306 @@
+// Replay the driver's classify trace with the saved conf:
+// TraceReplay <trace.bin> <trace.conf>
+//
+// The trace and the conf are saved by the "FortFirewall -c trace start|drain" commands.
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QVector>
+
+#include <algorithm>
+#include <cstdio>
+
+#include <common/fortconf.h>
+#include <common/fortdef.h>
+
+namespace {
+
+constexpr int diffsPrintMax = 100;
+
+enum ReplayStage : qint8 {
+    StageIsInet = 0,
+    StageInetIncluded,
+    StageAppFind,
+    StageAppBlocked,
+    StageCount
+};
+
+const char *const stageNames[StageCount] = {
+    "ip_is_inet",
+    "ip_inet_included",
+    "app_find",
+    "app_blocked",
+};
+
+struct ReplayStat
+{
+    int classifyCount = 0;
+    int keptCount = 0;
+    int lostCount = 0;
+    int diffCount = 0;
+
+    qint64 ticksFreq = 0;
+    QVector<quint32> tracedTicks;
+
+    qint64 stageNsecs[StageCount] = {};
+    int stageCalls[StageCount] = {};
+};
+
+struct ReplayVerdict
+{
+    bool blocked = true;
+    qint8 blockReason = FORT_BLOCK_REASON_UNKNOWN;
+
+    quint8 traceFlags() const
+    {
+        return blocked ? FORT_TRACE_BLOCKED
+                       : (blockReason == FORT_BLOCK_REASON_NONE ? FORT_TRACE_CONTINUE : 0);
+    }
+};
+
+class StageTimer
+{
+public:
+    StageTimer(ReplayStat &stat, ReplayStage stage) : m_stat(stat), m_stage(stage)
+    {
+        m_timer.start();
+    }
+
+    ~StageTimer()
+    {
+        m_stat.stageNsecs[m_stage] += m_timer.nsecsElapsed();
+        ++m_stat.stageCalls[m_stage];
+    }
+
+private:
+    ReplayStat &m_stat;
+    const ReplayStage m_stage;
+    QElapsedTimer m_timer;
+};
+
+// Same decisions as the driver's fort_callout_classify_v4_blocked(), without side effects
+ReplayVerdict replayClassify(const PFORT_CONF conf, const FORT_TRACE_RECORD &rec,
+        const QByteArray &path, ReplayStat &stat)
+{
+    const FORT_CONF_FLAGS conf_flags = conf->flags;
+
+    ReplayVerdict verdict;
+
+    if (conf_flags.filter_enabled) {
+        if (conf_flags.stop_traffic)
+            return verdict; // block all
+
+        bool isInet;
+        {
+            StageTimer t(stat, StageIsInet);
+            isInet = fort_conf_ip_is_inet(conf, nullptr, nullptr, rec.remote_ip);
+        }
+        if (!isInet) {
+            verdict.blocked = false;
+            return verdict; // allow LocalNetwork
+        }
+
+        if (conf_flags.stop_inet_traffic)
+            return verdict; // block Internet
+
+        bool inetIncluded;
+        {
+            StageTimer t(stat, StageInetIncluded);
+            inetIncluded = fort_conf_ip_inet_included(conf, nullptr, nullptr, rec.remote_ip);
+        }
+        if (!inetIncluded) {
+            verdict.blockReason = FORT_BLOCK_REASON_IP_INET;
+            return verdict; // block address
+        }
+    } else {
+        verdict.blocked = false;
+
+        if (!(conf_flags.log_stat && conf_flags.log_stat_no_filter))
+            return verdict; // allow (Filter Disabled)
+    }
+
+    FORT_APP_FLAGS app_flags;
+    {
+        StageTimer t(stat, StageAppFind);
+        app_flags = fort_conf_app_find(conf, (const PVOID) path.constData(), path.size(),
+                fort_conf_app_exe_find);
+    }
+
+    if (!verdict.blocked || (app_flags.v == 0 && conf_flags.allow_all_new)) {
+        verdict.blocked = false;
+        return verdict;
+    }
+
+    StageTimer t(stat, StageAppBlocked);
+    verdict.blocked = fort_conf_app_blocked(conf, app_flags, &verdict.blockReason);
+
+    return verdict;
+}
+
+QString ipToText(quint32 ip)
+{
+    return QString("%1.%2.%3.%4")
+            .arg(ip >> 24)
+            .arg((ip >> 16) & 0xFF)
+            .arg((ip >> 8) & 0xFF)
+            .arg(ip & 0xFF);
+}
+
+const char *actionText(quint8 flags)
+{
+    return (flags & FORT_TRACE_BLOCKED) ? "block"
+                                        : ((flags & FORT_TRACE_CONTINUE) ? "continue" : "permit");
+}
+
+void printDiff(const FORT_TRACE_RECORD &rec, const QByteArray &path, const ReplayVerdict &verdict)
+{
+    const QString pathText = QString::fromWCharArray(
+            (const wchar_t *) path.constData(), path.size() / int(sizeof(wchar_t)));
+
+    printf("diff: pid=%u path=%s %s %s:%u proto=%u traced=%s(%d) replayed=%s(%d)\n",
+            rec.process_id, qPrintable(pathText), (rec.flags & FORT_TRACE_INBOUND) ? "<-" : "->",
+            qPrintable(ipToText(rec.remote_ip)), rec.remote_port, rec.ip_proto,
+            actionText(rec.flags), rec.block_reason, actionText(verdict.traceFlags()),
+            verdict.blockReason);
+}
+
+void replayRecord(const PFORT_CONF conf, const FORT_TRACE_RECORD &rec, const QByteArray &path,
+        ReplayStat &stat)
+{
+    ++stat.classifyCount;
+    stat.tracedTicks.append(rec.ticks);
+
+    if (rec.flags & FORT_TRACE_KEPT) {
+        ++stat.keptCount; // the verdict was not checked in the driver
+        return;
+    }
+
+    const ReplayVerdict verdict = replayClassify(conf, rec, path, stat);
+
+    const quint8 actionMask = (FORT_TRACE_BLOCKED | FORT_TRACE_CONTINUE);
+
+    if ((rec.flags & actionMask) != verdict.traceFlags()) {
+        if (++stat.diffCount <= diffsPrintMax) {
+            printDiff(rec, path, verdict);
+        }
+    }
+}
+
+bool replayTrace(const PFORT_CONF conf, const QByteArray &trace, ReplayStat &stat)
+{
+    QHash<quint16, QByteArray> paths;
+
+    // Path's chars may be in the next drained chunk
+    QByteArray *pathData = nullptr;
+    quint32 pathRemaining = 0;
+
+    const char *p = trace.constData();
+    const char *end = p + trace.size();
+
+    while (p + sizeof(FORT_TRACE_HEADER) <= end) {
+        const FORT_TRACE_HEADER *header = reinterpret_cast<const FORT_TRACE_HEADER *>(p);
+        p += sizeof(FORT_TRACE_HEADER);
+
+        if (p + header->record_n * sizeof(FORT_TRACE_RECORD) > end)
+            return false;
+
+        stat.lostCount += header->lost_n;
+        stat.ticksFreq = header->ticks_freq;
+
+        const FORT_TRACE_RECORD *rec = reinterpret_cast<const FORT_TRACE_RECORD *>(p);
+        p += header->record_n * sizeof(FORT_TRACE_RECORD);
+
+        for (quint32 i = 0; i < header->record_n; ++i, ++rec) {
+            if (pathRemaining != 0) {
+                const quint32 size = std::min<quint32>(pathRemaining, sizeof(FORT_TRACE_RECORD));
+
+                pathData->append(reinterpret_cast<const char *>(rec), size);
+                pathRemaining -= size;
+                continue;
+            }
+
+            switch (rec->type) {
+            case FORT_TRACE_PATH: {
+                pathData = &paths[rec->path_id];
+                pathData->clear();
+                pathRemaining = rec->path_len;
+            } break;
+            case FORT_TRACE_CLASSIFY: {
+                replayRecord(conf, *rec, paths.value(rec->path_id), stat);
+            } break;
+            default:
+                return false;
+            }
+        }
+    }
+
+    return p == end;
+}
+
+void printStat(const ReplayStat &stat)
+{
+    printf("classify: records=%d kept=%d lost=%d diffs=%d\n", stat.classifyCount, stat.keptCount,
+            stat.lostCount, stat.diffCount);
+
+    if (!stat.tracedTicks.isEmpty() && stat.ticksFreq != 0) {
+        QVector<quint32> ticks = stat.tracedTicks;
+        std::sort(ticks.begin(), ticks.end());
+
+        const double nsPerTick = 1e9 / stat.ticksFreq;
+
+        printf("traced: p50=%.0fns p99=%.0fns\n", ticks.at(ticks.size() / 2) * nsPerTick,
+                ticks.at(qint64(ticks.size()) * 99 / 100) * nsPerTick);
+    }
+
+    for (int i = 0; i < StageCount; ++i) {
+        const int calls = stat.stageCalls[i];
+
+        printf("replayed %-16s: calls=%d avg=%lldns\n", stageNames[i], calls,
+                calls ? (stat.stageNsecs[i] / calls) : 0);
+    }
+}
+
+QByteArray readFile(const char *filePath)
+{
+    QFile file(QString::fromLocal8Bit(filePath));
+    if (!file.open(QFile::ReadOnly))
+        return QByteArray();
+
+    return file.readAll();
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        printf("Usage: TraceReplay <trace.bin> <trace.conf>\n");
+        return 1;
+    }
+
+    const QByteArray trace = readFile(argv[1]);
+    QByteArray confData = readFile(argv[2]);
+
+    if (confData.size() <= int(FORT_CONF_IO_CONF_OFF + FORT_CONF_DATA_OFF)) {
+        printf("Invalid conf: %s\n", argv[2]);
+        return 1;
+    }
+
+    // Zones are set separately, so the conf's zone-based address lists are not replayed
+    const PFORT_CONF conf = reinterpret_cast<PFORT_CONF>(confData.data() + FORT_CONF_IO_CONF_OFF);
+
+    fort_conf_app_perms_mask_init(conf, conf->flags.group_bits);
+
+    ReplayStat stat;
+
+    if (!replayTrace(conf, trace, stat)) {
+        printf("Invalid trace: %s\n", argv[1]);
+        return 1;
+    }
+
+    printStat(stat);
+
+    return 0;
+}
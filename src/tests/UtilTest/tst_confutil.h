@@ -4,6 +4,8 @@
 
 #include <googletest.h>
 
+#include <common/fortconf.h>
+#include <common/wildmatch.h>
 #include <conf/addressgroup.h>
 #include <conf/appgroup.h>
 #include <conf/firewallconf.h>
@@ -12,7 +14,9 @@
 #include <manager/envmanager.h>
 #include <util/conf/confappswalker.h>
 #include <util/conf/confutil.h>
+#include <util/conf/confwildindex.h>
 #include <util/fileutil.h>
+#include <util/net/ip4range.h>
 #include <util/net/netutil.h>
 
 class ConfUtilTest : public Test
@@ -52,12 +56,14 @@ TEST_F(ConfUtilTest, confWriteRead)
     appGroup1->setBlockText("System");
     appGroup1->setAllowText("C:\\Program Files\\Skype\\Phone\\Skype.exe\n"
                             "?:\\Utils\\Dev\\Git\\**\n"
-                            "D:\\**\\Programs\\**\n");
+                            "D:\\**\\Programs\\**\n"
+                            "C:\\Utils\\Dev\\**\n");
 
     AppGroup *appGroup2 = new AppGroup();
     appGroup2->setName("Browser");
     appGroup2->setEnabled(false);
-    appGroup2->setAllowText("C:\\Utils\\Firefox\\Bin\\firefox.exe");
+    appGroup2->setAllowText("C:\\Utils\\Firefox\\Bin\\firefox.exe\n"
+                            "C:\\Utils\\**\n");
     appGroup2->setLimitInEnabled(true);
     appGroup2->setSpeedLimitIn(1024);
 
@@ -122,6 +128,252 @@ TEST_F(ConfUtilTest, confWriteRead)
     ASSERT_TRUE(DriverCommon::confAppBlocked(data, firefoxFlags, &blockReason));
     ASSERT_EQ(blockReason, FORT_BLOCK_REASON_APP_GROUP_FOUND);
     ASSERT_EQ(int(DriverCommon::confAppGroupIndex(firefoxFlags)), 1);
+
+    // The longest prefix wins
+    ASSERT_EQ(int(DriverCommon::confAppGroupIndex(DriverCommon::confAppFind(
+                      data, FileUtil::pathToKernelPath("C:\\Utils\\Dev\\Test.exe")))),
+            0);
+    ASSERT_EQ(int(DriverCommon::confAppGroupIndex(DriverCommon::confAppFind(
+                      data, FileUtil::pathToKernelPath("C:\\Utils\\Test.exe")))),
+            1);
+}
+
+TEST_F(ConfUtilTest, confWritePatch)
+{
+    EnvManager envManager;
+    FirewallConf conf;
+
+    AddressGroup *inetGroup = conf.inetAddressGroup();
+    inetGroup->setIncludeAll(true);
+    inetGroup->setExcludeText(NetUtil::localIpv4Networks().join('\n'));
+
+    AppGroup *appGroup = new AppGroup();
+    appGroup->setName("Base");
+    appGroup->setEnabled(true);
+    appGroup->setBlockText("System");
+    appGroup->setAllowText("C:\\Utils\\**\n");
+
+    conf.addAppGroup(appGroup);
+
+    conf.resetEdited(true);
+    conf.prepareToSave();
+
+    ConfUtil confUtil;
+
+    QByteArray buf;
+    const int confIoSize = confUtil.write(conf, nullptr, envManager, buf);
+    ASSERT_NE(confIoSize, 0);
+
+    const QByteArray exeAppsKey = confUtil.exeAppsKey();
+    ASSERT_FALSE(exeAppsKey.isEmpty());
+
+    // The patch has no exe apps
+    QByteArray patchBuf;
+    const int patchSize = confUtil.writePatch(conf, envManager, patchBuf);
+    ASSERT_NE(patchSize, 0);
+    ASSERT_LT(patchSize, confIoSize);
+    ASSERT_EQ(confUtil.exeAppsKey(), exeAppsKey);
+
+    const char *data = patchBuf.constData() + DriverCommon::confIoConfOff();
+
+    ASSERT_EQ(DriverCommon::confAppFind(data, "System"), 0);
+    ASSERT_NE(DriverCommon::confAppFind(data, FileUtil::pathToKernelPath("C:\\Utils\\Test.exe")),
+            0);
+
+    // Addresses don't change the exe apps
+    inetGroup->setExcludeText(QString());
+    ASSERT_NE(confUtil.writePatch(conf, envManager, patchBuf), 0);
+    ASSERT_EQ(confUtil.exeAppsKey(), exeAppsKey);
+
+    // Exe apps of the app group's text must be written with the programs
+    appGroup->setBlockText("System\nC:\\Test.exe");
+    ASSERT_NE(confUtil.writePatch(conf, envManager, patchBuf), 0);
+    ASSERT_NE(confUtil.exeAppsKey(), exeAppsKey);
+}
+
+TEST_F(ConfUtilTest, zonesWriteRead)
+{
+    ConfUtil confUtil;
+
+    Ip4Range ip4Range1;
+    ASSERT_TRUE(ip4Range1.fromText("10.0.0.0/8\n"
+                                   "192.168.1.1\n"
+                                   "255.255.255.0/24"));
+
+    Ip4Range ip4Range2;
+    ASSERT_TRUE(ip4Range2.fromText("10.1.0.0-10.1.255.255\n"
+                                   "172.16.0.1"));
+
+    QByteArray zoneData1;
+    zoneData1.resize(confUtil.writeZone(ip4Range1, zoneData1));
+
+    QByteArray zoneData2;
+    zoneData2.resize(confUtil.writeZone(ip4Range2, zoneData2));
+
+    // Zone IDs: 1, 3
+    const quint32 zonesMask = 0x01 | 0x04;
+
+    QByteArray buf;
+    const int zonesSize = confUtil.writeZones(zonesMask, zonesMask, { zoneData1, zoneData2 }, buf);
+    ASSERT_NE(zonesSize, 0);
+
+    const char *data = buf.constData();
+
+    ASSERT_EQ(DriverCommon::confZonesIpMask(data, 0), 0u);
+    ASSERT_EQ(DriverCommon::confZonesIpMask(data, NetUtil::textToIp4("9.255.255.255")), 0u);
+    ASSERT_EQ(DriverCommon::confZonesIpMask(data, NetUtil::textToIp4("10.0.0.0")), 0x01u);
+    ASSERT_EQ(DriverCommon::confZonesIpMask(data, NetUtil::textToIp4("10.1.0.0")), 0x05u);
+    ASSERT_EQ(DriverCommon::confZonesIpMask(data, NetUtil::textToIp4("10.1.255.255")), 0x05u);
+    ASSERT_EQ(DriverCommon::confZonesIpMask(data, NetUtil::textToIp4("10.2.0.0")), 0x01u);
+    ASSERT_EQ(DriverCommon::confZonesIpMask(data, NetUtil::textToIp4("11.0.0.0")), 0u);
+    ASSERT_EQ(DriverCommon::confZonesIpMask(data, NetUtil::textToIp4("172.16.0.1")), 0x04u);
+    ASSERT_EQ(DriverCommon::confZonesIpMask(data, NetUtil::textToIp4("172.16.0.2")), 0u);
+    ASSERT_EQ(DriverCommon::confZonesIpMask(data, NetUtil::textToIp4("192.168.1.1")), 0x01u);
+    ASSERT_EQ(DriverCommon::confZonesIpMask(data, NetUtil::textToIp4("255.255.254.255")), 0u);
+    ASSERT_EQ(DriverCommon::confZonesIpMask(data, NetUtil::textToIp4("255.255.255.255")), 0x01u);
+}
+
+TEST_F(ConfUtilTest, wildAnchors)
+{
+    ASSERT_EQ(ConfWildIndex::literalAnchor("*\\node_modules\\*"), "\\node_modules\\");
+    ASSERT_EQ(ConfWildIndex::literalAnchor("?:\\Utils\\Dev\\Git\\**"), ":\\Utils\\Dev\\Git\\");
+    ASSERT_EQ(ConfWildIndex::literalAnchor("D:\\**\\Programs\\**"), "Programs\\");
+    ASSERT_EQ(ConfWildIndex::literalAnchor("C:\\[ab]in\\*.exe"), ".exe");
+    ASSERT_EQ(ConfWildIndex::literalAnchor("C:\\[]a]bcde"), "bcde");
+    ASSERT_EQ(ConfWildIndex::literalAnchor("C:\\[ab"), QString());
+    ASSERT_EQ(ConfWildIndex::literalAnchor("*"), QString());
+}
+
+namespace {
+
+// The wildcard apps' search before the prefilter: check all apps in the config's order
+quint16 wildAppFindLinear(const char *data, const QString &kernelPath)
+{
+    const PFORT_CONF conf = (const PFORT_CONF) data;
+    const QString kernelPathLower = kernelPath.toLower();
+    const WCHAR *path = (PCWCHAR) kernelPathLower.utf16();
+
+    const UINT32 *appOffsets = (const UINT32 *) (conf->data + conf->wild_apps_off);
+    const char *appEntries = (const char *) (appOffsets + conf->wild_apps_n + 1);
+
+    for (int i = 0; i < conf->wild_apps_n; ++i) {
+        const PFORT_APP_ENTRY appEntry = (const PFORT_APP_ENTRY) (appEntries + appOffsets[i]);
+        const WCHAR *appPath = (const WCHAR *) (appEntry + 1);
+
+        if (wildmatch(appPath, path) == WM_MATCH)
+            return appEntry->flags.v;
+    }
+
+    return 0;
+}
+
+}
+
+TEST_F(ConfUtilTest, wildPrefilterFirstMatch)
+{
+    QStringList wildPaths = {
+        // Literals with wildcards
+        "C:\\Program Files\\*\\Bin\\App.exe",
+        "C:\\[ab]in\\*.exe",
+        "C:\\Games\\*\\Game?.exe",
+        // Leading '*'
+        "*\\node_modules\\*",
+        "*\\Temp\\*.exe",
+        "*.tmp",
+        // '**'
+        "?:\\Utils\\Dev\\Git\\**",
+        "D:\\**\\Programs\\**",
+        "D:\\**\\Programs\\*.exe",
+        "*\\Steam\\**",
+        "E:\\Work\\**\\Build\\*",
+        // Case variants
+        "c:\\program files\\*\\bin\\app.exe",
+        "E:\\WORK\\**\\build\\*",
+        "*\\STEAM\\**",
+    };
+
+    // Many apps with the same anchor to overflow the candidates of a pass
+    for (int i = 0; i < 40; ++i) {
+        wildPaths.append(QString("*\\X\\*%1*").arg(i));
+    }
+
+    EnvManager envManager;
+    FirewallConf conf;
+
+    conf.inetAddressGroup()->setIncludeAll(true);
+
+    conf.setAppBlockAll(true);
+    conf.setAppAllowAll(false);
+
+    // Spread the apps over the groups to tell the matched ones by the flags
+    for (int groupIndex = 0; groupIndex < FORT_CONF_GROUP_MAX; ++groupIndex) {
+        QStringList allowLines;
+        for (int i = groupIndex; i < wildPaths.size(); i += FORT_CONF_GROUP_MAX) {
+            allowLines.append(wildPaths[i]);
+        }
+
+        AppGroup *appGroup = new AppGroup();
+        appGroup->setName(QString("Group%1").arg(groupIndex));
+        appGroup->setEnabled(true);
+        appGroup->setAllowText(allowLines.join('\n'));
+
+        conf.addAppGroup(appGroup);
+    }
+
+    conf.resetEdited(true);
+    conf.prepareToSave();
+
+    ConfUtil confUtil;
+
+    QByteArray buf;
+    ASSERT_NE(confUtil.write(conf, nullptr, envManager, buf), 0);
+
+    const char *data = buf.constData() + DriverCommon::confIoConfOff();
+
+    QStringList paths = {
+        "C:\\Program Files\\Vendor\\Bin\\App.exe",
+        "C:\\Program Files\\Vendor\\Sub\\Bin\\App.exe",
+        "C:\\bin\\tool.exe",
+        "C:\\ain\\tool.exe",
+        "C:\\cin\\tool.exe",
+        "C:\\Games\\Quake\\Game1.exe",
+        "C:\\Games\\Quake\\Game12.exe",
+        "C:\\Projects\\Site\\node_modules\\npm.exe",
+        "C:\\Users\\Me\\AppData\\Local\\Temp\\setup.exe",
+        "C:\\Users\\Me\\AppData\\Local\\Temp\\Sub\\setup.exe",
+        "C:\\Users\\Me\\file.tmp",
+        "C:\\Utils\\Dev\\Git\\bin\\git.exe",
+        "D:\\Utils\\Dev\\Git\\git.exe",
+        "D:\\My\\Programs\\Test.exe",
+        "D:\\My\\Programs\\Sub\\Test.dll",
+        "D:\\Programs\\Test.exe",
+        "C:\\Games\\Steam\\steam.exe",
+        "E:\\Work\\Repo\\Build\\app.exe",
+        "E:\\Work\\Build\\app.exe",
+        "C:\\X\\file39.exe",
+        "C:\\X\\file7.exe",
+        "C:\\Y\\X\\file.exe",
+        "C:\\Windows\\notepad.exe",
+    };
+
+    // Case variants of the paths
+    const int pathCount = paths.size();
+    for (int i = 0; i < pathCount; ++i) {
+        paths.append(paths[i].toUpper());
+    }
+
+    int foundCount = 0;
+
+    for (const QString &path : qAsConst(paths)) {
+        const QString kernelPath = FileUtil::pathToKernelPath(path);
+        const quint16 appFlags = wildAppFindLinear(data, kernelPath);
+
+        ASSERT_EQ(DriverCommon::confAppFind(data, kernelPath), appFlags) << path.toStdString();
+
+        foundCount += (appFlags != 0);
+    }
+
+    ASSERT_GT(foundCount, pathCount);
 }
 
 TEST_F(ConfUtilTest, checkPeriod)
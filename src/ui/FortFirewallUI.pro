@@ -61,6 +61,7 @@ SOURCES += \
     form/prog/programeditdialog.cpp \
     form/prog/programscontroller.cpp \
     form/prog/programswindow.cpp \
+    form/stat/pages/calloutspage.cpp \
     form/stat/pages/connectionspage.cpp \
     form/stat/pages/statbasepage.cpp \
     form/stat/pages/statmainpage.cpp \
@@ -95,7 +96,9 @@ SOURCES += \
     manager/windowmanager.cpp \
     model/applistmodel.cpp \
     model/appstatmodel.cpp \
+    model/calloutstatmodel.cpp \
     model/connlistmodel.cpp \
+    model/driverstatmodel.cpp \
     model/servicelistmodel.cpp \
     model/traflistmodel.cpp \
     model/zonelistmodel.cpp \
@@ -129,7 +132,9 @@ SOURCES += \
     user/iniuser.cpp \
     user/usersettings.cpp \
     util/conf/addressrange.cpp \
+    util/conf/confprefixtrie.cpp \
     util/conf/confutil.cpp \
+    util/conf/confwildindex.cpp \
     util/dateutil.cpp \
     util/device.cpp \
     util/fileutil.cpp \
@@ -215,6 +220,7 @@ HEADERS += \
     form/prog/programeditdialog.h \
     form/prog/programscontroller.h \
     form/prog/programswindow.h \
+    form/stat/pages/calloutspage.h \
     form/stat/pages/connectionspage.h \
     form/stat/pages/statbasepage.h \
     form/stat/pages/statmainpage.h \
@@ -250,7 +256,9 @@ HEADERS += \
     manager/windowmanager.h \
     model/applistmodel.h \
     model/appstatmodel.h \
+    model/calloutstatmodel.h \
     model/connlistmodel.h \
+    model/driverstatmodel.h \
     model/servicelistmodel.h \
     model/traflistmodel.h \
     model/zonelistmodel.h \
@@ -286,7 +294,9 @@ HEADERS += \
     util/classhelpers.h \
     util/conf/addressrange.h \
     util/conf/confappswalker.h \
+    util/conf/confprefixtrie.h \
     util/conf/confutil.h \
+    util/conf/confwildindex.h \
     util/dateutil.h \
     util/device.h \
     util/fileutil.h \
@@ -1033,6 +1033,9 @@ bool ConfManager::validateDriver()
 
 bool ConfManager::updateDriverConf(bool onlyFlags)
 {
+    if (!onlyFlags && updateDriverConfPatch())
+        return true;
+
     ConfUtil confUtil;
     QByteArray buf;
 
@@ -1045,13 +1048,49 @@ bool ConfManager::updateDriverConf(bool onlyFlags)
 
     auto driverManager = IoC<DriverManager>();
     if (!driverManager->writeConf(buf, confSize, onlyFlags)) {
+        m_driverExeAppsKey.clear();
+
         showErrorMessage(driverManager->errorMessage());
         return false;
     }
 
+    if (!onlyFlags) {
+        m_driverExeAppsKey = confUtil.exeAppsKey();
+    }
+
     return true;
 }
 
+bool ConfManager::updateDriverConfPatch()
+{
+    if (m_driverExeAppsKey.isEmpty())
+        return false;
+
+    ConfUtil confUtil;
+    QByteArray buf;
+
+    // Don't walk the programs, when the driver's exe apps are still actual
+    const int confSize = confUtil.writePatch(*conf(), *IoC<EnvManager>(), buf);
+    if (confSize == 0 || confUtil.exeAppsKey() != m_driverExeAppsKey)
+        return false;
+
+    return IoC<DriverManager>()->writeConfPatch(buf, confSize);
+}
+
+bool ConfManager::exportDriverConf(const QString &filePath)
+{
+    ConfUtil confUtil;
+    QByteArray buf;
+
+    const int confSize = confUtil.write(*conf(), this, *IoC<EnvManager>(), buf);
+    if (confSize == 0)
+        return false;
+
+    buf.resize(confSize);
+
+    return FileUtil::writeFileData(filePath, buf);
+}
+
 bool ConfManager::addOrUpdateApp(const QString &appPath, const QString &appName,
         const QDateTime &endTime, int groupIndex, bool useGroupPerm, bool applyChild, bool blocked,
         bool alerted)
@@ -1144,13 +1183,13 @@ bool ConfManager::updateDriverUpdateApp(const QString &appPath, int groupIndex,
     return true;
 }
 
-void ConfManager::updateDriverZones(quint32 zonesMask, quint32 enabledMask, quint32 dataSize,
-        const QList<QByteArray> &zonesData)
+void ConfManager::updateDriverZones(
+        quint32 zonesMask, quint32 enabledMask, const QList<QByteArray> &zonesData)
 {
     ConfUtil confUtil;
     QByteArray buf;
 
-    const int entrySize = confUtil.writeZones(zonesMask, enabledMask, dataSize, zonesData, buf);
+    const int entrySize = confUtil.writeZones(zonesMask, enabledMask, zonesData, buf);
 
     if (entrySize == 0) {
         showErrorMessage(confUtil.errorMessage());
@@ -90,8 +90,9 @@ public:
 
     bool validateDriver();
     virtual bool updateDriverConf(bool onlyFlags = false);
-    void updateDriverZones(quint32 zonesMask, quint32 enabledMask, quint32 dataSize,
-            const QList<QByteArray> &zonesData);
+    bool exportDriverConf(const QString &filePath);
+    void updateDriverZones(
+            quint32 zonesMask, quint32 enabledMask, const QList<QByteArray> &zonesData);
 
 signals:
     void confChanged(bool onlyFlags);
@@ -116,6 +117,8 @@ protected:
 private:
     void setupDefault(FirewallConf &conf) const;
 
+    bool updateDriverConfPatch();
+
     void emitAppAlerted();
     void emitAppChanged();
     void emitAppUpdated();
@@ -153,6 +156,8 @@ private:
     TriggerTimer m_appUpdatedTimer;
 
     QTimer m_appEndTimer;
+
+    QByteArray m_driverExeAppsKey; // of the conf in the driver
 };
 
 #endif // CONFMANAGER_H
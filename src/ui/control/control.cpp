@@ -12,6 +12,7 @@ const char *const commandString(Command cmd)
         CASE_STRING(CommandNone)
 
         CASE_STRING(Prog)
+        CASE_STRING(Trace)
 
         CASE_STRING(Rpc_Result_Ok)
         CASE_STRING(Rpc_Result_Error)
@@ -42,6 +43,7 @@ const char *const commandString(Command cmd)
         CASE_STRING(Rpc_ConfManager_zoneUpdated)
 
         CASE_STRING(Rpc_DriverManager_updateState)
+        CASE_STRING(Rpc_DriverManager_readStats)
 
         CASE_STRING(Rpc_QuotaManager_alert)
 
@@ -92,6 +94,7 @@ RpcManager managerByCommand(Command cmd)
         Rpc_NoneManager, // CommandNone = 0,
 
         Rpc_NoneManager, // Prog,
+        Rpc_NoneManager, // Trace,
 
         Rpc_NoneManager, // Rpc_Result_Ok,
         Rpc_NoneManager, // Rpc_Result_Error,
@@ -124,6 +127,7 @@ RpcManager managerByCommand(Command cmd)
         Rpc_ConfManager, // Rpc_ConfManager_zoneUpdated,
 
         Rpc_DriverManager, // Rpc_DriverManager_updateState,
+        Rpc_DriverManager, // Rpc_DriverManager_readStats,
 
         Rpc_QuotaManager, // Rpc_QuotaManager_alert,
 
@@ -157,6 +161,7 @@ bool commandRequiresValidation(Command cmd)
         0, // CommandNone = 0,
 
         0, // Prog,
+        0, // Trace,
 
         0, // Rpc_Result_Ok,
         0, // Rpc_Result_Error,
@@ -189,6 +194,7 @@ bool commandRequiresValidation(Command cmd)
         0, // Rpc_ConfManager_zoneUpdated,
 
         0, // Rpc_DriverManager_updateState,
+        0, // Rpc_DriverManager_readStats,
 
         0, // Rpc_QuotaManager_alert,
 
@@ -10,6 +10,7 @@ enum Command : qint8 {
     CommandNone = 0,
 
     Prog,
+    Trace,
 
     Rpc_Result_Ok,
     Rpc_Result_Error,
@@ -42,6 +43,7 @@ enum Command : qint8 {
     Rpc_ConfManager_zoneUpdated,
 
     Rpc_DriverManager_updateState,
+    Rpc_DriverManager_readStats,
 
     Rpc_QuotaManager_alert,
 
@@ -10,6 +10,7 @@
 #include <conf/appgroup.h>
 #include <conf/confmanager.h>
 #include <conf/firewallconf.h>
+#include <driver/drivermanager.h>
 #include <fortsettings.h>
 #include <manager/windowmanager.h>
 #include <rpc/rpcmanager.h>
@@ -86,6 +87,8 @@ bool ControlManager::postCommand()
     Control::Command command;
     if (settings->controlCommand() == "prog") {
         command = Control::Prog;
+    } else if (settings->controlCommand() == "trace") {
+        command = Control::Trace;
     } else {
         logWarning() << "Unknown control command:" << settings->controlCommand();
         return false;
@@ -163,6 +166,10 @@ bool ControlManager::processCommand(const ProcessCommandArgs &p)
         if (processCommandProg(p))
             return true;
         break;
+    case Control::Trace:
+        if (processCommandTrace(p))
+            return true;
+        break;
     default:
         if (IoC<RpcManager>()->processCommandRpc(p))
             return true;
@@ -201,6 +208,45 @@ bool ControlManager::processCommandProg(const ProcessCommandArgs &p)
     return false;
 }
 
+bool ControlManager::processCommandTrace(const ProcessCommandArgs &p)
+{
+    const int argsSize = p.args.size();
+    if (argsSize < 1) {
+        p.errorMessage = "trace start|drain";
+        return false;
+    }
+
+    const QString traceCommand = p.args.at(0).toString();
+
+    const bool isStart = (traceCommand == "start");
+    if (!isStart && traceCommand != "drain")
+        return false;
+
+    const QString tracePath = IoC<FortSettings>()->logsPath() + "trace";
+
+    // Save the conf to replay the trace with
+    if (isStart && !IoC<ConfManager>()->exportDriverConf(tracePath + ".conf")) {
+        p.errorMessage = "Export conf error";
+        return false;
+    }
+
+    QByteArray buf;
+    if (!IoC<DriverManager>()->readTrace(buf, /*restart=*/isStart)) {
+        p.errorMessage = "Read trace error";
+        return false;
+    }
+
+    const QString traceFilePath = tracePath + ".bin";
+
+    if (isStart ? !FileUtil::writeFileData(traceFilePath, buf)
+                : !FileUtil::appendFileData(traceFilePath, buf)) {
+        p.errorMessage = "Write trace error";
+        return false;
+    }
+
+    return true;
+}
+
 void ControlManager::close()
 {
     if (m_server) {
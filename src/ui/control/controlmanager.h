@@ -51,6 +51,7 @@ private slots:
 private:
     bool processCommand(const ProcessCommandArgs &p);
     bool processCommandProg(const ProcessCommandArgs &p);
+    bool processCommandTrace(const ProcessCommandArgs &p);
 
     void close();
 
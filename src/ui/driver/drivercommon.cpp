@@ -1,5 +1,7 @@
 #include "drivercommon.h"
 
+#include <atomic>
+
 #include <common/fortconf.h>
 #include <common/fortioctl.h>
 #include <common/fortlog.h>
@@ -52,6 +54,26 @@ quint32 ioctlSetZoneFlag()
     return FORT_IOCTL_SETZONEFLAG;
 }
 
+quint32 ioctlMapLog()
+{
+    return FORT_IOCTL_MAPLOG;
+}
+
+quint32 ioctlPatchConf()
+{
+    return FORT_IOCTL_PATCHCONF;
+}
+
+quint32 ioctlGetTrace()
+{
+    return FORT_IOCTL_GETTRACE;
+}
+
+quint32 ioctlGetStats()
+{
+    return FORT_IOCTL_GETSTATS;
+}
+
 quint32 userErrorCode()
 {
     return FORT_ERROR_USER_ERROR;
@@ -72,6 +94,70 @@ quint32 confIoConfOff()
     return FORT_CONF_IO_CONF_OFF;
 }
 
+quint32 traceRestartFlag()
+{
+    return FORT_TRACE_RESTART;
+}
+
+quint32 traceSize(int recordCount)
+{
+    return sizeof(FORT_TRACE_HEADER) + recordCount * sizeof(FORT_TRACE_RECORD);
+}
+
+quint32 statsSize()
+{
+    return sizeof(FORT_STATS);
+}
+
+int calloutCount()
+{
+    return FORT_CALLOUT_COUNT;
+}
+
+int calloutLatencyBuckets()
+{
+    return FORT_CALLOUT_LATENCY_BUCKETS;
+}
+
+qint64 calloutStatsTicksFreq(const char *input)
+{
+    const PFORT_STATS stats = (const PFORT_STATS) input;
+
+    return stats->callout.ticks_freq;
+}
+
+void calloutStatRead(const char *input, int calloutId, quint64 *calls, quint64 *permits,
+        quint64 *blocks, quint64 *defers, quint64 *reauths)
+{
+    const PFORT_STATS stats = (const PFORT_STATS) input;
+    const PFORT_CALLOUT_STAT stat = &stats->callout.callouts[calloutId];
+
+    *calls = stat->calls;
+    *permits = stat->permits;
+    *blocks = stat->blocks;
+    *defers = stat->defers;
+    *reauths = stat->reauths;
+}
+
+quint64 calloutStatLatency(const char *input, int calloutId, int bucket)
+{
+    const PFORT_STATS stats = (const PFORT_STATS) input;
+
+    return stats->callout.callouts[calloutId].latency[bucket];
+}
+
+int driverStatCount()
+{
+    return FORT_DRIVER_STAT_COUNT;
+}
+
+quint64 driverStatValue(const char *input, int statId)
+{
+    const PFORT_STATS stats = (const PFORT_STATS) input;
+
+    return stats->driver.values[statId];
+}
+
 quint32 logBlockedHeaderSize()
 {
     return FORT_LOG_BLOCKED_HEADER_SIZE;
@@ -92,6 +178,26 @@ quint32 logBlockedIpSize(quint32 pathLen)
     return FORT_LOG_BLOCKED_IP_SIZE(pathLen);
 }
 
+quint32 logBlockedIpRepeatHeaderSize()
+{
+    return FORT_LOG_BLOCKED_IP_REPEAT_HEADER_SIZE;
+}
+
+quint32 logBlockedIpRepeatSize(quint32 pathLen)
+{
+    return FORT_LOG_BLOCKED_IP_REPEAT_SIZE(pathLen);
+}
+
+quint32 logAllowedIpHeaderSize()
+{
+    return FORT_LOG_ALLOWED_IP_HEADER_SIZE;
+}
+
+quint32 logAllowedIpSize(quint32 pathLen)
+{
+    return FORT_LOG_ALLOWED_IP_SIZE(pathLen);
+}
+
 quint32 logProcNewHeaderSize()
 {
     return FORT_LOG_PROC_NEW_HEADER_SIZE;
@@ -102,6 +208,31 @@ quint32 logProcNewSize(quint32 pathLen)
     return FORT_LOG_PROC_NEW_SIZE(pathLen);
 }
 
+quint32 logPathDefineHeaderSize()
+{
+    return FORT_LOG_PATH_DEFINE_HEADER_SIZE;
+}
+
+quint32 logPathDefineSize(quint32 pathLen)
+{
+    return FORT_LOG_PATH_DEFINE_SIZE(pathLen);
+}
+
+bool logPathIsRef(quint32 pathLen)
+{
+    return fort_log_path_is_ref(pathLen);
+}
+
+quint16 logPathRefId(quint32 pathLen)
+{
+    return fort_log_path_ref_id(pathLen);
+}
+
+quint32 logPathRef(quint16 pathId)
+{
+    return fort_log_path_ref(pathId);
+}
+
 quint32 logStatHeaderSize()
 {
     return FORT_LOG_STAT_HEADER_SIZE;
@@ -127,6 +258,49 @@ quint8 logType(const char *input)
     return fort_log_type(input);
 }
 
+int logRingCount(const void *drvRings)
+{
+    const PFORT_LOG_RINGS rings = (const PFORT_LOG_RINGS) drvRings;
+
+    return int(rings->ring_count);
+}
+
+int logRingSize(const void *drvRings)
+{
+    const PFORT_LOG_RINGS rings = (const PFORT_LOG_RINGS) drvRings;
+
+    return int(rings->ring_size);
+}
+
+quint32 logRingHead(const void *drvRings, int index)
+{
+    const PFORT_LOG_RINGS rings = (const PFORT_LOG_RINGS) drvRings;
+
+    const quint32 head = rings->rings[index].head;
+
+    // The records up to the head are written
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return head;
+}
+
+const char *logRingData(const void *drvRings, int index)
+{
+    const PFORT_LOG_RINGS rings = (const PFORT_LOG_RINGS) drvRings;
+
+    return fort_log_ring_data(rings, index);
+}
+
+quint32 logRingsTailsSize(int ringCount)
+{
+    return FORT_LOG_RINGS_TAILS_SIZE(ringCount);
+}
+
+quint32 logRingsMapSize()
+{
+    return FORT_LOG_RINGS_MAP_SIZE(FORT_LOG_RINGS_MAX);
+}
+
 void logBlockedHeaderWrite(char *output, bool blocked, quint32 pid, quint32 pathLen)
 {
     fort_log_blocked_header_write(output, blocked, pid, pathLen);
@@ -153,6 +327,33 @@ void logBlockedIpHeaderRead(const char *input, int *inbound, int *inherited, qui
             remotePort, localIp, remoteIp, pid, pathLen);
 }
 
+void logBlockedIpRepeatHeaderWrite(
+        char *output, quint32 repeatCount, qint64 firstTime, qint64 lastTime)
+{
+    fort_log_blocked_ip_repeat_header_write(output, repeatCount, firstTime, lastTime);
+}
+
+void logBlockedIpRepeatHeaderRead(
+        const char *input, quint32 *repeatCount, qint64 *firstTime, qint64 *lastTime)
+{
+    fort_log_blocked_ip_repeat_header_read(input, repeatCount, firstTime, lastTime);
+}
+
+void logAllowedIpHeaderWrite(char *output, int inbound, int inherited, quint8 ipProto,
+        quint16 remotePort, quint32 remoteIp, quint32 pid, quint32 connCount, quint32 pathLen)
+{
+    fort_log_allowed_ip_header_write(
+            output, inbound, inherited, ipProto, remotePort, remoteIp, pid, connCount, pathLen);
+}
+
+void logAllowedIpHeaderRead(const char *input, int *inbound, int *inherited, quint8 *ipProto,
+        quint16 *remotePort, quint32 *remoteIp, quint32 *pid, quint32 *connCount,
+        quint32 *pathLen)
+{
+    fort_log_allowed_ip_header_read(
+            input, inbound, inherited, ipProto, remotePort, remoteIp, pid, connCount, pathLen);
+}
+
 void logProcNewHeaderWrite(char *output, quint32 pid, quint32 pathLen)
 {
     fort_log_proc_new_header_write(output, pid, pathLen);
@@ -163,6 +364,16 @@ void logProcNewHeaderRead(const char *input, quint32 *pid, quint32 *pathLen)
     fort_log_proc_new_header_read(input, pid, pathLen);
 }
 
+void logPathDefineHeaderWrite(char *output, quint16 pathId, quint32 pathLen)
+{
+    fort_log_path_define_header_write(output, pathId, pathLen);
+}
+
+void logPathDefineHeaderRead(const char *input, quint16 *pathId, quint32 *pathLen)
+{
+    fort_log_path_define_header_read(input, pathId, pathLen);
+}
+
 void logStatTrafHeaderRead(const char *input, quint16 *procCount)
 {
     fort_log_stat_traf_header_read(input, procCount);
@@ -178,6 +389,30 @@ void logTimeRead(const char *input, qint64 *unixTime)
     fort_log_time_read(input, unixTime);
 }
 
+quint32 confAddrListSize(int ipCount, int pairCount)
+{
+    return fort_conf_addr_list_size(ipCount, pairCount);
+}
+
+quint32 confZonesSize(int intervalCount)
+{
+    return fort_conf_zones_size(intervalCount);
+}
+
+quint32 confIpIndexWrite(char *output, const quint32 *ips, int count)
+{
+    fort_conf_ip_index_build((const UINT32 *) ips, count, (UINT32 *) output);
+
+    return fort_conf_ip_index_size(count);
+}
+
+bool confIpInList(const void *drvAddrList, quint32 ip)
+{
+    const PFORT_CONF_ADDR_LIST addrList = (const PFORT_CONF_ADDR_LIST) drvAddrList;
+
+    return fort_conf_ip_inlist(ip, addrList);
+}
+
 void confAppPermsMaskInit(void *drvConf)
 {
     PFORT_CONF conf = (PFORT_CONF) drvConf;
@@ -201,6 +436,13 @@ bool confIpInRange(const void *drvConf, quint32 ip, bool included, int addrGroup
     return fort_conf_ip_inlist(ip, addr_list);
 }
 
+quint32 confZonesIpMask(const void *drvZones, quint32 ip)
+{
+    const PFORT_CONF_ZONES zones = (const PFORT_CONF_ZONES) drvZones;
+
+    return fort_conf_zones_ip_find(zones, ip);
+}
+
 quint16 confAppFind(const void *drvConf, const QString &kernelPath)
 {
     const PFORT_CONF conf = (const PFORT_CONF) drvConf;
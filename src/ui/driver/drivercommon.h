@@ -15,6 +15,10 @@ quint32 ioctlAddApp();
 quint32 ioctlDelApp();
 quint32 ioctlSetZones();
 quint32 ioctlSetZoneFlag();
+quint32 ioctlMapLog();
+quint32 ioctlPatchConf();
+quint32 ioctlGetTrace();
+quint32 ioctlGetStats();
 
 quint32 userErrorCode();
 
@@ -24,15 +28,43 @@ int bufferSize();
 
 quint32 confIoConfOff();
 
+quint32 traceRestartFlag();
+quint32 traceSize(int recordCount);
+
+quint32 statsSize();
+
+int calloutCount();
+int calloutLatencyBuckets();
+qint64 calloutStatsTicksFreq(const char *input);
+void calloutStatRead(const char *input, int calloutId, quint64 *calls, quint64 *permits,
+        quint64 *blocks, quint64 *defers, quint64 *reauths);
+quint64 calloutStatLatency(const char *input, int calloutId, int bucket);
+
+int driverStatCount();
+quint64 driverStatValue(const char *input, int statId);
+
 quint32 logBlockedHeaderSize();
 quint32 logBlockedSize(quint32 pathLen);
 
 quint32 logBlockedIpHeaderSize();
 quint32 logBlockedIpSize(quint32 pathLen);
 
+quint32 logBlockedIpRepeatHeaderSize();
+quint32 logBlockedIpRepeatSize(quint32 pathLen);
+
+quint32 logAllowedIpHeaderSize();
+quint32 logAllowedIpSize(quint32 pathLen);
+
 quint32 logProcNewHeaderSize();
 quint32 logProcNewSize(quint32 pathLen);
 
+quint32 logPathDefineHeaderSize();
+quint32 logPathDefineSize(quint32 pathLen);
+
+bool logPathIsRef(quint32 pathLen);
+quint16 logPathRefId(quint32 pathLen);
+quint32 logPathRef(quint16 pathId);
+
 quint32 logStatHeaderSize();
 quint32 logStatTrafSize(quint16 procCount);
 quint32 logStatSize(quint16 procCount);
@@ -41,6 +73,13 @@ quint32 logTimeSize();
 
 quint8 logType(const char *input);
 
+int logRingCount(const void *drvRings);
+int logRingSize(const void *drvRings);
+quint32 logRingHead(const void *drvRings, int index);
+const char *logRingData(const void *drvRings, int index);
+quint32 logRingsTailsSize(int ringCount);
+quint32 logRingsMapSize();
+
 void logBlockedHeaderWrite(char *output, bool blocked, quint32 pid, quint32 pathLen);
 void logBlockedHeaderRead(const char *input, int *blocked, quint32 *pid, quint32 *pathLen);
 
@@ -51,16 +90,36 @@ void logBlockedIpHeaderRead(const char *input, int *inbound, int *inherited, qui
         quint8 *ipProto, quint16 *localPort, quint16 *remotePort, quint32 *localIp,
         quint32 *remoteIp, quint32 *pid, quint32 *pathLen);
 
+void logBlockedIpRepeatHeaderWrite(
+        char *output, quint32 repeatCount, qint64 firstTime, qint64 lastTime);
+void logBlockedIpRepeatHeaderRead(
+        const char *input, quint32 *repeatCount, qint64 *firstTime, qint64 *lastTime);
+
+void logAllowedIpHeaderWrite(char *output, int inbound, int inherited, quint8 ipProto,
+        quint16 remotePort, quint32 remoteIp, quint32 pid, quint32 connCount, quint32 pathLen);
+void logAllowedIpHeaderRead(const char *input, int *inbound, int *inherited, quint8 *ipProto,
+        quint16 *remotePort, quint32 *remoteIp, quint32 *pid, quint32 *connCount,
+        quint32 *pathLen);
+
 void logProcNewHeaderWrite(char *output, quint32 pid, quint32 pathLen);
 void logProcNewHeaderRead(const char *input, quint32 *pid, quint32 *pathLen);
 
+void logPathDefineHeaderWrite(char *output, quint16 pathId, quint32 pathLen);
+void logPathDefineHeaderRead(const char *input, quint16 *pathId, quint32 *pathLen);
+
 void logStatTrafHeaderRead(const char *input, quint16 *procCount);
 
 void logTimeWrite(char *output, qint64 unixTime);
 void logTimeRead(const char *input, qint64 *unixTime);
 
+quint32 confAddrListSize(int ipCount, int pairCount);
+quint32 confZonesSize(int intervalCount);
+quint32 confIpIndexWrite(char *output, const quint32 *ips, int count);
+bool confIpInList(const void *drvAddrList, quint32 ip);
+
 void confAppPermsMaskInit(void *drvConf);
 bool confIpInRange(const void *drvConf, quint32 ip, bool included = false, int addrGroupIndex = 0);
+quint32 confZonesIpMask(const void *drvZones, quint32 ip);
 quint16 confAppFind(const void *drvConf, const QString &kernelPath);
 quint8 confAppGroupIndex(quint16 appFlags);
 bool confAppBlocked(const void *drvConf, quint16 appFlags, qint8 *blockReason);
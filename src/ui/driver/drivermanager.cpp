@@ -82,6 +82,8 @@ bool DriverManager::openDevice()
 
 bool DriverManager::closeDevice()
 {
+    driverWorker()->setLogRings(nullptr);
+
     const bool res = device()->close();
 
     emit isDeviceOpenedChanged();
@@ -93,7 +95,30 @@ bool DriverManager::closeDevice()
 
 bool DriverManager::validate(QByteArray &buf, int size)
 {
-    return writeData(DriverCommon::ioctlValidate(), buf, size);
+    if (!writeData(DriverCommon::ioctlValidate(), buf, size))
+        return false;
+
+    mapLogRings();
+
+    return true;
+}
+
+void DriverManager::mapLogRings()
+{
+    QByteArray buf(int(DriverCommon::logRingsMapSize()), '\0');
+
+    const char *logRings = nullptr;
+    const quint32 *logRingTails = nullptr;
+
+    // Log records are read from the rings in place, else only from the buffer
+    if (readData(DriverCommon::ioctlMapLog(), buf)) {
+        const quint64 addr = *reinterpret_cast<const quint64 *>(buf.constData());
+
+        logRings = reinterpret_cast<const char *>(quintptr(addr));
+        logRingTails = reinterpret_cast<const quint32 *>(buf.constData() + sizeof(quint64));
+    }
+
+    driverWorker()->setLogRings(logRings, logRingTails);
 }
 
 bool DriverManager::writeConf(QByteArray &buf, int size, bool onlyFlags)
@@ -102,6 +127,11 @@ bool DriverManager::writeConf(QByteArray &buf, int size, bool onlyFlags)
             onlyFlags ? DriverCommon::ioctlSetFlags() : DriverCommon::ioctlSetConf(), buf, size);
 }
 
+bool DriverManager::writeConfPatch(QByteArray &buf, int size)
+{
+    return writeData(DriverCommon::ioctlPatchConf(), buf, size);
+}
+
 bool DriverManager::writeApp(QByteArray &buf, int size, bool remove)
 {
     return writeData(remove ? DriverCommon::ioctlDelApp() : DriverCommon::ioctlAddApp(), buf, size);
@@ -113,6 +143,38 @@ bool DriverManager::writeZones(QByteArray &buf, int size, bool onlyFlags)
             buf, size);
 }
 
+bool DriverManager::readTrace(QByteArray &buf, bool restart)
+{
+    constexpr int traceRecordsMax = 64 * 1024;
+
+    if (!device())
+        return false; // the device is opened by the service
+
+    quint32 flags = restart ? DriverCommon::traceRestartFlag() : 0;
+
+    buf.resize(DriverCommon::traceSize(traceRecordsMax));
+
+    int outSize = 0;
+    if (!readData(DriverCommon::ioctlGetTrace(), buf, (char *) &flags, sizeof(flags), &outSize))
+        return false;
+
+    buf.resize(outSize);
+
+    return true;
+}
+
+bool DriverManager::readStats(QByteArray &buf)
+{
+    buf.resize(DriverCommon::statsSize());
+
+    if (!readData(DriverCommon::ioctlGetStats(), buf)) {
+        buf.clear();
+        return false;
+    }
+
+    return true;
+}
+
 bool DriverManager::writeData(quint32 code, QByteArray &buf, int size)
 {
     if (!isDeviceOpened())
@@ -131,6 +193,31 @@ bool DriverManager::writeData(quint32 code, QByteArray &buf, int size)
     return res;
 }
 
+bool DriverManager::readData(quint32 code, QByteArray &buf, char *in, int inSize, int *outSize)
+{
+    if (!isDeviceOpened())
+        return false;
+
+    const bool wasCancelled = driverWorker()->cancelAsyncIo();
+
+    int retSize = 0;
+    const bool res = device()->ioctl(code, in, inSize, buf.data(), buf.size(), &retSize);
+
+    updateErrorCode(res);
+
+    if (wasCancelled) {
+        driverWorker()->continueAsyncIo();
+    }
+
+    // Variable-sized output
+    if (outSize) {
+        *outSize = retSize;
+        return res;
+    }
+
+    return res && retSize == buf.size();
+}
+
 bool DriverManager::reinstallDriver()
 {
     return executeCommand("reinstall.bat");
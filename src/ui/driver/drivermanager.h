@@ -43,9 +43,13 @@ public slots:
     bool validate(QByteArray &buf, int size);
 
     bool writeConf(QByteArray &buf, int size, bool onlyFlags = false);
+    bool writeConfPatch(QByteArray &buf, int size);
     bool writeApp(QByteArray &buf, int size, bool remove = false);
     bool writeZones(QByteArray &buf, int size, bool onlyFlags = false);
 
+    bool readTrace(QByteArray &buf, bool restart = false);
+    virtual bool readStats(QByteArray &buf);
+
 protected:
     void setErrorCode(quint32 v);
 
@@ -55,7 +59,11 @@ private:
     void setupWorker();
     void closeWorker();
 
+    void mapLogRings();
+
     bool writeData(quint32 code, QByteArray &buf, int size);
+    bool readData(quint32 code, QByteArray &buf, char *in = nullptr, int inSize = 0,
+            int *outSize = nullptr);
 
     static bool executeCommand(const QString &fileName);
 
@@ -14,6 +14,80 @@ void DriverWorker::run()
     } while (!m_aborted);
 }
 
+void DriverWorker::setLogRings(const char *logRings, const quint32 *logRingTails)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // The same mapping on re-validate, keep reading from the consumed positions
+    if (logRings && logRings == m_logRings)
+        return;
+
+    m_logRings = logRings;
+
+    const int ringCount = logRings ? DriverCommon::logRingCount(logRings) : 0;
+
+    m_logRingTails.resize(ringCount);
+
+    // Start from the driver's positions, so no records are skipped
+    for (int i = 0; i < ringCount; ++i) {
+        m_logRingTails[i] = logRingTails[i];
+    }
+
+    m_logRingHeads = m_logRingTails;
+
+    // The driver forgot the paths, defined to the previous mapping
+    m_logRingPathsReset = true;
+}
+
+QVector<QByteArrayList> DriverWorker::readLogRings(bool &pathsReset)
+{
+    QMutexLocker locker(&m_mutex);
+
+    pathsReset = m_logRingPathsReset;
+    m_logRingPathsReset = false;
+
+    if (!m_logRings)
+        return {};
+
+    const quint32 ringSize = quint32(DriverCommon::logRingSize(m_logRings));
+    const int ringCount = m_logRingTails.size();
+
+    QVector<QByteArrayList> ringViews(ringCount);
+
+    for (int i = 0; i < ringCount; ++i) {
+        const quint32 tail = m_logRingTails[i];
+        const quint32 head = DriverCommon::logRingHead(m_logRings, i);
+
+        m_logRingHeads[i] = head;
+
+        const quint32 used = head - tail;
+        if (used == 0 || used > ringSize)
+            continue;
+
+        // Parse the records in place, a wrapped range is split in two views
+        const char *data = DriverCommon::logRingData(m_logRings, i);
+        const quint32 offset = tail & (ringSize - 1);
+        const quint32 tailSize = qMin(used, ringSize - offset);
+
+        QByteArrayList &views = ringViews[i];
+
+        views.append(QByteArray::fromRawData(data + offset, int(tailSize)));
+
+        if (used > tailSize) {
+            views.append(QByteArray::fromRawData(data, int(used - tailSize)));
+        }
+    }
+
+    return ringViews;
+}
+
+void DriverWorker::commitLogRings()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_logRingTails = m_logRingHeads;
+}
+
 bool DriverWorker::readLogAsync(LogBuffer *logBuffer)
 {
     QMutexLocker locker(&m_mutex);
@@ -107,11 +181,21 @@ void DriverWorker::readLog()
     if (!waitLogBuffer())
         return;
 
+    // Tell the driver which records of the log rings are consumed
+    QVector<quint32> ringTails;
+    {
+        QMutexLocker locker(&m_mutex);
+        ringTails = m_logRingTails;
+    }
+
+    char *in = ringTails.isEmpty() ? nullptr : reinterpret_cast<char *>(ringTails.data());
+    const int inSize = int(DriverCommon::logRingsTailsSize(ringTails.size()));
+
     QByteArray &array = m_logBuffer->array();
     int nr;
 
     const bool success = m_device->ioctl(
-            DriverCommon::ioctlGetLog(), nullptr, 0, array.data(), array.size(), &nr);
+            DriverCommon::ioctlGetLog(), in, inSize, array.data(), array.size(), &nr);
 
     quint32 errorCode = 0;
 
@@ -1,9 +1,11 @@
 #ifndef DRIVERWORKER_H
 #define DRIVERWORKER_H
 
+#include <QByteArrayList>
 #include <QMutex>
 #include <QObject>
 #include <QRunnable>
+#include <QVector>
 #include <QWaitCondition>
 
 class Device;
@@ -18,6 +20,11 @@ public:
 
     void run() override;
 
+    void setLogRings(const char *logRings, const quint32 *logRingTails = nullptr);
+
+    QVector<QByteArrayList> readLogRings(bool &pathsReset);
+    void commitLogRings();
+
 signals:
     void readLogResult(LogBuffer *logBuffer, bool success, quint32 errorCode);
 
@@ -42,6 +49,11 @@ private:
 
     LogBuffer *m_logBuffer = nullptr;
 
+    const char *m_logRings = nullptr;
+    QVector<quint32> m_logRingTails;
+    QVector<quint32> m_logRingHeads;
+    bool m_logRingPathsReset = false;
+
     QMutex m_mutex;
     QWaitCondition m_bufferWaitCondition;
     QWaitCondition m_cancelledWaitCondition;
@@ -361,9 +361,8 @@ void StatisticsPage::setupConnBox()
     setupLogBlockedIp();
 
     // Layout
-    auto layout = ControlUtil::createLayoutByWidgets({ // TODO: Collect allowed connections
-            // m_cbLogAllowedIp, m_lscAllowedIpKeepCount, ControlUtil::createSeparator(),
-            m_cbLogBlockedIp, m_lscBlockedIpKeepCount });
+    auto layout = ControlUtil::createLayoutByWidgets({ m_cbLogAllowedIp, m_lscAllowedIpKeepCount,
+            ControlUtil::createSeparator(), m_cbLogBlockedIp, m_lscBlockedIpKeepCount });
 
     m_gbConn = new QGroupBox(this);
     m_gbConn->setLayout(layout);
@@ -0,0 +1,113 @@
+#include "calloutspage.h"
+
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+#include <driver/drivermanager.h>
+#include <form/controls/controlutil.h>
+#include <form/controls/tableview.h>
+#include <model/calloutstatmodel.h>
+#include <model/driverstatmodel.h>
+#include <util/ioc/ioccontainer.h>
+
+CalloutsPage::CalloutsPage(StatisticsController *ctrl, QWidget *parent) :
+    StatBasePage(ctrl, parent),
+    m_calloutStatModel(new CalloutStatModel(this)),
+    m_driverStatModel(new DriverStatModel(this))
+{
+    setupUi();
+}
+
+void CalloutsPage::onRetranslateUi()
+{
+    m_btRefresh->setText(tr("Refresh"));
+
+    calloutStatModel()->refresh();
+    driverStatModel()->refresh();
+}
+
+void CalloutsPage::updateStats()
+{
+    QByteArray buf;
+    IoC<DriverManager>()->readStats(buf);
+
+    // One read for both tables, so that they show the same moment
+    calloutStatModel()->setStats(buf);
+    driverStatModel()->setStats(buf);
+}
+
+void CalloutsPage::showEvent(QShowEvent *event)
+{
+    StatBasePage::showEvent(event);
+
+    // The driver's counters are read on demand only
+    updateStats();
+}
+
+void CalloutsPage::setupUi()
+{
+    auto layout = new QVBoxLayout();
+    layout->setContentsMargins(6, 6, 6, 6);
+
+    // Header
+    auto header = setupHeader();
+    layout->addLayout(header);
+
+    // Tables
+    setupTableCallouts();
+    setupTableCalloutsHeader();
+    layout->addWidget(m_calloutListView, 2);
+
+    setupTableDriverStats();
+    layout->addWidget(m_driverStatListView, 1);
+
+    this->setLayout(layout);
+}
+
+QLayout *CalloutsPage::setupHeader()
+{
+    auto layout = new QHBoxLayout();
+
+    m_btRefresh = ControlUtil::createButton(
+            ":/icons/arrow_refresh_small.png", [&] { updateStats(); });
+
+    layout->addWidget(m_btRefresh);
+    layout->addStretch();
+
+    return layout;
+}
+
+void CalloutsPage::setupTableCallouts()
+{
+    m_calloutListView = new TableView();
+    m_calloutListView->setAlternatingRowColors(true);
+    m_calloutListView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    m_calloutListView->setSelectionBehavior(QAbstractItemView::SelectItems);
+
+    m_calloutListView->setModel(calloutStatModel());
+}
+
+void CalloutsPage::setupTableCalloutsHeader()
+{
+    auto header = m_calloutListView->horizontalHeader();
+
+    header->setSectionResizeMode(QHeaderView::Stretch);
+    header->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+}
+
+void CalloutsPage::setupTableDriverStats()
+{
+    m_driverStatListView = new TableView();
+    m_driverStatListView->setAlternatingRowColors(true);
+    m_driverStatListView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    m_driverStatListView->setSelectionBehavior(QAbstractItemView::SelectItems);
+
+    m_driverStatListView->setModel(driverStatModel());
+
+    auto header = m_driverStatListView->horizontalHeader();
+
+    header->setSectionResizeMode(QHeaderView::Stretch);
+    header->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+}
@@ -0,0 +1,45 @@
+#ifndef CALLOUTSPAGE_H
+#define CALLOUTSPAGE_H
+
+#include "statbasepage.h"
+
+class CalloutStatModel;
+class DriverStatModel;
+class TableView;
+
+class CalloutsPage : public StatBasePage
+{
+    Q_OBJECT
+
+public:
+    explicit CalloutsPage(StatisticsController *ctrl = nullptr, QWidget *parent = nullptr);
+
+    CalloutStatModel *calloutStatModel() const { return m_calloutStatModel; }
+    DriverStatModel *driverStatModel() const { return m_driverStatModel; }
+
+public slots:
+    void updateStats();
+
+protected slots:
+    void onRetranslateUi() override;
+
+protected:
+    void showEvent(QShowEvent *event) override;
+
+private:
+    void setupUi();
+    QLayout *setupHeader();
+    void setupTableCallouts();
+    void setupTableCalloutsHeader();
+    void setupTableDriverStats();
+
+private:
+    CalloutStatModel *m_calloutStatModel = nullptr;
+    DriverStatModel *m_driverStatModel = nullptr;
+
+    QPushButton *m_btRefresh = nullptr;
+    TableView *m_calloutListView = nullptr;
+    TableView *m_driverStatListView = nullptr;
+};
+
+#endif // CALLOUTSPAGE_H
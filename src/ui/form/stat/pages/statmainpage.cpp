@@ -10,6 +10,7 @@
 #include <fortsettings.h>
 #include <util/iconcache.h>
 
+#include "calloutspage.h"
 #include "connectionspage.h"
 #include "trafficpage.h"
 
@@ -22,6 +23,7 @@ void StatMainPage::onRetranslateUi()
 {
     m_tabBar->setTabText(0, tr("Traffic"));
     m_tabBar->setTabText(1, tr("Blocked Connections"));
+    m_tabBar->setTabText(2, tr("Callouts"));
 }
 
 void StatMainPage::setupUi()
@@ -40,8 +42,10 @@ void StatMainPage::setupTabBar()
 {
     auto statisticsPage = new TrafficPage(ctrl());
     auto connectionsPage = new ConnectionsPage(ctrl());
+    auto calloutsPage = new CalloutsPage(ctrl());
 
     m_tabBar = new QTabWidget();
     m_tabBar->addTab(statisticsPage, IconCache::icon(":/icons/chart_bar.png"), QString());
     m_tabBar->addTab(connectionsPage, IconCache::icon(":/icons/connect.png"), QString());
+    m_tabBar->addTab(calloutsPage, IconCache::icon(":/icons/server_components.png"), QString());
 }
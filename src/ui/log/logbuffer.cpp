@@ -14,6 +14,11 @@ LogBuffer::LogBuffer(int bufferSize, QObject *parent) :
 {
 }
 
+LogBuffer::LogBuffer(const QByteArray &array, QObject *parent) :
+    QObject(parent), m_top(array.size()), m_array(array)
+{
+}
+
 void LogBuffer::reset(int top)
 {
     m_top = top;
@@ -39,6 +44,39 @@ void LogBuffer::prepareFor(int len)
     }
 }
 
+quint32 LogBuffer::writePathLen(const QString &path) const
+{
+    // Refer to the path, when it's already defined
+    if (m_pathTable && !path.isEmpty()) {
+        for (auto it = m_pathTable->constBegin(); it != m_pathTable->constEnd(); ++it) {
+            if (it.value() == path)
+                return DriverCommon::logPathRef(it.key());
+        }
+    }
+
+    return quint32(path.size()) * sizeof(wchar_t);
+}
+
+void LogBuffer::writePath(char *output, const QString &path, quint32 pathLen)
+{
+    if (pathLen != 0 && !DriverCommon::logPathIsRef(pathLen)) {
+        path.toWCharArray((wchar_t *) output);
+    }
+}
+
+QString LogBuffer::readPath(const char *input, quint32 pathLen) const
+{
+    if (DriverCommon::logPathIsRef(pathLen)) {
+        const quint16 pathId = DriverCommon::logPathRefId(pathLen);
+        return m_pathTable ? m_pathTable->value(pathId) : QString();
+    }
+
+    if (pathLen == 0)
+        return QString();
+
+    return QString::fromWCharArray((const wchar_t *) input, pathLen / int(sizeof(wchar_t)));
+}
+
 FortLogType LogBuffer::peekEntryType()
 {
     if (m_offset >= m_top)
@@ -51,10 +89,50 @@ FortLogType LogBuffer::peekEntryType()
     return static_cast<FortLogType>(type);
 }
 
+void LogBuffer::writeEntryPathDefine(quint16 pathId, const QString &path)
+{
+    const quint32 pathLen = quint32(path.size()) * sizeof(wchar_t);
+
+    const int entrySize = int(DriverCommon::logPathDefineSize(pathLen));
+    prepareFor(entrySize);
+
+    char *output = this->output();
+
+    DriverCommon::logPathDefineHeaderWrite(output, pathId, pathLen);
+
+    output += DriverCommon::logPathDefineHeaderSize();
+    path.toWCharArray((wchar_t *) output);
+
+    if (m_pathTable) {
+        m_pathTable->insert(pathId, path);
+    }
+
+    m_top += entrySize;
+}
+
+void LogBuffer::readEntryPathDefine()
+{
+    Q_ASSERT(m_offset < m_top);
+
+    const char *input = this->input();
+
+    quint16 pathId;
+    quint32 pathLen;
+    DriverCommon::logPathDefineHeaderRead(input, &pathId, &pathLen);
+
+    if (m_pathTable) {
+        input += DriverCommon::logPathDefineHeaderSize();
+        m_pathTable->insert(pathId, readPath(input, pathLen));
+    }
+
+    const int entrySize = int(DriverCommon::logPathDefineSize(pathLen));
+    m_offset += entrySize;
+}
+
 void LogBuffer::writeEntryBlocked(const LogEntryBlocked *logEntry)
 {
     const QString path = logEntry->kernelPath();
-    const quint32 pathLen = quint32(path.size()) * sizeof(wchar_t);
+    const quint32 pathLen = writePathLen(path);
 
     const int entrySize = int(DriverCommon::logBlockedSize(pathLen));
     prepareFor(entrySize);
@@ -63,10 +141,8 @@ void LogBuffer::writeEntryBlocked(const LogEntryBlocked *logEntry)
 
     DriverCommon::logBlockedHeaderWrite(output, logEntry->blocked(), logEntry->pid(), pathLen);
 
-    if (pathLen) {
-        output += DriverCommon::logBlockedHeaderSize();
-        path.toWCharArray((wchar_t *) output);
-    }
+    output += DriverCommon::logBlockedHeaderSize();
+    writePath(output, path, pathLen);
 
     m_top += entrySize;
 }
@@ -81,11 +157,8 @@ void LogBuffer::readEntryBlocked(LogEntryBlocked *logEntry)
     quint32 pid, pathLen;
     DriverCommon::logBlockedHeaderRead(input, &blocked, &pid, &pathLen);
 
-    QString path;
-    if (pathLen) {
-        input += DriverCommon::logBlockedHeaderSize();
-        path = QString::fromWCharArray((const wchar_t *) input, pathLen / int(sizeof(wchar_t)));
-    }
+    input += DriverCommon::logBlockedHeaderSize();
+    const QString path = readPath(input, pathLen);
 
     logEntry->setBlocked(blocked);
     logEntry->setPid(pid);
@@ -98,7 +171,7 @@ void LogBuffer::readEntryBlocked(LogEntryBlocked *logEntry)
 void LogBuffer::writeEntryBlockedIp(const LogEntryBlockedIp *logEntry)
 {
     const QString path = logEntry->kernelPath();
-    const quint32 pathLen = quint32(path.size()) * sizeof(wchar_t);
+    const quint32 pathLen = writePathLen(path);
 
     const int entrySize = int(DriverCommon::logBlockedIpSize(pathLen));
     prepareFor(entrySize);
@@ -110,10 +183,8 @@ void LogBuffer::writeEntryBlockedIp(const LogEntryBlockedIp *logEntry)
             logEntry->remotePort(), logEntry->localIp(), logEntry->remoteIp(), logEntry->pid(),
             pathLen);
 
-    if (pathLen) {
-        output += DriverCommon::logBlockedIpHeaderSize();
-        path.toWCharArray((wchar_t *) output);
-    }
+    output += DriverCommon::logBlockedIpHeaderSize();
+    writePath(output, path, pathLen);
 
     m_top += entrySize;
 }
@@ -135,11 +206,8 @@ void LogBuffer::readEntryBlockedIp(LogEntryBlockedIp *logEntry)
     DriverCommon::logBlockedIpHeaderRead(input, &inbound, &inherited, &blockReason, &proto,
             &localPort, &remotePort, &localIp, &remoteIp, &pid, &pathLen);
 
-    QString path;
-    if (pathLen) {
-        input += DriverCommon::logBlockedIpHeaderSize();
-        path = QString::fromWCharArray((const wchar_t *) input, pathLen / int(sizeof(wchar_t)));
-    }
+    input += DriverCommon::logBlockedIpHeaderSize();
+    const QString path = readPath(input, pathLen);
 
     logEntry->setInbound(inbound != 0);
     logEntry->setInherited(inherited != 0);
@@ -156,10 +224,127 @@ void LogBuffer::readEntryBlockedIp(LogEntryBlockedIp *logEntry)
     m_offset += entrySize;
 }
 
+void LogBuffer::writeEntryBlockedIpRepeat(const LogEntryBlockedIp *logEntry)
+{
+    const QString path = logEntry->kernelPath();
+    const quint32 pathLen = writePathLen(path);
+
+    const int entrySize = int(DriverCommon::logBlockedIpRepeatSize(pathLen));
+    prepareFor(entrySize);
+
+    char *output = this->output();
+
+    DriverCommon::logBlockedIpHeaderWrite(output, logEntry->inbound(), logEntry->inherited(),
+            logEntry->blockReason(), logEntry->ipProto(), logEntry->localPort(),
+            logEntry->remotePort(), logEntry->localIp(), logEntry->remoteIp(), logEntry->pid(),
+            pathLen);
+    DriverCommon::logBlockedIpRepeatHeaderWrite(output, logEntry->repeatCount(),
+            logEntry->firstTime(), logEntry->lastTime());
+
+    output += DriverCommon::logBlockedIpRepeatHeaderSize();
+    writePath(output, path, pathLen);
+
+    m_top += entrySize;
+}
+
+void LogBuffer::readEntryBlockedIpRepeat(LogEntryBlockedIp *logEntry)
+{
+    Q_ASSERT(m_offset < m_top);
+
+    const char *input = this->input();
+
+    int inbound;
+    int inherited;
+    quint8 blockReason;
+    quint8 proto;
+    quint16 localPort;
+    quint16 remotePort;
+    quint32 localIp, remoteIp;
+    quint32 pid, pathLen;
+    DriverCommon::logBlockedIpHeaderRead(input, &inbound, &inherited, &blockReason, &proto,
+            &localPort, &remotePort, &localIp, &remoteIp, &pid, &pathLen);
+
+    quint32 repeatCount;
+    qint64 firstTime, lastTime;
+    DriverCommon::logBlockedIpRepeatHeaderRead(input, &repeatCount, &firstTime, &lastTime);
+
+    input += DriverCommon::logBlockedIpRepeatHeaderSize();
+    const QString path = readPath(input, pathLen);
+
+    logEntry->setInbound(inbound != 0);
+    logEntry->setInherited(inherited != 0);
+    logEntry->setBlockReason(blockReason);
+    logEntry->setLocalIp(localIp);
+    logEntry->setRemoteIp(remoteIp);
+    logEntry->setLocalPort(localPort);
+    logEntry->setRemotePort(remotePort);
+    logEntry->setIpProto(proto);
+    logEntry->setPid(pid);
+    logEntry->setKernelPath(path);
+    logEntry->setRepeatCount(repeatCount);
+    logEntry->setFirstTime(firstTime);
+    logEntry->setLastTime(lastTime);
+
+    const int entrySize = int(DriverCommon::logBlockedIpRepeatSize(pathLen));
+    m_offset += entrySize;
+}
+
+void LogBuffer::writeEntryAllowedIp(const LogEntryBlockedIp *logEntry)
+{
+    const QString path = logEntry->kernelPath();
+    const quint32 pathLen = writePathLen(path);
+
+    const int entrySize = int(DriverCommon::logAllowedIpSize(pathLen));
+    prepareFor(entrySize);
+
+    char *output = this->output();
+
+    DriverCommon::logAllowedIpHeaderWrite(output, logEntry->inbound(), logEntry->inherited(),
+            logEntry->ipProto(), logEntry->remotePort(), logEntry->remoteIp(), logEntry->pid(),
+            logEntry->repeatCount(), pathLen);
+
+    output += DriverCommon::logAllowedIpHeaderSize();
+    writePath(output, path, pathLen);
+
+    m_top += entrySize;
+}
+
+void LogBuffer::readEntryAllowedIp(LogEntryBlockedIp *logEntry)
+{
+    Q_ASSERT(m_offset < m_top);
+
+    const char *input = this->input();
+
+    int inbound;
+    int inherited;
+    quint8 proto;
+    quint16 remotePort;
+    quint32 remoteIp;
+    quint32 pid, connCount, pathLen;
+    DriverCommon::logAllowedIpHeaderRead(input, &inbound, &inherited, &proto, &remotePort,
+            &remoteIp, &pid, &connCount, &pathLen);
+
+    input += DriverCommon::logAllowedIpHeaderSize();
+    const QString path = readPath(input, pathLen);
+
+    logEntry->setBlocked(false);
+    logEntry->setInbound(inbound != 0);
+    logEntry->setInherited(inherited != 0);
+    logEntry->setRemoteIp(remoteIp);
+    logEntry->setRemotePort(remotePort);
+    logEntry->setIpProto(proto);
+    logEntry->setPid(pid);
+    logEntry->setKernelPath(path);
+    logEntry->setRepeatCount(connCount);
+
+    const int entrySize = int(DriverCommon::logAllowedIpSize(pathLen));
+    m_offset += entrySize;
+}
+
 void LogBuffer::writeEntryProcNew(const LogEntryProcNew *logEntry)
 {
     const QString path = logEntry->kernelPath();
-    const quint32 pathLen = quint32(path.size()) * sizeof(wchar_t);
+    const quint32 pathLen = writePathLen(path);
 
     const int entrySize = int(DriverCommon::logProcNewSize(pathLen));
     prepareFor(entrySize);
@@ -168,10 +353,8 @@ void LogBuffer::writeEntryProcNew(const LogEntryProcNew *logEntry)
 
     DriverCommon::logProcNewHeaderWrite(output, logEntry->pid(), pathLen);
 
-    if (pathLen != 0) {
-        output += DriverCommon::logProcNewHeaderSize();
-        path.toWCharArray((wchar_t *) output);
-    }
+    output += DriverCommon::logProcNewHeaderSize();
+    writePath(output, path, pathLen);
 
     m_top += entrySize;
 }
@@ -185,11 +368,8 @@ void LogBuffer::readEntryProcNew(LogEntryProcNew *logEntry)
     quint32 pid, pathLen;
     DriverCommon::logProcNewHeaderRead(input, &pid, &pathLen);
 
-    QString path;
-    if (pathLen != 0) {
-        input += DriverCommon::logProcNewHeaderSize();
-        path = QString::fromWCharArray((const wchar_t *) input, pathLen / sizeof(wchar_t));
-    }
+    input += DriverCommon::logProcNewHeaderSize();
+    const QString path = readPath(input, pathLen);
 
     logEntry->setPid(pid);
     logEntry->setKernelPath(path);
@@ -1,8 +1,9 @@
 #ifndef LOGBUFFER_H
 #define LOGBUFFER_H
 
-#include <QObject>
 #include <QByteArray>
+#include <QHash>
+#include <QObject>
 
 #include "logentry.h"
 
@@ -12,26 +13,42 @@ class LogEntryProcNew;
 class LogEntryStatTraf;
 class LogEntryTime;
 
+// Paths defined by a log stream of the driver
+using LogPathTable = QHash<quint16, QString>;
+
 class LogBuffer : public QObject
 {
     Q_OBJECT
 
 public:
     explicit LogBuffer(int bufferSize = 0, QObject *parent = nullptr);
+    explicit LogBuffer(const QByteArray &array, QObject *parent = nullptr);
 
     int top() const { return m_top; }
     int offset() const { return m_offset; }
 
     QByteArray &array() { return m_array; }
 
+    LogPathTable *pathTable() const { return m_pathTable; }
+    void setPathTable(LogPathTable *pathTable) { m_pathTable = pathTable; }
+
     FortLogType peekEntryType();
 
+    void writeEntryPathDefine(quint16 pathId, const QString &path);
+    void readEntryPathDefine();
+
     void writeEntryBlocked(const LogEntryBlocked *logEntry);
     void readEntryBlocked(LogEntryBlocked *logEntry);
 
     void writeEntryBlockedIp(const LogEntryBlockedIp *logEntry);
     void readEntryBlockedIp(LogEntryBlockedIp *logEntry);
 
+    void writeEntryBlockedIpRepeat(const LogEntryBlockedIp *logEntry);
+    void readEntryBlockedIpRepeat(LogEntryBlockedIp *logEntry);
+
+    void writeEntryAllowedIp(const LogEntryBlockedIp *logEntry);
+    void readEntryAllowedIp(LogEntryBlockedIp *logEntry);
+
     void writeEntryProcNew(const LogEntryProcNew *logEntry);
     void readEntryProcNew(LogEntryProcNew *logEntry);
 
@@ -49,11 +66,17 @@ private:
 
     void prepareFor(int len);
 
+    quint32 writePathLen(const QString &path) const;
+    static void writePath(char *output, const QString &path, quint32 pathLen);
+    QString readPath(const char *input, quint32 pathLen) const;
+
 private:
     int m_top = 0;
     int m_offset = 0;
 
     QByteArray m_array;
+
+    LogPathTable *m_pathTable = nullptr;
 };
 
 #endif // LOGBUFFER_H
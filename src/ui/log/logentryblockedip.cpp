@@ -54,3 +54,18 @@ void LogEntryBlockedIp::setRemoteIp(quint32 ip)
 {
     m_remoteIp = ip;
 }
+
+void LogEntryBlockedIp::setRepeatCount(quint32 count)
+{
+    m_repeatCount = count;
+}
+
+void LogEntryBlockedIp::setFirstTime(qint64 unixTime)
+{
+    m_firstTime = unixTime;
+}
+
+void LogEntryBlockedIp::setLastTime(qint64 unixTime)
+{
+    m_lastTime = unixTime;
+}
@@ -10,7 +10,10 @@ public:
             quint16 remotePort = 0, quint32 localIp = 0, quint32 remoteIp = 0, quint32 pid = 0,
             const QString &kernelPath = QString());
 
-    FortLogType type() const override { return FORT_LOG_TYPE_BLOCKED_IP; }
+    FortLogType type() const override
+    {
+        return blocked() ? FORT_LOG_TYPE_BLOCKED_IP : FORT_LOG_TYPE_ALLOWED_IP;
+    }
 
     bool inbound() const { return m_inbound; }
     void setInbound(bool inbound);
@@ -36,6 +39,16 @@ public:
     quint32 remoteIp() const { return m_remoteIp; }
     void setRemoteIp(quint32 ip);
 
+    // Repeats of the connection, folded by the driver; all connections, when allowed
+    quint32 repeatCount() const { return m_repeatCount; }
+    void setRepeatCount(quint32 count);
+
+    qint64 firstTime() const { return m_firstTime; }
+    void setFirstTime(qint64 unixTime);
+
+    qint64 lastTime() const { return m_lastTime; }
+    void setLastTime(qint64 unixTime);
+
 private:
     bool m_inbound : 1;
     bool m_inherited : 1;
@@ -45,6 +58,9 @@ private:
     quint16 m_remotePort = 0;
     quint32 m_localIp = 0;
     quint32 m_remoteIp = 0;
+    quint32 m_repeatCount = 1;
+    qint64 m_firstTime = 0;
+    qint64 m_lastTime = 0;
 };
 
 #endif // LOGENTRYBLOCKEDIP_H
@@ -92,8 +92,11 @@ void LogManager::cancelAsyncIo()
 
 LogBuffer *LogManager::getFreeBuffer()
 {
-    if (m_freeBuffers.isEmpty())
-        return new LogBuffer(DriverCommon::bufferSize(), this);
+    if (m_freeBuffers.isEmpty()) {
+        auto logBuffer = new LogBuffer(DriverCommon::bufferSize(), this);
+        logBuffer->setPathTable(&m_bufferPaths);
+        return logBuffer;
+    }
 
     return m_freeBuffers.takeLast();
 }
@@ -111,6 +114,7 @@ void LogManager::processLogBuffer(LogBuffer *logBuffer, bool success, quint32 er
 
     if (success) {
         readLogEntries(logBuffer);
+        readLogRings();
     } else if (errorCode != 0) {
         const auto errorMessage = OsUtil::errorMessage(errorCode);
         setErrorMessage(errorMessage);
@@ -126,6 +130,9 @@ void LogManager::readLogEntries(LogBuffer *logBuffer)
         const auto logType = logBuffer->peekEntryType();
 
         switch (logType) {
+        case FORT_LOG_TYPE_PATH_DEFINE: {
+            logBuffer->readEntryPathDefine();
+        } break;
         case FORT_LOG_TYPE_BLOCKED:
         case FORT_LOG_TYPE_ALLOWED: {
             LogEntryBlocked blockedEntry;
@@ -137,6 +144,16 @@ void LogManager::readLogEntries(LogBuffer *logBuffer)
             logBuffer->readEntryBlockedIp(&blockedIpEntry);
             IoC<StatManager>()->logBlockedIp(blockedIpEntry, currentUnixTime());
         } break;
+        case FORT_LOG_TYPE_BLOCKED_IP_REPEAT: {
+            LogEntryBlockedIp blockedIpEntry;
+            logBuffer->readEntryBlockedIpRepeat(&blockedIpEntry);
+            IoC<StatManager>()->logBlockedIp(blockedIpEntry, blockedIpEntry.lastTime());
+        } break;
+        case FORT_LOG_TYPE_ALLOWED_IP: {
+            LogEntryBlockedIp allowedIpEntry;
+            logBuffer->readEntryAllowedIp(&allowedIpEntry);
+            IoC<StatManager>()->logAllowedIp(allowedIpEntry, currentUnixTime());
+        } break;
         case FORT_LOG_TYPE_PROC_NEW: {
             LogEntryProcNew procNewEntry;
             logBuffer->readEntryProcNew(&procNewEntry);
@@ -153,7 +170,8 @@ void LogManager::readLogEntries(LogBuffer *logBuffer)
             setCurrentUnixTime(timeEntry.unixTime());
         } break;
         default:
-            if (logBuffer->offset() < logBuffer->top()) {
+            // FORT_LOG_TYPE_NONE skips the rest of a log ring
+            if (logType != FORT_LOG_TYPE_NONE && logBuffer->offset() < logBuffer->top()) {
                 const auto data = QByteArray::fromRawData(
                         logBuffer->array().constData() + logBuffer->offset(),
                         logBuffer->top() - logBuffer->offset());
@@ -165,3 +183,31 @@ void LogManager::readLogEntries(LogBuffer *logBuffer)
         }
     }
 }
+
+void LogManager::readLogRings()
+{
+    const auto driverWorker = IoC<DriverManager>()->driverWorker();
+
+    bool pathsReset;
+    const QVector<QByteArrayList> ringViews = driverWorker->readLogRings(pathsReset);
+    const int ringCount = ringViews.size();
+
+    // The path ids are defined again from the new reader's start
+    if (pathsReset) {
+        m_ringPaths.clear();
+    }
+
+    if (m_ringPaths.size() < ringCount) {
+        m_ringPaths.resize(ringCount);
+    }
+
+    for (int i = 0; i < ringCount; ++i) {
+        for (const QByteArray &view : ringViews[i]) {
+            LogBuffer logBuffer(view);
+            logBuffer.setPathTable(&m_ringPaths[i]);
+            readLogEntries(&logBuffer);
+        }
+    }
+
+    driverWorker->commitLogRings();
+}
@@ -2,10 +2,12 @@
 #define LOGMANAGER_H
 
 #include <QObject>
+#include <QVector>
 
 #include <util/ioc/iocservice.h>
 
-class LogBuffer;
+#include "logbuffer.h"
+
 class LogEntry;
 
 class LogManager : public QObject, public IocService
@@ -42,12 +44,17 @@ private:
     void addFreeBuffer(LogBuffer *logBuffer);
 
     void readLogEntries(LogBuffer *logBuffer);
+    void readLogRings();
 
 private:
     bool m_active = false;
 
     QList<LogBuffer *> m_freeBuffers;
 
+    // Each log stream of the driver defines its own paths
+    LogPathTable m_bufferPaths;
+    QVector<LogPathTable> m_ringPaths;
+
     QString m_errorMessage;
 
     qint64 m_currentUnixTime = 0;
@@ -0,0 +1,173 @@
+#include "calloutstatmodel.h"
+
+#include <driver/drivercommon.h>
+
+CalloutStatModel::CalloutStatModel(QObject *parent) : TableItemModel(parent) { }
+
+int CalloutStatModel::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+
+    return m_calloutStats.size();
+}
+
+int CalloutStatModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 9;
+}
+
+QVariant CalloutStatModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && (role == Qt::DisplayRole || role == Qt::ToolTipRole)) {
+        switch (section) {
+        case 0:
+            return tr("Callout");
+        case 1:
+            return tr("Calls");
+        case 2:
+            return tr("Permitted");
+        case 3:
+            return tr("Blocked");
+        case 4:
+            return tr("Deferred");
+        case 5:
+            return tr("Reauthorized");
+        case 6:
+            return tr("Median, ns");
+        case 7:
+            return tr("99%, ns");
+        case 8:
+            return tr("Max, ns");
+        }
+    }
+    return QVariant();
+}
+
+QVariant CalloutStatModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    switch (role) {
+    // Label
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        return dataDisplay(index);
+    }
+
+    return QVariant();
+}
+
+QVariant CalloutStatModel::dataDisplay(const QModelIndex &index) const
+{
+    const int row = index.row();
+    const int column = index.column();
+
+    const auto &statRow = calloutStatRowAt(row);
+
+    switch (column) {
+    case 0:
+        return calloutName(row);
+    case 1:
+        return statRow.calls;
+    case 2:
+        return statRow.permits;
+    case 3:
+        return statRow.blocks;
+    case 4:
+        return statRow.defers;
+    case 5:
+        return statRow.reauths;
+    case 6:
+        return statRow.medianNs;
+    case 7:
+        return statRow.p99Ns;
+    case 8:
+        return statRow.maxNs;
+    }
+
+    return QVariant();
+}
+
+const CalloutStatRow &CalloutStatModel::calloutStatRowAt(int row) const
+{
+    if (row < 0 || row >= m_calloutStats.size()) {
+        static const CalloutStatRow g_nullCalloutStatRow;
+        return g_nullCalloutStatRow;
+    }
+    return m_calloutStats[row];
+}
+
+void CalloutStatModel::setStats(const QByteArray &buf)
+{
+    m_calloutStats.clear();
+
+    if (!buf.isEmpty()) {
+        const char *input = buf.constData();
+
+        const qint64 ticksFreq = DriverCommon::calloutStatsTicksFreq(input);
+        const double nsPerTick = (ticksFreq != 0) ? 1e9 / ticksFreq : 0;
+
+        const int calloutCount = DriverCommon::calloutCount();
+        m_calloutStats.resize(calloutCount);
+
+        for (int id = 0; id < calloutCount; ++id) {
+            CalloutStatRow &statRow = m_calloutStats[id];
+
+            DriverCommon::calloutStatRead(input, id, &statRow.calls, &statRow.permits,
+                    &statRow.blocks, &statRow.defers, &statRow.reauths);
+
+            readLatency(input, id, nsPerTick, statRow);
+        }
+    }
+
+    reset();
+}
+
+QString CalloutStatModel::calloutName(int calloutId)
+{
+    static const QStringList names = { "Connect", "Accept", "Stream", "Datagram",
+        "Inbound Transport", "Outbound Transport", "Flow Delete" };
+
+    return names.value(calloutId);
+}
+
+void CalloutStatModel::readLatency(
+        const char *input, int calloutId, double nsPerTick, CalloutStatRow &statRow)
+{
+    const int bucketCount = DriverCommon::calloutLatencyBuckets();
+
+    QVector<quint64> buckets(bucketCount);
+    quint64 total = 0;
+
+    for (int b = 0; b < bucketCount; ++b) {
+        total += buckets[b] = DriverCommon::calloutStatLatency(input, calloutId, b);
+    }
+
+    if (total == 0)
+        return;
+
+    // The bucket #b counts the calls of less than 2^b ticks
+    const auto bucketNs = [&](int b) { return qRound64((qint64(1) << b) * nsPerTick); };
+
+    const quint64 medianCount = (total + 1) / 2;
+    const quint64 p99Count = total - total / 100;
+
+    quint64 count = 0;
+    for (int b = 0; b < bucketCount; ++b) {
+        const quint64 n = buckets[b];
+        if (n == 0)
+            continue;
+
+        if (count < medianCount && count + n >= medianCount) {
+            statRow.medianNs = bucketNs(b);
+        }
+        if (count < p99Count && count + n >= p99Count) {
+            statRow.p99Ns = bucketNs(b);
+        }
+
+        statRow.maxNs = bucketNs(b);
+
+        count += n;
+    }
+}
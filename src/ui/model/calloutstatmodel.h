@@ -0,0 +1,59 @@
+#ifndef CALLOUTSTATMODEL_H
+#define CALLOUTSTATMODEL_H
+
+#include <QVector>
+
+#include <util/model/tableitemmodel.h>
+
+struct CalloutStatRow
+{
+    quint64 calls = 0;
+    quint64 permits = 0;
+    quint64 blocks = 0;
+    quint64 defers = 0;
+    quint64 reauths = 0;
+
+    // Upper bounds of the latency histogram's buckets, in nanoseconds
+    qint64 medianNs = 0;
+    qint64 p99Ns = 0;
+    qint64 maxNs = 0;
+};
+
+class CalloutStatModel : public TableItemModel
+{
+    Q_OBJECT
+
+public:
+    explicit CalloutStatModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    QVariant headerData(
+            int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    const CalloutStatRow &calloutStatRowAt(int row) const;
+
+    // The buffer is the output of DriverManager::readStats(), empty when not read
+    void setStats(const QByteArray &buf);
+
+protected:
+    bool updateTableRow(int /*row*/) const override { return true; }
+    TableRow &tableRow() const override { return m_calloutRow; }
+
+private:
+    QVariant dataDisplay(const QModelIndex &index) const;
+
+    static QString calloutName(int calloutId);
+
+    static void readLatency(
+            const char *input, int calloutId, double nsPerTick, CalloutStatRow &statRow);
+
+private:
+    QVector<CalloutStatRow> m_calloutStats;
+
+    mutable TableRow m_calloutRow;
+};
+
+#endif // CALLOUTSTATMODEL_H
@@ -148,7 +148,10 @@ QVariant ConnListModel::dataDisplayDirection(const ConnRow &connRow, int role) c
         if (connRow.blocked) {
             // Show block reason in a tool-tip
             return blockReasonText(connRow)
-                    + (connRow.inherited ? " (" + tr("Inherited") + ")" : QString());
+                    + (connRow.inherited ? " (" + tr("Inherited") + ")" : QString())
+                    + (connRow.repeatCount > 1
+                                    ? " (" + tr("Repeats: %1").arg(connRow.repeatCount) + ")"
+                                    : QString());
         }
     }
     return connRow.inbound ? tr("In") : tr("Out");
@@ -308,6 +311,7 @@ bool ConnListModel::updateTableRow(int row) const
 
     if (isConnBlock()) {
         m_connRow.blockReason = stmt.columnInt(13);
+        m_connRow.repeatCount = stmt.columnInt(14);
     }
 
     return true;
@@ -339,7 +343,8 @@ QString ConnListModel::sqlBase() const
                                "    JOIN %1 c ON c.conn_id = t.conn_id"
                                "    JOIN app a ON a.app_id = t.app_id")
             .arg(isConnBlock() ? "conn_block" : "conn_traffic",
-                    isConnBlock() ? "c.block_reason" : "c.end_time, c.in_bytes, c.out_bytes");
+                    isConnBlock() ? "c.block_reason, c.repeat_count"
+                                  : "c.end_time, c.in_bytes, c.out_bytes");
 }
 
 QString ConnListModel::sqlWhere() const
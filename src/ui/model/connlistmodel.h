@@ -19,6 +19,8 @@ struct ConnRow : TableRow
 
     quint8 blockReason = 0;
 
+    quint32 repeatCount = 1;
+
     quint8 ipProto = 0;
     quint16 localPort = 0;
     quint16 remotePort = 0;
@@ -0,0 +1,88 @@
+#include "driverstatmodel.h"
+
+#include <driver/drivercommon.h>
+
+DriverStatModel::DriverStatModel(QObject *parent) : TableItemModel(parent) { }
+
+int DriverStatModel::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+
+    return m_values.size();
+}
+
+int DriverStatModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 2;
+}
+
+QVariant DriverStatModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && (role == Qt::DisplayRole || role == Qt::ToolTipRole)) {
+        switch (section) {
+        case 0:
+            return tr("Name");
+        case 1:
+            return tr("Value");
+        }
+    }
+    return QVariant();
+}
+
+QVariant DriverStatModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    switch (role) {
+    // Label
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        return dataDisplay(index);
+    }
+
+    return QVariant();
+}
+
+QVariant DriverStatModel::dataDisplay(const QModelIndex &index) const
+{
+    const int row = index.row();
+    const int column = index.column();
+
+    switch (column) {
+    case 0:
+        return statName(row);
+    case 1:
+        return m_values.value(row);
+    }
+
+    return QVariant();
+}
+
+void DriverStatModel::setStats(const QByteArray &buf)
+{
+    m_values.clear();
+
+    if (!buf.isEmpty()) {
+        const char *input = buf.constData();
+
+        const int statCount = DriverCommon::driverStatCount();
+        m_values.resize(statCount);
+
+        for (int id = 0; id < statCount; ++id) {
+            m_values[id] = DriverCommon::driverStatValue(input, id);
+        }
+    }
+
+    reset();
+}
+
+QString DriverStatModel::statName(int statId)
+{
+    static const QStringList names = { "Active Flows", "Verdict Cache Hits",
+        "Verdict Cache Misses", "Flow Table Full", "Shaper Deferred", "Shaper Dropped",
+        "Flows Reassociated", "Flow Layers Avoided", "Deferred Queue Max", "Deferred Re-injected",
+        "Deferred Wait Max, us", "Deferred Wait Sum, us" };
+
+    return names.value(statId);
+}
@@ -0,0 +1,40 @@
+#ifndef DRIVERSTATMODEL_H
+#define DRIVERSTATMODEL_H
+
+#include <QVector>
+
+#include <util/model/tableitemmodel.h>
+
+class DriverStatModel : public TableItemModel
+{
+    Q_OBJECT
+
+public:
+    explicit DriverStatModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    QVariant headerData(
+            int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    // The buffer is the output of DriverManager::readStats(), empty when not read
+    void setStats(const QByteArray &buf);
+
+protected:
+    bool updateTableRow(int /*row*/) const override { return true; }
+    TableRow &tableRow() const override { return m_driverRow; }
+
+private:
+    QVariant dataDisplay(const QModelIndex &index) const;
+
+    static QString statName(int statId);
+
+private:
+    QVector<quint64> m_values;
+
+    mutable TableRow m_driverRow;
+};
+
+#endif // DRIVERSTATMODEL_H
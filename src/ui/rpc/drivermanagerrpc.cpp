@@ -36,3 +36,15 @@ bool DriverManagerRpc::closeDevice()
 
     return false;
 }
+
+bool DriverManagerRpc::readStats(QByteArray &buf)
+{
+    QVariantList resArgs;
+
+    if (!IoC<RpcManager>()->doOnServer(Control::Rpc_DriverManager_readStats, {}, &resArgs))
+        return false;
+
+    buf = resArgs.value(0).toByteArray();
+
+    return !buf.isEmpty();
+}
@@ -21,6 +21,8 @@ public slots:
     bool openDevice() override;
     bool closeDevice() override;
 
+    bool readStats(QByteArray &buf) override;
+
 private:
     bool m_isDeviceOpened : 1;
 };
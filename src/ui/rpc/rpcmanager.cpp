@@ -560,6 +560,12 @@ bool RpcManager::processDriverManagerRpc(const ProcessCommandArgs &p)
             dm->updateState(p.args.value(0).toUInt(), p.args.value(1).toBool());
         }
         return true;
+    case Control::Rpc_DriverManager_readStats: {
+        QByteArray buf;
+        driverManager->readStats(buf); // empty, when the driver is not opened
+        sendResult(p.worker, true, { buf });
+        return true;
+    }
     default:
         return false;
     }
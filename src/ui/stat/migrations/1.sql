@@ -75,7 +75,8 @@ CREATE INDEX conn_app_id_idx ON conn(app_id);
 CREATE TABLE conn_block(
   id INTEGER PRIMARY KEY,
   conn_id INTEGER NOT NULL,
-  block_reason INTEGER NOT NULL
+  block_reason INTEGER NOT NULL,
+  repeat_count INTEGER NOT NULL DEFAULT 1
 );
 
 CREATE UNIQUE INDEX conn_block_conn_id_uk ON conn_block(conn_id);
@@ -85,7 +86,8 @@ CREATE TABLE conn_traffic(
   conn_id INTEGER NOT NULL,
   end_time INTEGER NOT NULL,
   in_bytes INTEGER NOT NULL,
-  out_bytes INTEGER NOT NULL
+  out_bytes INTEGER NOT NULL,
+  conn_count INTEGER NOT NULL DEFAULT 1
 );
 
 CREATE UNIQUE INDEX conn_traffic_conn_id_uk ON conn_traffic(conn_id);
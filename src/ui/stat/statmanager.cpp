@@ -24,12 +24,14 @@ Q_LOGGING_CATEGORY(CLOG_STAT_MANAGER, "stat")
 #define logWarning()  qCWarning(CLOG_STAT_MANAGER, )
 #define logCritical() qCCritical(CLOG_STAT_MANAGER, )
 
-#define DATABASE_USER_VERSION 5
+#define DATABASE_USER_VERSION 7
 
 #define ACTIVE_PERIOD_CHECK_SECS (60 * OS_TICKS_PER_SECOND)
 
 #define INVALID_APP_ID qint64(-1)
 
+#define ALLOWED_IP_BATCH_MAX 256
+
 namespace {
 
 bool migrateFunc(SqliteDb *db, int version, bool isNewDb, void *ctx)
@@ -65,6 +67,9 @@ StatManager::StatManager(const QString &filePath, QObject *parent, quint32 openF
     m_isActivePeriod(false),
     m_sqliteDb(new SqliteDb(filePath, openFlags))
 {
+    m_allowedIpTimer.setInterval(1000);
+
+    connect(&m_allowedIpTimer, &QTimer::timeout, this, &StatManager::flushAllowedIp);
     connect(&m_connChangedTimer, &QTimer::timeout, this, &StatManager::connChanged);
 }
 
@@ -120,6 +125,11 @@ void StatManager::updateConnBlockId()
     const auto vars = sqliteDb()->executeEx(StatSql::sqlSelectMinMaxConnBlockId, {}, 2).toList();
     m_connBlockIdMin = vars.value(0).toLongLong();
     m_connBlockIdMax = vars.value(1).toLongLong();
+
+    const auto trafVars =
+            sqliteDb()->executeEx(StatSql::sqlSelectMinMaxConnTrafId, {}, 2).toList();
+    m_connTrafIdMin = trafVars.value(0).toLongLong();
+    m_connTrafIdMax = trafVars.value(1).toLongLong();
 }
 
 void StatManager::setupTrafDate()
@@ -390,6 +400,57 @@ bool StatManager::logBlockedIp(const LogEntryBlockedIp &entry, qint64 unixTime)
     return ok;
 }
 
+bool StatManager::logAllowedIp(const LogEntryBlockedIp &entry, qint64 unixTime)
+{
+    if (!conf() || !conf()->logAllowedIp())
+        return false;
+
+    m_allowedIpList.append(entry);
+    m_allowedIpList.last().setLastTime(unixTime);
+
+    // Insert the connections in batches
+    if (m_allowedIpList.size() >= ALLOWED_IP_BATCH_MAX) {
+        flushAllowedIp();
+    } else {
+        m_allowedIpTimer.startTrigger();
+    }
+
+    return true;
+}
+
+void StatManager::flushAllowedIp()
+{
+    m_allowedIpTimer.stop();
+
+    if (m_allowedIpList.isEmpty())
+        return;
+
+    int count = 0;
+    sqliteDb()->beginTransaction();
+
+    for (const LogEntryBlockedIp &entry : qAsConst(m_allowedIpList)) {
+        const qint64 appId = getOrCreateAppId(entry.path(), entry.lastTime());
+        if (appId != INVALID_APP_ID && createConnTraf(entry, appId)) {
+            ++count;
+        }
+    }
+
+    sqliteDb()->endTransaction();
+
+    m_allowedIpList.clear();
+
+    if (count > 0) {
+        emitConnChanged();
+
+        constexpr int connTrafIncMax = 1000;
+        m_connTrafInc += count;
+        if (m_connTrafInc >= connTrafIncMax) {
+            m_connTrafInc = 0;
+            deleteOldConnTraf();
+        }
+    }
+}
+
 bool StatManager::deleteStatApp(qint64 appId)
 {
     sqliteDb()->beginTransaction();
@@ -422,6 +483,21 @@ bool StatManager::deleteOldConnBlock()
     return true;
 }
 
+bool StatManager::deleteOldConnTraf()
+{
+    const int keepCount = ini()->allowedIpKeepCount();
+    const int totalCount = m_connTrafIdMax - m_connTrafIdMin + 1;
+    const int oldCount = totalCount - keepCount;
+    if (oldCount <= 0)
+        return false;
+
+    deleteConnTraf(m_connTrafIdMin + oldCount - 1);
+
+    emitConnChanged();
+
+    return true;
+}
+
 bool StatManager::deleteConn(qint64 rowIdTo, bool blocked)
 {
     sqliteDb()->beginTransaction();
@@ -429,7 +505,7 @@ bool StatManager::deleteConn(qint64 rowIdTo, bool blocked)
     if (blocked) {
         deleteConnBlock(rowIdTo);
     } else {
-        // TODO: deleteRangeConnTraf(rowIdTo);
+        deleteConnTraf(rowIdTo);
     }
 
     sqliteDb()->commitTransaction();
@@ -444,7 +520,8 @@ bool StatManager::deleteConnAll()
     sqliteDb()->beginTransaction();
 
     deleteAppStmtList({ sqliteDb()->stmt(StatSql::sqlDeleteAllConn),
-                              sqliteDb()->stmt(StatSql::sqlDeleteAllConnBlock) },
+                              sqliteDb()->stmt(StatSql::sqlDeleteAllConnBlock),
+                              sqliteDb()->stmt(StatSql::sqlDeleteAllConnTraf) },
             sqliteDb()->stmt(StatSql::sqlSelectDeletedAllConnAppList));
 
     sqliteDb()->vacuum();
@@ -452,6 +529,7 @@ bool StatManager::deleteConnAll()
     sqliteDb()->commitTransaction();
 
     m_connBlockIdMin = m_connBlockIdMax = 0;
+    m_connTrafIdMin = m_connTrafIdMax = 0;
 
     emitConnChanged();
 
@@ -662,11 +740,12 @@ qint64 StatManager::insertConn(const LogEntryBlockedIp &entry, qint64 unixTime,
     stmt->bindInt(3, entry.pid());
     stmt->bindInt(4, entry.inbound());
     stmt->bindInt(5, entry.inherited());
-    stmt->bindInt(6, entry.ipProto());
-    stmt->bindInt(7, entry.localPort());
-    stmt->bindInt(8, entry.remotePort());
-    stmt->bindInt(9, entry.localIp());
-    stmt->bindInt(10, entry.remoteIp());
+    stmt->bindInt(6, entry.blocked());
+    stmt->bindInt(7, entry.ipProto());
+    stmt->bindInt(8, entry.localPort());
+    stmt->bindInt(9, entry.remotePort());
+    stmt->bindInt(10, entry.localIp());
+    stmt->bindInt(11, entry.remoteIp());
 
     if (sqliteDb()->done(stmt)) {
         return sqliteDb()->lastInsertRowid();
@@ -675,12 +754,28 @@ qint64 StatManager::insertConn(const LogEntryBlockedIp &entry, qint64 unixTime,
     return 0;
 }
 
-qint64 StatManager::insertConnBlock(qint64 connId, quint8 blockReason)
+qint64 StatManager::insertConnBlock(qint64 connId, quint8 blockReason, quint32 repeatCount)
 {
     SqliteStmt *stmt = sqliteDb()->stmt(StatSql::sqlInsertConnBlock);
 
     stmt->bindInt64(1, connId);
     stmt->bindInt(2, blockReason);
+    stmt->bindInt(3, repeatCount);
+
+    if (sqliteDb()->done(stmt)) {
+        return sqliteDb()->lastInsertRowid();
+    }
+
+    return 0;
+}
+
+qint64 StatManager::insertConnTraf(qint64 connId, qint64 endTime, quint32 connCount)
+{
+    SqliteStmt *stmt = sqliteDb()->stmt(StatSql::sqlInsertConnTraf);
+
+    stmt->bindInt64(1, connId);
+    stmt->bindInt64(2, endTime);
+    stmt->bindInt(3, connCount);
 
     if (sqliteDb()->done(stmt)) {
         return sqliteDb()->lastInsertRowid();
@@ -695,7 +790,7 @@ bool StatManager::createConnBlock(const LogEntryBlockedIp &entry, qint64 unixTim
     if (connId <= 0)
         return false;
 
-    const qint64 connBlockId = insertConnBlock(connId, entry.blockReason());
+    const qint64 connBlockId = insertConnBlock(connId, entry.blockReason(), entry.repeatCount());
     if (connBlockId <= 0)
         return false;
 
@@ -708,6 +803,27 @@ bool StatManager::createConnBlock(const LogEntryBlockedIp &entry, qint64 unixTim
     return true;
 }
 
+bool StatManager::createConnTraf(const LogEntryBlockedIp &entry, qint64 appId)
+{
+    const qint64 unixTime = entry.lastTime();
+
+    const qint64 connId = insertConn(entry, unixTime, appId);
+    if (connId <= 0)
+        return false;
+
+    const qint64 connTrafId = insertConnTraf(connId, unixTime, entry.repeatCount());
+    if (connTrafId <= 0)
+        return false;
+
+    if (m_connTrafIdMax > 0) {
+        m_connTrafIdMax++;
+    } else {
+        m_connTrafIdMin = m_connTrafIdMax = 1;
+    }
+
+    return true;
+}
+
 void StatManager::deleteConnBlock(qint64 rowIdTo)
 {
     deleteAppStmtList({ getIdStmt(StatSql::sqlDeleteConnForBlock, rowIdTo),
@@ -720,6 +836,18 @@ void StatManager::deleteConnBlock(qint64 rowIdTo)
     }
 }
 
+void StatManager::deleteConnTraf(qint64 rowIdTo)
+{
+    deleteAppStmtList({ getIdStmt(StatSql::sqlDeleteConnForTraf, rowIdTo),
+                              getIdStmt(StatSql::sqlDeleteConnTraf, rowIdTo) },
+            getStmt(StatSql::sqlSelectDeletedConnBlockAppList));
+
+    m_connTrafIdMin = rowIdTo + 1;
+    if (m_connTrafIdMin >= m_connTrafIdMax) {
+        m_connTrafIdMin = m_connTrafIdMax = 0;
+    }
+}
+
 void StatManager::deleteAppStmtList(const StatManager::QStmtList &stmtList, SqliteStmt *stmtAppList)
 {
     // Delete Statements
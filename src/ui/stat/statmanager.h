@@ -6,13 +6,13 @@
 #include <QStringList>
 #include <QVector>
 
+#include <log/logentryblockedip.h>
 #include <util/classhelpers.h>
 #include <util/ioc/iocservice.h>
 #include <util/triggertimer.h>
 
 class FirewallConf;
 class IniOptions;
-class LogEntryBlockedIp;
 class LogEntryProcNew;
 class LogEntryStatTraf;
 class SqliteDb;
@@ -48,6 +48,7 @@ public:
     bool logStatTraf(const LogEntryStatTraf &entry, qint64 unixTime = 0);
 
     bool logBlockedIp(const LogEntryBlockedIp &entry, qint64 unixTime);
+    bool logAllowedIp(const LogEntryBlockedIp &entry, qint64 unixTime);
 
     void getStatAppList(QStringList &list, QVector<qint64> &appIds);
 
@@ -82,6 +83,9 @@ protected:
     bool isConnIdRangeUpdated() const { return m_isConnIdRangeUpdated; }
     void setIsConnIdRangeUpdated(bool v) { m_isConnIdRangeUpdated = v; }
 
+private slots:
+    void flushAllowedIp();
+
 private:
     void emitConnChanged();
 
@@ -110,6 +114,7 @@ private:
     void clearAppIdCache();
 
     bool deleteOldConnBlock();
+    bool deleteOldConnTraf();
 
     qint64 getAppId(const QString &appPath);
     qint64 createAppId(const QString &appPath, qint64 unixTime);
@@ -128,11 +133,15 @@ private:
     bool updateTraffic(SqliteStmt *stmt, quint32 inBytes, quint32 outBytes, qint64 appId = 0);
 
     qint64 insertConn(const LogEntryBlockedIp &entry, qint64 unixTime, qint64 appId);
-    qint64 insertConnBlock(qint64 connId, quint8 blockReason);
+    qint64 insertConnBlock(qint64 connId, quint8 blockReason, quint32 repeatCount);
+    qint64 insertConnTraf(qint64 connId, qint64 endTime, quint32 connCount);
 
     bool createConnBlock(const LogEntryBlockedIp &entry, qint64 unixTime, qint64 appId);
     void deleteConnBlock(qint64 rowIdTo);
 
+    bool createConnTraf(const LogEntryBlockedIp &entry, qint64 appId);
+    void deleteConnTraf(qint64 rowIdTo);
+
     void deleteAppStmtList(const QStmtList &stmtList, SqliteStmt *stmtAppList);
 
     void doStmtList(const QStmtList &stmtList);
@@ -153,6 +162,7 @@ private:
     quint8 m_activePeriodToMinute = 0;
 
     int m_connBlockInc = 999999999; // to trigger on first check
+    int m_connTrafInc = 999999999; // to trigger on first check
 
     qint32 m_trafHour = 0;
     qint32 m_trafDay = 0;
@@ -172,6 +182,9 @@ private:
     QHash<quint32, QString> m_appPidPathMap; // pid -> appPath
     QHash<QString, qint64> m_appPathIdCache; // appPath -> appId
 
+    QVector<LogEntryBlockedIp> m_allowedIpList; // batched, flushed by the timer
+    TriggerTimer m_allowedIpTimer;
+
     TriggerTimer m_connChangedTimer;
 };
 
@@ -172,13 +172,20 @@ const char *const StatSql::sqlDeleteAllTraffic =
 const char *const StatSql::sqlInsertConn =
         "INSERT INTO conn(app_id, conn_time, process_id, inbound, inherited, blocked,"
         "    ip_proto, local_port, remote_port, local_ip, remote_ip)"
-        "  VALUES(?1, ?2, ?3, ?4, ?5, 1, ?6, ?7, ?8, ?9, ?10);";
+        "  VALUES(?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11);";
 
-const char *const StatSql::sqlInsertConnBlock = "INSERT INTO conn_block(conn_id, block_reason)"
-                                                "  VALUES(?1, ?2);";
+const char *const StatSql::sqlInsertConnBlock =
+        "INSERT INTO conn_block(conn_id, block_reason, repeat_count)"
+        "  VALUES(?1, ?2, ?3);";
+
+const char *const StatSql::sqlInsertConnTraf =
+        "INSERT INTO conn_traffic(conn_id, end_time, in_bytes, out_bytes, conn_count)"
+        "  VALUES(?1, ?2, 0, 0, ?3);";
 
 const char *const StatSql::sqlSelectMinMaxConnBlockId = "SELECT MIN(id), MAX(id) FROM conn_block;";
 
+const char *const StatSql::sqlSelectMinMaxConnTrafId = "SELECT MIN(id), MAX(id) FROM conn_traffic;";
+
 const char *const StatSql::sqlDeleteConnForBlock = "DELETE FROM conn WHERE conn_id IN ("
                                                    "  SELECT conn_id FROM conn_block WHERE id <= ?1"
                                                    ");";
@@ -192,10 +199,19 @@ const char *const StatSql::sqlSelectDeletedConnBlockAppList =
         "    SELECT 1 FROM conn c WHERE c.app_id = t.app_id LIMIT 1"
         "  ) IS NULL;";
 
+const char *const StatSql::sqlDeleteConnForTraf =
+        "DELETE FROM conn WHERE conn_id IN ("
+        "  SELECT conn_id FROM conn_traffic WHERE id <= ?1"
+        ");";
+
+const char *const StatSql::sqlDeleteConnTraf = "DELETE FROM conn_traffic WHERE id <= ?1;";
+
 const char *const StatSql::sqlDeleteAllConn = "DELETE FROM conn;";
 
 const char *const StatSql::sqlDeleteAllConnBlock = "DELETE FROM conn_block;";
 
+const char *const StatSql::sqlDeleteAllConnTraf = "DELETE FROM conn_traffic;";
+
 const char *const StatSql::sqlSelectDeletedAllConnAppList =
         "SELECT t.app_id, t.path FROM app t"
         "  LEFT JOIN traffic_app ta ON ta.app_id = t.app_id"
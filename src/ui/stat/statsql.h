@@ -70,15 +70,21 @@ public:
 
     static const char *const sqlInsertConn;
     static const char *const sqlInsertConnBlock;
+    static const char *const sqlInsertConnTraf;
 
     static const char *const sqlSelectMinMaxConnBlockId;
+    static const char *const sqlSelectMinMaxConnTrafId;
 
     static const char *const sqlDeleteConnForBlock;
     static const char *const sqlDeleteConnBlock;
     static const char *const sqlSelectDeletedConnBlockAppList;
 
+    static const char *const sqlDeleteConnForTraf;
+    static const char *const sqlDeleteConnTraf;
+
     static const char *const sqlDeleteAllConn;
     static const char *const sqlDeleteAllConnBlock;
+    static const char *const sqlDeleteAllConnTraf;
     static const char *const sqlSelectDeletedAllConnAppList;
 };
 
@@ -162,7 +162,6 @@ void TaskInfoZoneDownloader::clearSubResults()
 {
     m_dataZonesMask = 0;
     m_enabledMask = 0;
-    m_dataSize = 0;
     m_zonesData.clear();
 }
 
@@ -175,12 +174,10 @@ void TaskInfoZoneDownloader::addSubResult(TaskZoneDownloader *worker, bool succe
     }
 
     const auto zoneData = worker->zoneData();
-    const int size = zoneData.size();
 
-    if (size == 0)
+    if (zoneData.isEmpty())
         return;
 
-    m_dataSize += size;
     m_zonesData.append(zoneData);
 
     insertZoneId(m_dataZonesMask, worker->zoneId());
@@ -192,7 +189,7 @@ void TaskInfoZoneDownloader::addSubResult(TaskZoneDownloader *worker, bool succe
 
 void TaskInfoZoneDownloader::emitZonesUpdated()
 {
-    emit zonesUpdated(m_dataZonesMask, m_enabledMask, m_dataSize, m_zonesData);
+    emit zonesUpdated(m_dataZonesMask, m_enabledMask, m_zonesData);
 
     removeOrphanCacheFiles();
 
@@ -19,8 +19,8 @@ public:
     ZoneListModel *zoneListModel() const;
 
 signals:
-    void zonesUpdated(quint32 zonesMask, quint32 enabledMask, quint32 dataSize,
-            const QList<QByteArray> &zonesData);
+    void zonesUpdated(
+            quint32 zonesMask, quint32 enabledMask, const QList<QByteArray> &zonesData);
 
 public slots:
     bool processResult(bool success) override;
@@ -57,7 +57,6 @@ private:
 
     quint32 m_dataZonesMask = 0;
     quint32 m_enabledMask = 0;
-    quint32 m_dataSize = 0;
 
     QStringList m_zoneNames;
     QList<QByteArray> m_zonesData;
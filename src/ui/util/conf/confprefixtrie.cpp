@@ -0,0 +1,98 @@
+#include "confprefixtrie.h"
+
+#include <common/fortconf.h>
+
+void ConfPrefixTrie::build(const QStringList &prefixPaths)
+{
+    m_paths = prefixPaths;
+
+    m_nodes.clear();
+    m_nodes.append(Node()); // root
+
+    buildNode(0, 0, m_paths.size(), 0);
+}
+
+quint32 ConfPrefixTrie::size() const
+{
+    return FORT_CONF_PREFIX_TRIE_SIZE(m_nodes.size());
+}
+
+void ConfPrefixTrie::write(char **data) const
+{
+    PFORT_CONF_PREFIX_TRIE prefixTrie = PFORT_CONF_PREFIX_TRIE(*data);
+
+    prefixTrie->node_n = quint32(m_nodes.size());
+
+    // Breadth-first order keeps the children of a node together
+    QVector<int> order = { 0 };
+    QVector<int> childOffsets(m_nodes.size());
+
+    for (int i = 0; i < order.size(); ++i) {
+        const int nodeIndex = order.at(i);
+
+        childOffsets[nodeIndex] = order.size();
+        order.append(m_nodes.at(nodeIndex).children);
+    }
+
+    PFORT_CONF_PREFIX_NODE drvNode = prefixTrie->nodes;
+
+    for (const int nodeIndex : order) {
+        const Node &node = m_nodes.at(nodeIndex);
+
+        drvNode->c = node.c;
+        drvNode->label_len = node.labelLen;
+        drvNode->label_app = node.labelApp;
+        drvNode->label_pos = node.labelPos;
+        drvNode->app_id = node.appId;
+        drvNode->child_n = quint16(node.children.size());
+        drvNode->child_off = quint32(childOffsets.at(nodeIndex));
+        ++drvNode;
+    }
+
+    *data += size();
+}
+
+// Paths are sorted and share the first "depth" chars
+void ConfPrefixTrie::buildNode(int nodeIndex, int lo, int hi, int depth)
+{
+    int i = lo;
+
+    // The path, which ends at the node, is first
+    if (i < hi && m_paths.at(i).size() == depth) {
+        m_nodes[nodeIndex].appId = quint16(i + 1);
+        ++i;
+    }
+
+    while (i < hi) {
+        const QString &first = m_paths.at(i);
+        const QChar c = first.at(depth);
+
+        int j = i + 1;
+        while (j < hi && m_paths.at(j).at(depth) == c) {
+            ++j;
+        }
+
+        // Common prefix of the sorted group is the common prefix of its first and last paths
+        const QString &last = m_paths.at(j - 1);
+        const int maxLen = qMin(first.size(), last.size());
+
+        int childDepth = depth + 1;
+        while (childDepth < maxLen && first.at(childDepth) == last.at(childDepth)) {
+            ++childDepth;
+        }
+
+        Node child;
+        child.c = c.unicode();
+        child.labelLen = quint16(childDepth - depth);
+        child.labelApp = quint16(i);
+        child.labelPos = quint16(depth);
+
+        const int childIndex = m_nodes.size();
+        m_nodes.append(child);
+        m_nodes[nodeIndex].children.append(childIndex);
+
+        buildNode(childIndex, i, j, childDepth);
+
+        i = j;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef CONFPREFIXTRIE_H
+#define CONFPREFIXTRIE_H
+
+#include <QObject>
+#include <QVector>
+
+// Compressed trie of prefix paths, which labels refer to the paths' chars.
+// The driver walks it once per path to find the longest matching prefix.
+class ConfPrefixTrie
+{
+public:
+    explicit ConfPrefixTrie() = default;
+
+    void build(const QStringList &prefixPaths);
+
+    quint32 size() const;
+
+    void write(char **data) const;
+
+private:
+    void buildNode(int nodeIndex, int lo, int hi, int depth);
+
+private:
+    struct Node
+    {
+        quint16 c = 0;
+        quint16 labelLen = 0;
+        quint16 labelApp = 0;
+        quint16 labelPos = 0;
+        quint16 appId = 0;
+        QVector<int> children;
+    };
+
+    QStringList m_paths;
+    QVector<Node> m_nodes;
+};
+
+#endif // CONFPREFIXTRIE_H
@@ -16,6 +16,8 @@
 #include <util/stringutil.h>
 
 #include "confappswalker.h"
+#include "confprefixtrie.h"
+#include "confwildindex.h"
 
 #define APP_GROUP_MAX      FORT_CONF_GROUP_MAX
 #define APP_GROUP_NAME_MAX 128
@@ -45,6 +47,74 @@ void writeConfFlags(const FirewallConf &conf, PFORT_CONF_FLAGS confFlags)
     confFlags->group_bits = conf.appGroupBits();
 }
 
+struct ZoneEdge
+{
+    quint64 ip;
+    qint8 delta;
+    quint8 zoneIndex;
+};
+
+using zoneedges_arr_t = QVector<ZoneEdge>;
+
+void addZoneRange(zoneedges_arr_t &edges, int zoneIndex, quint32 from, quint32 to)
+{
+    edges.append({ from, 1, quint8(zoneIndex) });
+    edges.append({ quint64(to) + 1, -1, quint8(zoneIndex) });
+}
+
+void addZoneEdges(zoneedges_arr_t &edges, int zoneIndex, const Ip4Range &ip4Range)
+{
+    for (const quint32 ip : ip4Range.ipArray()) {
+        addZoneRange(edges, zoneIndex, ip, ip);
+    }
+
+    for (int i = 0, n = ip4Range.pairSize(); i < n; ++i) {
+        const Ip4Pair pair = ip4Range.pairAt(i);
+
+        addZoneRange(edges, zoneIndex, pair.from, pair.to);
+    }
+}
+
+// Merge the zones' ranges into non-overlapping intervals with masks of zones
+void buildZoneIntervals(zoneedges_arr_t &edges, longs_arr_t &ipArray, longs_arr_t &maskArray)
+{
+    std::sort(edges.begin(), edges.end(),
+            [](const ZoneEdge &a, const ZoneEdge &b) { return a.ip < b.ip; });
+
+    int zoneCounts[FORT_CONF_ZONE_MAX] = {};
+    quint32 mask = 0;
+
+    ipArray.append(0);
+    maskArray.append(0);
+
+    for (int i = 0, n = edges.size(); i < n;) {
+        const quint64 ip = edges[i].ip;
+
+        // Apply all edges at the IP
+        do {
+            const ZoneEdge &edge = edges[i];
+            const quint32 zoneMask = (quint32(1) << edge.zoneIndex);
+
+            zoneCounts[edge.zoneIndex] += edge.delta;
+
+            mask = (zoneCounts[edge.zoneIndex] > 0) ? (mask | zoneMask) : (mask & ~zoneMask);
+        } while (++i < n && edges[i].ip == ip);
+
+        if (ip > 0xFFFFFFFF)
+            break; // end of the address space
+
+        if (mask == maskArray.last())
+            continue;
+
+        if (ipArray.last() == ip) {
+            maskArray.last() = mask;
+        } else {
+            ipArray.append(quint32(ip));
+            maskArray.append(mask);
+        }
+    }
+}
+
 }
 
 ConfUtil::ConfUtil(QObject *parent) : QObject(parent) { }
@@ -64,6 +134,17 @@ void ConfUtil::setErrorMessage(const QString &errorMessage)
 
 int ConfUtil::write(const FirewallConf &conf, ConfAppsWalker *confAppsWalker,
         EnvManager &envManager, QByteArray &buf)
+{
+    return writeConf(conf, confAppsWalker, envManager, buf, /*isPatch=*/false);
+}
+
+int ConfUtil::writePatch(const FirewallConf &conf, EnvManager &envManager, QByteArray &buf)
+{
+    return writeConf(conf, /*confAppsWalker=*/nullptr, envManager, buf, /*isPatch=*/true);
+}
+
+int ConfUtil::writeConf(const FirewallConf &conf, ConfAppsWalker *confAppsWalker,
+        EnvManager &envManager, QByteArray &buf, bool isPatch)
 {
     quint32 addressGroupsSize = 0;
     longs_arr_t addressGroupOffsets;
@@ -85,27 +166,45 @@ int ConfUtil::write(const FirewallConf &conf, ConfAppsWalker *confAppsWalker,
     quint32 exeAppsSize = 0;
 
     if (!parseAppGroups(envManager, conf.appGroups(), appPeriods, appPeriodsCount, wildAppsMap,
-                prefixAppsMap, exeAppsMap, wildAppsSize, prefixAppsSize, exeAppsSize)
-            || !parseExeApps(confAppsWalker, exeAppsMap, exeAppsSize))
+                prefixAppsMap, exeAppsMap, wildAppsSize, prefixAppsSize, exeAppsSize))
         return 0;
 
+    setExeAppsKey(conf.appGroups(), exeAppsMap);
+
+    if (isPatch) {
+        // The driver keeps its exe apps
+        exeAppsMap.clear();
+        exeAppsSize = 0;
+    } else if (!parseExeApps(confAppsWalker, exeAppsMap, exeAppsSize)) {
+        return 0;
+    }
+
     const quint32 appsSize = wildAppsSize + prefixAppsSize + exeAppsSize;
     if (appsSize > FORT_CONF_APPS_LEN_MAX) {
         setErrorMessage(tr("Too many application paths"));
         return 0;
     }
 
+    ConfWildIndex wildIndex;
+    wildIndex.build(wildAppsMap.keys());
+
+    ConfPrefixTrie prefixTrie;
+    prefixTrie.build(prefixAppsMap.keys());
+
     // Fill the buffer
     const size_t confIoSize = FORT_CONF_IO_CONF_OFF + FORT_CONF_DATA_OFF + addressGroupsSize
             + FORT_CONF_STR_DATA_SIZE(conf.appGroups().size() * sizeof(FORT_PERIOD)) // appPeriods
-            + FORT_CONF_STR_DATA_SIZE(wildAppsSize)
+            + FORT_CONF_STR_HEADER_SIZE(wildAppsMap.size())
+            + FORT_CONF_STR_DATA_SIZE(wildAppsSize) + wildIndex.size()
             + FORT_CONF_STR_HEADER_SIZE(prefixAppsMap.size())
-            + FORT_CONF_STR_DATA_SIZE(prefixAppsSize) + FORT_CONF_STR_DATA_SIZE(exeAppsSize);
+            + FORT_CONF_STR_DATA_SIZE(prefixAppsSize) + prefixTrie.size()
+            + FORT_CONF_STR_DATA_SIZE(exeAppsSize);
 
-    buf.reserve(confIoSize);
+    // Zero the paddings, the driver compares the confs
+    buf.fill('\0', int(confIoSize));
 
     writeData(buf.data(), conf, addressRanges, addressGroupOffsets, appPeriods, appPeriodsCount,
-            wildAppsMap, prefixAppsMap, exeAppsMap);
+            wildAppsMap, wildIndex, prefixAppsMap, prefixTrie, exeAppsMap);
 
     return int(confIoSize);
 }
@@ -160,7 +259,7 @@ int ConfUtil::writeVersion(QByteArray &buf)
 
 int ConfUtil::writeZone(const Ip4Range &ip4Range, QByteArray &buf)
 {
-    const int addrSize = FORT_CONF_ADDR_LIST_SIZE(ip4Range.ipSize(), ip4Range.pairSize());
+    const int addrSize = DriverCommon::confAddrListSize(ip4Range.ipSize(), ip4Range.pairSize());
 
     buf.reserve(addrSize);
 
@@ -172,35 +271,48 @@ int ConfUtil::writeZone(const Ip4Range &ip4Range, QByteArray &buf)
     return addrSize;
 }
 
-int ConfUtil::writeZones(quint32 zonesMask, quint32 enabledMask, quint32 dataSize,
+int ConfUtil::writeZones(quint32 zonesMask, quint32 enabledMask,
         const QList<QByteArray> &zonesData, QByteArray &buf)
 {
-    const int zonesSize = FORT_CONF_ZONES_DATA_OFF + dataSize;
+    zoneedges_arr_t edges;
+    quint32 dataZonesMask = zonesMask;
+
+    for (const auto &zoneData : zonesData) {
+        Q_ASSERT(!zoneData.isEmpty());
+
+        const int zoneIndex = DriverCommon::bitScanForward(dataZonesMask);
+        const quint32 zoneMask = (quint32(1) << zoneIndex);
+
+        Ip4Range ip4Range;
+        if (!loadZone(zoneData, ip4Range)) {
+            setErrorMessage(tr("Bad Zone data"));
+            return 0;
+        }
+
+        addZoneEdges(edges, zoneIndex, ip4Range);
+
+        dataZonesMask ^= zoneMask;
+    }
+
+    longs_arr_t ipArray;
+    longs_arr_t maskArray;
+    buildZoneIntervals(edges, ipArray, maskArray);
+
+    const int zonesSize = DriverCommon::confZonesSize(ipArray.size());
 
     buf.reserve(zonesSize);
 
     // Fill the buffer
     PFORT_CONF_ZONES confZones = (PFORT_CONF_ZONES) buf.data();
-    char *data = confZones->data;
-
-    memset(confZones, 0, sizeof(FORT_CONF_ZONES_DATA_OFF));
+    char *data = (char *) confZones->ip;
 
     confZones->mask = zonesMask;
     confZones->enabled_mask = enabledMask;
+    confZones->interval_n = quint32(ipArray.size());
 
-    for (const auto &zoneData : zonesData) {
-        Q_ASSERT(!zoneData.isEmpty());
-
-        const int zoneIndex = DriverCommon::bitScanForward(zonesMask);
-        const quint32 zoneMask = (quint32(1) << zoneIndex);
-
-#define CONF_DATA_OFFSET quint32(data - confZones->data)
-        confZones->addr_off[zoneIndex] = CONF_DATA_OFFSET;
-        writeArray(&data, zoneData);
-#undef CONF_DATA_OFFSET
-
-        zonesMask ^= zoneMask;
-    }
+    writeLongs(&data, ipArray);
+    writeLongs(&data, maskArray);
+    writeIpIndex(&data, ipArray);
 
     return zonesSize;
 }
@@ -243,6 +355,25 @@ bool ConfUtil::loadZone(const QByteArray &buf, Ip4Range &ip4Range)
     return true;
 }
 
+void ConfUtil::setExeAppsKey(const QList<AppGroup *> &appGroups, const appentry_map_t &exeAppsMap)
+{
+    m_exeAppsKey.clear();
+
+    // Programs refer to the app groups by their indexes
+    for (const AppGroup *appGroup : appGroups) {
+        const qint64 appGroupId = appGroup->id();
+
+        m_exeAppsKey.append((const char *) &appGroupId, sizeof(qint64));
+    }
+
+    for (auto it = exeAppsMap.constBegin(); it != exeAppsMap.constEnd(); ++it) {
+        const quint32 appEntry = it.value();
+
+        m_exeAppsKey.append(it.key().toUtf8()).append('\0');
+        m_exeAppsKey.append((const char *) &appEntry, sizeof(quint32));
+    }
+}
+
 bool ConfUtil::parseAddressGroups(const QList<AddressGroup *> &addressGroups,
         addrranges_arr_t &addressRanges, longs_arr_t &addressGroupOffsets,
         quint32 &addressGroupsSize)
@@ -287,8 +418,8 @@ bool ConfUtil::parseAddressGroups(const QList<AddressGroup *> &addressGroups,
         addressGroupOffsets.append(addressGroupsSize);
 
         addressGroupsSize += FORT_CONF_ADDR_GROUP_OFF
-                + FORT_CONF_ADDR_LIST_SIZE(incIpSize, incPairSize)
-                + FORT_CONF_ADDR_LIST_SIZE(excIpSize, excPairSize);
+                + DriverCommon::confAddrListSize(incIpSize, incPairSize)
+                + DriverCommon::confAddrListSize(excIpSize, excPairSize);
     }
 
     return true;
@@ -473,14 +604,15 @@ void ConfUtil::parseAppPeriod(
 void ConfUtil::writeData(char *output, const FirewallConf &conf,
         const addrranges_arr_t &addressRanges, const longs_arr_t &addressGroupOffsets,
         const chars_arr_t &appPeriods, quint8 appPeriodsCount, const appentry_map_t &wildAppsMap,
-        const appentry_map_t &prefixAppsMap, const appentry_map_t &exeAppsMap)
+        const ConfWildIndex &wildIndex, const appentry_map_t &prefixAppsMap,
+        const ConfPrefixTrie &prefixTrie, const appentry_map_t &exeAppsMap)
 {
     PFORT_CONF_IO drvConfIo = (PFORT_CONF_IO) output;
     PFORT_CONF drvConf = &drvConfIo->conf;
     char *data = drvConf->data;
     quint32 addrGroupsOff;
     quint32 appPeriodsOff;
-    quint32 wildAppsOff, prefixAppsOff, exeAppsOff;
+    quint32 wildAppsOff, wildIndexOff, prefixAppsOff, prefixTrieOff, exeAppsOff;
 
 #define CONF_DATA_OFFSET quint32(data - drvConf->data)
     addrGroupsOff = CONF_DATA_OFFSET;
@@ -491,11 +623,17 @@ void ConfUtil::writeData(char *output, const FirewallConf &conf,
     writeChars(&data, appPeriods);
 
     wildAppsOff = CONF_DATA_OFFSET;
-    writeApps(&data, wildAppsMap);
+    writeApps(&data, wildAppsMap, true);
+
+    wildIndexOff = CONF_DATA_OFFSET;
+    wildIndex.write(&data);
 
     prefixAppsOff = CONF_DATA_OFFSET;
     writeApps(&data, prefixAppsMap, true);
 
+    prefixTrieOff = CONF_DATA_OFFSET;
+    prefixTrie.write(&data);
+
     exeAppsOff = CONF_DATA_OFFSET;
     writeApps(&data, exeAppsMap);
 #undef CONF_DATA_OFFSET
@@ -520,7 +658,9 @@ void ConfUtil::writeData(char *output, const FirewallConf &conf,
     drvConf->app_periods_off = appPeriodsOff;
 
     drvConf->wild_apps_off = wildAppsOff;
+    drvConf->wild_index_off = wildIndexOff;
     drvConf->prefix_apps_off = prefixAppsOff;
+    drvConf->prefix_trie_off = prefixTrieOff;
     drvConf->exe_apps_off = exeAppsOff;
 }
 
@@ -617,6 +757,9 @@ void ConfUtil::writeAddressList(char **data, const Ip4Range &ip4Range)
     writeLongs(data, ip4Range.ipArray());
     writeLongs(data, ip4Range.pairFromArray());
     writeLongs(data, ip4Range.pairToArray());
+
+    writeIpIndex(data, ip4Range.ipArray());
+    writeIpIndex(data, ip4Range.pairFromArray());
 }
 
 void ConfUtil::writeApps(char **data, const appentry_map_t &apps, bool useHeader)
@@ -667,6 +810,11 @@ void ConfUtil::writeLongs(char **data, const longs_arr_t &array)
     writeData(data, array.constData(), array.size(), sizeof(quint32));
 }
 
+void ConfUtil::writeIpIndex(char **data, const longs_arr_t &array)
+{
+    *data += DriverCommon::confIpIndexWrite(*data, array.constData(), array.size());
+}
+
 void ConfUtil::writeData(char **data, void const *src, int elemCount, uint elemSize)
 {
     const size_t arraySize = size_t(elemCount) * elemSize;
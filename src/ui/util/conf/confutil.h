@@ -12,6 +12,8 @@
 class AddressGroup;
 class AppGroup;
 class ConfAppsWalker;
+class ConfPrefixTrie;
+class ConfWildIndex;
 class EnvManager;
 class FirewallConf;
 
@@ -36,19 +38,23 @@ public:
 
     QString errorMessage() const { return m_errorMessage; }
 
+    // Identifies the exe apps of the written conf, except the programs
+    QByteArray exeAppsKey() const { return m_exeAppsKey; }
+
 signals:
     void errorMessageChanged();
 
 public slots:
     int write(const FirewallConf &conf, ConfAppsWalker *confAppsWalker, EnvManager &envManager,
             QByteArray &buf);
+    int writePatch(const FirewallConf &conf, EnvManager &envManager, QByteArray &buf);
     int writeFlags(const FirewallConf &conf, QByteArray &buf);
     int writeAppEntry(int groupIndex, bool useGroupPerm, bool applyChild, bool blocked,
             bool alerted, bool isNew, const QString &appPath, QByteArray &buf);
     int writeVersion(QByteArray &buf);
     int writeZone(const Ip4Range &ip4Range, QByteArray &buf);
-    int writeZones(quint32 zonesMask, quint32 enabledMask, quint32 dataSize,
-            const QList<QByteArray> &zonesData, QByteArray &buf);
+    int writeZones(quint32 zonesMask, quint32 enabledMask, const QList<QByteArray> &zonesData,
+            QByteArray &buf);
     int writeZoneFlag(int zoneId, bool enabled, QByteArray &buf);
 
     bool loadZone(const QByteArray &buf, Ip4Range &ip4Range);
@@ -56,6 +62,11 @@ public slots:
 private:
     void setErrorMessage(const QString &errorMessage);
 
+    int writeConf(const FirewallConf &conf, ConfAppsWalker *confAppsWalker,
+            EnvManager &envManager, QByteArray &buf, bool isPatch);
+
+    void setExeAppsKey(const QList<AppGroup *> &appGroups, const appentry_map_t &exeAppsMap);
+
     bool parseAddressGroups(const QList<AddressGroup *> &addressGroups,
             addrranges_arr_t &addressRanges, longs_arr_t &addressGroupOffsets,
             quint32 &addressGroupsSize);
@@ -90,7 +101,8 @@ private:
     static void writeData(char *output, const FirewallConf &conf,
             const addrranges_arr_t &addressRanges, const longs_arr_t &addressGroupOffsets,
             const chars_arr_t &appPeriods, quint8 appPeriodsCount,
-            const appentry_map_t &wildAppsMap, const appentry_map_t &prefixAppsMap,
+            const appentry_map_t &wildAppsMap, const ConfWildIndex &wildIndex,
+            const appentry_map_t &prefixAppsMap, const ConfPrefixTrie &prefixTrie,
             const appentry_map_t &exeAppsMap);
 
     static void writeAppGroupFlags(
@@ -107,6 +119,7 @@ private:
 
     static void writeShorts(char **data, const shorts_arr_t &array);
     static void writeLongs(char **data, const longs_arr_t &array);
+    static void writeIpIndex(char **data, const longs_arr_t &array);
     static void writeData(char **data, void const *src, int elemCount, uint elemSize);
     static void writeChars(char **data, const chars_arr_t &array);
     static void writeArray(char **data, const QByteArray &array);
@@ -116,6 +129,8 @@ private:
 
 private:
     QString m_errorMessage;
+
+    QByteArray m_exeAppsKey;
 };
 
 #endif // CONFUTIL_H
@@ -0,0 +1,200 @@
+#include "confwildindex.h"
+
+#include <QQueue>
+
+#include <common/fortconf.h>
+
+void ConfWildIndex::build(const QStringList &wildPaths)
+{
+    m_edgeCount = 0;
+    m_outCount = 0;
+
+    m_states.clear();
+    m_states.append(State()); // root
+
+    m_anyIndexes.clear();
+
+    quint16 index = 0;
+    for (const QString &wildPath : wildPaths) {
+        const QString anchor = literalAnchor(wildPath);
+
+        if (anchor.isEmpty()) {
+            m_anyIndexes.append(index);
+        } else {
+            const int stateIndex = addAnchor(anchor);
+
+            m_states[stateIndex].outs.append(index);
+            ++m_outCount;
+        }
+
+        ++index;
+    }
+
+    buildFailLinks();
+}
+
+quint32 ConfWildIndex::size() const
+{
+    return FORT_CONF_WILD_INDEX_SIZE(
+            m_states.size(), m_edgeCount, m_outCount, m_anyIndexes.size());
+}
+
+void ConfWildIndex::write(char **data) const
+{
+    PFORT_CONF_WILD_INDEX wildIndex = PFORT_CONF_WILD_INDEX(*data);
+
+    wildIndex->state_n = quint32(m_states.size());
+    wildIndex->edge_n = quint32(m_edgeCount);
+    wildIndex->out_n = quint32(m_outCount);
+    wildIndex->any_n = quint32(m_anyIndexes.size());
+
+    PFORT_CONF_WILD_STATE drvState = PFORT_CONF_WILD_STATE(wildIndex->data);
+    quint32 *edgeTargets = (quint32 *) (drvState + m_states.size());
+    quint16 *edgeChars = (quint16 *) (edgeTargets + m_edgeCount);
+    quint16 *outs = (quint16 *) ((char *) edgeChars
+            + FORT_CONF_STR_DATA_SIZE(m_edgeCount * sizeof(quint16)));
+
+    quint32 edgeOff = 0;
+    quint32 outOff = 0;
+
+    for (const State &state : m_states) {
+        drvState->edge_off = edgeOff;
+        drvState->edge_n = quint32(state.edges.size());
+        drvState->out_off = outOff;
+        drvState->out_n = quint32(state.outs.size());
+        drvState->fail = quint32(state.fail);
+        drvState->out_link = quint32(state.outLink);
+        ++drvState;
+
+        // Edges are sorted by chars
+        for (auto it = state.edges.constBegin(); it != state.edges.constEnd(); ++it) {
+            edgeChars[edgeOff] = it.key();
+            edgeTargets[edgeOff] = quint32(it.value());
+            ++edgeOff;
+        }
+
+        for (const quint16 index : state.outs) {
+            outs[outOff++] = index;
+        }
+    }
+
+    for (const quint16 index : m_anyIndexes) {
+        outs[outOff++] = index;
+    }
+
+    *data += size();
+}
+
+QString ConfWildIndex::literalAnchor(const QString &wildPath)
+{
+    const int n = wildPath.size();
+    int anchorStart = 0;
+    int anchorLen = 0;
+    int runStart = 0;
+
+    auto endRun = [&](int runEnd) {
+        if (runEnd - runStart > anchorLen) {
+            anchorStart = runStart;
+            anchorLen = runEnd - runStart;
+        }
+    };
+
+    for (int i = 0; i < n;) {
+        const QChar c = wildPath.at(i);
+
+        if (c == '*') {
+            endRun(i);
+
+            const int starsStart = i;
+            while (++i < n && wildPath.at(i) == '*') { }
+
+            // "**\" matches also no directories, so the separator may be absent in a path
+            const bool isStarStar = (i - starsStart) > 1;
+            runStart = (isStarStar && i < n && wildPath.at(i) == '\\') ? i + 1 : i;
+        } else if (c == '?') {
+            endRun(i);
+
+            runStart = ++i;
+        } else if (c == '[') {
+            endRun(i);
+
+            // Skip the character class
+            if (++i < n && (wildPath.at(i) == '!' || wildPath.at(i) == '^')) {
+                ++i;
+            }
+            ++i; // the first char of the class may be ']'
+            while (i < n && wildPath.at(i) != ']') {
+                ++i;
+            }
+            if (i >= n)
+                return {}; // not terminated class: the path doesn't match anything
+
+            runStart = ++i;
+        } else {
+            ++i;
+        }
+    }
+
+    endRun(n);
+
+    return wildPath.mid(anchorStart, anchorLen);
+}
+
+int ConfWildIndex::addAnchor(const QString &anchor)
+{
+    int stateIndex = 0;
+
+    for (const QChar c : anchor) {
+        const quint16 ch = c.unicode();
+
+        const int nextIndex = m_states[stateIndex].edges.value(ch, -1);
+        if (nextIndex > 0) {
+            stateIndex = nextIndex;
+            continue;
+        }
+
+        const int newIndex = m_states.size();
+        m_states.append(State());
+
+        m_states[stateIndex].edges.insert(ch, newIndex);
+        ++m_edgeCount;
+
+        stateIndex = newIndex;
+    }
+
+    return stateIndex;
+}
+
+void ConfWildIndex::buildFailLinks()
+{
+    QQueue<int> queue;
+
+    for (const int childIndex : m_states[0].edges) {
+        queue.enqueue(childIndex);
+    }
+
+    // Breadth-first: fail states are shorter, so they are ready
+    while (!queue.isEmpty()) {
+        const int stateIndex = queue.dequeue();
+        const State &state = m_states[stateIndex];
+
+        for (auto it = state.edges.constBegin(); it != state.edges.constEnd(); ++it) {
+            const quint16 ch = it.key();
+            const int childIndex = it.value();
+
+            int failIndex = state.fail;
+            int nextIndex;
+            while ((nextIndex = m_states[failIndex].edges.value(ch, -1)) < 0 && failIndex != 0) {
+                failIndex = m_states[failIndex].fail;
+            }
+
+            State &child = m_states[childIndex];
+            child.fail = (nextIndex > 0 && nextIndex != childIndex) ? nextIndex : 0;
+
+            const State &failState = m_states[child.fail];
+            child.outLink = failState.outs.isEmpty() ? failState.outLink : child.fail;
+
+            queue.enqueue(childIndex);
+        }
+    }
+}
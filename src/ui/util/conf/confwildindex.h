@@ -0,0 +1,44 @@
+#ifndef CONFWILDINDEX_H
+#define CONFWILDINDEX_H
+
+#include <QMap>
+#include <QObject>
+#include <QVector>
+
+// Aho-Corasick automaton over the longest literal anchors of wildcard paths.
+// The driver checks with wildmatch() only the paths, which anchors are found.
+class ConfWildIndex
+{
+public:
+    explicit ConfWildIndex() = default;
+
+    void build(const QStringList &wildPaths);
+
+    quint32 size() const;
+
+    void write(char **data) const;
+
+    static QString literalAnchor(const QString &wildPath);
+
+private:
+    int addAnchor(const QString &anchor);
+
+    void buildFailLinks();
+
+private:
+    struct State
+    {
+        QMap<quint16, int> edges;
+        QVector<quint16> outs;
+        int fail = 0;
+        int outLink = 0;
+    };
+
+    int m_edgeCount = 0;
+    int m_outCount = 0;
+
+    QVector<State> m_states;
+    QVector<quint16> m_anyIndexes;
+};
+
+#endif // CONFWILDINDEX_H
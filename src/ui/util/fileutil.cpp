@@ -207,6 +207,15 @@ bool writeFileData(const QString &filePath, const QByteArray &data)
     return file.write(data) == data.size() && file.flush();
 }
 
+bool appendFileData(const QString &filePath, const QByteArray &data)
+{
+    QFile file(filePath);
+    if (!file.open(QFile::WriteOnly | QFile::Append))
+        return false;
+
+    return file.write(data) == data.size() && file.flush();
+}
+
 QDateTime fileModTime(const QString &filePath)
 {
     QFileInfo fi(filePath);
@@ -46,6 +46,7 @@ QByteArray readFileData(const QString &filePath, qint64 maxSize = -1);
 
 bool writeFile(const QString &filePath, const QString &text);
 bool writeFileData(const QString &filePath, const QByteArray &data);
+bool appendFileData(const QString &filePath, const QByteArray &data);
 
 QDateTime fileModTime(const QString &filePath);
 